@@ -0,0 +1,193 @@
+/*
+ * micro.c -- fbpanel-bench harness.
+ *
+ * For every case (see micro.h): run setup, double the batch size until one
+ * batch takes at least --sample-us, run --warmup batches and discard them,
+ * then time --repetitions batches.  A sample is the batch time divided by
+ * the batch size.
+ *
+ * Output, one JSON object per case on stdout:
+ *
+ *   {"case":"xconf.read_block.heap","batch":64,
+ *    "ns_per_call":{"n":..,"min":..,"mean":..,"p50":..,"p90":..,"p99":..,"max":..}}
+ *
+ * No display is needed; cases that draw (chart.draw) are skipped unless
+ * one can be opened.  Skipped cases are reported on stderr.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "micro.h"
+#include "stats.h"
+
+static bench_case *subjects[] = {
+    bench_xconf, bench_cpu, bench_mem, bench_net, bench_diskio,
+    bench_battery, bench_icons, bench_taskbar, bench_fbwidgets, bench_chart,
+    NULL
+};
+
+static int warmup = 3;
+static int repetitions = 30;
+static int sample_us = 2000;
+static gchar *filter;
+static gboolean list;
+
+FILE *
+bench_fopen(const char *path, const char *mode)
+{
+    gchar *name, *full;
+    FILE *fp;
+
+    if (!g_str_has_prefix(path, "/proc/"))
+        return fopen(path, mode);
+    name = g_strdelimit(g_strdup(path + 1), "/", '_');
+    full = bench_data_path(name);
+    fp = fopen(full, mode);
+    g_free(full);
+    g_free(name);
+    return fp;
+}
+
+gchar *
+bench_data_path(const char *name)
+{
+    return g_build_filename(BENCH_DATA_DIR, name, NULL);
+}
+
+GdkPixbuf *
+bench_icon_pixbuf(int size)
+{
+    GdkPixbuf *pix;
+    guchar *row, *px;
+    int x, y, stride, d;
+
+    pix = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+    row = gdk_pixbuf_get_pixels(pix);
+    stride = gdk_pixbuf_get_rowstride(pix);
+    for (y = 0; y < size; y++, row += stride)
+        for (x = 0, px = row; x < size; x++, px += 4) {
+            /* distance to the nearest edge: transparent border, ramp in */
+            d = MIN(MIN(x, y), MIN(size - 1 - x, size - 1 - y));
+            px[0] = x * 255 / size;
+            px[1] = y * 255 / size;
+            px[2] = (x + y) * 127 / size;
+            px[3] = d < 2 ? 0 : MIN(255, d * 64);
+        }
+    return pix;
+}
+
+gulong *
+bench_icon_argb(int size)
+{
+    GdkPixbuf *pix = bench_icon_pixbuf(size);
+    guchar *row, *px;
+    gulong *argb, *p;
+    int x, y, stride;
+
+    p = argb = g_new(gulong, size * size);
+    row = gdk_pixbuf_get_pixels(pix);
+    stride = gdk_pixbuf_get_rowstride(pix);
+    for (y = 0; y < size; y++, row += stride)
+        for (x = 0, px = row; x < size; x++, px += 4)
+            *p++ = (gulong) px[3] << 24 | px[0] << 16 | px[1] << 8 | px[2];
+    g_object_unref(pix);
+    return argb;
+}
+
+static gint64
+run_batch(bench_case *c, int batch)
+{
+    gint64 t0;
+    int i;
+
+    t0 = g_get_monotonic_time();
+    for (i = 0; i < batch; i++)
+        c->run();
+    return g_get_monotonic_time() - t0;
+}
+
+static void
+run_case(bench_case *c)
+{
+    GString *out;
+    double *ns;
+    int batch, i;
+
+    if (c->setup && !c->setup()) {
+        g_printerr("bench: %s skipped\n", c->name);
+        return;
+    }
+    for (batch = 1; batch < (1 << 24); batch *= 2)
+        if (run_batch(c, batch) >= sample_us)
+            break;
+    for (i = 0; i < warmup; i++)
+        run_batch(c, batch);
+    ns = g_new(double, repetitions);
+    for (i = 0; i < repetitions; i++)
+        ns[i] = run_batch(c, batch) * 1000.0 / batch;
+    if (c->teardown)
+        c->teardown();
+
+    out = g_string_new(NULL);
+    g_string_printf(out, "{\"case\":\"%s\",\"batch\":%d", c->name, batch);
+    bench_json_dist(out, "ns_per_call", ns, repetitions);
+    g_string_append(out, "}\n");
+    fputs(out->str, stdout);
+    fflush(stdout);
+    g_string_free(out, TRUE);
+    g_free(ns);
+}
+
+static GOptionEntry entries[] = {
+    { "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+      "run only cases whose name contains TEXT", "TEXT" },
+    { "warmup", 'w', 0, G_OPTION_ARG_INT, &warmup,
+      "discarded batches per case (3)", "N" },
+    { "repetitions", 'r', 0, G_OPTION_ARG_INT, &repetitions,
+      "measured batches per case (30)", "N" },
+    { "sample-us", 0, 0, G_OPTION_ARG_INT, &sample_us,
+      "minimum length of one batch in microseconds (2000)", "US" },
+    { "list", 'l', 0, G_OPTION_ARG_NONE, &list,
+      "list the cases and exit", NULL },
+    { NULL }
+};
+
+int
+main(int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    GError *err = NULL;
+    bench_case *c;
+    int i;
+
+    ctx = g_option_context_new("- fbpanel microbenchmarks");
+    g_option_context_add_main_entries(ctx, entries, NULL);
+    g_option_context_set_ignore_unknown_options(ctx, TRUE);
+    if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+        g_printerr("bench: %s\n", err->message);
+        return 2;
+    }
+    g_option_context_free(ctx);
+    warmup = MAX(warmup, 0);
+    repetitions = MAX(repetitions, 1);
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+    /* only the drawing cases need it */
+    gtk_init_check(&argc, &argv);
+
+    for (i = 0; subjects[i]; i++)
+        for (c = subjects[i]; c->name; c++) {
+            if (filter && !strstr(c->name, filter))
+                continue;
+            if (list)
+                printf("%s\n", c->name);
+            else
+                run_case(c);
+        }
+    return 0;
+}
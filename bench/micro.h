@@ -0,0 +1,56 @@
+/*
+ * micro.h -- fbpanel-bench: microbenchmarks for parsers and pixel kernels.
+ *
+ * Every micro_<subject>.c #includes the source file it measures, so the
+ * static helpers in there can be called directly without exporting them;
+ * the fbpanel-bench target leaves those files out of its own copy of the
+ * core sources.  Before the include, fopen() is redirected to
+ * bench_fopen(), which serves /proc/... from the recorded snapshots in
+ * bench/data (BENCH_DATA_DIR), so results do not depend on the host.
+ * Plugin sources are included with -Wunused-variable silenced: built
+ * without PLUGIN, their class_ptr has no ctor/dtor to use it.
+ *
+ * A subject exports a NULL-terminated table of bench_case; micro.c runs
+ * each case with calibration, warmup and repetitions and prints one JSON
+ * line per case.
+ */
+#ifndef _BENCH_MICRO_H_
+#define _BENCH_MICRO_H_
+
+#include <stdio.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+typedef struct {
+    const char *name;        /* "<subject>.<function>[.<input>]" */
+    /* prepare inputs; FALSE skips the case (say why on stderr); may be NULL */
+    gboolean (*setup)(void);
+    void (*run)(void);       /* one call of the function under test */
+    void (*teardown)(void);  /* may be NULL */
+} bench_case;
+
+/* bench_fopen -- fopen() with /proc/<a>/<b> mapped to BENCH_DATA_DIR/proc_<a>_<b> */
+FILE *bench_fopen(const char *path, const char *mode);
+
+/* bench_data_path -- BENCH_DATA_DIR/@name, g_free() it */
+gchar *bench_data_path(const char *name);
+
+/* bench_icon_pixbuf -- @size x @size RGBA test icon (gradient, soft edge) */
+GdkPixbuf *bench_icon_pixbuf(int size);
+
+/* bench_icon_argb -- the same icon as _NET_WM_ICON data, without the
+ * width/height header; g_free() it */
+gulong *bench_icon_argb(int size);
+
+extern bench_case bench_xconf[];
+extern bench_case bench_cpu[];
+extern bench_case bench_mem[];
+extern bench_case bench_net[];
+extern bench_case bench_diskio[];
+extern bench_case bench_battery[];
+extern bench_case bench_icons[];
+extern bench_case bench_taskbar[];
+extern bench_case bench_fbwidgets[];
+extern bench_case bench_chart[];
+
+#endif /* _BENCH_MICRO_H_ */
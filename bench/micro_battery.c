@@ -0,0 +1,30 @@
+/*
+ * micro_battery.c -- battery plugin sysfs uevent parser.
+ */
+
+#include "micro.h"
+#include "../plugins/battery/power_supply.c"
+
+static gchar *uevent;
+
+static gboolean
+uevent_setup(void)
+{
+    if (!uevent)
+        uevent = bench_data_path("power_supply_BAT0_uevent");
+    return TRUE;
+}
+
+static void
+uevent_run(void)
+{
+    GHashTable *h = uevent_parse(uevent);
+
+    if (h)
+        g_hash_table_destroy(h);
+}
+
+bench_case bench_battery[] = {
+    { "battery.uevent_parse", uevent_setup, uevent_run, NULL },
+    { NULL }
+};
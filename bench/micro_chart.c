@@ -0,0 +1,70 @@
+/*
+ * micro_chart.c -- chart plugin chart_draw on a 120x32, two-row chart.
+ *
+ * Needs a display (run under Xvfb); skipped otherwise.  The chart draws
+ * into a mapped popup window standing in for the panel, the ticks are a
+ * fixed pseudo-random history and each call ends with gdk_flush() so the
+ * X server's work is included.
+ */
+
+#include "micro.h"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../plugins/chart/chart.c"
+#pragma GCC diagnostic pop
+
+static chart_priv chart;
+static panel chart_panel;
+
+static gboolean
+chart_draw_setup(void)
+{
+    static gchar *colors[] = { "green", "orange" };
+    GtkWidget *win;
+    GRand *rnd;
+    int i, j;
+
+    if (!gdk_display_get_default()) {
+        g_printerr("bench: chart.draw needs a display\n");
+        return FALSE;
+    }
+    win = gtk_window_new(GTK_WINDOW_POPUP);
+    gtk_window_set_default_size(GTK_WINDOW(win), 120, 32);
+    gtk_widget_show(win);
+    chart_panel.topgwin = win;
+    chart.plugin.panel = &chart_panel;
+    chart.da = win;
+    chart.w = 120;
+    chart.h = 32;
+    chart.rows = 2;
+    chart_alloc_ticks(&chart);
+    chart_alloc_gcs(&chart, colors);
+    rnd = g_rand_new_with_seed(1);
+    for (i = 0; i < chart.w; i++)
+        for (j = 0; j < chart.rows; j++)
+            chart.ticks[j][i] = g_rand_int_range(rnd, 0, chart.h / 2);
+    g_rand_free(rnd);
+    gdk_flush();
+    return TRUE;
+}
+
+static void
+chart_draw_run(void)
+{
+    chart_draw(&chart);
+    gdk_flush();
+}
+
+static void
+chart_draw_teardown(void)
+{
+    chart_free_gcs(&chart);
+    chart_free_ticks(&chart);
+    gtk_widget_destroy(chart.da);
+}
+
+bench_case bench_chart[] = {
+    { "chart.draw.120x32", chart_draw_setup, chart_draw_run,
+      chart_draw_teardown },
+    { NULL }
+};
@@ -0,0 +1,10 @@
+/*
+ * micro_core.c -- panel.c for fbpanel-bench, with its main() renamed.
+ *
+ * The plugin sources the cases #include refer to panel.c's globals (fbev,
+ * the_panel, ...), so fbpanel-bench links the whole core; the harness in
+ * micro.c provides main().
+ */
+
+#define main fbpanel_main
+#include "../panel/panel.c"
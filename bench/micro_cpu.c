@@ -0,0 +1,24 @@
+/*
+ * micro_cpu.c -- cpu plugin /proc/stat parser (16-thread snapshot).
+ */
+
+#include "micro.h"
+#define fopen(path, mode) bench_fopen(path, mode)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../plugins/cpu/cpu.c"
+#pragma GCC diagnostic pop
+#undef fopen
+
+static void
+proc_stat_run(void)
+{
+    struct cpu_stat s;
+
+    cpu_get_load_real(&s);
+}
+
+bench_case bench_cpu[] = {
+    { "cpu.proc_stat", NULL, proc_stat_run, NULL },
+    { NULL }
+};
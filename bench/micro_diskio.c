@@ -0,0 +1,37 @@
+/*
+ * micro_diskio.c -- diskio plugin /proc/diskstats parser.
+ *
+ * The snapshot has 16 loop devices ahead of the NVMe partitions, as on a
+ * desktop with snaps installed; nvme0n1p2 is looked up.
+ */
+
+#include "micro.h"
+#define fopen(path, mode) bench_fopen(path, mode)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../plugins/diskio/diskio.c"
+#pragma GCC diagnostic pop
+#undef fopen
+
+static diskio_priv disk;
+
+static gboolean
+proc_diskstats_setup(void)
+{
+    disk.device = "nvme0n1p2";
+    return TRUE;
+}
+
+static void
+proc_diskstats_run(void)
+{
+    struct diskio_stat s;
+
+    diskio_read_stat(&disk, &s);
+}
+
+bench_case bench_diskio[] = {
+    { "diskio.proc_diskstats", proc_diskstats_setup, proc_diskstats_run,
+      NULL },
+    { NULL }
+};
@@ -0,0 +1,38 @@
+/*
+ * micro_fbwidgets.c -- fb_pixbuf_make_back_image (48px and 128px icons).
+ */
+
+#include "micro.h"
+#include "../panel/fbwidgets.c"
+
+static GdkPixbuf *icon48, *icon128;
+
+static gboolean
+back_image_setup(void)
+{
+    if (!icon48) {
+        icon48 = bench_icon_pixbuf(48);
+        icon128 = bench_icon_pixbuf(128);
+    }
+    return TRUE;
+}
+
+static void
+back_image_48_run(void)
+{
+    g_object_unref(fb_pixbuf_make_back_image(icon48, 0x202020));
+}
+
+static void
+back_image_128_run(void)
+{
+    g_object_unref(fb_pixbuf_make_back_image(icon128, 0x202020));
+}
+
+bench_case bench_fbwidgets[] = {
+    { "fbwidgets.make_back_image.48", back_image_setup, back_image_48_run,
+      NULL },
+    { "fbwidgets.make_back_image.128", back_image_setup, back_image_128_run,
+      NULL },
+    { NULL }
+};
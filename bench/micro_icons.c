@@ -0,0 +1,43 @@
+/*
+ * micro_icons.c -- icons plugin pixbuf2argb (48px and 128px icons).
+ */
+
+#include "micro.h"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../plugins/icons/icons.c"
+#pragma GCC diagnostic pop
+
+static GdkPixbuf *icon48, *icon128;
+
+static gboolean
+pixbuf2argb_setup(void)
+{
+    if (!icon48) {
+        icon48 = bench_icon_pixbuf(48);
+        icon128 = bench_icon_pixbuf(128);
+    }
+    return TRUE;
+}
+
+static void
+pixbuf2argb_48_run(void)
+{
+    int size;
+
+    g_free(pixbuf2argb(icon48, &size));
+}
+
+static void
+pixbuf2argb_128_run(void)
+{
+    int size;
+
+    g_free(pixbuf2argb(icon128, &size));
+}
+
+bench_case bench_icons[] = {
+    { "icons.pixbuf2argb.48", pixbuf2argb_setup, pixbuf2argb_48_run, NULL },
+    { "icons.pixbuf2argb.128", pixbuf2argb_setup, pixbuf2argb_128_run, NULL },
+    { NULL }
+};
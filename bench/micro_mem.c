@@ -0,0 +1,22 @@
+/*
+ * micro_mem.c -- mem plugin /proc/meminfo parser.
+ */
+
+#include "micro.h"
+#define fopen(path, mode) bench_fopen(path, mode)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../plugins/mem/mem.c"
+#pragma GCC diagnostic pop
+#undef fopen
+
+static void
+proc_meminfo_run(void)
+{
+    mem_usage();
+}
+
+bench_case bench_mem[] = {
+    { "mem.proc_meminfo", NULL, proc_meminfo_run, NULL },
+    { NULL }
+};
@@ -0,0 +1,36 @@
+/*
+ * micro_net.c -- net plugin /proc/net/dev parser.
+ *
+ * The snapshot lists 18 interfaces (loopback, wired, wireless, a docker
+ * bridge with a dozen veths); wlp2s0, the third, is looked up.
+ */
+
+#include "micro.h"
+#define fopen(path, mode) bench_fopen(path, mode)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../plugins/net/net.c"
+#pragma GCC diagnostic pop
+#undef fopen
+
+static net_priv net;
+
+static gboolean
+proc_net_dev_setup(void)
+{
+    net.iface = "wlp2s0";
+    return TRUE;
+}
+
+static void
+proc_net_dev_run(void)
+{
+    struct net_stat s;
+
+    net_get_load_real(&net, &s);
+}
+
+bench_case bench_net[] = {
+    { "net.proc_net_dev", proc_net_dev_setup, proc_net_dev_run, NULL },
+    { NULL }
+};
@@ -0,0 +1,43 @@
+/*
+ * micro_taskbar.c -- taskbar argbdata_to_pixdata (48px and 128px icons).
+ *
+ * The pager has an identical copy; this one stands for both.
+ */
+
+#include "micro.h"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../plugins/taskbar/taskbar.c"
+#pragma GCC diagnostic pop
+
+static gulong *argb48, *argb128;
+
+static gboolean
+argbdata_setup(void)
+{
+    if (!argb48) {
+        argb48 = bench_icon_argb(48);
+        argb128 = bench_icon_argb(128);
+    }
+    return TRUE;
+}
+
+static void
+argbdata_48_run(void)
+{
+    g_free(argbdata_to_pixdata(argb48, 48 * 48));
+}
+
+static void
+argbdata_128_run(void)
+{
+    g_free(argbdata_to_pixdata(argb128, 128 * 128));
+}
+
+bench_case bench_taskbar[] = {
+    { "taskbar.argbdata_to_pixdata.48", argbdata_setup, argbdata_48_run,
+      NULL },
+    { "taskbar.argbdata_to_pixdata.128", argbdata_setup, argbdata_128_run,
+      NULL },
+    { NULL }
+};
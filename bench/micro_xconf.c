@@ -0,0 +1,90 @@
+/*
+ * micro_xconf.c -- xconf parser cases (read_line, read_block).
+ *
+ * Input: a generated profile of 300 menu plugins with nested submenus,
+ * comments and blank lines (about 22000 lines), parsed from memory with
+ * fmemopen() so file-system cost is left out.
+ */
+
+#include "micro.h"
+#include "../panel/xconf.c"
+
+static gchar *conf;
+static gsize conf_len;
+
+static gboolean
+xconf_setup(void)
+{
+    GString *s;
+    int i, j;
+
+    if (conf)
+        return TRUE;
+    s = g_string_new("# fbpanel-bench profile\n\nGlobal {\n"
+        "    edge = bottom\n    allign = center\n    widthtype = percent\n"
+        "    width = 100\n    heighttype = pixel\n    height = 28\n"
+        "    transparent = true\n    tintcolor = #202020\n    alpha = 40\n"
+        "    autohide = false\n    setdocktype = true\n"
+        "    setpartialstrut = true\n}\n\n");
+    for (i = 0; i < 300; i++) {
+        g_string_append_printf(s, "Plugin {\n    type = menu\n"
+            "    expand = false\n    padding = %d\n    Config {\n"
+            "        image = /usr/share/icons/hicolor/24x24/apps/menu%d.png\n"
+            "        systemmenu {\n        }\n\n"
+            "        # applications %d\n        menu {\n"
+            "            name = Group %d\n            icon = folder\n",
+            i % 4, i, i, i);
+        for (j = 0; j < 10; j++)
+            g_string_append_printf(s, "            item {\n"
+                "                name = Application %d.%d\n"
+                "                icon = application-x-executable\n"
+                "                action = /usr/bin/app%d --profile %d\n"
+                "            }\n", i, j, j, i);
+        g_string_append(s, "        }\n        separator {\n        }\n"
+            "        item {\n            name = Log out\n"
+            "            icon = system-log-out\n"
+            "            action = pkill -u $USER\n        }\n"
+            "    }\n}\n\n");
+    }
+    conf_len = s->len;
+    conf = g_string_free(s, FALSE);
+    return TRUE;
+}
+
+static void
+read_line_run(void)
+{
+    FILE *fp = fmemopen(conf, conf_len, "r");
+    line s;
+
+    while (read_line(fp, &s) != LINE_NONE)
+        ;
+    fclose(fp);
+}
+
+static void
+read_block_heap_run(void)
+{
+    FILE *fp = fmemopen(conf, conf_len, "r");
+
+    xconf_del(read_block(fp, "profile", NULL), FALSE);
+    fclose(fp);
+}
+
+static void
+read_block_arena_run(void)
+{
+    FILE *fp = fmemopen(conf, conf_len, "r");
+    xconf_arena *a = xconf_arena_new();
+
+    read_block(fp, "profile", a);
+    xconf_arena_free(a);
+    fclose(fp);
+}
+
+bench_case bench_xconf[] = {
+    { "xconf.read_line", xconf_setup, read_line_run, NULL },
+    { "xconf.read_block.heap", xconf_setup, read_block_heap_run, NULL },
+    { "xconf.read_block.arena", xconf_setup, read_block_arena_run, NULL },
+    { NULL }
+};
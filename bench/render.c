@@ -0,0 +1,159 @@
+/*
+ * render.c -- offscreen render benchmark (fbpanel-render-bench).
+ *
+ * Procedure, for every panel and, in it, every plugin's pwid followed by the
+ * panel's topgwin as a whole:
+ *
+ *   layout -- gtk_widget_queue_resize() + size_request + size_allocate with
+ *             the widget's current allocation, so only its own subtree is
+ *             measured and re-laid out; nothing around it moves.
+ *   paint  -- gtk_widget_get_snapshot() renders the widget into an offscreen
+ *             pixmap by running its expose handlers against it.
+ *
+ * Each step ends with XSync() so the time includes the X server's share;
+ * the X requests a step issued are counted with XNextRequest() (minus the
+ * XSync itself).  BENCH_WARMUP rounds are run and discarded first.  The
+ * benchmark runs from one main-loop callback, so nothing else (timers,
+ * property changes) is interleaved with the measurements.
+ *
+ * Output, one JSON object per line on stdout:
+ *
+ *   {"panel":0,"widget":"plugin","type":"taskbar","index":3,
+ *    "width":600,"height":24,"transparent":1,
+ *    "layout_us":{"n":..,"min":..,"mean":..,"p50":..,"p90":..,"p99":..,"max":..},
+ *    "paint_us":{..},"layout_requests":{..},"paint_requests":{..}}
+ *
+ * The topgwin line has "widget" and "type" "panel" and "index" one past
+ * the last plugin.
+ * Diagnostics go to stderr, so stdout can be collected as-is.
+ */
+
+#include <stdio.h>
+
+#include <gdk/gdkx.h>
+
+#include "panel.h"
+#include "plugin.h"
+#include "render.h"
+#include "stats.h"
+
+//#define DEBUGPRN
+#include "dbg.h"
+
+#define BENCH_WARMUP 5     /* discarded rounds per widget */
+#define BENCH_SETTLE 500   /* ms for the panels to be mapped and placed */
+
+static GList *bench_panels;
+static int bench_iterations;
+
+/*
+ * bench_widget -- measure @w and append its samples to @out.
+ * Returns FALSE (and appends nothing) if @w is not drawable.
+ */
+static gboolean
+bench_widget(GtkWidget *w, GString *out)
+{
+    Display *dpy = GDK_DISPLAY();
+    int n = bench_iterations;
+    double *layout, *paint, *layout_req, *paint_req;
+    GtkRequisition req;
+    GtkAllocation alloc;
+    GdkPixmap *pix;
+    unsigned long r0;
+    gint64 t0;
+    int i;
+
+    ENTER;
+    if (!GTK_WIDGET_DRAWABLE(w))
+        RET(FALSE);
+    layout = g_new(double, 4 * n);
+    paint = layout + n;
+    layout_req = paint + n;
+    paint_req = layout_req + n;
+    for (i = -BENCH_WARMUP; i < n; i++) {
+        alloc = w->allocation;
+        r0 = XNextRequest(dpy);
+        t0 = g_get_monotonic_time();
+        gtk_widget_queue_resize(w);
+        gtk_widget_size_request(w, &req);
+        gtk_widget_size_allocate(w, &alloc);
+        XSync(dpy, False);
+        if (i >= 0) {
+            layout[i] = g_get_monotonic_time() - t0;
+            layout_req[i] = XNextRequest(dpy) - r0 - 1;
+        }
+
+        r0 = XNextRequest(dpy);
+        t0 = g_get_monotonic_time();
+        pix = gtk_widget_get_snapshot(w, NULL);
+        XSync(dpy, False);
+        if (i >= 0) {
+            paint[i] = g_get_monotonic_time() - t0;
+            paint_req[i] = XNextRequest(dpy) - r0 - 1;
+        }
+        if (pix)
+            g_object_unref(pix);
+    }
+    g_string_append_printf(out, ",\"width\":%d,\"height\":%d",
+        w->allocation.width, w->allocation.height);
+    bench_json_dist(out, "layout_us", layout, n);
+    bench_json_dist(out, "paint_us", paint, n);
+    bench_json_dist(out, "layout_requests", layout_req, n);
+    bench_json_dist(out, "paint_requests", paint_req, n);
+    g_free(layout);
+    RET(TRUE);
+}
+
+/*
+ * bench_emit -- measure one widget and print its line, or say why not.
+ */
+static void
+bench_emit(GString *out, GtkWidget *w, const gchar *what)
+{
+    if (bench_widget(w, out)) {
+        g_string_append(out, "}\n");
+        fputs(out->str, stdout);
+    } else
+        g_printerr("render-bench: %s is not drawable, skipped\n", what);
+}
+
+static gboolean
+render_bench_run(gpointer data)
+{
+    GString *out = g_string_new(NULL);
+    plugin_instance *plug;
+    GList *l, *m;
+    panel *p;
+    int pn, i;
+
+    ENTER;
+    for (l = bench_panels, pn = 0; l; l = l->next, pn++) {
+        p = l->data;
+        for (m = p->plugins, i = 0; m; m = m->next, i++) {
+            plug = m->data;
+            g_string_printf(out, "{\"panel\":%d,\"widget\":\"plugin\","
+                "\"type\":\"%s\",\"index\":%d,\"transparent\":%d",
+                pn, plug->class->type, i, p->transparent);
+            bench_emit(out, plug->pwid, plug->class->type);
+        }
+        g_string_printf(out, "{\"panel\":%d,\"widget\":\"panel\","
+            "\"type\":\"panel\",\"index\":%d,\"transparent\":%d",
+            pn, i, p->transparent);
+        bench_emit(out, p->topgwin, "panel");
+    }
+    fflush(stdout);
+    g_string_free(out, TRUE);
+    force_quit = 1;
+    gtk_main_quit();
+    RET(FALSE);
+}
+
+void
+render_bench_start(GList *panels, int iterations)
+{
+    ENTER;
+    bench_panels = panels;
+    bench_iterations = MAX(iterations, 1);
+    g_timeout_add(BENCH_SETTLE, render_bench_run, NULL);
+    RET();
+}
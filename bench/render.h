@@ -0,0 +1,27 @@
+/*
+ * render.h -- offscreen render benchmark for fbpanel-render-bench.
+ *
+ * fbpanel-render-bench is fbpanel built with FBPANEL_RENDER_BENCH defined:
+ * it loads a profile exactly as fbpanel does, then, instead of serving the
+ * desktop, times layout and paint of every plugin and panel and exits.
+ * See render.c for the procedure and the output format.
+ */
+#ifndef _RENDER_BENCH_H_
+#define _RENDER_BENCH_H_
+
+#include <glib.h>
+
+/*
+ * render_bench_start -- schedule the benchmark of @panels (GList of panel*).
+ *
+ * Runs from the main loop once the panels have been placed and mapped,
+ * writes one JSON object per plugin and per panel to stdout, then sets
+ * force_quit and leaves gtk_main().
+ *
+ * Parameters:
+ *   panels     -- the running panels; must stay alive until the run ends.
+ *   iterations -- measured repetitions per widget (after a few warmups).
+ */
+void render_bench_start(GList *panels, int iterations);
+
+#endif /* _RENDER_BENCH_H_ */
@@ -0,0 +1,352 @@
+/*
+ * snicheck.c -- fbpanel-sni-check: the tray's StatusNotifierItem host
+ * against a private session bus.
+ *
+ * Starts `dbus-daemon --session --print-address`, points
+ * DBUS_SESSION_BUS_ADDRESS at it and creates an SniHost (so the host also
+ * provides the watcher).  A fake item is served from a second connection
+ * to the same bus and registered with the watcher.  Checks, in order:
+ *
+ *   appear  - the item shows up in the host and its icon is visible
+ *   batch   - a burst of SNI_CHECK_BURST signals of each New* kind costs
+ *             exactly one GetAll
+ *   pixmap  - a GetAll that sends the same IconPixmap again is served
+ *             from the pixmap cache (same pixbuf, no new cache entry),
+ *             also after switching to another pixmap and back
+ *   vanish  - closing the item's connection removes it from the host
+ *
+ * Prints "<check>: ok" or "<check>: FAIL (...)" per check on stdout.  Exit
+ * status is 0 if every check passed, 1 if one failed, and 77 (skipped) if
+ * there is no display or no dbus-daemon.
+ *
+ * sni.c is #included so the host's internals (items, pixmap cache) can be
+ * inspected directly.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../plugins/tray/sni.c"
+
+#define SNI_CHECK_SIZE    24    /* host icon size */
+#define SNI_CHECK_BURST   10    /* signals of each kind per burst */
+#define SNI_CHECK_WAIT    3000  /* ms to wait for a condition */
+
+static GDBusConnection *item_conn;
+static guint item_reg;
+static GVariant *item_pixmap;   /* current IconPixmap value */
+static int get_alls;            /* Title reads, i.e. GetAll calls served */
+static int failures;
+
+static const gchar item_xml[] =
+    "<node>"
+    " <interface name='" SNI_ITEM_IFACE "'>"
+    "  <property name='Status' type='s' access='read'/>"
+    "  <property name='Title' type='s' access='read'/>"
+    "  <property name='IconPixmap' type='a(iiay)' access='read'/>"
+    " </interface>"
+    "</node>";
+
+/*
+ * item_pixmap_new - a(iiay) with one size x size pixmap filled with @argb.
+ */
+static GVariant *
+item_pixmap_new(int size, guint32 argb)
+{
+    GVariantBuilder b;
+    guchar *data;
+    GVariant *bytes;
+    int i;
+
+    data = g_malloc(size * size * 4);
+    for (i = 0; i < size * size * 4; i += 4) {
+        data[i]     = argb >> 24;
+        data[i + 1] = argb >> 16;
+        data[i + 2] = argb >> 8;
+        data[i + 3] = argb;
+    }
+    bytes = g_variant_new_from_data(G_VARIANT_TYPE("ay"), data,
+        size * size * 4, TRUE, g_free, data);
+    g_variant_builder_init(&b, G_VARIANT_TYPE("a(iiay)"));
+    g_variant_builder_add(&b, "(ii@ay)", size, size, bytes);
+    return g_variant_ref_sink(g_variant_builder_end(&b));
+}
+
+static GVariant *
+item_get_property(GDBusConnection *conn, const gchar *sender,
+    const gchar *path, const gchar *iface, const gchar *prop,
+    GError **err, gpointer data)
+{
+    if (!strcmp(prop, "Status"))
+        return g_variant_new_string("Active");
+    if (!strcmp(prop, "Title")) {
+        get_alls++;
+        return g_variant_new_string("sni-check");
+    }
+    return g_variant_ref(item_pixmap);
+}
+
+static const GDBusInterfaceVTable item_vtable = {
+    NULL,
+    item_get_property,
+    NULL,
+};
+
+/*
+ * item_new - connect to the bus, export the fake item and register it.
+ */
+static gboolean
+item_new(const gchar *address)
+{
+    GDBusNodeInfo *info;
+    GError *err = NULL;
+
+    item_conn = g_dbus_connection_new_for_address_sync(address,
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+        | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION, NULL, NULL, &err);
+    if (!item_conn) {
+        g_printerr("sni-check: item connection: %s\n", err->message);
+        g_error_free(err);
+        return FALSE;
+    }
+    info = g_dbus_node_info_new_for_xml(item_xml, NULL);
+    item_reg = g_dbus_connection_register_object(item_conn, SNI_ITEM_PATH,
+        info->interfaces[0], &item_vtable, NULL, NULL, &err);
+    g_dbus_node_info_unref(info);
+    if (!item_reg) {
+        g_printerr("sni-check: item object: %s\n", err->message);
+        g_error_free(err);
+        return FALSE;
+    }
+    g_dbus_connection_call(item_conn, SNI_WATCHER_NAME, SNI_WATCHER_PATH,
+        SNI_WATCHER_IFACE, "RegisterStatusNotifierItem",
+        g_variant_new("(s)", g_dbus_connection_get_unique_name(item_conn)),
+        NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+    return TRUE;
+}
+
+/*
+ * item_burst - SNI_CHECK_BURST of every New* signal, back to back.
+ */
+static void
+item_burst(void)
+{
+    static const gchar *signals[] = {
+        "NewIcon", "NewToolTip", "NewStatus", "NewTitle", NULL
+    };
+    int i, j;
+
+    for (i = 0; i < SNI_CHECK_BURST; i++)
+        for (j = 0; signals[j]; j++)
+            g_dbus_connection_emit_signal(item_conn, NULL, SNI_ITEM_PATH,
+                SNI_ITEM_IFACE, signals[j],
+                !strcmp(signals[j], "NewStatus")
+                    ? g_variant_new("(s)", "Active") : NULL, NULL);
+    g_dbus_connection_flush_sync(item_conn, NULL, NULL);
+}
+
+static gboolean
+wake(gpointer data)
+{
+    return TRUE;
+}
+
+/*
+ * run_until - run the main loop until @cond() holds or @ms have passed;
+ * returns @cond().  With a NULL @cond it just runs for @ms.
+ */
+static gboolean
+run_until(gboolean (*cond)(SniHost *), SniHost *host, int ms)
+{
+    gint64 end = g_get_monotonic_time() + ms * 1000;
+    guint id = g_timeout_add(10, wake, NULL);
+
+    while (!(cond && cond(host)) && g_get_monotonic_time() < end)
+        g_main_context_iteration(NULL, TRUE);
+    g_source_remove(id);
+    return cond && cond(host);
+}
+
+static sni_item *
+first_item(SniHost *host)
+{
+    GHashTableIter iter;
+    sni_item *item = NULL;
+
+    g_hash_table_iter_init(&iter, host->items);
+    g_hash_table_iter_next(&iter, NULL, (gpointer *) &item);
+    return item;
+}
+
+/* our watcher owns the name and the host has registered with it */
+static gboolean
+watcher_ready(SniHost *host)
+{
+    return watcher && watcher->host_seen;
+}
+
+static gboolean
+item_shown(SniHost *host)
+{
+    sni_item *item = first_item(host);
+
+    return item && GTK_WIDGET_VISIBLE(item->image);
+}
+
+static gboolean
+item_idle(SniHost *host)
+{
+    sni_item *item = first_item(host);
+
+    return item && !item->busy && !item->refresh_id;
+}
+
+static gboolean
+item_gone(SniHost *host)
+{
+    return g_hash_table_size(host->items) == 0;
+}
+
+static GdkPixbuf *
+item_pixbuf(SniHost *host)
+{
+    return gtk_image_get_pixbuf(GTK_IMAGE(first_item(host)->image));
+}
+
+static void
+report(const gchar *check, gboolean ok, const gchar *detail)
+{
+    if (ok)
+        printf("%s: ok\n", check);
+    else {
+        printf("%s: FAIL (%s)\n", check, detail);
+        failures++;
+    }
+    fflush(stdout);
+}
+
+/*
+ * refresh - make the item re-read its properties and wait for it.
+ */
+static void
+refresh(SniHost *host)
+{
+    item_burst();
+    run_until(NULL, NULL, SNI_REFRESH_DELAY);
+    run_until(item_idle, host, SNI_CHECK_WAIT);
+}
+
+static void
+run_checks(SniHost *host)
+{
+    GdkPixbuf *first;
+    gchar *detail;
+    int n;
+
+    report("appear", run_until(item_shown, host, SNI_CHECK_WAIT),
+        "item not shown");
+    if (!item_shown(host))
+        return;
+    run_until(item_idle, host, SNI_CHECK_WAIT);
+
+    n = get_alls;
+    item_burst();
+    run_until(NULL, NULL, 3 * SNI_REFRESH_DELAY);
+    run_until(item_idle, host, SNI_CHECK_WAIT);
+    detail = g_strdup_printf("%d GetAll for one burst", get_alls - n);
+    report("batch", get_alls - n == 1, detail);
+    g_free(detail);
+
+    first = item_pixbuf(host);
+    refresh(host);
+    if (item_pixbuf(host) != first
+        || g_hash_table_size(host->pixmaps) != 1) {
+        report("pixmap", FALSE, "same pixmap converted again");
+    } else {
+        g_variant_unref(item_pixmap);
+        item_pixmap = item_pixmap_new(16, 0xff0000ff);
+        refresh(host);
+        g_variant_unref(item_pixmap);
+        item_pixmap = item_pixmap_new(SNI_CHECK_SIZE, 0xffff0000);
+        refresh(host);
+        report("pixmap", item_pixbuf(host) == first
+            && g_hash_table_size(host->pixmaps) == 2,
+            "pixmap not served from the cache");
+    }
+
+    g_dbus_connection_close_sync(item_conn, NULL, NULL);
+    report("vanish", run_until(item_gone, host, SNI_CHECK_WAIT),
+        "item still shown");
+}
+
+/*
+ * bus_start - spawn a private dbus-daemon; returns its address or NULL.
+ */
+static gchar *
+bus_start(GPid *pid)
+{
+    gchar *argv[] = { "dbus-daemon", "--session", "--nofork",
+        "--print-address", NULL };
+    GError *err = NULL;
+    gchar line[512];
+    FILE *fp;
+    int out;
+
+    if (!g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_SEARCH_PATH,
+            NULL, NULL, pid, NULL, &out, NULL, &err)) {
+        g_printerr("sni-check: %s\n", err->message);
+        g_error_free(err);
+        return NULL;
+    }
+    fp = fdopen(out, "r");
+    if (!fgets(line, sizeof(line), fp)) {
+        g_printerr("sni-check: dbus-daemon printed no address\n");
+        fclose(fp);
+        kill(*pid, SIGTERM);
+        return NULL;
+    }
+    fclose(fp);
+    return g_strstrip(g_strdup(line));
+}
+
+int
+main(int argc, char *argv[])
+{
+    GtkWidget *evbox, *box;
+    SniHost *host;
+    gchar *address;
+    GPid pid;
+
+    if (!gtk_init_check(&argc, &argv)) {
+        g_printerr("sni-check: needs a display\n");
+        return 77;
+    }
+    fb_init();
+    if (!(address = bus_start(&pid)))
+        return 77;
+    g_setenv("DBUS_SESSION_BUS_ADDRESS", address, TRUE);
+
+    evbox = gtk_event_box_new();
+    box = gtk_hbox_new(FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(evbox), box);
+    if (!(host = sni_host_new(box, evbox, SNI_CHECK_SIZE))) {
+        kill(pid, SIGTERM);
+        return 77;
+    }
+    item_pixmap = item_pixmap_new(SNI_CHECK_SIZE, 0xffff0000);
+    if (!run_until(watcher_ready, host, SNI_CHECK_WAIT)) {
+        report("watcher", FALSE, "host never registered with the watcher");
+    } else if (item_new(address))
+        run_checks(host);
+    else
+        failures++;
+
+    sni_host_free(host);
+    gtk_widget_destroy(evbox);
+    g_variant_unref(item_pixmap);
+    kill(pid, SIGTERM);
+    g_spawn_close_pid(pid);
+    g_free(address);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * stats.c -- sample statistics shared by the fbpanel benchmarks.
+ */
+
+#include <stdlib.h>
+
+#include "stats.h"
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+double
+bench_percentile(const double *v, int n, double q)
+{
+    double pos;
+    int i;
+
+    if (n <= 0)
+        return 0;
+    pos = q * (n - 1);
+    i = (int) pos;
+    if (i + 1 >= n)
+        return v[n - 1];
+    return v[i] + (pos - i) * (v[i + 1] - v[i]);
+}
+
+void
+bench_json_dist(GString *out, const gchar *name, double *v, int n)
+{
+    double sum = 0;
+    int i;
+
+    qsort(v, n, sizeof(double), cmp_double);
+    for (i = 0; i < n; i++)
+        sum += v[i];
+    g_string_append_printf(out, ",\"%s\":{\"n\":%d,\"min\":%.3f,"
+        "\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+        name, n, n ? v[0] : 0, n ? sum / n : 0,
+        bench_percentile(v, n, 0.50), bench_percentile(v, n, 0.90),
+        bench_percentile(v, n, 0.99), n ? v[n - 1] : 0);
+}
@@ -0,0 +1,26 @@
+/*
+ * stats.h -- sample statistics shared by the fbpanel benchmarks.
+ *
+ * The benchmarks collect one double per repetition (microseconds, request
+ * counts, ...) and report each series as a JSON object of order statistics.
+ */
+#ifndef _BENCH_STATS_H_
+#define _BENCH_STATS_H_
+
+#include <glib.h>
+
+/*
+ * bench_percentile -- value at quantile @q (0..1) of @v, which must be
+ * sorted ascending; linear interpolation between the closest ranks.
+ * Returns 0 for an empty series.
+ */
+double bench_percentile(const double *v, int n, double q);
+
+/*
+ * bench_json_dist -- sort @v in place and append
+ *   ,"<name>":{"n":..,"min":..,"mean":..,"p50":..,"p90":..,"p99":..,"max":..}
+ * to @out.
+ */
+void bench_json_dist(GString *out, const gchar *name, double *v, int n);
+
+#endif /* _BENCH_STATS_H_ */
@@ -0,0 +1,698 @@
+/*
+ * winstorm.c -- window-storm stress generator (fbpanel-winstorm).
+ *
+ * Measures how quickly fbpanel's taskbar and pager follow heavy window
+ * churn.  The tool is the window manager of the display it runs on
+ * (normally a fresh Xvfb): it holds SubstructureRedirect on the root,
+ * publishes the EWMH root properties a panel reads, maps and configures
+ * whatever fbpanel asks for and answers _NET_CURRENT_DESKTOP and
+ * _NET_ACTIVE_WINDOW requests.  It creates --windows client windows,
+ * starts the panel command with FBPANEL_PROBE pointing at a FIFO (see
+ * panel/probe.h) and then, for --duration seconds, drives these actions at
+ * fixed rates, each on a random window:
+ *
+ *   action    X change                               answered by
+ *   title     WM_NAME                                tb.name
+ *   desktop   _NET_WM_DESKTOP                        tb.desktop, pager.desktop
+ *   icon      _NET_WM_ICON (a new 16x16 frame)       tb.icon
+ *   restack   raise; _NET_CLIENT_LIST_STACKING       pager.stacking
+ *   churn     destroy one window and create one;     tb.clientlist,
+ *             _NET_CLIENT_LIST and ..._STACKING      pager.stacking
+ *
+ * A sample is the probe time minus the time of the oldest change it
+ * answers.  Further changes to the same (probe, window) made before the
+ * panel caught up are counted as coalesced: the panel reads the property
+ * once for all of them.  Changes still unanswered --grace seconds after
+ * the storm are lost; those to a window destroyed meanwhile are cancelled.
+ *
+ * Output, one JSON object per probe event on stdout:
+ *
+ *   {"event":"tb.name","changes":..,"samples":..,"coalesced":..,
+ *    "cancelled":..,"lost":..,
+ *    "latency_us":{"n":..,"min":..,"mean":..,"p50":..,"p90":..,"p99":..,"max":..}}
+ *
+ * Usage:
+ *   xvfb-run -a ./fbpanel-winstorm --windows 300 --title-rate 500 \
+ *       -- fbpanel --profile storm
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xproto.h>
+#include <X11/Xutil.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "stats.h"
+
+/* probe events, as named in panel/probe.h */
+enum { P_CLIENTLIST, P_STACKING, P_NAME, P_TB_DESKTOP, P_PG_DESKTOP, P_ICON,
+       P_N };
+
+typedef struct {
+    const char *name;
+    guint64 changes, samples, coalesced, cancelled;
+    GArray *latency;        /* double, microseconds */
+    GHashTable *pending;    /* Window -> gint64* time of the oldest change */
+} probe_stat;
+
+static probe_stat probes[P_N] = {
+    { "tb.clientlist" }, { "pager.stacking" }, { "tb.name" },
+    { "tb.desktop" }, { "pager.desktop" }, { "tb.icon" },
+};
+
+/* storm actions */
+typedef struct {
+    const char *name;
+    double rate;            /* per second; 0 = off */
+    gint64 next;            /* monotonic time it is due */
+    void (*run)(gint64 now);
+} action;
+
+enum {
+    A_NET_SUPPORTED, A_NET_SUPPORTING_WM_CHECK, A_NET_WM_NAME, A_UTF8_STRING,
+    A_NET_NUMBER_OF_DESKTOPS, A_NET_CURRENT_DESKTOP, A_NET_DESKTOP_GEOMETRY,
+    A_NET_DESKTOP_VIEWPORT, A_NET_WORKAREA, A_NET_CLIENT_LIST,
+    A_NET_CLIENT_LIST_STACKING, A_NET_ACTIVE_WINDOW, A_NET_WM_DESKTOP,
+    A_NET_WM_ICON, A_NET_WM_WINDOW_TYPE, A_NET_WM_WINDOW_TYPE_NORMAL,
+    A_NET_WM_STATE, A_N
+};
+
+static char *atom_names[A_N] = {
+    "_NET_SUPPORTED", "_NET_SUPPORTING_WM_CHECK", "_NET_WM_NAME",
+    "UTF8_STRING", "_NET_NUMBER_OF_DESKTOPS", "_NET_CURRENT_DESKTOP",
+    "_NET_DESKTOP_GEOMETRY", "_NET_DESKTOP_VIEWPORT", "_NET_WORKAREA",
+    "_NET_CLIENT_LIST", "_NET_CLIENT_LIST_STACKING", "_NET_ACTIVE_WINDOW",
+    "_NET_WM_DESKTOP", "_NET_WM_ICON", "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_NORMAL", "_NET_WM_STATE",
+};
+
+static Display *dpy;
+static Window root;
+static Atom atoms[A_N];
+static int screen_w, screen_h;
+
+static GArray *clients;     /* Window, in mapping order (_NET_CLIENT_LIST) */
+static GArray *stack;       /* Window, bottom to top (..._STACKING) */
+static GHashTable *desks;   /* Window -> desktop + 1 */
+static GRand *rnd;
+static guint serial;        /* bumped on every title and icon change */
+
+static int probe_fd = -1;
+static gboolean probe_seen;
+
+/* options */
+static int n_windows = 200;
+static int n_desktops = 4;
+static double duration = 10;
+static double grace = 2;
+static double settle = 5;
+static int seed = 1;
+static double title_rate = 100, desktop_rate = 20, icon_rate = 50;
+static double restack_rate = 20, churn_rate = 5;
+static gchar **panel_argv;
+
+static gboolean wm_conflict;
+
+/*
+ * pending changes and their answers
+ */
+static void
+changed(int p, Window w, gint64 now)
+{
+    probe_stat *ps = &probes[p];
+    gint64 *t;
+
+    ps->changes++;
+    if (g_hash_table_lookup(ps->pending, GSIZE_TO_POINTER(w))) {
+        ps->coalesced++;
+        return;
+    }
+    t = g_new(gint64, 1);
+    *t = now;
+    g_hash_table_insert(ps->pending, GSIZE_TO_POINTER(w), t);
+}
+
+static void
+answered(int p, Window w, gint64 when)
+{
+    probe_stat *ps = &probes[p];
+    gint64 *t;
+    double us;
+
+    if (!(t = g_hash_table_lookup(ps->pending, GSIZE_TO_POINTER(w))))
+        return;
+    us = when - *t;
+    g_array_append_val(ps->latency, us);
+    ps->samples++;
+    g_hash_table_remove(ps->pending, GSIZE_TO_POINTER(w));
+}
+
+static void
+cancel_window(Window w)
+{
+    int p;
+
+    for (p = 0; p < P_N; p++)
+        if (g_hash_table_remove(probes[p].pending, GSIZE_TO_POINTER(w)))
+            probes[p].cancelled++;
+}
+
+static void
+probes_reset(void)
+{
+    int p;
+
+    for (p = 0; p < P_N; p++) {
+        probes[p].changes = probes[p].samples = 0;
+        probes[p].coalesced = probes[p].cancelled = 0;
+        g_array_set_size(probes[p].latency, 0);
+        g_hash_table_remove_all(probes[p].pending);
+    }
+}
+
+static guint
+probes_pending(void)
+{
+    guint n = 0;
+    int p;
+
+    for (p = 0; p < P_N; p++)
+        n += g_hash_table_size(probes[p].pending);
+    return n;
+}
+
+static void
+probe_line(const char *line)
+{
+    char event[64];
+    unsigned long w;
+    long long t;
+    int p;
+
+    if (sscanf(line, "%63s %lx %lld", event, &w, &t) != 3)
+        return;
+    probe_seen = TRUE;
+    for (p = 0; p < P_N; p++)
+        if (!strcmp(event, probes[p].name))
+            answered(p, w, t);
+}
+
+static void
+probe_read(void)
+{
+    static char buf[4096];
+    static int len;
+    char *line, *nl;
+    ssize_t n;
+
+    while ((n = read(probe_fd, buf + len, sizeof(buf) - 1 - len)) > 0) {
+        len += n;
+        buf[len] = 0;
+        for (line = buf; (nl = strchr(line, '\n')); line = nl + 1) {
+            *nl = 0;
+            probe_line(line);
+        }
+        len -= line - buf;
+        memmove(buf, line, len);
+        if (len == sizeof(buf) - 1)
+            len = 0;    /* not a probe stream */
+    }
+}
+
+/*
+ * the stand-in window manager
+ */
+static int
+wm_error(Display *d, XErrorEvent *ev)
+{
+    if (ev->error_code == BadAccess
+        && ev->request_code == X_ChangeWindowAttributes)
+        wm_conflict = TRUE;
+    return 0;
+}
+
+static void
+set_cardinals(Window w, Atom prop, long *v, int n)
+{
+    XChangeProperty(dpy, w, prop, XA_CARDINAL, 32, PropModeReplace,
+        (unsigned char *) v, n);
+}
+
+static void
+publish_lists(gboolean client_list)
+{
+    if (client_list)
+        XChangeProperty(dpy, root, atoms[A_NET_CLIENT_LIST], XA_WINDOW, 32,
+            PropModeReplace, (unsigned char *) clients->data, clients->len);
+    XChangeProperty(dpy, root, atoms[A_NET_CLIENT_LIST_STACKING], XA_WINDOW,
+        32, PropModeReplace, (unsigned char *) stack->data, stack->len);
+}
+
+static gboolean
+wm_start(void)
+{
+    XSetWindowAttributes attr;
+    Window check;
+    long v[4 * 8];
+    int i;
+
+    XSetErrorHandler(wm_error);
+    attr.event_mask = SubstructureRedirectMask | SubstructureNotifyMask;
+    XChangeWindowAttributes(dpy, root, CWEventMask, &attr);
+    XSync(dpy, False);
+    if (wm_conflict) {
+        g_printerr("winstorm: another window manager is running\n");
+        return FALSE;
+    }
+
+    check = XCreateSimpleWindow(dpy, root, -1, -1, 1, 1, 0, 0, 0);
+    XChangeProperty(dpy, check, atoms[A_NET_SUPPORTING_WM_CHECK], XA_WINDOW,
+        32, PropModeReplace, (unsigned char *) &check, 1);
+    XChangeProperty(dpy, check, atoms[A_NET_WM_NAME], atoms[A_UTF8_STRING],
+        8, PropModeReplace, (unsigned char *) "fbpanel-winstorm", 16);
+    XChangeProperty(dpy, root, atoms[A_NET_SUPPORTING_WM_CHECK], XA_WINDOW,
+        32, PropModeReplace, (unsigned char *) &check, 1);
+    XChangeProperty(dpy, root, atoms[A_NET_SUPPORTED], XA_ATOM,
+        32, PropModeReplace, (unsigned char *) atoms, A_N);
+
+    v[0] = n_desktops;
+    set_cardinals(root, atoms[A_NET_NUMBER_OF_DESKTOPS], v, 1);
+    v[0] = 0;
+    set_cardinals(root, atoms[A_NET_CURRENT_DESKTOP], v, 1);
+    v[0] = screen_w;
+    v[1] = screen_h;
+    set_cardinals(root, atoms[A_NET_DESKTOP_GEOMETRY], v, 2);
+    for (i = 0; i < MIN(n_desktops, 8); i++) {
+        v[4 * i] = v[4 * i + 1] = 0;
+        v[4 * i + 2] = screen_w;
+        v[4 * i + 3] = screen_h;
+    }
+    set_cardinals(root, atoms[A_NET_WORKAREA], v, 4 * MIN(n_desktops, 8));
+    memset(v, 0, sizeof(v));
+    set_cardinals(root, atoms[A_NET_DESKTOP_VIEWPORT], v,
+        2 * MIN(n_desktops, 8));
+    v[0] = None;
+    XChangeProperty(dpy, root, atoms[A_NET_ACTIVE_WINDOW], XA_WINDOW, 32,
+        PropModeReplace, (unsigned char *) v, 1);
+    publish_lists(TRUE);
+    XSync(dpy, False);
+    return TRUE;
+}
+
+static void
+wm_event(XEvent *ev)
+{
+    XWindowChanges wc;
+    long v;
+
+    switch (ev->type) {
+    case MapRequest:
+        XMapWindow(dpy, ev->xmaprequest.window);
+        break;
+    case ConfigureRequest:
+        wc.x = ev->xconfigurerequest.x;
+        wc.y = ev->xconfigurerequest.y;
+        wc.width = ev->xconfigurerequest.width;
+        wc.height = ev->xconfigurerequest.height;
+        wc.border_width = ev->xconfigurerequest.border_width;
+        wc.sibling = ev->xconfigurerequest.above;
+        wc.stack_mode = ev->xconfigurerequest.detail;
+        XConfigureWindow(dpy, ev->xconfigurerequest.window,
+            ev->xconfigurerequest.value_mask, &wc);
+        break;
+    case ClientMessage:
+        if (ev->xclient.message_type == atoms[A_NET_CURRENT_DESKTOP]) {
+            v = ev->xclient.data.l[0];
+            set_cardinals(root, atoms[A_NET_CURRENT_DESKTOP], &v, 1);
+        } else if (ev->xclient.message_type == atoms[A_NET_ACTIVE_WINDOW]) {
+            XChangeProperty(dpy, root, atoms[A_NET_ACTIVE_WINDOW], XA_WINDOW,
+                32, PropModeReplace,
+                (unsigned char *) &ev->xclient.window, 1);
+        }
+        break;
+    }
+}
+
+static void
+wm_pump(void)
+{
+    XEvent ev;
+
+    while (XPending(dpy)) {
+        XNextEvent(dpy, &ev);
+        wm_event(&ev);
+    }
+}
+
+/*
+ * clients
+ */
+static Window
+random_client(void)
+{
+    return g_array_index(clients, Window,
+        g_rand_int_range(rnd, 0, clients->len));
+}
+
+static void
+set_title(Window w)
+{
+    gchar *title;
+
+    title = g_strdup_printf("storm %u", ++serial);
+    XStoreName(dpy, w, title);
+    g_free(title);
+}
+
+static void
+set_icon(Window w)
+{
+    long icon[2 + 16 * 16];
+    guint32 argb;
+    int i;
+
+    argb = 0xff000000 | (g_rand_int(rnd) & 0xffffff);
+    serial++;
+    icon[0] = icon[1] = 16;
+    for (i = 0; i < 16 * 16; i++)
+        icon[2 + i] = (i + serial) % 16 < 8 ? argb : 0xff000000;
+    set_cardinals(w, atoms[A_NET_WM_ICON], icon, G_N_ELEMENTS(icon));
+}
+
+static void
+set_desktop(Window w, int desk)
+{
+    long v = desk;
+
+    set_cardinals(w, atoms[A_NET_WM_DESKTOP], &v, 1);
+    g_hash_table_insert(desks, GSIZE_TO_POINTER(w), GINT_TO_POINTER(desk + 1));
+}
+
+static void
+client_new(void)
+{
+    Window w;
+    Atom type = atoms[A_NET_WM_WINDOW_TYPE_NORMAL];
+
+    w = XCreateSimpleWindow(dpy, root,
+        g_rand_int_range(rnd, 0, MAX(screen_w - 160, 1)),
+        g_rand_int_range(rnd, 0, MAX(screen_h - 100, 1)),
+        160, 100, 0, 0, 0xffffff);
+    set_title(w);
+    XChangeProperty(dpy, w, atoms[A_NET_WM_WINDOW_TYPE], XA_ATOM, 32,
+        PropModeReplace, (unsigned char *) &type, 1);
+    set_desktop(w, g_rand_int_range(rnd, 0, n_desktops));
+    set_icon(w);
+    XMapWindow(dpy, w);
+    g_array_append_val(clients, w);
+    g_array_append_val(stack, w);
+}
+
+static void
+array_remove(GArray *a, Window w)
+{
+    guint i;
+
+    for (i = 0; i < a->len; i++)
+        if (g_array_index(a, Window, i) == w) {
+            g_array_remove_index(a, i);
+            return;
+        }
+}
+
+/*
+ * storm actions
+ */
+static void
+do_title(gint64 now)
+{
+    Window w = random_client();
+
+    set_title(w);
+    changed(P_NAME, w, now);
+}
+
+static void
+do_desktop(gint64 now)
+{
+    Window w = random_client();
+    int desk;
+
+    desk = GPOINTER_TO_INT(g_hash_table_lookup(desks, GSIZE_TO_POINTER(w))) - 1;
+    desk = (desk + g_rand_int_range(rnd, 1, MAX(n_desktops, 2))) % n_desktops;
+    set_desktop(w, desk);
+    changed(P_TB_DESKTOP, w, now);
+    changed(P_PG_DESKTOP, w, now);
+}
+
+static void
+do_icon(gint64 now)
+{
+    Window w = random_client();
+
+    set_icon(w);
+    changed(P_ICON, w, now);
+}
+
+static void
+do_restack(gint64 now)
+{
+    Window w = random_client();
+
+    XRaiseWindow(dpy, w);
+    array_remove(stack, w);
+    g_array_append_val(stack, w);
+    publish_lists(FALSE);
+    changed(P_STACKING, None, now);
+}
+
+static void
+do_churn(gint64 now)
+{
+    Window w = random_client();
+
+    cancel_window(w);
+    array_remove(clients, w);
+    array_remove(stack, w);
+    g_hash_table_remove(desks, GSIZE_TO_POINTER(w));
+    XDestroyWindow(dpy, w);
+    client_new();
+    publish_lists(TRUE);
+    changed(P_CLIENTLIST, None, now);
+    changed(P_STACKING, None, now);
+}
+
+/*
+ * main loop: X events, probe lines and due actions until @until
+ */
+static void
+run_until(gint64 until, action *acts, int nacts, gboolean stop_when_idle)
+{
+    struct pollfd pfd[2];
+    gint64 now, due;
+    int i, timeout;
+
+    pfd[0].fd = ConnectionNumber(dpy);
+    pfd[0].events = POLLIN;
+    pfd[1].fd = probe_fd;
+    pfd[1].events = POLLIN;
+    while ((now = g_get_monotonic_time()) < until) {
+        for (i = 0; i < nacts; i++)
+            while (acts[i].rate > 0 && acts[i].next <= now) {
+                acts[i].run(now);
+                XFlush(dpy);
+                acts[i].next += 1e6 / acts[i].rate;
+            }
+        wm_pump();
+        probe_read();
+        if (stop_when_idle && !probes_pending())
+            return;
+        due = until;
+        for (i = 0; i < nacts; i++)
+            if (acts[i].rate > 0)
+                due = MIN(due, acts[i].next);
+        timeout = MAX((due - g_get_monotonic_time() + 999) / 1000, 0);
+        XFlush(dpy);
+        poll(pfd, 2, timeout);
+    }
+    wm_pump();
+    probe_read();
+}
+
+static void
+report(void)
+{
+    GString *out = g_string_new(NULL);
+    int p;
+
+    for (p = 0; p < P_N; p++) {
+        g_string_printf(out, "{\"event\":\"%s\",\"changes\":%" G_GUINT64_FORMAT
+            ",\"samples\":%" G_GUINT64_FORMAT ",\"coalesced\":%" G_GUINT64_FORMAT
+            ",\"cancelled\":%" G_GUINT64_FORMAT ",\"lost\":%u",
+            probes[p].name, probes[p].changes, probes[p].samples,
+            probes[p].coalesced, probes[p].cancelled,
+            g_hash_table_size(probes[p].pending));
+        bench_json_dist(out, "latency_us", (double *) probes[p].latency->data,
+            probes[p].latency->len);
+        g_string_append(out, "}\n");
+        fputs(out->str, stdout);
+    }
+    fflush(stdout);
+    g_string_free(out, TRUE);
+}
+
+static GOptionEntry entries[] = {
+    { "windows", 'n', 0, G_OPTION_ARG_INT, &n_windows,
+      "client windows to keep open (200)", "N" },
+    { "desktops", 0, 0, G_OPTION_ARG_INT, &n_desktops,
+      "number of desktops (4)", "N" },
+    { "duration", 'd', 0, G_OPTION_ARG_DOUBLE, &duration,
+      "storm length in seconds (10)", "S" },
+    { "grace", 0, 0, G_OPTION_ARG_DOUBLE, &grace,
+      "seconds to wait for late updates (2)", "S" },
+    { "settle", 0, 0, G_OPTION_ARG_DOUBLE, &settle,
+      "seconds to wait for the panel to start (5)", "S" },
+    { "seed", 0, 0, G_OPTION_ARG_INT, &seed,
+      "random seed (1)", "N" },
+    { "title-rate", 0, 0, G_OPTION_ARG_DOUBLE, &title_rate,
+      "title changes per second (100)", "R" },
+    { "desktop-rate", 0, 0, G_OPTION_ARG_DOUBLE, &desktop_rate,
+      "desktop moves per second (20)", "R" },
+    { "icon-rate", 0, 0, G_OPTION_ARG_DOUBLE, &icon_rate,
+      "icon frames per second (50)", "R" },
+    { "restack-rate", 0, 0, G_OPTION_ARG_DOUBLE, &restack_rate,
+      "raises per second (20)", "R" },
+    { "churn-rate", 0, 0, G_OPTION_ARG_DOUBLE, &churn_rate,
+      "window replacements per second (5)", "R" },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &panel_argv,
+      NULL, "[-- PANEL COMMAND...]" },
+    { NULL }
+};
+
+int
+main(int argc, char *argv[])
+{
+    static gchar *default_panel[] = { "fbpanel", NULL };
+    action acts[] = {
+        { "title", 0, 0, do_title },
+        { "desktop", 0, 0, do_desktop },
+        { "icon", 0, 0, do_icon },
+        { "restack", 0, 0, do_restack },
+        { "churn", 0, 0, do_churn },
+    };
+    GOptionContext *ctx;
+    GError *err = NULL;
+    gchar *dir, *fifo, **envp;
+    GPid pid;
+    gint64 now;
+    int i, p, status, keep_fd = -1;
+
+    ctx = g_option_context_new("- stress fbpanel's taskbar and pager");
+    g_option_context_add_main_entries(ctx, entries, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+        g_printerr("winstorm: %s\n", err->message);
+        return 2;
+    }
+    g_option_context_free(ctx);
+    n_windows = MAX(n_windows, 1);
+    n_desktops = MAX(n_desktops, 1);
+    acts[0].rate = title_rate;
+    acts[1].rate = n_desktops > 1 ? desktop_rate : 0;
+    acts[2].rate = icon_rate;
+    acts[3].rate = restack_rate;
+    acts[4].rate = churn_rate;
+    if (!panel_argv || !panel_argv[0])
+        panel_argv = default_panel;
+
+    if (!(dpy = XOpenDisplay(NULL))) {
+        g_printerr("winstorm: can't open display\n");
+        return 1;
+    }
+    root = DefaultRootWindow(dpy);
+    screen_w = DisplayWidth(dpy, DefaultScreen(dpy));
+    screen_h = DisplayHeight(dpy, DefaultScreen(dpy));
+    XInternAtoms(dpy, atom_names, A_N, False, atoms);
+    rnd = g_rand_new_with_seed(seed);
+    clients = g_array_new(FALSE, FALSE, sizeof(Window));
+    stack = g_array_new(FALSE, FALSE, sizeof(Window));
+    desks = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (p = 0; p < P_N; p++) {
+        probes[p].latency = g_array_new(FALSE, FALSE, sizeof(double));
+        probes[p].pending = g_hash_table_new_full(g_direct_hash,
+            g_direct_equal, NULL, g_free);
+    }
+    if (!wm_start())
+        return 1;
+    for (i = 0; i < n_windows; i++)
+        client_new();
+    publish_lists(TRUE);
+    XSync(dpy, False);
+
+    /* the FIFO is opened for reading first, so the panel's non-blocking
+     * open for writing succeeds; our own writer end keeps it from hanging
+     * up (and poll() from spinning) if the panel exits */
+    if (!(dir = g_dir_make_tmp("fbpanel-winstorm-XXXXXX", &err))) {
+        g_printerr("winstorm: %s\n", err->message);
+        return 1;
+    }
+    fifo = g_build_filename(dir, "probe", NULL);
+    if (mkfifo(fifo, 0600) ||
+        (probe_fd = open(fifo, O_RDONLY | O_NONBLOCK)) < 0 ||
+        (keep_fd = open(fifo, O_WRONLY | O_NONBLOCK)) < 0) {
+        g_printerr("winstorm: %s: %s\n", fifo, g_strerror(errno));
+        return 1;
+    }
+    envp = g_environ_setenv(g_get_environ(), "FBPANEL_PROBE", fifo, TRUE);
+    if (!g_spawn_async(NULL, panel_argv, envp,
+            G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+            &pid, &err)) {
+        g_printerr("winstorm: %s: %s\n", panel_argv[0], err->message);
+        return 1;
+    }
+    g_strfreev(envp);
+
+    /* startup: the panel reads the client list once it is up */
+    now = g_get_monotonic_time();
+    while (!probe_seen && g_get_monotonic_time() < now + settle * 1e6)
+        run_until(g_get_monotonic_time() + 100000, NULL, 0, FALSE);
+    if (!probe_seen)
+        g_printerr("winstorm: no probes from the panel; does its profile "
+            "have a taskbar or pager?\n");
+    run_until(g_get_monotonic_time() + 500000, NULL, 0, FALSE);
+    probes_reset();
+
+    now = g_get_monotonic_time();
+    for (i = 0; i < (int) G_N_ELEMENTS(acts); i++)
+        acts[i].next = now;
+    run_until(now + duration * 1e6, acts, G_N_ELEMENTS(acts), FALSE);
+    run_until(g_get_monotonic_time() + grace * 1e6, NULL, 0, TRUE);
+    report();
+
+    /* SIGUSR2 is fbpanel's clean exit */
+    kill(pid, SIGUSR2);
+    for (i = 0; i < 20 && waitpid(pid, &status, WNOHANG) == 0; i++)
+        g_usleep(100000);
+    if (i == 20) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    close(keep_fd);
+    close(probe_fd);
+    unlink(fifo);
+    g_rmdir(dir);
+    XCloseDisplay(dpy);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * calendar.c -- popup calendar shared by the clock plugins.
+ *
+ * Widget tree, built once by fb_calendar_build():
+ *
+ *   win (GtkWindow, undecorated, sticky, no taskbar/pager entry)
+ *     box (GtkHBox)
+ *       cal[0] .. cal[months-1] (GtkCalendar)
+ *
+ * cal[0] is the navigable one; its "month-changed" handler moves the others
+ * to the following months (they have GTK_CALENDAR_NO_MONTH_CHANGE).  Today
+ * is selected in whichever calendar shows the current month; the others
+ * have no selected day.
+ *
+ * The window is realized right after it is built, so fb_calendar_show()
+ * only positions and maps it.  A FB_CLOCK_DAY subscription keeps "today"
+ * current: while hidden the view jumps to the new month, while shown only
+ * the selection moves so the user's navigation is not disturbed.
+ */
+
+#include "calendar.h"
+#include "clock.h"
+
+//#define DEBUGPRN
+#include "dbg.h"
+
+struct _fb_calendar {
+    int months;                 /* calendars in the row                    */
+    gboolean week_numbers;
+    GtkWidget *win;             /* popup window, NULL until built          */
+    GtkWidget *cal[FB_CALENDAR_MAX_MONTHS];
+    guint idle;                 /* pending build idle source, or 0         */
+    guint timer;                /* fb_clock_add id, 0 until built          */
+    int year, month, day;       /* today; month is 0-based as in GtkCalendar */
+};
+
+/*
+ * fb_calendar_follow -- "month-changed" on cal[0]: move the other calendars
+ * to the following months and put the selection on today, if shown.
+ */
+static void
+fb_calendar_follow(GtkCalendar *first, fb_calendar *c)
+{
+    guint year, month;
+    int i, m, y;
+
+    ENTER;
+    gtk_calendar_get_date(first, &year, &month, NULL);
+    for (i = 0; i < c->months; i++) {
+        m = (month + i) % 12;
+        y = year + (month + i) / 12;
+        if (i)
+            gtk_calendar_select_month(GTK_CALENDAR(c->cal[i]), m, y);
+        gtk_calendar_select_day(GTK_CALENDAR(c->cal[i]),
+            (m == c->month && y == c->year) ? c->day : 0);
+    }
+    RET();
+}
+
+/*
+ * fb_calendar_today -- show the current month in cal[0].
+ */
+static void
+fb_calendar_today(fb_calendar *c)
+{
+    ENTER;
+    gtk_calendar_select_month(GTK_CALENDAR(c->cal[0]), c->month, c->year);
+    /* select_month only emits "month-changed" if the month differs */
+    fb_calendar_follow(GTK_CALENDAR(c->cal[0]), c);
+    RET();
+}
+
+/*
+ * fb_calendar_day -- fb_clock callback at midnight.
+ */
+static void
+fb_calendar_day(const struct tm *now, gpointer data)
+{
+    fb_calendar *c = data;
+
+    ENTER;
+    c->year = now->tm_year + 1900;
+    c->month = now->tm_mon;
+    c->day = now->tm_mday;
+    if (GTK_WIDGET_VISIBLE(c->win))
+        fb_calendar_follow(GTK_CALENDAR(c->cal[0]), c);
+    else
+        fb_calendar_today(c);
+    RET();
+}
+
+/*
+ * fb_calendar_build -- create and realize the widget tree (once).
+ */
+static void
+fb_calendar_build(fb_calendar *c)
+{
+    GtkCalendarDisplayOptions opts;
+    GtkWidget *box;
+    int i;
+
+    ENTER;
+    c->win = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_decorated(GTK_WINDOW(c->win), FALSE);
+    gtk_window_set_resizable(GTK_WINDOW(c->win), FALSE);
+    gtk_container_set_border_width(GTK_CONTAINER(c->win), 5);
+    gtk_window_set_skip_taskbar_hint(GTK_WINDOW(c->win), TRUE);
+    gtk_window_set_skip_pager_hint(GTK_WINDOW(c->win), TRUE);
+    gtk_window_set_title(GTK_WINDOW(c->win), "calendar");
+    gtk_window_stick(GTK_WINDOW(c->win));
+
+    box = gtk_hbox_new(FALSE, 6);
+    gtk_container_add(GTK_CONTAINER(c->win), box);
+    opts = GTK_CALENDAR_SHOW_DAY_NAMES | GTK_CALENDAR_SHOW_HEADING;
+    if (c->week_numbers)
+        opts |= GTK_CALENDAR_SHOW_WEEK_NUMBERS;
+    for (i = 0; i < c->months; i++) {
+        c->cal[i] = gtk_calendar_new();
+        gtk_calendar_set_display_options(GTK_CALENDAR(c->cal[i]),
+            i ? opts | GTK_CALENDAR_NO_MONTH_CHANGE : opts);
+        gtk_box_pack_start(GTK_BOX(box), c->cal[i], FALSE, FALSE, 0);
+    }
+    g_signal_connect(G_OBJECT(c->cal[0]), "month-changed",
+        G_CALLBACK(fb_calendar_follow), c);
+    gtk_widget_show_all(box);
+
+    c->timer = fb_clock_add(FB_CLOCK_DAY, fb_calendar_day, c);
+    fb_calendar_day(fb_clock_localtime(), c);
+    gtk_widget_realize(c->win);
+    RET();
+}
+
+static gboolean
+fb_calendar_build_idle(gpointer data)
+{
+    fb_calendar *c = data;
+
+    ENTER;
+    c->idle = 0;
+    if (!c->win)
+        fb_calendar_build(c);
+    RET(FALSE);
+}
+
+fb_calendar *
+fb_calendar_new(int months, gboolean week_numbers)
+{
+    fb_calendar *c;
+
+    ENTER;
+    c = g_new0(fb_calendar, 1);
+    c->months = CLAMP(months, 1, FB_CALENDAR_MAX_MONTHS);
+    c->week_numbers = week_numbers;
+    /* after the panel is up, so it does not delay startup */
+    c->idle = g_idle_add_full(G_PRIORITY_LOW, fb_calendar_build_idle, c, NULL);
+    RET(c);
+}
+
+void
+fb_calendar_free(fb_calendar *c)
+{
+    ENTER;
+    if (!c)
+        RET();
+    if (c->idle)
+        g_source_remove(c->idle);
+    fb_clock_remove(c->timer);
+    if (c->win)
+        gtk_widget_destroy(c->win);
+    g_free(c);
+    RET();
+}
+
+void
+fb_calendar_show(fb_calendar *c)
+{
+    GdkRectangle mon;
+    GdkScreen *screen;
+    GtkRequisition req;
+    guint year, month;
+    int x, y;
+
+    ENTER;
+    if (!c->win) {
+        if (c->idle)
+            g_source_remove(c->idle);
+        c->idle = 0;
+        fb_calendar_build(c);
+    }
+    if (GTK_WIDGET_VISIBLE(c->win))
+        RET();
+    /* left on another month last time */
+    gtk_calendar_get_date(GTK_CALENDAR(c->cal[0]), &year, &month, NULL);
+    if ((int) year != c->year || (int) month != c->month)
+        fb_calendar_today(c);
+
+    /* centred on the pointer, kept on its monitor; the requisition is
+     * cached since the widgets were built */
+    gtk_widget_size_request(c->win, &req);
+    gdk_display_get_pointer(gdk_display_get_default(), &screen, &x, &y, NULL);
+    gdk_screen_get_monitor_geometry(screen,
+        gdk_screen_get_monitor_at_point(screen, x, y), &mon);
+    x = CLAMP(x - req.width / 2, mon.x,
+        MAX(mon.x, mon.x + mon.width - req.width));
+    y = CLAMP(y - req.height / 2, mon.y,
+        MAX(mon.y, mon.y + mon.height - req.height));
+    if (gtk_window_get_screen(GTK_WINDOW(c->win)) != screen)
+        gtk_window_set_screen(GTK_WINDOW(c->win), screen);
+    gtk_window_move(GTK_WINDOW(c->win), x, y);
+    gtk_widget_show(c->win);
+    RET();
+}
+
+void
+fb_calendar_hide(fb_calendar *c)
+{
+    ENTER;
+    if (c->win)
+        gtk_widget_hide(c->win);
+    RET();
+}
+
+gboolean
+fb_calendar_toggle(fb_calendar *c)
+{
+    ENTER;
+    if (fb_calendar_visible(c))
+        fb_calendar_hide(c);
+    else
+        fb_calendar_show(c);
+    RET(fb_calendar_visible(c));
+}
+
+gboolean
+fb_calendar_visible(fb_calendar *c)
+{
+    return c && c->win && GTK_WIDGET_VISIBLE(c->win);
+}
@@ -0,0 +1,55 @@
+/*
+ * calendar.h -- popup calendar shared by the clock plugins.
+ *
+ * The popup (an undecorated, sticky window holding one GtkCalendar per
+ * month shown) is built once, from a low-priority idle callback after the
+ * plugin starts, and realized but not mapped.  Showing it is then only a
+ * move and a map; hiding it unmaps it and keeps the widgets for the next
+ * time.  While it exists it follows the date through a day-resolution
+ * clock.h subscription, updating the calendars in place.
+ *
+ * All functions must be called from the GTK main thread.
+ */
+#ifndef _CALENDAR_H_
+#define _CALENDAR_H_
+
+#include <gtk/gtk.h>
+
+/* Upper bound for the months argument of fb_calendar_new(). */
+#define FB_CALENDAR_MAX_MONTHS 12
+
+typedef struct _fb_calendar fb_calendar;
+
+/*
+ * fb_calendar_new -- create a popup calendar (widgets are built later).
+ *
+ * Parameters:
+ *   months       -- number of consecutive months shown side by side,
+ *                   starting with the current one; clamped to
+ *                   1..FB_CALENDAR_MAX_MONTHS.  Only the first calendar
+ *                   has month navigation; the others follow it.
+ *   week_numbers -- show ISO week numbers.
+ *
+ * Returns: a new fb_calendar; free with fb_calendar_free().
+ */
+fb_calendar *fb_calendar_new(int months, gboolean week_numbers);
+
+/* fb_calendar_free -- destroy the popup and cancel its timers; NULL is ok. */
+void fb_calendar_free(fb_calendar *cal);
+
+/*
+ * fb_calendar_show -- map the popup near the mouse pointer, showing the
+ * current month.  Builds it first if the idle callback has not run yet.
+ */
+void fb_calendar_show(fb_calendar *cal);
+
+/* fb_calendar_hide -- unmap the popup; it is kept for the next show. */
+void fb_calendar_hide(fb_calendar *cal);
+
+/* fb_calendar_toggle -- show or hide.  Returns: TRUE if now shown. */
+gboolean fb_calendar_toggle(fb_calendar *cal);
+
+/* fb_calendar_visible -- TRUE while the popup is shown; NULL gives FALSE. */
+gboolean fb_calendar_visible(fb_calendar *cal);
+
+#endif /* _CALENDAR_H_ */
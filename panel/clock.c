@@ -0,0 +1,381 @@
+/*
+ * clock.c -- shared wall-clock scheduler for clock plugins.
+ *
+ * Subscribers (fb_clock_sub) each have a resolution and the absolute time
+ * (time_t) of their next boundary.  One timer is armed for the earliest of
+ * those; when it fires, the subscribers that are due are called with one
+ * shared localtime() result and their next boundary is computed.
+ *
+ * Boundaries are computed in local time: a minute boundary is the next
+ * hh:mm:00, an hour or day boundary goes through mktime() so DST changes
+ * land on the right instant.
+ *
+ * Timer: a CLOCK_REALTIME timerfd with TFD_TIMER_ABSTIME, so the expiry is
+ * the wall-clock instant itself rather than an interval that drifts, and
+ * TFD_TIMER_CANCEL_ON_SET, so a settimeofday()/NTP step makes the read fail
+ * with ECANCELED and everything is re-rendered and re-armed.  Without
+ * timerfd (or if the kernel refuses it) a GLib timeout up to the deadline
+ * is used; an early wake-up there just re-arms.
+ *
+ * Timezone: /etc/localtime is monitored while there are subscribers; a
+ * change re-reads the zone (tzset) and re-renders everything.
+ *
+ * State is file-static; the timer, fd and monitor exist only while there
+ * are subscribers.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+#endif
+
+#include "clock.h"
+
+//#define DEBUGPRN
+#include "dbg.h"
+
+#define TZ_FILE "/etc/localtime"
+
+typedef struct {
+    guint id;
+    fb_clock_res res;
+    fb_clock_func func;     /* NULL: removed during dispatch */
+    gpointer data;
+    time_t next;            /* next boundary to fire at */
+} fb_clock_sub;
+
+static GList *subs;
+static guint last_id;
+static gboolean dispatching;
+
+static time_t armed;        /* deadline the timer is armed for; 0 = none */
+static int tfd = -1;        /* timerfd, or -1 */
+static guint tfd_watch;     /* GIOChannel watch on tfd */
+static guint tsource;       /* fallback g_timeout_add source */
+static GFileMonitor *tzmon;
+
+static time_t cached_t = -1;
+static struct tm cached_tm;
+
+static void fb_clock_arm(void);
+
+const struct tm *
+fb_clock_localtime(void)
+{
+    time_t now = time(NULL);
+
+    if (now != cached_t) {
+        localtime_r(&now, &cached_tm);
+        cached_t = now;
+    }
+    return &cached_tm;
+}
+
+fb_clock_res
+fb_clock_format_resolution(const gchar *fmt)
+{
+    fb_clock_res res = FB_CLOCK_DAY;
+
+    if (!fmt)
+        return res;
+    for (; *fmt; fmt++) {
+        if (*fmt != '%')
+            continue;
+        /* skip glibc flags, field width and the E/O modifiers */
+        for (fmt++; *fmt && strchr("_-0^#123456789EO", *fmt); fmt++)
+            ;
+        switch (*fmt) {
+        case '\0':
+            return res;
+        case '%': case 'n': case 't':
+            break;
+        case 'a': case 'A': case 'b': case 'B': case 'C': case 'd': case 'D':
+        case 'e': case 'F': case 'g': case 'G': case 'h': case 'j': case 'm':
+        case 'u': case 'U': case 'V': case 'w': case 'W': case 'x': case 'y':
+        case 'Y':
+            break;
+        case 'H': case 'I': case 'k': case 'l': case 'p': case 'P':
+        case 'z': case 'Z':
+            res = MIN(res, FB_CLOCK_HOUR);
+            break;
+        case 'M': case 'R':
+            res = MIN(res, FB_CLOCK_MINUTE);
+            break;
+        default:    /* %S %T %s %c %r %X %+ and anything unknown */
+            return FB_CLOCK_SECOND;
+        }
+    }
+    return res;
+}
+
+/*
+ * fb_clock_next -- first @res boundary of local time after @now.
+ */
+static time_t
+fb_clock_next(time_t now, fb_clock_res res)
+{
+    struct tm tm;
+    time_t t;
+
+    if (res == FB_CLOCK_SECOND)
+        return now + 1;
+    localtime_r(&now, &tm);
+    /* UTC offsets are whole minutes: no mktime() needed */
+    if (res == FB_CLOCK_MINUTE)
+        return now - tm.tm_sec + 60;
+    tm.tm_sec = tm.tm_min = 0;
+    if (res == FB_CLOCK_HOUR)
+        tm.tm_hour++;
+    else {
+        tm.tm_hour = 0;
+        tm.tm_mday++;
+    }
+    tm.tm_isdst = -1;
+    t = mktime(&tm);
+    /* a DST fold can map the boundary back onto the past */
+    return (t > now) ? t : now + res;
+}
+
+/*
+ * fb_clock_fire -- call the due subscribers (all of them if @all) and
+ * re-arm the timer.
+ */
+static void
+fb_clock_fire(gboolean all)
+{
+    const struct tm *tm;
+    fb_clock_sub *s;
+    GList *l, *next;
+    time_t now;
+
+    ENTER;
+    tm = fb_clock_localtime();
+    now = cached_t;
+    dispatching = TRUE;
+    for (l = subs; l; l = l->next) {
+        s = l->data;
+        if (!s->func)
+            continue;
+        if (all || s->next <= now) {
+            s->next = fb_clock_next(now, s->res);
+            s->func(tm, s->data);
+        } else if (s->next - now > (time_t) s->res) {
+            /* the clock went back (fallback timer only) */
+            s->next = fb_clock_next(now, s->res);
+        }
+    }
+    dispatching = FALSE;
+    for (l = subs; l; l = next) {
+        next = l->next;
+        s = l->data;
+        if (!s->func) {
+            subs = g_list_delete_link(subs, l);
+            g_free(s);
+        }
+    }
+    fb_clock_arm();
+    RET();
+}
+
+#ifdef __linux__
+/*
+ * fb_clock_tfd_ready -- the timerfd expired, or the system time was set
+ * (read fails with ECANCELED).
+ */
+static gboolean
+fb_clock_tfd_ready(GIOChannel *ch, GIOCondition cond, gpointer data)
+{
+    guint64 n;
+
+    ENTER;
+    if (read(tfd, &n, sizeof(n)) < 0) {
+        if (errno != ECANCELED)     /* EAGAIN, EINTR */
+            RET(TRUE);
+        DBG("system time was set\n");
+        armed = 0;
+        cached_t = -1;
+        fb_clock_fire(TRUE);
+        RET(TRUE);
+    }
+    armed = 0;
+    fb_clock_fire(FALSE);
+    RET(TRUE);
+}
+
+/*
+ * fb_clock_tfd_arm -- arm the timerfd for @deadline, creating it on first
+ * use.  Returns FALSE if timerfd can't be used.
+ */
+static gboolean
+fb_clock_tfd_arm(time_t deadline)
+{
+    struct itimerspec its;
+    GIOChannel *ch;
+
+    if (tfd < 0) {
+        if ((tfd = timerfd_create(CLOCK_REALTIME,
+                    TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+            return FALSE;
+        ch = g_io_channel_unix_new(tfd);
+        tfd_watch = g_io_add_watch(ch, G_IO_IN, fb_clock_tfd_ready, NULL);
+        g_io_channel_unref(ch);
+    }
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = deadline;
+    if (!timerfd_settime(tfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+            &its, NULL))
+        return TRUE;
+    /* pre-3.0 kernels: no CANCEL_ON_SET, still wall-clock aligned */
+    if (!timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL))
+        return TRUE;
+    g_source_remove(tfd_watch);
+    close(tfd);
+    tfd = -1;
+    return FALSE;
+}
+#endif
+
+/*
+ * fb_clock_timeout -- fallback timer expired.
+ */
+static gboolean
+fb_clock_timeout(gpointer data)
+{
+    ENTER;
+    tsource = 0;
+    armed = 0;
+    fb_clock_fire(FALSE);
+    RET(FALSE);
+}
+
+/*
+ * fb_clock_tz_changed -- /etc/localtime changed: new zone, new boundaries.
+ */
+static void
+fb_clock_tz_changed(GFileMonitor *mon, GFile *file, GFile *other,
+    GFileMonitorEvent event, gpointer data)
+{
+    ENTER;
+    if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+        && event != G_FILE_MONITOR_EVENT_CREATED
+        && event != G_FILE_MONITOR_EVENT_DELETED)
+        RET();
+    DBG("timezone changed\n");
+    tzset();
+    cached_t = -1;
+    armed = 0;
+    fb_clock_fire(TRUE);
+    RET();
+}
+
+/*
+ * fb_clock_arm -- (re)arm the timer for the earliest deadline; tear it
+ * down when there are no subscribers left.
+ */
+static void
+fb_clock_arm(void)
+{
+    fb_clock_sub *s;
+    time_t next = 0;
+    GList *l;
+    gint64 ms;
+
+    for (l = subs; l; l = l->next) {
+        s = l->data;
+        if (s->func && (!next || s->next < next))
+            next = s->next;
+    }
+    if (!next) {
+#ifdef __linux__
+        if (tfd >= 0) {
+            g_source_remove(tfd_watch);
+            close(tfd);
+            tfd = -1;
+        }
+#endif
+        if (tsource)
+            g_source_remove(tsource);
+        tsource = 0;
+        if (tzmon) {
+            g_object_unref(tzmon);
+            tzmon = NULL;
+        }
+        armed = 0;
+        return;
+    }
+    if (next == armed)
+        return;
+    armed = next;
+    DBG("next wake-up in %ld s\n", (long) (next - time(NULL)));
+#ifdef __linux__
+    if (fb_clock_tfd_arm(next))
+        return;
+#endif
+    if (tsource)
+        g_source_remove(tsource);
+    ms = ((gint64) next * G_USEC_PER_SEC - g_get_real_time()) / 1000 + 1;
+    tsource = g_timeout_add(MAX(ms, 0), fb_clock_timeout, NULL);
+}
+
+guint
+fb_clock_add(fb_clock_res res, fb_clock_func func, gpointer data)
+{
+    fb_clock_sub *s;
+    GFile *file;
+
+    ENTER;
+    g_return_val_if_fail(func != NULL, 0);
+    if (!subs) {
+        tzset();
+        cached_t = -1;
+        if (!tzmon) {
+            file = g_file_new_for_path(TZ_FILE);
+            tzmon = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+            g_object_unref(file);
+            if (tzmon)
+                g_signal_connect(tzmon, "changed",
+                    G_CALLBACK(fb_clock_tz_changed), NULL);
+        }
+    }
+    s = g_new0(fb_clock_sub, 1);
+    s->id = ++last_id;
+    s->res = res;
+    s->func = func;
+    s->data = data;
+    s->next = fb_clock_next(time(NULL), res);
+    subs = g_list_append(subs, s);
+    fb_clock_arm();
+    RET(s->id);
+}
+
+void
+fb_clock_remove(guint id)
+{
+    fb_clock_sub *s;
+    GList *l;
+
+    ENTER;
+    for (l = subs; l; l = l->next) {
+        s = l->data;
+        if (s->id != id)
+            continue;
+        if (dispatching) {
+            /* swept by fb_clock_fire */
+            s->func = NULL;
+            RET();
+        }
+        subs = g_list_delete_link(subs, l);
+        g_free(s);
+        fb_clock_arm();
+        RET();
+    }
+    RET();
+}
@@ -0,0 +1,64 @@
+/*
+ * clock.h -- shared wall-clock scheduler for clock plugins.
+ *
+ * Clock plugins subscribe with the coarsest resolution their strftime
+ * formats need (fb_clock_format_resolution) and are called back once at
+ * every local-time boundary of that resolution: a "%R" clock wakes once a
+ * minute, a "%A %x" tooltip once a day.  All subscribers share one timer,
+ * armed for the earliest boundary.
+ *
+ * On Linux the timer is a CLOCK_REALTIME timerfd armed with an absolute
+ * expiry and TFD_TIMER_CANCEL_ON_SET, so it fires exactly on the wall-clock
+ * boundary and is re-armed when the system time is set.  Changes of
+ * /etc/localtime (timezone) re-arm it too.  Elsewhere a GLib timeout is
+ * used.
+ *
+ * All functions must be called from the GTK main thread.
+ */
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <time.h>
+#include <glib.h>
+
+/* How often a rendered format can change, in seconds. */
+typedef enum {
+    FB_CLOCK_SECOND = 1,
+    FB_CLOCK_MINUTE = 60,
+    FB_CLOCK_HOUR   = 3600,
+    FB_CLOCK_DAY    = 86400,
+} fb_clock_res;
+
+/* Callback: @now is the local time of the boundary just reached. */
+typedef void (*fb_clock_func)(const struct tm *now, gpointer data);
+
+/*
+ * fb_clock_format_resolution -- finest conversion used by a strftime format.
+ *
+ * %S %T %s %c %r %X %+ give FB_CLOCK_SECOND, %M %R FB_CLOCK_MINUTE,
+ * %H %I %k %l %p %P %z %Z FB_CLOCK_HOUR, date conversions FB_CLOCK_DAY.
+ * Unknown conversions count as FB_CLOCK_SECOND.  NULL or a format without
+ * conversions gives FB_CLOCK_DAY.
+ */
+fb_clock_res fb_clock_format_resolution(const gchar *fmt);
+
+/*
+ * fb_clock_add -- call @func at every @res boundary of local time.
+ *
+ * The first call happens at the next boundary, not immediately; render the
+ * initial state with fb_clock_localtime().
+ *
+ * Returns: a subscription id (> 0) for fb_clock_remove().
+ */
+guint fb_clock_add(fb_clock_res res, fb_clock_func func, gpointer data);
+
+/* fb_clock_remove -- cancel a subscription; 0 is ignored. */
+void fb_clock_remove(guint id);
+
+/*
+ * fb_clock_localtime -- local time now, computed at most once per second
+ * and shared by all callers.  Points to static storage.
+ */
+const struct tm *fb_clock_localtime(void);
+
+#endif /* _CLOCK_H_ */
@@ -147,6 +147,8 @@ struct _FbEv {
     Window active_window;          // cached _NET_ACTIVE_WINDOW; None means stale
     Window *client_list;           // cached _NET_CLIENT_LIST; NULL means stale
     Window *client_list_stacking;  // cached _NET_CLIENT_LIST_STACKING; NULL means stale
+    int client_list_num;           // entries in client_list
+    int client_list_stacking_num;  // entries in client_list_stacking
 
     // Fields below are unused remnants, apparently copied from FbBg struct:
     Window   xroot;   // unused
@@ -362,30 +364,20 @@ fb_ev_new()
  *
  * Called by the GObject machinery when the reference count reaches zero.
  *
- * NOTE: The body is almost empty.  The XFreeGC call is commented out because
- * ev->gc is never initialised (the X11 fields are unused dead code).
- * However, the cached EWMH data (desktop_names, client_list,
- * client_list_stacking) is NOT freed here — it is only freed inside the
- * signal handlers (ev_desktop_names, ev_client_list, ev_client_list_stacking).
- * If those signals are never emitted before the object is destroyed, or if
- * the data was fetched after the last signal, these allocations will LEAK.
- *
- * Specifically:
- *   ev->desktop_names        — must be g_strfreev()'d; NOT done in finalize.
- *   ev->client_list          — must be XFree()'d; NOT done in finalize.
- *   ev->client_list_stacking — must be XFree()'d; NOT done in finalize.
- *
- * The parent class finalize is also not chained (same issue as FbBg).
+ * Releases the cached EWMH data still held (desktop names, client lists).
+ * The XFreeGC call is commented out because ev->gc is never initialised
+ * (the X11 fields are unused dead code).
  */
 static void
 fb_ev_finalize (GObject *object)
 {
-    FbEv *ev G_GNUC_UNUSED;  // G_GNUC_UNUSED suppresses unused-variable warning
+    FbEv *ev;
 
     ev = FB_EV (object);
     //XFreeGC(ev->dpy, ev->gc);  // intentionally commented out; gc/dpy are never set
-    // BUG: ev->desktop_names, ev->client_list, ev->client_list_stacking
-    //      are NOT freed here, causing memory leaks if they hold live data.
+    ev_desktop_names(ev, NULL);
+    ev_client_list(ev, NULL);
+    ev_client_list_stacking(ev, NULL);
 }
 
 /*
@@ -442,8 +434,7 @@ ev_current_desktop(FbEv *ev, gpointer p)
  *   p  - unused; present to match the signal handler signature.
  *
  * Invalidates the cached active window by resetting it to None.
- * The next call to fb_ev_active_window() would re-fetch — but see the
- * note on fb_ev_active_window being declared but not implemented below.
+ * The next call to fb_ev_active_window() will re-fetch from the X server.
  */
 static void
 ev_active_window(FbEv *ev, gpointer p)
@@ -515,6 +506,7 @@ ev_client_list(FbEv *ev, gpointer p)
     if (ev->client_list) {
         XFree(ev->client_list);  // use XFree because Xlib allocated this buffer
         ev->client_list = NULL;  // reset to sentinel so accessor re-fetches
+        ev->client_list_num = 0;
     }
     RET();
 }
@@ -538,6 +530,7 @@ ev_client_list_stacking(FbEv *ev, gpointer p)
     if (ev->client_list_stacking) {
         XFree(ev->client_list_stacking);  // use XFree because Xlib allocated this buffer
         ev->client_list_stacking = NULL;  // reset to sentinel so accessor re-fetches
+        ev->client_list_stacking_num = 0;
     }
     RET();
 }
@@ -619,23 +612,71 @@ fb_ev_number_of_desktops(FbEv *ev)
 }
 
 /*
- * The following three function declarations appear at the bottom of the .c file.
- * These are DECLARATIONS only (no bodies), meaning these functions are
- * implemented elsewhere (presumably in another .c file, or they are stubs
- * that were never completed).
- *
- * This is highly unusual — function declarations belong in header files, not
- * in .c files.  Having declarations without definitions here means the linker
- * will look for these symbols in other translation units.  If they are not
- * found, the build will fail with undefined reference errors.
- *
- * fb_ev_active_window:       returns the _NET_ACTIVE_WINDOW Window ID.
- * fb_ev_client_list:         returns the _NET_CLIENT_LIST Window array.
- * fb_ev_client_list_stacking:returns the _NET_CLIENT_LIST_STACKING Window array.
- *
- * All three are declared in ev.h as well, which is the correct place.
- * These declarations here are redundant at best and confusing at worst.
+ * fb_ev_active_window - return the focused window (_NET_ACTIVE_WINDOW).
+ *
+ * Parameters:
+ *   ev - a valid FbEv instance.
+ *
+ * Returns: the X11 Window ID, or None if the property is not set.
+ *
+ * Lazy-fetch as above.  A None result is not cached (None is also the
+ * "stale" sentinel), so with no active window every call asks the server.
+ */
+Window
+fb_ev_active_window(FbEv *ev)
+{
+    ENTER;
+    if (ev->active_window == None) {
+        Window *data;
+
+        data = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_ACTIVE_WINDOW, XA_WINDOW, 0);
+        if (data) {
+            ev->active_window = *data;
+            XFree (data);
+        }
+    }
+    RET(ev->active_window);
+}
+
+/*
+ * fb_ev_client_list - return the managed windows (_NET_CLIENT_LIST).
+ *
+ * Parameters:
+ *   ev  - a valid FbEv instance.
+ *   num - OUT: number of entries; 0 when the property is not set.
+ *
+ * Returns: the window array, or NULL.  Owned by FbEv and shared by every
+ * caller in the process (all panels), so one X round trip serves all
+ * taskbars; valid until the next EV_CLIENT_LIST trigger.  Do not XFree().
+ */
+Window *
+fb_ev_client_list(FbEv *ev, int *num)
+{
+    ENTER;
+    if (!ev->client_list)
+        ev->client_list = get_xaproperty (GDK_ROOT_WINDOW(),
+            a_NET_CLIENT_LIST, XA_WINDOW, &ev->client_list_num);
+    if (!ev->client_list)
+        ev->client_list_num = 0;
+    *num = ev->client_list_num;
+    RET(ev->client_list);
+}
+
+/*
+ * fb_ev_client_list_stacking - as fb_ev_client_list(), for
+ * _NET_CLIENT_LIST_STACKING (bottom-most window first); valid until the
+ * next EV_CLIENT_LIST_STACKING trigger.
  */
-Window fb_ev_active_window(FbEv *ev);           // declared but NOT defined in this file
-Window *fb_ev_client_list(FbEv *ev);            // declared but NOT defined in this file
-Window *fb_ev_client_list_stacking(FbEv *ev);   // declared but NOT defined in this file
+Window *
+fb_ev_client_list_stacking(FbEv *ev, int *num)
+{
+    ENTER;
+    if (!ev->client_list_stacking)
+        ev->client_list_stacking = get_xaproperty (GDK_ROOT_WINDOW(),
+            a_NET_CLIENT_LIST_STACKING, XA_WINDOW,
+            &ev->client_list_stacking_num);
+    if (!ev->client_list_stacking)
+        ev->client_list_stacking_num = 0;
+    *num = ev->client_list_stacking_num;
+    RET(ev->client_list_stacking);
+}
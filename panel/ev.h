@@ -54,6 +54,7 @@
 #include <glib.h>
 #include <glib-object.h>
 #include <gtk/gtk.h>
+#include <X11/Xlib.h>
 
 /*
  * GObject type macros for FbEv.
@@ -198,42 +199,36 @@ int fb_ev_number_of_desktops(FbEv *ev);
  *
  * Returns: X11 Window ID of the active window, or None if not set.
  *
- * NOTE: This function is declared here and in ev.c but has NO IMPLEMENTATION
- * anywhere in the visible source.  Calling it will cause a linker error.
- * The cache field (ev->active_window) and the invalidation handler
- * (ev_active_window) exist, but the lazy-fetch body was never written.
+ * Lazy-fetches and caches _NET_ACTIVE_WINDOW; the cache is invalidated
+ * when EV_ACTIVE_WINDOW is triggered.
  */
-Window fb_ev_active_window(FbEv *ev);  // WARNING: implementation is missing
+Window fb_ev_active_window(FbEv *ev);
 
 /*
  * fb_ev_client_list - return the list of all managed client windows.
  *
  * Parameters:
- *   ev - a valid FbEv instance.
+ *   ev  - a valid FbEv instance.
+ *   num - OUT: number of entries (0 if the property is not set).
  *
  * Returns: pointer to an array of X11 Window IDs from _NET_CLIENT_LIST,
- *          or NULL if not set.  The array is owned by FbEv; do NOT XFree() it.
+ *          or NULL if not set.  The array is owned by FbEv and shared by
+ *          all panels and plugins of the process; do NOT XFree() it.
  *          The pointer becomes invalid after the next EV_CLIENT_LIST trigger.
- *
- * NOTE: This function is declared here and in ev.c but has NO IMPLEMENTATION
- * anywhere in the visible source.  Calling it will cause a linker error.
  */
-Window *fb_ev_client_list(FbEv *ev);  // WARNING: implementation is missing
+Window *fb_ev_client_list(FbEv *ev, int *num);
 
 /*
  * fb_ev_client_list_stacking - return client windows in stacking order.
  *
  * Parameters:
- *   ev - a valid FbEv instance.
+ *   ev  - a valid FbEv instance.
+ *   num - OUT: number of entries (0 if the property is not set).
  *
  * Returns: pointer to an array of X11 Window IDs from _NET_CLIENT_LIST_STACKING,
  *          or NULL if not set.  The array is owned by FbEv; do NOT XFree() it.
  *          The pointer becomes invalid after the next EV_CLIENT_LIST_STACKING trigger.
- *
- * NOTE: This function is declared here and in ev.c but has NO IMPLEMENTATION
- * anywhere in the visible source.  Calling it will cause a linker error.
  */
-Window *fb_ev_client_list_stacking(FbEv *ev);  // WARNING: implementation is missing
-
+Window *fb_ev_client_list_stacking(FbEv *ev, int *num);
 
 #endif /* __FB_EV_H__ */
@@ -69,6 +69,8 @@ Atom a_NET_WM_STRUT;
 Atom a_NET_WM_STRUT_PARTIAL;
 Atom a_NET_WM_ICON;
 Atom a_KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR;
+Atom a_NET_STARTUP_INFO_BEGIN;
+Atom a_NET_STARTUP_INFO;
 
 /*
  * resolve_atoms - Intern all required X11 atoms with the X server.
@@ -120,6 +122,8 @@ void resolve_atoms(void)
     a_NET_WM_ICON                = XInternAtom(GDK_DISPLAY(), "_NET_WM_ICON", False);
     a_KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR
                                  = XInternAtom(GDK_DISPLAY(), "_KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR", False);
+    a_NET_STARTUP_INFO_BEGIN     = XInternAtom(GDK_DISPLAY(), "_NET_STARTUP_INFO_BEGIN", False);
+    a_NET_STARTUP_INFO           = XInternAtom(GDK_DISPLAY(), "_NET_STARTUP_INFO", False);
 
     RET();
 }
@@ -70,6 +70,10 @@ extern Atom a_NET_WM_STRUT_PARTIAL;
 extern Atom a_NET_WM_ICON;
 extern Atom a_KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR;
 
+/* freedesktop startup-notification messages (see run.c) */
+extern Atom a_NET_STARTUP_INFO_BEGIN;
+extern Atom a_NET_STARTUP_INFO;
+
 /* -----------------------------------------------------------------------
  * Initialisation
  * ----------------------------------------------------------------------- */
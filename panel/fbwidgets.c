@@ -11,7 +11,9 @@
  *     with ref-count 1; the caller should add it to a container (which
  *     transfers ownership) or manage the ref explicitly.
  *   - GdkPixbuf objects returned by fb_pixbuf_new() are owned by the caller
- *     and must be released with g_object_unref().
+ *     and must be released with g_object_unref().  They may be shared with
+ *     other callers through the pixbuf cache, so they must not be modified
+ *     in place; copy first.
  */
 
 #include <gtk/gtk.h>
@@ -164,6 +166,107 @@ gdk_color_to_RRGGBB(GdkColor *color)
  * Icons larger than this are scaled down. */
 #define MAX_SIZE 192
 
+/*
+ * Pixbuf cache
+ *
+ * Every fb_pixbuf_new() result is kept in a process-wide table keyed by
+ * (iname, fname, width, height, use_fallback), so identical icons in menus,
+ * launchbars, fb_images and meters are looked up and rasterised once and
+ * stored once.  The cache holds one ref per entry; callers get their own.
+ *
+ * Entries are kept in most-recently-used order and the oldest are dropped
+ * beyond PIXBUF_CACHE_MAX.  Dropping an entry only releases the cache's
+ * ref; pixbufs still shown stay alive with their users.
+ *
+ * On icon-theme "changed" the whole cache is flushed once, before any
+ * user reloads (fb_pixbuf_cache_init() connects first, users connect
+ * later or AFTER), so the reloads repopulate it lazily with one lookup per
+ * distinct icon.
+ */
+#define PIXBUF_CACHE_MAX 256
+
+typedef struct {
+    gchar *key;          /* hash key; owned */
+    GdkPixbuf *pb;       /* the cache's reference */
+    GList *lru;          /* link in pixbuf_lru */
+} pixbuf_entry;
+
+static GHashTable *pixbuf_cache;   /* key -> pixbuf_entry* */
+static GQueue pixbuf_lru;          /* pixbuf_entry*, most recent first */
+static gulong pixbuf_itc_id;
+
+static void
+pixbuf_entry_free(pixbuf_entry *e)
+{
+    g_queue_delete_link(&pixbuf_lru, e->lru);
+    g_object_unref(G_OBJECT(e->pb));
+    g_free(e->key);
+    g_free(e);
+}
+
+static void
+pixbuf_cache_flush(GtkIconTheme *theme, gpointer data)
+{
+    ENTER;
+    DBG("flushing %d pixbufs\n", g_hash_table_size(pixbuf_cache));
+    g_hash_table_remove_all(pixbuf_cache);
+    RET();
+}
+
+/*
+ * fb_pixbuf_cache_init - Create the pixbuf cache.
+ *
+ * Called from fb_init() right after icon_theme is set, so its "changed"
+ * handler runs before those of any widget or plugin.
+ */
+void
+fb_pixbuf_cache_init(void)
+{
+    pixbuf_cache = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify) pixbuf_entry_free);
+    g_queue_init(&pixbuf_lru);
+    pixbuf_itc_id = g_signal_connect(G_OBJECT(icon_theme), "changed",
+        G_CALLBACK(pixbuf_cache_flush), NULL);
+}
+
+/* fb_pixbuf_cache_free - Drop the cache; called from fb_free(). */
+void
+fb_pixbuf_cache_free(void)
+{
+    if (!pixbuf_cache)
+        return;
+    g_signal_handler_disconnect(G_OBJECT(icon_theme), pixbuf_itc_id);
+    g_hash_table_destroy(pixbuf_cache);
+    pixbuf_cache = NULL;
+}
+
+/*
+ * fb_pixbuf_load - Uncached part of fb_pixbuf_new(): tries the icon theme,
+ * then the file, then the fallback icon.
+ */
+static GdkPixbuf *
+fb_pixbuf_load(gchar *iname, gchar *fname, int width, int height,
+        gboolean use_fallback)
+{
+    GdkPixbuf *pb = NULL;
+    int size;
+
+    // Clamp the requested size to MAX_SIZE (icon theme uses a single dimension)
+    size = MIN(192, MAX(width, height));
+    // Try loading from the current GTK icon theme by name
+    if (iname && !pb)
+        pb = gtk_icon_theme_load_icon(icon_theme, iname, size,
+            GTK_ICON_LOOKUP_FORCE_SIZE, NULL);  // NULL: ignore GError
+    // Fall back to loading from a file path
+    if (fname && !pb)
+        pb = gdk_pixbuf_new_from_file_at_size(fname, width, height, NULL);
+    // Final fallback: standard "missing image" indicator
+    if (use_fallback && !pb)
+        pb = gtk_icon_theme_load_icon(icon_theme, "gtk-missing-image", size,
+            GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+    return pb;
+}
+
 /*
  * fb_pixbuf_new - Load a GdkPixbuf from an icon name or file, with fallback.
  *
@@ -183,34 +286,47 @@ gdk_color_to_RRGGBB(GdkColor *color)
  *          The result is always no larger than MAX_SIZE (192) pixels in either
  *          dimension when loaded from the icon theme.
  *
- * Memory: Caller owns the returned GdkPixbuf and must unref with
- *         g_object_unref() when done.
+ * Memory: Caller owns a reference to the returned GdkPixbuf and must
+ *         unref it with g_object_unref() when done.  The pixbuf may be
+ *         shared through the pixbuf cache and must not be modified.
  *
- * Ref-count: gtk_icon_theme_load_icon() and gdk_pixbuf_new_from_file_at_size()
- *            both return a pixbuf with an initial ref-count of 1.
+ * Failed loads are not cached, so an icon installed later is found.
  */
 GdkPixbuf *
 fb_pixbuf_new(gchar *iname, gchar *fname, int width, int height,
         gboolean use_fallback)
 {
-    GdkPixbuf *pb = NULL;
-    int size;
+    pixbuf_entry *e;
+    GdkPixbuf *pb;
+    gchar *key;
 
     ENTER;
-    // Clamp the requested size to MAX_SIZE (icon theme uses a single dimension)
-    size = MIN(192, MAX(width, height));
-    // Try loading from the current GTK icon theme by name
-    if (iname && !pb)
-        pb = gtk_icon_theme_load_icon(icon_theme, iname, size,
-            GTK_ICON_LOOKUP_FORCE_SIZE, NULL);  // NULL: ignore GError
-    // Fall back to loading from a file path
-    if (fname && !pb)
-        pb = gdk_pixbuf_new_from_file_at_size(fname, width, height, NULL);
-    // Final fallback: standard "missing image" indicator
-    if (use_fallback && !pb)
-        pb = gtk_icon_theme_load_icon(icon_theme, "gtk-missing-image", size,
-            GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
-    RET(pb);  // may be NULL if all sources failed and use_fallback is FALSE
+    if (!pixbuf_cache)
+        RET(fb_pixbuf_load(iname, fname, width, height, use_fallback));
+    key = g_strdup_printf("%s\n%s\n%dx%d%c", iname ? iname : "",
+        fname ? fname : "", width, height, use_fallback ? '+' : '-');
+    if ((e = g_hash_table_lookup(pixbuf_cache, key))) {
+        g_free(key);
+        /* move to the front of the LRU list */
+        g_queue_unlink(&pixbuf_lru, e->lru);
+        g_queue_push_head_link(&pixbuf_lru, e->lru);
+        RET(g_object_ref(e->pb));
+    }
+    if (!(pb = fb_pixbuf_load(iname, fname, width, height, use_fallback))) {
+        g_free(key);
+        RET(NULL);  // all sources failed and use_fallback is FALSE
+    }
+    e = g_new(pixbuf_entry, 1);
+    e->key = key;
+    e->pb = pb;
+    g_queue_push_head(&pixbuf_lru, e);
+    e->lru = pixbuf_lru.head;
+    g_hash_table_insert(pixbuf_cache, e->key, e);
+    while (pixbuf_lru.length > PIXBUF_CACHE_MAX) {
+        e = g_queue_peek_tail(&pixbuf_lru);
+        g_hash_table_remove(pixbuf_cache, e->key);
+    }
+    RET(g_object_ref(pb));
 }
 
 /*
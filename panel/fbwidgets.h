@@ -37,10 +37,15 @@ gchar *gdk_color_to_RRGGBB(GdkColor *color);
  * Pixbuf / image / button widget factory
  * ----------------------------------------------------------------------- */
 
-/* Load a GdkPixbuf from an icon name or file path, with optional fallback. */
+/* Load a GdkPixbuf from an icon name or file path, with optional fallback.
+ * Results are shared through a process-wide cache: do not modify them. */
 GdkPixbuf *fb_pixbuf_new(gchar *iname, gchar *fname, int width, int height,
         gboolean use_fallback);
 
+/* Create / drop the pixbuf cache; called by fb_init() / fb_free(). */
+void fb_pixbuf_cache_init(void);
+void fb_pixbuf_cache_free(void);
+
 /* Create a GtkImage with automatic icon-theme-change tracking. */
 GtkWidget *fb_image_new(gchar *iname, gchar *fname, int width, int height);
 
@@ -33,7 +33,10 @@
  *     This is correct but confusing — both are separate copies of oxc.
  *   NOTE: dialog is a static global — only one preferences dialog can be
  *     open at a time.  configure() idempotently raises the existing dialog
- *     if called again.
+ *     if called again, even from another panel of the profile.
+ *   - In a multi-panel profile the dialog edits one Panel block; on Apply
+ *     that block is spliced into a fresh read of the profile file, so the
+ *     other panels are saved unchanged (save_panel()).
  */
 
 #include "gconf.h"
@@ -45,6 +48,11 @@
 /* the single preferences dialog instance (NULL when closed) */
 static GtkWidget *dialog;
 
+/* index of the edited Panel block in the profile; -1 for a single-panel
+ * profile configured at top level.  An index, not a pointer: the live
+ * config tree is freed when Apply restarts the panels. */
+static int panel_no;
+
 /* Static references to specific spin/combo widgets for geom_changed() */
 static GtkWidget *width_spin, *width_opt;
 static GtkWidget *xmargin_spin, *ymargin_spin;
@@ -457,6 +465,39 @@ mk_tab_profile(xconf *xc)
     RET(page);
 }
 
+/*
+ * save_panel -- write the edited config @xc to the profile file.
+ *
+ * For panel_no >= 0, the profile is re-read, the sons of its panel_no-th
+ * Panel block are replaced by copies of @xc's sons, and the whole tree is
+ * written back.
+ */
+static void
+save_panel(xconf *xc)
+{
+    xconf *root, *dst, *tmp;
+
+    ENTER;
+    if (panel_no < 0) {
+        xconf_save_to_profile(xc);
+        RET();
+    }
+    root = xconf_new_from_file(panel_get_profile_file(), panel_get_profile());
+    if (!root || !(dst = xconf_find(root, "panel", panel_no))) {
+        ERR("fbpanel: panel %d is no longer in %s; not saved\n",
+            panel_no, panel_get_profile_file());
+        xconf_del(root, FALSE);
+        RET();
+    }
+    xconf_del(dst, TRUE);
+    tmp = xconf_dup(xc);
+    xconf_append_sons(dst, tmp);
+    xconf_del(tmp, FALSE);
+    xconf_save_to_profile(root);
+    xconf_del(root, FALSE);
+    RET();
+}
+
 /*
  * dialog_response_event -- GtkDialog "response" handler.
  *
@@ -496,7 +537,7 @@ dialog_response_event(GtkDialog *_dialog, gint rid, xconf *xc)
             xconf_del(oxc, FALSE);             /* free old snapshot */
             oxc = xconf_dup(xc);              /* new snapshot of current state */
             g_object_set_data(G_OBJECT(dialog), "oxc", oxc);
-            xconf_save_to_profile(xc);         /* persist to disk */
+            save_panel(xc);                    /* persist to disk */
             gtk_main_quit();                   /* trigger panel restart */
         }
     }
@@ -571,8 +612,12 @@ mk_dialog(xconf *oxc)
 
     ENTER;
     DBG("creating dialog\n");
-    name = g_strdup_printf("fbpanel settings: <%s> profile",
-        panel_get_profile());
+    if (panel_no < 0)
+        name = g_strdup_printf("fbpanel settings: <%s> profile",
+            panel_get_profile());
+    else
+        name = g_strdup_printf("fbpanel settings: <%s> profile, panel %d",
+            panel_get_profile(), panel_no + 1);
     dialog = gtk_dialog_new_with_buttons (name,
         NULL,
         GTK_DIALOG_NO_SEPARATOR,
@@ -635,17 +680,27 @@ mk_dialog(xconf *oxc)
  * If already open, brings it to the foreground.
  *
  * Parameters:
- *   xc - the current xconf root tree (passed to mk_dialog as oxc).
+ *   xc - the panel's config: the profile root, or one of its Panel blocks
+ *        (passed to mk_dialog as oxc).
  *
  * Note: Only one preferences dialog can be open at a time (singleton).
  */
 void
 configure(xconf *xc)
 {
+    xconf *x;
+    int i;
+
     ENTER;
     DBG("dialog %p\n",  dialog);
-    if (!dialog)
+    if (!dialog) {
+        panel_no = -1;
+        if (xc->parent)
+            for (i = 0; (x = xconf_find(xc->parent, "panel", i)); i++)
+                if (x == xc)
+                    panel_no = i;
         dialog = mk_dialog(xc);
+    }
     gtk_widget_show(dialog);   /* re-raise if already open */
     RET();
 }
@@ -55,6 +55,20 @@
  * counting and placement — this allows plugins to be hidden without
  * re-ordering the grid.
  *
+ * Incremental layout
+ * ------------------
+ * Taskbars may hold hundreds of children, and any title or visibility
+ * change queues a resize of the whole bar.  To keep that cheap:
+ *   - GTK keeps each child's requisition and only re-runs a child's
+ *     size_request after that child queued a resize.  GtkBar hooks the
+ *     child's "size-request" signal to learn which children did so and
+ *     marks them dirty (bar_dirty_quark).
+ *   - rows/cols and the cell size are cached in the GtkBar and recomputed
+ *     only when the visible-child count, the dimension or the allocation
+ *     size changed.
+ *   - size_allocate calls gtk_widget_size_allocate only on children that
+ *     are dirty or whose cell moved; the others keep their allocation.
+ *
  * Inheritance chain
  * -----------------
  *   GObject -> GInitiallyUnowned -> GtkObject -> GtkWidget
@@ -120,6 +134,16 @@ float ceilf(float x);
  */
 static GtkBoxClass *parent_class = NULL;
 
+/*
+ * bar_dirty_quark - per-child state kept as qdata on each child widget:
+ *   NULL      - not seen yet (no "size-request" hook connected)
+ *   BAR_CLEAN - allocated and not re-requested since
+ *   BAR_DIRTY - re-requested; must be allocated again
+ */
+static GQuark bar_dirty_quark = 0;
+#define BAR_CLEAN GINT_TO_POINTER(1)
+#define BAR_DIRTY GINT_TO_POINTER(2)
+
 /*
  * gtk_bar_get_type - GObject type registration for GtkBar.
  *
@@ -184,6 +208,7 @@ gtk_bar_class_init (GtkBarClass *class)
 
     widget_class->size_request  = gtk_bar_size_request;   // custom grid size request
     widget_class->size_allocate = gtk_bar_size_allocate;  // custom grid size allocate
+    bar_dirty_quark = g_quark_from_static_string("gtk-bar-dirty");
     //widget_class->expose_event = gtk_bar_expose;        // disabled; use GtkBox default
 
 }
@@ -226,6 +251,7 @@ gtk_bar_new(GtkOrientation orient, gint spacing,
     bar->child_width  = MAX(1, child_width);   // clamp to at least 1 pixel to avoid zero-size
     bar->child_height = MAX(1, child_height);  // clamp to at least 1 pixel to avoid zero-size
     bar->dimension    = 1;                     // start with 1 row (or 1 col); caller can adjust
+    bar->last_nvis    = -1;                    // no grid cached yet
     return (GtkWidget *)bar;
 }
 
@@ -270,6 +296,40 @@ gint gtk_bar_get_dimension(GtkBar *bar)
     return bar->dimension;
 }
 
+/*
+ * gtk_bar_child_size_request - "size-request" hook on every child.
+ *
+ * GTK emits it only when the child actually recomputes its requisition,
+ * i.e. after it queued a resize.  Marks the child for reallocation.
+ */
+static void
+gtk_bar_child_size_request(GtkWidget *child, GtkRequisition *req,
+    gpointer data)
+{
+    g_object_set_qdata(G_OBJECT(child), bar_dirty_quark, BAR_DIRTY);
+}
+
+/*
+ * gtk_bar_grid - compute rows and cols for @nvis visible children.
+ *
+ * Horizontal: rows = MIN(dimension, nvis), cols = ceil(nvis / rows)
+ * Vertical:   cols = MIN(dimension, nvis), rows = ceil(nvis / cols)
+ * @nvis must be > 0.
+ */
+static void
+gtk_bar_grid(GtkBar *bar, gint nvis, gint *rows, gint *cols)
+{
+    gint dim = MIN(bar->dimension, nvis);
+
+    if (bar->orient == GTK_ORIENTATION_HORIZONTAL) {
+        *rows = dim;
+        *cols = (gint) ceilf((float) nvis / dim);
+    } else {
+        *cols = dim;
+        *rows = (gint) ceilf((float) nvis / dim);
+    }
+}
+
 /*
  * gtk_bar_size_request - GtkWidget::size_request override.
  *
@@ -277,60 +337,45 @@ gint gtk_bar_get_dimension(GtkBar *bar)
  *   widget      - the GtkBar widget (cast to GtkBox and GtkBar internally).
  *   requisition - output: filled with the widget's desired width and height.
  *
- * This function overrides GtkBox's size_request to implement a grid layout.
- * It iterates over all children, counts the visible ones, and computes the
- * minimum size needed to display them all in a rows x cols grid.
- *
- * Algorithm:
- *   1. Count visible children (nvis_children).
- *   2. If none, return a minimal 2x2 requisition (prevents zero-size widget).
- *   3. Compute rows and cols from dimension and nvis_children:
- *      Horizontal: rows = MIN(dimension, nvis_children),
- *                  cols = ceil(nvis_children / rows)
- *      Vertical:   cols = MIN(dimension, nvis_children),
- *                  rows = ceil(nvis_children / cols)
- *   4. Compute total width/height from child size and spacing.
- *
- * Side effect: calls gtk_widget_size_request() on every visible child.
- *   This is required so children can calculate their own preferred sizes
- *   (particularly important for GtkLabel which needs this before allocation).
- *   The child's reported size is intentionally NOT used in the grid calculation
- *   (all cells have the same fixed size from bar->child_width/height).
- *
- * NOTE: The function calls gtk_widget_size_request() on children but discards
- * the result.  This is intentional — the comment "Do not remove child request"
- * explains that GtkLabel's layout depends on size_request running before
- * size_allocate.  This is a known GTK2 quirk.
- *
- * NOTE: If dimension > nvis_children, dim is clamped to nvis_children via
- * MIN(), preventing division-by-zero in the ceil() calculation (since dim
- * would be the denominator as rows or cols and is at least 1 after the clamp).
+ * Counts the visible children into bar->nvis and returns the size of a
+ * rows x cols grid of fixed cells (see gtk_bar_grid):
+ *   width  = child_width  * cols + spacing * (cols - 1)
+ *   height = child_height * rows + spacing * (rows - 1)
+ * With no visible children a minimal 2x2 requisition is returned.
+ *
+ * Each visible child is still asked for its size request: GtkLabel's
+ * layout depends on request running before alloc.  For children that did
+ * not queue a resize GTK returns the cached requisition without any widget
+ * work; the ones that did are marked dirty by gtk_bar_child_size_request.
+ * A child seen for the first time gets that hook connected and is dirty.
  */
 static void
 gtk_bar_size_request(GtkWidget *widget, GtkRequisition *requisition)
 {
-    GtkBox *box = GTK_BOX(widget);   // access GtkBox base fields (children, spacing)
-    GtkBar *bar = GTK_BAR(widget);;  // access GtkBar fields (child_width, child_height, etc.)
+    GtkBox *box = GTK_BOX(widget);
+    GtkBar *bar = GTK_BAR(widget);
     GtkBoxChild *child;
     GList *children;
-    gint nvis_children, rows, cols, dim;
+    GtkRequisition child_requisition;
+    gint nvis_children, rows, cols;
 
-    // Count visible children; also drive each child's own size_request
     nvis_children = 0;
-    children = box->children;
-    while (children) {
+    for (children = box->children; children; children = children->next) {
         child = children->data;
-        children = children->next;
-
-        if (GTK_WIDGET_VISIBLE(child->widget))	{
-            GtkRequisition child_requisition;
-
-            /* Do not remove child request !!! Label's proper layout depends
-             * on request running before alloc. */
-            gtk_widget_size_request(child->widget, &child_requisition); // result is discarded
-            nvis_children++;
+        if (!GTK_WIDGET_VISIBLE(child->widget))
+            continue;
+        if (!g_object_get_qdata(G_OBJECT(child->widget), bar_dirty_quark)) {
+            g_signal_connect_after(G_OBJECT(child->widget), "size-request",
+                G_CALLBACK(gtk_bar_child_size_request), NULL);
+            g_object_set_qdata(G_OBJECT(child->widget), bar_dirty_quark,
+                BAR_DIRTY);
         }
+        /* Do not remove child request !!! Label's proper layout depends
+         * on request running before alloc. */
+        gtk_widget_size_request(child->widget, &child_requisition);
+        nvis_children++;
     }
+    bar->nvis = nvis_children;
     DBG("nvis_children=%d\n", nvis_children);
     if (!nvis_children) {
         // No visible children: return a minimal non-zero size to avoid layout
@@ -339,17 +384,7 @@ gtk_bar_size_request(GtkWidget *widget, GtkRequisition *requisition)
         requisition->height = 2;
         return;
     }
-    // Clamp dimension to available children count (prevents dim=0 if dimension > nvis_children)
-    dim = MIN(bar->dimension, nvis_children);
-    if (bar->orient == GTK_ORIENTATION_HORIZONTAL) {
-        rows = dim;                                             // dim controls row count
-        cols = (gint) ceilf((float) nvis_children / rows);     // columns = ceil(n/rows)
-    } else {
-        cols = dim;                                             // dim controls column count
-        rows = (gint) ceilf((float) nvis_children / cols);     // rows = ceil(n/cols)
-    }
-
-    // Total size = cell_size * count + spacing * (count - 1)
+    gtk_bar_grid(bar, nvis_children, &rows, &cols);
     requisition->width  = bar->child_width  * cols + box->spacing * (cols - 1);
     requisition->height = bar->child_height * rows + box->spacing * (rows - 1);
     DBG("width=%d, height=%d\n", requisition->width, requisition->height);
@@ -363,42 +398,20 @@ gtk_bar_size_request(GtkWidget *widget, GtkRequisition *requisition)
  *   allocation - the rectangle (x, y, width, height) assigned by the parent
  *                container; this is the space GtkBar must fit into.
  *
- * Called by GTK after size_request, with the actual space the parent has
- * decided to give us (may differ from our request).  Must place all visible
- * children within this space.
- *
- * Algorithm:
- *   1. Count visible children.
- *   2. Compute rows/cols as in size_request.
- *   3. Compute child cell size:
- *      child_width  = MIN(available_width  / cols, bar->child_width)
- *      child_height = MIN(available_height / rows, bar->child_height)
- *      (clamped to >= 1)
- *   4. Walk visible children, placing them left-to-right, top-to-bottom,
- *      wrapping to a new row after every `cols` children.
- *
- * The allocation is stored in widget->allocation (GtkWidget base struct)
- * so that the widget knows its current screen position.
- *
- * gtk_widget_queue_draw() is called after computing layout but before
- * allocating children — this forces a repaint of the bar background even
- * if child positions have not changed.
- *
- * NOTE: Children that exceed bar->child_width / bar->child_height (e.g. if
- * the container gives more space than requested) are capped to the configured
- * cell size via MIN().  This intentionally prevents children from growing
- * larger than the configured cell size even if extra space is available.
- *
- * NOTE: If allocation->width is very small (cols * spacing >= allocation->width),
- * tmp / cols could be 0 or negative before the clamp to >= 1.  The clamp
- * ensures no zero-size allocation is passed to children, preventing X errors,
- * but the layout will overlap or be clipped.
- *
- * NOTE: Invisible children are skipped in placement but they DO occupy slots
- * in the GList iteration; the `tmp` column counter only advances for visible
- * children, so row-wrapping is based on visible children count only.  This
- * means hidden children do not leave gaps in the grid — the next visible child
- * fills in where the hidden one would have been.
+ * Places the bar->nvis visible children counted by the preceding
+ * size_request left-to-right, top-to-bottom, wrapping after every `cols`
+ * children.  The cell size is
+ *   cell_width  = MIN((width  - (cols - 1) * spacing) / cols, child_width)
+ *   cell_height = MIN((height - (rows - 1) * spacing) / rows, child_height)
+ * clamped to >= 1 so no zero-size allocation reaches a child (X errors);
+ * a too small bar overlaps or clips instead.  Cells are capped at the
+ * configured child size even when more space is given.
+ *
+ * The grid and cell size are reused from the previous call unless nvis,
+ * dimension or the allocation size changed; only then is the whole bar
+ * queued for redraw.  A child is allocated only if it is dirty (see
+ * gtk_bar_child_size_request) or its cell differs from its current
+ * allocation.  Hidden children take no cell.
  */
 static void
 gtk_bar_size_allocate(GtkWidget *widget, GtkAllocation *allocation)
@@ -408,80 +421,64 @@ gtk_bar_size_allocate(GtkWidget *widget, GtkAllocation *allocation)
     GtkBoxChild *child;
     GList *children;
     GtkAllocation child_allocation;  // scratch: current cell position/size for each child
-    gint nvis_children, tmp, rows, cols, dim;
+    GtkAllocation *cur;
+    gint tmp;
 
     ENTER;
     DBG("a.w=%d  a.h=%d\n", allocation->width, allocation->height);
     box = GTK_BOX (widget);
     bar = GTK_BAR (widget);
     widget->allocation = *allocation;  // store our actual allocated rectangle
-
-    // Count visible children first (needed to compute grid dimensions)
-    nvis_children = 0;
-    children = box->children;
-    while (children) {
-        child = children->data;
-        children = children->next;
-
-        if (GTK_WIDGET_VISIBLE (child->widget))
-            nvis_children += 1;
-    }
-    gtk_widget_queue_draw(widget);   // force redraw even if child allocations are unchanged
-
-    dim = MIN(bar->dimension, nvis_children);  // clamp dimension to actual child count
-    if (nvis_children == 0)
+    if (bar->nvis == 0) {
+        bar->last_nvis = 0;
         RET();  // nothing to allocate; return early
+    }
 
-    // Compute grid dimensions using same formula as size_request
-    if (bar->orient == GTK_ORIENTATION_HORIZONTAL) {
-        rows = dim;                                          // horizontal: dim = rows
-        cols = (gint) ceilf((float) nvis_children / rows);  // cols = ceil(n/rows)
-    } else {
-        cols = dim;                                          // vertical: dim = cols
-        rows = (gint) ceilf((float) nvis_children / cols);  // rows = ceil(n/cols)
+    if (bar->nvis != bar->last_nvis || bar->dimension != bar->last_dimension
+        || allocation->width != bar->last_width
+        || allocation->height != bar->last_height) {
+        gtk_bar_grid(bar, bar->nvis, &bar->rows, &bar->cols);
+        tmp = allocation->width - (bar->cols - 1) * box->spacing;
+        bar->cell_width = MAX(1, MIN(tmp / bar->cols, bar->child_width));
+        tmp = allocation->height - (bar->rows - 1) * box->spacing;
+        bar->cell_height = MAX(1, MIN(tmp / bar->rows, bar->child_height));
+        bar->last_nvis = bar->nvis;
+        bar->last_dimension = bar->dimension;
+        bar->last_width = allocation->width;
+        bar->last_height = allocation->height;
+        gtk_widget_queue_draw(widget);   // layout changed: repaint the bar
+        DBG("rows=%d cols=%d cell %dx%d\n", bar->rows, bar->cols,
+            bar->cell_width, bar->cell_height);
     }
-    DBG("rows=%d cols=%d\n", rows, cols);
-
-    // Compute child cell width: divide available width among cols, capped at child_width
-    tmp = allocation->width - (cols - 1) * box->spacing;   // total width minus inter-cell gaps
-    child_allocation.width = MIN(tmp / cols, bar->child_width);  // per-cell width, capped
-
-    // Compute child cell height: divide available height among rows, capped at child_height
-    tmp = allocation->height - (rows - 1) * box->spacing;  // total height minus inter-cell gaps
-    child_allocation.height = MIN(tmp / rows, bar->child_height); // per-cell height, capped
-
-    // Clamp to at least 1 pixel to prevent BadValue X errors on zero-size windows
-    if (child_allocation.width < 1)
-        child_allocation.width = 1;
-    if (child_allocation.height < 1)
-        child_allocation.height = 1;
-    DBG("child alloc: width=%d height=%d\n",
-        child_allocation.width,
-        child_allocation.height);
-
-    // Start placing children at the top-left of our allocated rectangle
+
+    child_allocation.width = bar->cell_width;
+    child_allocation.height = bar->cell_height;
     child_allocation.x = allocation->x;
     child_allocation.y = allocation->y;
-    children = box->children;  // restart list iteration from the beginning
     tmp = 0;                   // column counter: tracks position within current row
-    while (children) {
+    for (children = box->children; children; children = children->next) {
         child = children->data;
-        children = children->next;
-
-        if (GTK_WIDGET_VISIBLE (child->widget)) {
+        if (!GTK_WIDGET_VISIBLE (child->widget))
+            continue;
+        cur = &child->widget->allocation;
+        if (g_object_get_qdata(G_OBJECT(child->widget), bar_dirty_quark)
+                != BAR_CLEAN
+            || cur->x != child_allocation.x || cur->y != child_allocation.y
+            || cur->width != child_allocation.width
+            || cur->height != child_allocation.height) {
             DBG("allocate x=%d y=%d\n", child_allocation.x,
                 child_allocation.y);
-            gtk_widget_size_allocate(child->widget, &child_allocation);  // place child in cell
-            tmp++;  // advance column counter
-            if (tmp == cols) {
-                // End of row: wrap to the next row
-                child_allocation.x  = allocation->x;                        // reset to left edge
-                child_allocation.y += child_allocation.height + box->spacing; // move down one row
-                tmp = 0;  // reset column counter for new row
-            } else {
-                // Same row: advance to the next column
-                child_allocation.x += child_allocation.width + box->spacing;
-            }
+            gtk_widget_size_allocate(child->widget, &child_allocation);
+            g_object_set_qdata(G_OBJECT(child->widget), bar_dirty_quark,
+                BAR_CLEAN);
+        }
+        if (++tmp == bar->cols) {
+            // End of row: wrap to the next row
+            child_allocation.x  = allocation->x;
+            child_allocation.y += child_allocation.height + box->spacing;
+            tmp = 0;
+        } else {
+            child_allocation.x += child_allocation.width + box->spacing;
         }
     }
     RET();
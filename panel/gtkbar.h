@@ -95,6 +95,14 @@ typedef struct _GtkBarClass  GtkBarClass;
  *   orient       - GTK_ORIENTATION_HORIZONTAL or GTK_ORIENTATION_VERTICAL;
  *                  set at construction time and used by size_allocate to
  *                  determine tiling direction.
+ *
+ * Layout cache (private; maintained by size_request / size_allocate):
+ *   nvis         - visible children counted by the last size_request.
+ *   rows, cols   - grid computed for (nvis, dimension).
+ *   cell_width,
+ *   cell_height  - cell size computed for (rows, cols, last_width,
+ *                  last_height).
+ *   last_*       - inputs the cached grid was computed from.
  */
 struct _GtkBar
 {
@@ -103,6 +111,11 @@ struct _GtkBar
     gint child_width;        /* width per child slot in pixels */
     gint dimension;          /* max children per row/column (wrapping threshold) */
     GtkOrientation orient;   /* layout direction: horizontal or vertical */
+
+    gint nvis;
+    gint rows, cols;
+    gint cell_width, cell_height;
+    gint last_nvis, last_dimension, last_width, last_height;
 };
 
 /*
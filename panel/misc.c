@@ -30,16 +30,11 @@
 #include "misc.h"
 #include "fbwidgets.h"
 #include "ewmh.h"
+#include "probe.h"
 
 //#define DEBUGPRN
 #include "dbg.h"
 
-/* Global reference to the single panel instance.  Defined in panel.c and
- * used here by menu_pos() to query the panel's geometry.
- * ISSUE: This hard-codes single-panel support; multi-panel setups would
- * require passing the panel explicitly. */
-extern panel *the_panel;
-
 /* ---------------------------------------------------------------------------
  * Enum tables used by the xconf config reader / writer (xconf.c) and the
  * GTK config dialog (gconf_panel.c).  Each table is a NULL-terminated array
@@ -148,7 +143,8 @@ num2str(xconf_enum *p, int num, gchar *defval)
  * fb_init - One-time initialisation of the fbpanel utility layer.
  *
  * Must be called after gtk_init() but before any other fb_* functions.
- * Interns all X11 atoms and caches the default GTK icon theme.
+ * Interns all X11 atoms, caches the default GTK icon theme, creates
+ * the shared pixbuf cache and opens the FBPANEL_PROBE file, if any.
  *
  * No parameters; no return value.
  */
@@ -157,16 +153,20 @@ void fb_init()
     resolve_atoms();
     // gtk_icon_theme_get_default() returns a shared singleton – do NOT unref it
     icon_theme = gtk_icon_theme_get_default();
+    fb_pixbuf_cache_init();
+    fb_probe_init();
 }
 
 /*
  * fb_free - Cleanup counterpart to fb_init().
  *
- * Currently a no-op: the icon_theme singleton is owned by GTK and must NOT
- * be unref'd here (GTK takes care of it at shutdown).
+ * Drops the pixbuf cache and closes the probe file.  The icon_theme singleton is owned by GTK and
+ * must NOT be unref'd here (GTK takes care of it at shutdown).
  */
 void fb_free()
 {
+    fb_pixbuf_cache_free();
+    fb_probe_free();
     // MUST NOT be ref'd or unref'd
     // g_object_unref(icon_theme);
 }
@@ -267,9 +267,10 @@ calculate_width(int scrw, int wtype, int allign, int xmargin,
  *
  * No return value.
  *
- * ISSUE: If np->xineramaHead is a valid index but the Xinerama monitor list
- *        has changed since startup (monitor hotplug), gdk_screen_get_monitor_geometry
- *        could return stale data.  No refresh mechanism exists.
+ * The position is absolute (root-window coordinates), so panels on a monitor
+ * that does not touch the root origin land on that monitor.  GDK refreshes
+ * its monitor list on RandR notifications before emitting "monitors-changed",
+ * so calling this again from that signal (panel.c) gives fresh geometry.
  *
  * ISSUE: aw=0 / ah=0 are clamped to 1 at the end to avoid zero-size windows.
  *        However, gdk/X11 may still reject a 1x1 window in some configurations.
@@ -327,9 +328,9 @@ calculate_position(panel *np)
         np->ah = MIN(PANEL_HEIGHT_MAX, np->ah);  // clamp to max allowed height
         np->ah = MAX(PANEL_HEIGHT_MIN, np->ah);  // clamp to min allowed height
         if (np->edge == EDGE_TOP)
-            np->ay = np->ymargin;          // top-edge panel: offset from top
+            np->ay = miny + np->ymargin;   // top-edge panel: offset from top
         else
-            np->ay = ssheight - np->ah - np->ymargin;  // bottom-edge: offset from bottom
+            np->ay = miny + ssheight - np->ah - np->ymargin;  // bottom-edge: offset from bottom
 
     } else {
         /* Vertical panel: "width" config applies to the vertical (Y) dimension */
@@ -341,9 +342,9 @@ calculate_position(panel *np)
         np->aw = MIN(PANEL_HEIGHT_MAX, np->aw);
         np->aw = MAX(PANEL_HEIGHT_MIN, np->aw);
         if (np->edge == EDGE_LEFT)
-            np->ax = np->ymargin;          // left-edge panel: offset from left
+            np->ax = minx + np->ymargin;   // left-edge panel: offset from left
         else
-            np->ax = sswidth - np->aw - np->ymargin;  // right-edge: offset from right
+            np->ax = minx + sswidth - np->aw - np->ymargin;  // right-edge: offset from right
     }
     // Prevent zero-size windows which confuse X11
     if (!np->aw)
@@ -411,8 +412,8 @@ expand_tilda(gchar *file)
  * @widget  : The widget relative to which the menu should appear, or NULL to
  *            use the current mouse pointer position.
  *
- * ISSUE: Accesses the global the_panel directly; will break with multi-panel
- *        support.
+ * The panel kept clear is the one @widget is packed in (panel_get_by_widget);
+ * with no widget it is the first panel.
  *
  * ISSUE: When @widget is NULL and the pointer coordinates are used, the 20px
  *        offsets are hardcoded and may place the menu off-screen on very
@@ -426,22 +427,23 @@ void
 menu_pos(GtkMenu *menu, gint *x, gint *y, gboolean *push_in, GtkWidget *widget)
 {
     GdkRectangle menuRect;
+    panel *p = panel_get_by_widget(widget);
     // Copy the panel's screen rectangle as the starting "valid area"
-    GdkRectangle validRect = the_panel->screenRect;
+    GdkRectangle validRect = p->screenRect;
 
     ENTER;
 
     /* Shrink validRect to exclude the panel bar itself, so the menu won't
      * be placed on top of the panel. */
-    if(the_panel->orientation == GTK_ORIENTATION_HORIZONTAL) {
-      validRect.height -= the_panel->ah;  // remove panel height from available area
-      if(the_panel->edge == EDGE_TOP) {
-        validRect.y += the_panel->ah;     // top panel: shift valid area downward
+    if(p->orientation == GTK_ORIENTATION_HORIZONTAL) {
+      validRect.height -= p->ah;  // remove panel height from available area
+      if(p->edge == EDGE_TOP) {
+        validRect.y += p->ah;     // top panel: shift valid area downward
       }
     } else {
-      validRect.width -= the_panel->aw;   // remove panel width from available area
-      if(the_panel->edge == EDGE_LEFT) {
-        validRect.x += the_panel->aw;     // left panel: shift valid area rightward
+      validRect.width -= p->aw;   // remove panel width from available area
+      if(p->edge == EDGE_LEFT) {
+        validRect.x += p->aw;     // left panel: shift valid area rightward
       }
     }
 
@@ -3,7 +3,8 @@
  *
  * This file implements:
  *   1. main() — GTK init, argument parsing, profile loading, and the
- *      restart loop (gtk_main → panel_stop → repeat until force_quit != 0).
+ *      restart loop (panels_start → gtk_main → panels_stop → repeat until
+ *      force_quit != 0).
  *   2. panel_start_gui() — builds the complete GTK widget hierarchy:
  *         GtkWindow (topgwin)
  *           └─ GtkBgbox (bbox)
@@ -15,16 +16,32 @@
  *   5. Config parsing (panel_parse_global, panel_parse_plugin).
  *   6. WM strut management (panel_set_wm_strut).
  *
- * Global state (single-panel design):
- *   p / the_panel  — the single active panel instance.
+ * Multiple panels:
+ *   A profile either holds one panel (Global and Plugin blocks at top
+ *   level) or a list of Panel blocks, each with its own Global and Plugin
+ *   blocks.  All panels run in this one process: they share the plugin
+ *   classes (loaded once, refcounted), the icon and pixbuf caches, the FbEv
+ *   bus with its cached client lists and the FbBg root-pixmap reader.  The
+ *   root-window PropertyNotify filter is installed once and fans out to
+ *   every panel; everything else per panel lives in its panel struct.
+ *
+ * Monitor hotplug:
+ *   GDK turns RandR notifications into GdkScreen "monitors-changed" and
+ *   "size-changed"; those (and _NET_DESKTOP_GEOMETRY) schedule one
+ *   panels_update(), which moves each panel and rewrites its strut in
+ *   place — plugins are not restarted.  A Panel whose Global block sets
+ *   PerMonitor runs one instance per monitor; instances are started and
+ *   retired as monitors come and go.
+ *
+ * Global state:
+ *   panels         — GList of panel*, in profile order.
+ *   the_panel      — the first of them (kept for older callers).
  *   fbev           — the FbEv event-bus singleton.
  *   force_quit     — 0 = restart after gtk_main() returns, 1 = exit.
  *   config         — 1 if --configure was passed on the command line.
  *   log_level      — verbosity for DBG()/ERR() macros.
- *   xineramaHead   — Xinerama head index (-1 = no preference).
- *   mwid, hpid     — GLib timeout source IDs for autohide mouse-watcher
- *                    and hide-panel timer.  These are globals, which limits
- *                    fbpanel to a single panel per process.
+ *   xineramaHead   — Xinerama head index (-1 = no preference); the default
+ *                    for panels that do not set xineramaHead themselves.
  */
 
 #include <stdlib.h>
@@ -43,18 +60,20 @@
 #include "misc.h"
 #include "bg.h"
 #include "gtkbgbox.h"
+#ifdef FBPANEL_RENDER_BENCH
+#include "render.h"
+#endif
 
 
 static gchar version[] = PROJECT_VERSION;
 static gchar *profile = "default";     /* name of the active profile */
 static gchar *profile_file;            /* full path to the profile config file */
 
-guint mwid; /* GLib source ID for the autohide mouse-watcher timer (global) */
-guint hpid; /* GLib source ID for the autohide hide-panel timer (global) */
-
-
-FbEv *fbev;          /* FbEv singleton; created in panel_start(), destroyed in panel_stop() */
+FbEv *fbev;          /* FbEv singleton; created in panels_start(), destroyed in panels_stop() */
 gint force_quit = 0; /* 0 = restart after gtk_main() returns; non-zero = exit process */
+#ifdef FBPANEL_RENDER_BENCH
+static int bench_iterations = 100;   /* --iterations */
+#endif
 int config;          /* 1 if --configure / -C flag was given */
 int xineramaHead = FBPANEL_INVALID_XINERAMA_HEAD; /* Xinerama screen index; -1 = auto */
 
@@ -64,8 +83,15 @@ int xineramaHead = FBPANEL_INVALID_XINERAMA_HEAD; /* Xinerama screen index; -1 =
 /** verbosity level of dbg and log functions */
 int log_level = LOG_WARN;
 
-static panel *p;    /* the active panel (used by panel_parse_* helpers) */
-panel *the_panel;   /* same pointer, exposed to plugins via panel.h */
+static GList *panels; /* all panels of the profile, in order */
+panel *the_panel;     /* the first one, exposed via panel.h */
+
+static GSList *per_monitor;   /* config blocks with PerMonitor set */
+static guint update_idle;     /* pending panels_update() source; 0 if none */
+static gulong monitors_sig;   /* GdkScreen "monitors-changed" handler */
+static gulong size_sig;       /* GdkScreen "size-changed" handler */
+
+static void panels_update_later(void);
 
 /*
  * panel_set_wm_strut -- set _NET_WM_STRUT and _NET_WM_STRUT_PARTIAL on topxwin.
@@ -80,6 +106,9 @@ panel *the_panel;   /* same pointer, exposed to plugins via panel.h */
  *   - autohide is enabled (the panel moves off-screen; struts would block apps).
  *
  * Note: data[4..11] encode the start/end of the strut along the screen axis.
+ * Struts are measured from the root window's edges, so a panel on an inner
+ * monitor edge reserves everything between it and the root edge; this is
+ * what EWMH allows, and is exact for monitors at the root's boundary.
  */
 void
 panel_set_wm_strut(panel *p)
@@ -97,28 +126,28 @@ panel_set_wm_strut(panel *p)
     switch (p->edge) {
     case EDGE_LEFT:
         i = 0;
-        data[i] = p->aw + p->ymargin;
+        data[i] = p->ax + p->aw;
         data[4 + i*2] = p->ay;
         data[5 + i*2] = p->ay + p->ah;
         if (p->autohide) data[i] = p->height_when_hidden;
         break;
     case EDGE_RIGHT:
         i = 1;
-        data[i] = p->aw + p->ymargin;
+        data[i] = gdk_screen_width() - p->ax;
         data[4 + i*2] = p->ay;
         data[5 + i*2] = p->ay + p->ah;
         if (p->autohide) data[i] = p->height_when_hidden;
         break;
     case EDGE_TOP:
         i = 2;
-        data[i] = p->ah + p->ymargin;
+        data[i] = p->ay + p->ah;
         data[4 + i*2] = p->ax;
         data[5 + i*2] = p->ax + p->aw;
         if (p->autohide) data[i] = p->height_when_hidden;
         break;
     case EDGE_BOTTOM:
         i = 3;
-        data[i] = p->ah + p->ymargin;
+        data[i] = gdk_screen_height() - p->ay;
         data[4 + i*2] = p->ax;
         data[5 + i*2] = p->ax + p->aw;
         if (p->autohide) data[i] = p->height_when_hidden;
@@ -168,22 +197,22 @@ print_wmdata(panel *p)
  * Only handles PropertyNotify events on the root window.
  * Translates _NET_* atom changes into FbEv signals (via fb_ev_trigger).
  *
+ * Installed once per process by panels_start(); each change is triggered
+ * once on the shared fbev and the desktop state is copied into every panel.
+ *
  * Special cases:
- *   _XROOTPMAP_ID          — refreshes background (if transparent).
- *   _NET_DESKTOP_GEOMETRY  — calls gtk_main_quit() to trigger a restart.
- *
- * BUG: When _NET_DESKTOP_GEOMETRY fires, gtk_main_quit() is called but
- *   force_quit is NOT set to 0 (RESTART).  The restart loop condition is
- *   `while (force_quit == 0)`, so after quitting, force_quit is still 0
- *   and the panel restarts.  This actually works, but it is fragile and
- *   relies on force_quit's initial value of 0.
+ *   _XROOTPMAP_ID          — refreshes background (if any panel is transparent).
+ *   _NET_DESKTOP_GEOMETRY  — re-places the panels (panels_update_later()).
  */
 static GdkFilterReturn
-panel_event_filter(GdkXEvent *xevent, GdkEvent *event, panel *p)
+panel_event_filter(GdkXEvent *xevent, GdkEvent *event, gpointer data)
 {
     Atom at;
     Window win;
     XEvent *ev = (XEvent *) xevent;
+    GList *l;
+    panel *p;
+    guint n;
 
     ENTER;
     DBG("win = 0x%lx\n", ev->xproperty.window);
@@ -199,11 +228,15 @@ panel_event_filter(GdkXEvent *xevent, GdkEvent *event, panel *p)
             fb_ev_trigger(fbev, EV_CLIENT_LIST);
         } else if (at == a_NET_CURRENT_DESKTOP) {
             DBG("A_NET_CURRENT_DESKTOP\n");
-            p->curdesk = get_net_current_desktop();
+            n = get_net_current_desktop();
+            for (l = panels; l; l = l->next)
+                ((panel *) l->data)->curdesk = n;
             fb_ev_trigger(fbev, EV_CURRENT_DESKTOP);
         } else if (at == a_NET_NUMBER_OF_DESKTOPS) {
             DBG("A_NET_NUMBER_OF_DESKTOPS\n");
-            p->desknum = get_net_number_of_desktops();
+            n = get_net_number_of_desktops();
+            for (l = panels; l; l = l->next)
+                ((panel *) l->data)->desknum = n;
             fb_ev_trigger(fbev, EV_NUMBER_OF_DESKTOPS);
         } else if (at == a_NET_DESKTOP_NAMES) {
             DBG("A_NET_DESKTOP_NAMES\n");
@@ -220,13 +253,20 @@ panel_event_filter(GdkXEvent *xevent, GdkEvent *event, panel *p)
             //      XA_CARDINAL, &p->wa_len);
             //print_wmdata(p);
         } else if (at == a_XROOTPMAP_ID) {
-            /* root window pixmap changed → refresh pseudo-transparent background */
-            if (p->transparent)
-                fb_bg_notify_changed_bg(p->bg);
+            /* root window pixmap changed → refresh pseudo-transparent
+             * backgrounds; FbBg is shared, so notifying it once reaches
+             * every transparent panel */
+            for (l = panels; l; l = l->next) {
+                p = l->data;
+                if (p->transparent && p->bg) {
+                    fb_bg_notify_changed_bg(p->bg);
+                    break;
+                }
+            }
         } else if (at == a_NET_DESKTOP_GEOMETRY) {
             DBG("a_NET_DESKTOP_GEOMETRY\n");
-            /* desktop geometry changed → force a panel restart */
-            gtk_main_quit();
+            /* desktop geometry changed → move the panels */
+            panels_update_later();
         } else
             RET(GDK_FILTER_CONTINUE);
         RET(GDK_FILTER_REMOVE);    /* event handled; swallow it */
@@ -543,7 +583,7 @@ ah_state_visible(panel *p)
  * If the mouse returns close before the timer fires, cancels the timer and
  * transitions back to VISIBLE.
  *
- * Note: hpid is a global variable, which assumes a single panel per process.
+ * The timer id is kept in p->hide_tout.
  */
 static gboolean
 ah_state_waiting(panel *p)
@@ -552,11 +592,11 @@ ah_state_waiting(panel *p)
     if (p->ah_state != ah_state_waiting) {
         /* entering WAITING state: start hide timer */
         p->ah_state = ah_state_waiting;
-        hpid = g_timeout_add(2 * PERIOD, (GSourceFunc) ah_state_hidden, p);
+        p->hide_tout = g_timeout_add(2 * PERIOD, (GSourceFunc) ah_state_hidden, p);
     } else if (!p->ah_far) {
         /* mouse came back close → cancel hide timer, go back to visible */
-        g_source_remove(hpid);
-        hpid = 0;
+        g_source_remove(p->hide_tout);
+        p->hide_tout = 0;
         ah_state_visible(p);
     }
     RET(FALSE);
@@ -573,7 +613,9 @@ ah_state_hidden(panel *p)
 {
     ENTER;
     if (p->ah_state != ah_state_hidden) {
-        /* entering HIDDEN state: hide panel window */
+        /* entering HIDDEN state (from the one-shot WAITING timer, which
+         * is removed by returning FALSE): hide panel window */
+        p->hide_tout = 0;
         p->ah_state = ah_state_hidden;
         gtk_widget_hide(p->topgwin);
     } else if (!p->ah_far) {
@@ -587,13 +629,13 @@ ah_state_hidden(panel *p)
  * ah_start -- start the autohide state machine.
  *
  * Starts the mouse-watcher timer and puts the state machine in VISIBLE.
- * mwid (global) holds the timer source ID.
+ * p->mouse_tout holds the timer source ID.
  */
 void
 ah_start(panel *p)
 {
     ENTER;
-    mwid = g_timeout_add(PERIOD, (GSourceFunc) mouse_watch, p);
+    p->mouse_tout = g_timeout_add(PERIOD, (GSourceFunc) mouse_watch, p);
     ah_state_visible(p);
     RET();
 }
@@ -601,20 +643,20 @@ ah_start(panel *p)
 /*
  * ah_stop -- stop the autohide state machine.
  *
- * Cancels both the mouse-watcher timer (mwid) and the hide-panel timer
- * (hpid), if they are running.
+ * Cancels both the mouse-watcher timer (mouse_tout) and the hide-panel
+ * timer (hide_tout), if they are running.
  */
 void
 ah_stop(panel *p)
 {
     ENTER;
-    if (mwid) {
-        g_source_remove(mwid);
-        mwid = 0;
+    if (p->mouse_tout) {
+        g_source_remove(p->mouse_tout);
+        p->mouse_tout = 0;
     }
-    if (hpid) {
-        g_source_remove(hpid);
-        hpid = 0;
+    if (p->hide_tout) {
+        g_source_remove(p->hide_tout);
+        p->hide_tout = 0;
     }
     RET();
 }
@@ -753,7 +795,7 @@ panel_scroll_event(GtkWidget *widget, GdkEventScroll *event, panel *p)
  * Also:
  *   - Registers signal handlers on topgwin.
  *   - Realizes the window and gets the X11 window ID (topxwin).
- *   - Installs the root-window PropertyNotify filter.
+ *   - Tags topgwin with @p for panel_get_by_widget().
  *   - Creates the right-click context menu.
  *   - Sets the WM strut if configured.
  *
@@ -762,8 +804,8 @@ panel_scroll_event(GtkWidget *widget, GdkEventScroll *event, panel *p)
  *   once the window manager places it correctly, or from panel_show_anyway()
  *   (200ms timeout) as a fallback.
  *
- * BUG: p->bg (FbBg) is acquired here via fb_bg_get_for_display() but is
- *   never released with g_object_unref() in panel_stop().  The FbBg ref leaks.
+ * p->bg (FbBg) is acquired here via fb_bg_get_for_display() and released
+ * in panel_stop().
  */
 static void
 panel_start_gui(panel *p)
@@ -772,6 +814,7 @@ panel_start_gui(panel *p)
 
     /* create the top-level panel window */
     p->topgwin = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    g_object_set_data(G_OBJECT(p->topgwin), "panel", p);
     gtk_container_set_border_width(GTK_CONTAINER(p->topgwin), 0);
     g_signal_connect(G_OBJECT(p->topgwin), "destroy-event",
         (GCallback) panel_destroy_event, p);
@@ -823,8 +866,7 @@ panel_start_gui(panel *p)
     gtk_container_add(GTK_CONTAINER(p->topgwin), p->bbox);
     gtk_container_set_border_width(GTK_CONTAINER(p->bbox), 0);
     if (p->transparent) {
-        /* BUG: p->bg is never g_object_unref'd in panel_stop() — leaks FbBg ref */
-        p->bg = fb_bg_get_for_display();
+        p->bg = fb_bg_get_for_display();   /* shared; unref'd in panel_stop() */
         gtk_bgbox_set_background(p->bbox, BG_ROOT, p->tintcolor, p->alpha);
     }
 
@@ -850,11 +892,6 @@ panel_start_gui(panel *p)
 
     if (p->setstrut)
         panel_set_wm_strut(p);
-
-    /* listen for PropertyNotify events on the root window */
-    XSelectInput(GDK_DISPLAY(), GDK_ROOT_WINDOW(), PropertyChangeMask);
-    gdk_window_add_filter(gdk_get_default_root_window(),
-          (GdkFilterFunc)panel_event_filter, p);
     gdk_flush();
     RET();
 }
@@ -868,7 +905,8 @@ panel_start_gui(panel *p)
  * fetches initial desktop state from X11, and calls panel_start_gui().
  *
  * Parameters:
- *   xc - the "global" xconf sub-tree.
+ *   p  - the panel being started.
+ *   xc - its "global" xconf sub-tree.
  *
  * Returns: 1 (always; panel_start_gui does not fail).
  *
@@ -878,7 +916,7 @@ panel_start_gui(panel *p)
  *   though HEIGHT_PERCENT is defined.
  */
 static int
-panel_parse_global(xconf *xc)
+panel_parse_global(panel *p, xconf *xc)
 {
     ENTER;
     /* Set default values */
@@ -912,6 +950,8 @@ panel_parse_global(xconf *xc)
     XCG(xc, "height", &p->height, int);
     XCG(xc, "xmargin", &p->xmargin, int);
     XCG(xc, "ymargin", &p->ymargin, int);
+    if (!p->per_monitor)
+        XCG(xc, "xineramahead", &p->xineramaHead, int);
 
     /* properties */
     XCG(xc, "setdocktype", &p->setdocktype, enum, bool_enum);
@@ -976,6 +1016,7 @@ panel_parse_global(xconf *xc)
  * plugin.
  *
  * Parameters:
+ *   p  - the panel the plugin goes into.
  *   xc - a "plugin" xconf sub-tree.
  *
  * If the plugin's .so cannot be loaded, a g_warning is printed and the
@@ -984,7 +1025,7 @@ panel_parse_global(xconf *xc)
  * and the function returns — the panel continues with the remaining plugins.
  */
 static void
-panel_parse_plugin(xconf *xc)
+panel_parse_plugin(panel *p, xconf *xc)
 {
     plugin_instance *plug = NULL;
     gchar *type = NULL;
@@ -1019,26 +1060,182 @@ panel_parse_plugin(xconf *xc)
  * Returns: FALSE to remove itself from the GLib main loop.
  */
 static gboolean
-panel_show_anyway(gpointer data)
+panel_show_anyway(panel *p)
 {
     ENTER;
+    p->show_tout = 0;
     gtk_widget_show_all(p->topgwin);
     return FALSE;
 }
 
 
 /*
- * panel_start -- top-level panel initialisation sequence.
+ * panel_start -- initialise one panel from its config.
+ *
+ * Parses the "global" config block (which builds the GUI), and then loads
+ * each "plugin" block of p->xc.  Schedules a 200ms fallback show timeout.
+ */
+static void
+panel_start(panel *p)
+{
+    int i;
+    xconf *pxc;
+
+    ENTER;
+    panel_parse_global(p, xconf_find(p->xc, "global", 0));
+    for (i = 0; (pxc = xconf_find(p->xc, "plugin", i)); i++)
+        panel_parse_plugin(p, pxc);
+    /* Fallback: show panel 200ms after startup regardless of configure-event */
+    p->show_tout = g_timeout_add(200, (GSourceFunc) panel_show_anyway, p);
+    RET();
+}
+
+/*
+ * panel_new -- create a panel for the config block @xc and start it.
  *
- * Creates the FbEv singleton, parses the "global" config block (which builds
- * the GUI), and then loads each "plugin" block from the config tree.
- * Schedules a 200ms fallback show timeout.
+ * @head is the monitor of a PerMonitor instance, or -1 for an ordinary
+ * panel (which takes xineramaHead from its config or the command line).
  *
- * Parameters:
- *   xc - the root xconf tree (profile config).
+ * The first panel created also becomes `the_panel`; it is set before the
+ * panel starts so that plugin classes loaded from here on register as
+ * dynamic (see class_register()).
+ */
+static void
+panel_new(xconf *xc, int head)
+{
+    panel *p;
+
+    ENTER;
+    p = g_new0(panel, 1);
+    p->per_monitor = (head >= 0);
+    p->xineramaHead = p->per_monitor ? head : xineramaHead;
+    p->xc = xc;
+    if (!panels)
+        the_panel = p;
+    panels = g_list_append(panels, p);
+    panel_start(p);
+    RET();
+}
+
+/*
+ * panels_add -- start the panel(s) of one config block: one panel, or one
+ * per monitor if its Global block sets PerMonitor.
+ */
+static void
+panels_add(xconf *xc)
+{
+    int i, n, pm = 0;
+
+    ENTER;
+    XCG(xconf_find(xc, "global", 0), "permonitor", &pm, enum, bool_enum);
+    if (!pm) {
+        panel_new(xc, -1);
+        RET();
+    }
+    per_monitor = g_slist_append(per_monitor, xc);
+    n = gdk_screen_get_n_monitors(gdk_screen_get_default());
+    for (i = 0; i < n; i++)
+        panel_new(xc, i);
+    RET();
+}
+
+/*
+ * panel_reposition -- move and resize a running panel after a screen change.
+ *
+ * panel_configure_event() finishes the job (background, corners, strut)
+ * once the WM has moved the window.  The strut is also rewritten right
+ * away, since it depends on the root size, which may change while the
+ * panel stays put.
  */
 static void
-panel_start(xconf *xc)
+panel_reposition(panel *p)
+{
+    ENTER;
+    calculate_position(p);
+    DBG("move-resize x %d y %d w %d h %d\n", p->ax, p->ay, p->aw, p->ah);
+    gtk_window_move(GTK_WINDOW(p->topgwin), p->ax, p->ay);
+    gtk_window_resize(GTK_WINDOW(p->topgwin), p->aw, p->ah);
+    if (p->setstrut)
+        panel_set_wm_strut(p);
+    RET();
+}
+
+/*
+ * panels_update -- follow a monitor or screen-size change (idle callback).
+ *
+ * Retires PerMonitor instances whose monitor is gone, re-places every
+ * other panel, then starts instances for monitors that have none yet.
+ */
+static gboolean
+panels_update(gpointer data)
+{
+    GList *l, *next;
+    GSList *s;
+    panel *p;
+    int i, n;
+
+    ENTER;
+    update_idle = 0;
+    n = gdk_screen_get_n_monitors(gdk_screen_get_default());
+    DBG("%d monitors\n", n);
+    for (l = panels; l; l = next) {
+        next = l->next;
+        p = l->data;
+        if (p->per_monitor && p->xineramaHead >= n) {
+            DBG("retire panel of monitor %d\n", p->xineramaHead);
+            panels = g_list_delete_link(panels, l);
+            panel_stop(p);
+            g_free(p);
+        } else
+            panel_reposition(p);
+    }
+    /* monitor 0 always exists, so no PerMonitor set is ever empty */
+    the_panel = panels->data;
+    for (s = per_monitor; s; s = s->next)
+        for (i = 0; i < n; i++) {
+            for (l = panels; l; l = l->next) {
+                p = l->data;
+                if (p->per_monitor && p->xc == s->data && p->xineramaHead == i)
+                    break;
+            }
+            if (!l) {
+                DBG("new panel for monitor %d\n", i);
+                panel_new(s->data, i);
+            }
+        }
+    RET(FALSE);
+}
+
+/*
+ * panels_update_later -- schedule panels_update(); a hotplug typically
+ * emits several signals and property changes, which all fold into one.
+ */
+static void
+panels_update_later(void)
+{
+    if (!update_idle)
+        update_idle = g_idle_add(panels_update, NULL);
+}
+
+/* panels_screen_changed -- GdkScreen "monitors-changed"/"size-changed". */
+static void
+panels_screen_changed(GdkScreen *screen, gpointer data)
+{
+    ENTER;
+    panels_update_later();
+    RET();
+}
+
+/*
+ * panels_start -- start every panel of the profile @xc.
+ *
+ * Creates the FbEv singleton and the root-window PropertyNotify filter
+ * shared by all panels, then the panels of each Panel block; a profile
+ * without Panel blocks is a single panel configured at top level.
+ * Finally subscribes to screen changes.
+ */
+static void
+panels_start(xconf *xc)
 {
     int i;
     xconf *pxc;
@@ -1046,11 +1243,20 @@ panel_start(xconf *xc)
     ENTER;
     fbev = fb_ev_new();   /* create FbEv event-bus singleton */
 
-    panel_parse_global(xconf_find(xc, "global", 0));
-    for (i = 0; (pxc = xconf_find(xc, "plugin", i)); i++)
-        panel_parse_plugin(pxc);
-    /* Fallback: show panel 200ms after startup regardless of configure-event */
-    g_timeout_add(200, panel_show_anyway, NULL);
+    /* listen for PropertyNotify events on the root window */
+    XSelectInput(GDK_DISPLAY(), GDK_ROOT_WINDOW(), PropertyChangeMask);
+    gdk_window_add_filter(gdk_get_default_root_window(),
+          (GdkFilterFunc)panel_event_filter, NULL);
+
+    if (!xconf_find(xc, "panel", 0))
+        panels_add(xc);
+    for (i = 0; (pxc = xconf_find(xc, "panel", i)); i++)
+        panels_add(pxc);
+
+    monitors_sig = g_signal_connect(G_OBJECT(gdk_screen_get_default()),
+        "monitors-changed", G_CALLBACK(panels_screen_changed), NULL);
+    size_sig = g_signal_connect(G_OBJECT(gdk_screen_get_default()),
+        "size-changed", G_CALLBACK(panels_screen_changed), NULL);
     RET();
 }
 
@@ -1072,16 +1278,11 @@ delete_plugin(gpointer data, gpointer udata)
  * panel_stop -- tear down the panel and release all resources.
  *
  * Order of operations:
- *   1. Stop autohide timers.
+ *   1. Stop autohide and fallback-show timers.
  *   2. Destroy all loaded plugins (stop + put).
- *   3. Remove root-window X11 event filter.
- *   4. Destroy topgwin (which cascades to all child widgets).
- *   5. Destroy context menu.
- *   6. Unref FbEv singleton.
- *   7. Flush X11 event queues.
- *
- * Note: p->bg (FbBg) is NOT unreffed here — this is a memory leak.
- *   Fix: if (p->transparent && p->bg) g_object_unref(p->bg);
+ *   3. Destroy topgwin (which cascades to all child widgets).
+ *   4. Destroy context menu.
+ *   5. Release the FbBg reference.
  */
 static void
 panel_stop(panel *p)
@@ -1090,23 +1291,70 @@ panel_stop(panel *p)
 
     if (p->autohide)
         ah_stop(p);                      /* stop autohide timers */
+    if (p->show_tout)
+        g_source_remove(p->show_tout);
     g_list_foreach(p->plugins, delete_plugin, NULL);
     g_list_free(p->plugins);
     p->plugins = NULL;
 
-    XSelectInput(GDK_DISPLAY(), GDK_ROOT_WINDOW(), NoEventMask);
-    gdk_window_remove_filter(gdk_get_default_root_window(),
-          (GdkFilterFunc)panel_event_filter, p);
     gtk_widget_destroy(p->topgwin);   /* destroys all child widgets recursively */
     gtk_widget_destroy(p->menu);      /* menu is not a child of topgwin */
+    if (p->bg)
+        g_object_unref(p->bg);
+    RET();
+}
+
+/*
+ * panels_stop -- stop and free every panel, then the shared state set up
+ * by panels_start(), and flush the X11 event queues.
+ *
+ * `the_panel` is left pointing at the freed first panel: class_register()
+ * only tests it for NULL, and the next panels_start() replaces it.
+ */
+static void
+panels_stop(void)
+{
+    GList *l;
+
+    ENTER;
+    g_signal_handler_disconnect(G_OBJECT(gdk_screen_get_default()),
+        monitors_sig);
+    g_signal_handler_disconnect(G_OBJECT(gdk_screen_get_default()), size_sig);
+    if (update_idle) {
+        g_source_remove(update_idle);
+        update_idle = 0;
+    }
+    for (l = panels; l; l = l->next) {
+        panel_stop(l->data);
+        g_free(l->data);
+    }
+    g_list_free(panels);
+    panels = NULL;
+    g_slist_free(per_monitor);
+    per_monitor = NULL;
+
+    XSelectInput(GDK_DISPLAY(), GDK_ROOT_WINDOW(), NoEventMask);
+    gdk_window_remove_filter(gdk_get_default_root_window(),
+          (GdkFilterFunc)panel_event_filter, NULL);
     g_object_unref(fbev);             /* release FbEv singleton */
-    /* BUG: p->bg (FbBg) not g_object_unref'd here if p->transparent was set */
     gdk_flush();
     XFlush(GDK_DISPLAY());
     XSync(GDK_DISPLAY(), True);
     RET();
 }
 
+/* panel_get_by_widget -- see panel.h */
+panel *
+panel_get_by_widget(GtkWidget *widget)
+{
+    panel *p = NULL;
+
+    if (widget)
+        p = g_object_get_data(G_OBJECT(gtk_widget_get_toplevel(widget)),
+            "panel");
+    return p ? p : the_panel;
+}
+
 /*
  * usage -- print command-line help and exit.
  */
@@ -1121,6 +1369,9 @@ usage()
     printf(" --log <number> -- set log level 0-5. 0 - none 5 - chatty\n");
     printf(" --configure -- launch configuration utility\n");
     printf(" --profile name -- use specified profile\n");
+#ifdef FBPANEL_RENDER_BENCH
+    printf(" --iterations N -- measured relayouts/repaints per widget\n");
+#endif
     printf("\n");
     printf(" -h  -- same as --help\n");
     printf(" -p  -- same as --profile\n");
@@ -1180,7 +1431,8 @@ sig_usr2(int signum)
  * do_argv -- parse command-line arguments.
  *
  * Processes --help, --version, --log, --configure, --profile, --xineramaHead
- * and their short-form equivalents.
+ * and their short-form equivalents, plus --iterations in the render
+ * benchmark build.
  * Exits the process directly for --help and --version.
  */
 static void
@@ -1224,6 +1476,16 @@ do_argv(int argc, char *argv[])
             exit(1);
           }
           xineramaHead = atoi(argv[i]);
+#ifdef FBPANEL_RENDER_BENCH
+        } else if (!strcmp(argv[i], "--iterations")) {
+            i++;
+            if (i == argc) {
+                ERR("fbpanel: missing iteration count\n");
+                usage();
+                exit(1);
+            }
+            bench_iterations = atoi(argv[i]);
+#endif
         } else {
             printf("fbpanel: unknown option - %s\n", argv[i]);
             usage();
@@ -1280,11 +1542,10 @@ ensure_profile()
  * Initialises locale, GTK, X11, and GLib, then enters the restart loop:
  *
  *   do {
- *       allocate panel struct
  *       parse config from profile_file
- *       panel_start() → build GUI, load plugins, run gtk_main()
- *       panel_stop()  → destroy plugins and widgets
- *       free panel struct
+ *       panels_start() → build every panel's GUI and load its plugins
+ *       gtk_main()
+ *       panels_stop()  → destroy plugins and widgets, free the panels
  *   } while (force_quit == 0);
  *
  * The restart loop allows SIGUSR1 to reload the config without restarting
@@ -1294,6 +1555,8 @@ ensure_profile()
 int
 main(int argc, char *argv[])
 {
+    xconf *xc;
+
     setlocale(LC_CTYPE, "");
     bindtextdomain(PROJECT_NAME, LOCALEDIR);
     textdomain(PROJECT_NAME);
@@ -1311,21 +1574,21 @@ main(int argc, char *argv[])
     signal(SIGUSR1, sig_usr1);   /* reload config */
     signal(SIGUSR2, sig_usr2);   /* quit */
 
-    /* restart loop: each iteration = one panel lifetime */
+    /* restart loop: each iteration = one lifetime of the profile's panels */
     do {
-        the_panel = p = g_new0(panel, 1);
-        p->xineramaHead = xineramaHead;
-        p->xc = xconf_new_from_file(profile_file, profile);
-        if (!p->xc)
+        xc = xconf_new_from_file(profile_file, profile);
+        if (!xc)
             exit(1);
 
-        panel_start(p->xc);
+        panels_start(xc);
+#ifdef FBPANEL_RENDER_BENCH
+        render_bench_start(panels, bench_iterations);
+#endif
         if (config)
-            configure(p->xc);   /* open preferences dialog if -C given */
+            configure(the_panel->xc);   /* open preferences dialog if -C given */
         gtk_main();             /* run GTK event loop */
-        panel_stop(p);
-        xconf_del(p->xc, FALSE);
-        g_free(p);
+        panels_stop();
+        xconf_del(xc, FALSE);
         DBG("force_quit=%d\n", force_quit);
     } while (force_quit == 0);
     g_free(profile_file);
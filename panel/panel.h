@@ -12,7 +12,7 @@
  * Global variables exported here:
  *   fbev        - the EWMH event bus (FbEv GObject)
  *   icon_theme  - the global GtkIconTheme (do not unref)
- *   the_panel   - pointer to the single panel instance (declared in panel.c)
+ *   the_panel   - the first panel of the profile (declared in panel.c)
  *   verbose     - debug verbosity level
  *   force_quit  - set to non-zero to exit the main loop
  *   cprofile    - currently active profile name string
@@ -77,10 +77,11 @@ enum { LAYER_ABOVE, LAYER_BELOW };
 #define IMGPREFIX  DATADIR "/images"
 
 /*
- * struct _panel -- runtime state for the single fbpanel instance.
+ * struct _panel -- runtime state of one panel bar.
  *
- * Created in panel.c:panel_new() and accessed via the global `the_panel`.
- * Plugins receive a non-owning pointer via plugin_instance::panel.
+ * Created in panel.c:panel_new(), one per panel of the profile; the first
+ * one is also the global `the_panel`.  Plugins receive a non-owning
+ * pointer via plugin_instance::panel and must use that, not `the_panel`.
  *
  * Layout-related fields:
  *   topgwin         - top-level GtkWindow (the panel bar itself)
@@ -114,15 +115,20 @@ enum { LAYER_ABOVE, LAYER_BELOW };
  *   ah_dx, ah_dy    - pixel offsets applied when sliding the panel hidden
  *   height_when_hidden - panel height in pixels when hidden (≥ 1)
  *   hide_tout       - GLib timer source ID for the hide delay; 0 if inactive
+ *   mouse_tout      - GLib timer source ID for the mouse watcher; 0 if inactive
  *   ah_state        - function pointer to the current autohide state handler
  *
  * Plugin management:
  *   plug_num        - count of active plugin instances
  *   plugins         - GList of plugin_instance* pointers (in display order)
- *   xc              - root of the parsed config tree (owned by the panel)
+ *   xc              - this panel's config: the profile root, or its Panel
+ *                     block in a multi-panel profile (owned by main())
+ *   show_tout       - fallback show timer started by panel_start(); 0 once run
  *
  * Multimonitor:
  *   xineramaHead    - monitor index (-1 = FBPANEL_INVALID_XINERAMA_HEAD)
+ *   per_monitor     - 1 if this is one instance of a PerMonitor panel;
+ *                     xineramaHead is then its monitor
  *   screenRect      - GdkRectangle of the target monitor geometry
  *
  * EWMH state cache:
@@ -163,6 +169,7 @@ typedef struct _panel
 
     /* Multi-monitor */
     int xineramaHead;             /* target monitor index; -1 = use primary */
+    gint per_monitor;             /* 1 = one instance of a PerMonitor panel */
     GdkRectangle screenRect;      /* geometry of the target monitor */
 
     /* Panel behaviour flags */
@@ -180,6 +187,7 @@ typedef struct _panel
     int ah_dx, ah_dy;             /* pixel offsets for slide-hide animation */
     int height_when_hidden;       /* panel height when hidden (pixels; ≥ 1) */
     guint hide_tout;              /* GLib source ID of hide-delay timer; 0 if off */
+    guint mouse_tout;             /* GLib source ID of mouse-watch timer; 0 if off */
 
     int spacing;                  /* pixel gap between plugins in the box */
 
@@ -195,7 +203,8 @@ typedef struct _panel
     /* Autohide state function pointer (set by ah_start/ah_stop) */
     gboolean (*ah_state)(struct _panel *);
 
-    xconf *xc;                    /* root of the config tree (owned by panel) */
+    xconf *xc;                    /* this panel's config tree (not owned) */
+    guint show_tout;              /* fallback show timer; 0 once it has run */
 } panel;
 
 
@@ -356,6 +365,14 @@ extern GtkIconTheme *icon_theme;      /* global icon theme; do NOT g_object_unre
  */
 void panel_set_wm_strut(panel *p);
 
+/*
+ * panel_get_by_widget -- return the panel a widget is packed in.
+ *
+ * Looks at the widget's toplevel window; for widgets outside any panel
+ * (popup menus, dialogs) and for NULL, returns `the_panel`.
+ */
+panel *panel_get_by_widget(GtkWidget *widget);
+
 /*
  * panel_get_profile -- return the active profile name (e.g., "default").
  *
@@ -48,6 +48,12 @@
 //#define DEBUGPRN
 #include "dbg.h"  // ENTER/RET/DBG/ERR tracing macros
 
+// Directory the lib<name>.so plugins are loaded from.  fbpanel-render-bench
+// defines it as the build directory so it runs without installing.
+#ifndef PLUGIN_DIR
+#define PLUGIN_DIR LIBDIR
+#endif
+
 /*
  * the_panel -- singleton panel instance declared in main panel code.
  * We use it here only to determine whether a registering plugin is "dynamic"
@@ -213,7 +219,7 @@ class_put(char *name)
         RET();
 
     // The last instance of a dynamic plugin was released; close the .so.
-    s = g_strdup_printf(LIBDIR "/lib%s.so", name);  // reconstruct the .so path
+    s = g_strdup_printf(PLUGIN_DIR "/lib%s.so", name);  // reconstruct the .so path
     DBG("loading module %s\n", s);
 
     // Open the module a second time to get a fresh GModule handle.
@@ -240,7 +246,8 @@ class_put(char *name)
  * class_get:
  *
  * Looks up a plugin class by type name.  If not already in the registry,
- * attempts to load LIBDIR/lib<name>.so via GModule.
+ * attempts to load PLUGIN_DIR/lib<name>.so via GModule (PLUGIN_DIR is
+ * LIBDIR except in fbpanel-render-bench).
  *
  * Parameters:
  *   name - the plugin type string (e.g., "taskbar", "clock").
@@ -285,7 +292,7 @@ class_get(char *name)
     }
 
     // Slow path: attempt to load the shared library for this plugin type.
-    s = g_strdup_printf(LIBDIR "/lib%s.so", name);  // e.g., "/usr/lib/libclock.so"
+    s = g_strdup_printf(PLUGIN_DIR "/lib%s.so", name);  // e.g., "/usr/lib/libclock.so"
     DBG("loading module %s\n", s);
     m = g_module_open(s, G_MODULE_BIND_LAZY);  // LAZY = resolve symbols on use
     g_free(s);  // path string no longer needed after open
@@ -0,0 +1,57 @@
+/*
+ * probe.c -- latency probes for external benchmarks (see probe.h).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "probe.h"
+
+//#define DEBUGPRN
+#include "dbg.h"
+
+int fb_probe_fd = -1;
+
+void
+fb_probe_init(void)
+{
+    const char *path;
+
+    ENTER;
+    if (fb_probe_fd >= 0 || !(path = getenv("FBPANEL_PROBE")) || !*path)
+        RET();
+    /* O_NONBLOCK: a FIFO without a reader fails here instead of hanging,
+     * and a full one drops lines instead of stalling the panel */
+    fb_probe_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_NONBLOCK
+        | O_CLOEXEC, 0644);
+    if (fb_probe_fd < 0)
+        ERR("fbpanel: can't open probe file %s: %s\n", path,
+            g_strerror(errno));
+    RET();
+}
+
+void
+fb_probe_free(void)
+{
+    ENTER;
+    if (fb_probe_fd >= 0)
+        close(fb_probe_fd);
+    fb_probe_fd = -1;
+    RET();
+}
+
+void
+fb_probe_hit(const char *event, Window win)
+{
+    char buf[96];
+    int n;
+
+    n = g_snprintf(buf, sizeof(buf), "%s 0x%lx %" G_GINT64_FORMAT "\n",
+        event, (unsigned long) win, g_get_monotonic_time());
+    /* shorter than PIPE_BUF, so a FIFO gets the line whole or not at all */
+    if (write(fb_probe_fd, buf, MIN(n, (int) sizeof(buf) - 1)) < 0)
+        DBG("probe dropped: %s", buf);
+}
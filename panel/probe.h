@@ -0,0 +1,44 @@
+/*
+ * probe.h -- latency probes for external benchmarks.
+ *
+ * When fbpanel is started with FBPANEL_PROBE=<path> in its environment,
+ * every FB_PROBE() hit appends one line to <path>:
+ *
+ *   <event> 0x<window> <microseconds>\n
+ *
+ * where the time is g_get_monotonic_time() (CLOCK_MONOTONIC, comparable
+ * across processes on the same host).  <path> is usually a FIFO read by
+ * fbpanel-winstorm, but any writable file works.  Writes never block:
+ * if the reader falls behind, lines are dropped.
+ *
+ * Without FBPANEL_PROBE a probe costs one test of a global.
+ *
+ * Events (see docs/DEBUGGING.md):
+ *   tb.clientlist     taskbar applied _NET_CLIENT_LIST (window None)
+ *   tb.name           taskbar relabelled a task after WM_NAME
+ *   tb.desktop        taskbar applied _NET_WM_DESKTOP
+ *   tb.icon           taskbar replaced a task icon after _NET_WM_ICON
+ *   pager.stacking    pager applied _NET_CLIENT_LIST_STACKING (window None)
+ *   pager.desktop     pager applied _NET_WM_DESKTOP
+ */
+#ifndef _PROBE_H_
+#define _PROBE_H_
+
+#include <X11/Xlib.h>
+#include <glib.h>
+
+extern int fb_probe_fd;   /* -1 unless FBPANEL_PROBE is set */
+
+#define FB_PROBE(event, win) \
+    do { if (fb_probe_fd >= 0) fb_probe_hit(event, win); } while (0)
+
+/* fb_probe_init -- open FBPANEL_PROBE, if set; called by fb_init(). */
+void fb_probe_init(void);
+
+/* fb_probe_free -- close it; called by fb_free(). */
+void fb_probe_free(void);
+
+/* fb_probe_hit -- write one line; use FB_PROBE() instead. */
+void fb_probe_hit(const char *event, Window win);
+
+#endif /* _PROBE_H_ */
@@ -1,48 +1,420 @@
 /*
  * run.c -- Asynchronous process execution for fbpanel plugins.
  *
- * Two entry points:
- *   run_app()      - launches a shell command string (via g_spawn_command_line_async)
+ * Entry points:
+ *   fb_launcher_*  - a command parsed once at config time and spawned on
+ *                    demand (launchbar buttons, menu items)
+ *   run_app()      - one-shot launch of a command string
  *   run_app_argv() - launches a command from an argv array (via g_spawn_async)
  *
- * Both display a GTK error dialog on failure and return immediately on success.
- * Callers do not need to wait for or reap child processes.
+ * Launcher spawning:
+ *   A command line without shell syntax is split into argv once, its
+ *   program resolved against PATH on the first launch (creating a launcher
+ *   costs no file system access, so menus with many entries rebuild
+ *   cheaply), and each launch is a single
+ *   posix_spawn() -- vfork semantics, so launching does not copy the page
+ *   tables of the panel and does not start a /bin/sh.  Commands that need
+ *   the shell (pipes, redirects, globs, variables, ...) are spawned as
+ *   /bin/sh -c "cmd", still via posix_spawn().
+ *
+ *   Launched children stay children of the panel; they are reaped through
+ *   GLib's child watch (one SIGCHLD handler for the whole process) with a
+ *   single shared callback, launch_child_exited().
+ *
+ * Startup notification:
+ *   Each launch broadcasts a freedesktop startup-notification "new:"
+ *   message (_NET_STARTUP_INFO_BEGIN/_NET_STARTUP_INFO client messages on
+ *   the root window) and exports DESKTOP_STARTUP_ID to the child, so window
+ *   managers and taskbars can show launch feedback.  Applications complete
+ *   the sequence themselves; fbpanel sends "remove:" if the child fails or
+ *   after SN_TIMEOUT seconds.
+ *
+ * All functions display a GTK error dialog on failure and return
+ * immediately on success.
  *
  * See run.h for the public API documentation.
  */
+#include <spawn.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
 #include "run.h"
+#include "ewmh.h"
 #include "dbg.h"
 
+extern char **environ;
+
+/* Seconds after which a startup sequence is closed by the panel. */
+#define SN_TIMEOUT 15
+
+/* Characters that make a command line need /bin/sh.  Quotes and
+ * backslashes are not listed: g_shell_parse_argv() handles them. */
+#define SHELL_CHARS "|&;<>()$`*?[#~\n"
+
+struct _fb_launcher {
+    gchar  *cmd;      /* original command line (shell path, DnD) */
+    gchar **argv;     /* parsed argv; NULL when the shell is needed */
+    gchar  *path;     /* argv[0] resolved against PATH; NULL until launched */
+    gchar  *name;     /* startup-notification NAME */
+    gchar  *icon;     /* startup-notification ICON, or NULL */
+    gchar  *bin;      /* program basename, for BIN= and the sequence id */
+};
+
+/* One running launch: reaped by launch_child_exited(). */
+typedef struct {
+    GPid   pid;
+    gchar *sn_id;     /* startup id while the sequence is open, else NULL */
+    guint  timeout;   /* SN_TIMEOUT source id, 0 when not armed */
+} launch;
+
+static Window sn_window;     /* source window of startup messages */
+static guint sn_serial;      /* makes startup ids unique per process */
+
+/* Show a spawn error to the user in a modal dialog. */
+static void
+run_error(const gchar *msg)
+{
+    GtkWidget *dialog = gtk_message_dialog_new(NULL, 0,
+        GTK_MESSAGE_ERROR,
+        GTK_BUTTONS_CLOSE,
+        "%s", msg);
+    gtk_dialog_run(GTK_DIALOG(dialog));   // blocks until user closes
+    gtk_widget_destroy(dialog);           // clean up the dialog widget
+}
+
+/* ---------------------------------------------------------------------------
+ * Startup notification
+ * ------------------------------------------------------------------------- */
+
+/*
+ * sn_broadcast -- send one startup-notification message.
+ *
+ * The NUL-terminated message is split into 20-byte ClientMessage chunks;
+ * the first uses _NET_STARTUP_INFO_BEGIN, the rest _NET_STARTUP_INFO.
+ */
+static void
+sn_broadcast(const gchar *msg)
+{
+    XClientMessageEvent xev;
+    const gchar *src = msg;
+    gsize left = strlen(msg) + 1;
+    gsize n;
+
+    if (!sn_window)
+        sn_window = XCreateSimpleWindow(GDK_DISPLAY(), GDK_ROOT_WINDOW(),
+            -100, -100, 1, 1, 0, 0, 0);
+    memset(&xev, 0, sizeof(xev));
+    xev.type = ClientMessage;
+    xev.send_event = True;
+    xev.display = GDK_DISPLAY();
+    xev.window = sn_window;
+    xev.message_type = a_NET_STARTUP_INFO_BEGIN;
+    xev.format = 8;
+    while (left) {
+        n = MIN(left, sizeof(xev.data.b));
+        memset(xev.data.b, 0, sizeof(xev.data.b));
+        memcpy(xev.data.b, src, n);
+        XSendEvent(GDK_DISPLAY(), GDK_ROOT_WINDOW(), False,
+            PropertyChangeMask, (XEvent *) &xev);
+        xev.message_type = a_NET_STARTUP_INFO;
+        src += n;
+        left -= n;
+    }
+    XFlush(GDK_DISPLAY());
+}
+
+/* Append ` key="value"` to @s, escaping as the spec requires. */
+static void
+sn_append(GString *s, const gchar *key, const gchar *value)
+{
+    if (!value)
+        return;
+    g_string_append_printf(s, " %s=\"", key);
+    for (; *value; value++) {
+        if (*value == '"' || *value == '\\')
+            g_string_append_c(s, '\\');
+        g_string_append_c(s, *value);
+    }
+    g_string_append_c(s, '"');
+}
+
+/* Open a startup sequence for @l; returns its id (DESKTOP_STARTUP_ID). */
+static gchar *
+sn_begin(fb_launcher *l)
+{
+    guint32 time = gtk_get_current_event_time();
+    GString *msg;
+    gchar *id, *screen, *desktop;
+
+    if (time == GDK_CURRENT_TIME)
+        time = gdk_x11_get_server_time(gdk_get_default_root_window());
+    id = g_strdup_printf("fbpanel-%d-%s-%s-%u_TIME%u", (int) getpid(),
+        g_get_host_name(), l->bin, sn_serial++, time);
+    g_strdelimit(id, " \t\n\"\\", '_');
+    screen = g_strdup_printf("%d",
+        gdk_screen_get_number(gdk_screen_get_default()));
+    desktop = g_strdup_printf("%u", get_net_current_desktop());
+
+    msg = g_string_new("new:");
+    sn_append(msg, "ID", id);
+    sn_append(msg, "NAME", l->name);
+    sn_append(msg, "SCREEN", screen);
+    sn_append(msg, "BIN", l->bin);
+    sn_append(msg, "ICON", l->icon);
+    sn_append(msg, "DESKTOP", desktop);
+    sn_broadcast(msg->str);
+    g_string_free(msg, TRUE);
+    g_free(screen);
+    g_free(desktop);
+    return id;
+}
+
+/* Close the startup sequence of @la, if still open. */
+static void
+sn_end(launch *la)
+{
+    GString *msg;
+
+    if (la->timeout) {
+        g_source_remove(la->timeout);
+        la->timeout = 0;
+    }
+    if (!la->sn_id)
+        return;
+    msg = g_string_new("remove:");
+    sn_append(msg, "ID", la->sn_id);
+    sn_broadcast(msg->str);
+    g_string_free(msg, TRUE);
+    g_free(la->sn_id);
+    la->sn_id = NULL;
+}
+
+/* ---------------------------------------------------------------------------
+ * Launcher
+ * ------------------------------------------------------------------------- */
+
 /*
- * run_app -- spawn a shell command string asynchronously.
+ * A launch is freed once both its child has exited and its startup
+ * sequence is closed, whichever of the two callbacks below runs last.
+ */
+
+/* SN_TIMEOUT expired: the application never completed its sequence. */
+static gboolean
+launch_sn_timeout(launch *la)
+{
+    la->timeout = 0;
+    sn_end(la);
+    if (!la->pid)
+        g_free(la);
+    return FALSE;
+}
+
+/*
+ * launch_child_exited -- shared child-watch callback for all launches.
  *
- * Wraps g_spawn_command_line_async(), which uses /bin/sh -c internally.
- * Shows a GtkMessageDialog on spawn failure and frees the GError.
+ * A child that exits with an error closes its startup sequence at once;
+ * a clean exit (e.g. a wrapper script that started the real program)
+ * leaves it to the application or to SN_TIMEOUT.
+ */
+static void
+launch_child_exited(GPid pid, gint status, launch *la)
+{
+    ENTER;
+    DBG("pid %d exited with status %d\n", pid, status);
+    g_spawn_close_pid(pid);
+    la->pid = 0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        sn_end(la);
+    if (!la->timeout)
+        g_free(la);
+    RET();
+}
+
+fb_launcher *
+fb_launcher_new(const gchar *cmd, const gchar *name, const gchar *icon)
+{
+    fb_launcher *l;
+    const gchar *prog;
+
+    ENTER;
+    if (!cmd)
+        RET(NULL);
+    while (g_ascii_isspace(*cmd))
+        cmd++;
+    if (!*cmd)
+        RET(NULL);
+    l = g_new0(fb_launcher, 1);
+    l->cmd = g_strdup(cmd);
+    l->icon = g_strdup(icon);
+    if (!strpbrk(cmd, SHELL_CHARS)
+        && g_shell_parse_argv(cmd, NULL, &l->argv, NULL)
+        && strchr(l->argv[0], '=')) {
+        /* leading VAR=value assignment: only the shell understands it */
+        g_strfreev(l->argv);
+        l->argv = NULL;
+    }
+    prog = l->argv ? l->argv[0] : cmd;
+    l->bin = g_path_get_basename(prog);
+    if (!l->argv)
+        /* shell command: the first word is the best guess at the program */
+        l->bin[strcspn(l->bin, " \t" SHELL_CHARS)] = '\0';
+    l->name = g_strdup(name ? name : l->bin);
+    DBG("'%s': %s\n", cmd, l->argv ? "direct" : "shell");
+    RET(l);
+}
+
+void
+fb_launcher_free(fb_launcher *l)
+{
+    ENTER;
+    if (!l)
+        RET();
+    g_free(l->cmd);
+    g_strfreev(l->argv);
+    g_free(l->path);
+    g_free(l->name);
+    g_free(l->icon);
+    g_free(l->bin);
+    g_free(l);
+    RET();
+}
+
+GPid
+fb_launcher_run(fb_launcher *l, gchar **args)
+{
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t fa;
+    sigset_t mask;
+    gchar **argv, **envp, *shcmd = NULL, *quoted;
+    const gchar *path;
+    launch *la;
+    pid_t pid;
+    short flags;
+    int n, nargs, i, err;
+
+    ENTER;
+    if (!l)
+        RET(0);
+    nargs = args ? g_strv_length(args) : 0;
+    if (l->argv) {
+        if (!l->path)
+            l->path = g_find_program_in_path(l->argv[0]);
+        if (!l->path) {
+            gchar *msg = g_strdup_printf("Failed to execute child process "
+                "\"%s\" (%s)", l->argv[0], g_strerror(ENOENT));
+            run_error(msg);
+            g_free(msg);
+            RET(0);
+        }
+        path = l->path;
+        n = g_strv_length(l->argv);
+        argv = g_new(gchar *, n + nargs + 1);
+        memcpy(argv, l->argv, n * sizeof(gchar *));
+        if (nargs)
+            memcpy(argv + n, args, nargs * sizeof(gchar *));
+        argv[n + nargs] = NULL;
+    } else {
+        if (nargs) {
+            GString *cmd = g_string_new(l->cmd);
+
+            for (i = 0; i < nargs; i++) {
+                quoted = g_shell_quote(args[i]);
+                g_string_append_c(cmd, ' ');
+                g_string_append(cmd, quoted);
+                g_free(quoted);
+            }
+            shcmd = g_string_free(cmd, FALSE);
+        }
+        path = "/bin/sh";
+        argv = g_new(gchar *, 4);
+        argv[0] = "sh";
+        argv[1] = "-c";
+        argv[2] = shcmd ? shcmd : l->cmd;
+        argv[3] = NULL;
+    }
+
+    la = g_new0(launch, 1);
+    la->sn_id = sn_begin(l);
+    envp = g_environ_setenv(g_get_environ(), "DESKTOP_STARTUP_ID",
+        la->sn_id, TRUE);
+
+    /* child starts with default signal handling and an empty mask */
+    posix_spawnattr_init(&attr);
+    flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+#ifdef POSIX_SPAWN_SETSID
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigfillset(&mask);
+    posix_spawnattr_setsigdefault(&attr, &mask);
+    posix_spawn_file_actions_init(&fa);
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 34)
+    /* do not leak the panel's descriptors into the application */
+    posix_spawn_file_actions_addclosefrom_np(&fa, 3);
+#endif
+#endif
+
+    err = posix_spawn(&pid, path, &fa, &attr, argv, envp);
+    if (err == ENOENT && l->argv) {
+        /* the cached path went away (package upgrade...): look again */
+        g_free(l->path);
+        if ((l->path = g_find_program_in_path(l->argv[0]))) {
+            path = l->path;
+            err = posix_spawn(&pid, path, &fa, &attr, argv, envp);
+        } else
+            path = l->argv[0];
+    }
+
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+    g_strfreev(envp);
+    g_free(argv);
+    g_free(shcmd);
+
+    if (err) {
+        gchar *msg = g_strdup_printf("Failed to execute child process "
+            "\"%s\" (%s)", path, g_strerror(err));
+        sn_end(la);
+        g_free(la);
+        run_error(msg);
+        g_free(msg);
+        RET(0);
+    }
+    la->pid = pid;
+    la->timeout = g_timeout_add_seconds(SN_TIMEOUT,
+        (GSourceFunc) launch_sn_timeout, la);
+    g_child_watch_add(pid, (GChildWatchFunc) launch_child_exited, la);
+    RET(pid);
+}
+
+/*
+ * run_app -- spawn a command string asynchronously.
+ *
+ * Builds a temporary fb_launcher so one-off commands get the same direct
+ * exec path and startup notification as launchbar buttons.
  * Silently returns (no error) if cmd is NULL.
  *
- * Memory: the GError is allocated by GLib on failure and freed here.
  * The cmd string is not modified or owned.
  */
 void
 run_app(gchar *cmd)
 {
-    GError *error = NULL;
+    fb_launcher *l;
 
     ENTER;
-    if (!cmd)          // nothing to do if no command given
+    if (!(l = fb_launcher_new(cmd, NULL, NULL)))
         RET();
-
-    if (!g_spawn_command_line_async(cmd, &error))
-    {
-        /* Show the spawn error to the user in a modal dialog */
-        GtkWidget *dialog = gtk_message_dialog_new(NULL, 0,
-            GTK_MESSAGE_ERROR,
-            GTK_BUTTONS_CLOSE,
-            "%s", error->message);
-        gtk_dialog_run(GTK_DIALOG(dialog));   // blocks until user closes
-        gtk_widget_destroy(dialog);           // clean up the dialog widget
-        g_error_free(error);                  // release the GError struct
-    }
+    fb_launcher_run(l, NULL);
+    fb_launcher_free(l);
     RET();
 }
 
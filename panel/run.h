@@ -1,10 +1,11 @@
 /*
  * run.h -- Asynchronous process execution API for fbpanel.
  *
- * Provides simple wrappers around GLib's g_spawn_* family for launching
- * external commands from plugins (launchbar, menu, wincmd, etc.).
+ * Provides a launcher object for commands that are run repeatedly
+ * (launchbar buttons, menu items) and simple one-shot wrappers for
+ * everything else.
  *
- * Both functions are non-blocking: they return immediately after forking
+ * All functions are non-blocking: they return immediately after spawning
  * the child process.  Error messages are shown in a GTK dialog on failure.
  *
  * Thread safety: both functions must be called from the GTK main thread only.
@@ -15,17 +16,59 @@
 #include <gtk/gtk.h>
 
 /*
- * run_app -- spawn a shell command asynchronously.
+ * fb_launcher -- a command parsed once, ready to be spawned many times.
+ *
+ * Commands without shell syntax are split into argv at creation time and
+ * executed directly with posix_spawn(); the program is looked up in PATH
+ * on the first launch and again if it has disappeared since.  The rest
+ * run through /bin/sh -c.
+ * Each launch sends a freedesktop startup-notification "new:" message and
+ * passes DESKTOP_STARTUP_ID to the child.  Children are reaped by run.c.
+ */
+typedef struct _fb_launcher fb_launcher;
+
+/*
+ * fb_launcher_new -- parse @cmd into a launcher.
+ *
+ * Parameters:
+ *   cmd  - command line (tilde already expanded by the caller).
+ *   name - human readable name for startup notification, or NULL to use
+ *          the program name.
+ *   icon - icon name for startup notification, or NULL.
+ *
+ * Returns: a new launcher (free with fb_launcher_free), or NULL if @cmd
+ *          is NULL or empty.  All strings are copied.
+ */
+fb_launcher *fb_launcher_new(const gchar *cmd, const gchar *name,
+    const gchar *icon);
+
+/* fb_launcher_free -- free @l; children already launched are unaffected. */
+void fb_launcher_free(fb_launcher *l);
+
+/*
+ * fb_launcher_run -- spawn the command of @l.
+ *
+ * Parameters:
+ *   l    - launcher; NULL is a no-op.
+ *   args - optional NULL-terminated extra arguments (e.g. dropped files)
+ *          appended to the command line, or NULL.  Quoted for the shell
+ *          when the command runs through it.
+ *
+ * Returns: the child's pid, or 0 on failure (an error dialog is shown).
+ */
+GPid fb_launcher_run(fb_launcher *l, gchar **args);
+
+/*
+ * run_app -- spawn a command line asynchronously.
  *
  * Parameters:
- *   cmd - shell command string passed to g_spawn_command_line_async().
- *         The shell is used for word-splitting, globbing, and redirects.
- *         May be NULL (silently returns without error).
+ *   cmd - command string; may be NULL (silently returns without error).
  *
- * On failure: shows a GtkMessageDialog with the error and frees GError.
- * On success: child process runs independently; panel does not wait for it.
+ * Convenience wrapper for one-off commands: builds a temporary fb_launcher,
+ * runs it and frees it.  Plugins that run the same command repeatedly
+ * should keep an fb_launcher instead.
  *
- * Note: g_spawn_command_line_async runs the command through the shell (/bin/sh).
+ * Note: commands containing shell syntax run through /bin/sh.
  * Do not pass untrusted user input — it may be executed as shell code.
  */
 void run_app(gchar *cmd);
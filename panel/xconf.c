@@ -27,6 +27,9 @@
  *   xconf_cmp()           — compare two trees for differences.
  *   xconf_save_to_file()  — serialise tree back to a file.
  *   xconf_prn()           — debug-print tree to a FILE*.
+ *   xconf_arena_new()     — create a region for bulk-allocated trees.
+ *   xconf_new_in()        — allocate a node inside an arena.
+ *   xconf_arena_free()    — release an arena and every node in it.
  *
  * Ownership rules:
  *   - xconf_get_str() sets *val to a RAW POINTER into xconf-owned memory.
@@ -34,6 +37,12 @@
  *   - xconf_get_strdup() sets *val to a g_strdup'd copy.  Caller MUST g_free().
  *   - xconf_del() frees the node AND all descendants.  After calling it, any
  *     string pointers obtained via xconf_get_str() are dangling.
+ *   - Arena nodes (x->arena != NULL) are never freed individually: their
+ *     structs, strings and sons links are bump-allocated from the arena's
+ *     blocks, xconf_del() only unlinks them, and xconf_arena_free() returns
+ *     everything in a handful of g_free() calls.  This keeps generated menus
+ *     with thousands of entries from costing tens of thousands of
+ *     malloc/free pairs on every rebuild.
  *
  * Known bugs / limitations:
  *   - LINE_LENGTH (256) truncates config values longer than 255 characters.
@@ -46,6 +55,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <stdio.h>
 #include <ctype.h>
@@ -85,6 +95,168 @@ typedef struct {
 } line;
 
 
+/* Size of one regular arena block; larger requests get a dedicated block. */
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+/* Alignment for node structs and list links carved out of an arena. */
+#define ARENA_ALIGN (2 * sizeof(gpointer))
+
+/*
+ * arena_block -- header of one g_malloc'd arena block.
+ *
+ * The usable area starts at ARENA_HDR bytes past the header so that the
+ * first allocation in every block is ARENA_ALIGN-aligned.
+ */
+typedef struct _arena_block {
+    struct _arena_block *next;   /* previously allocated block, or NULL */
+} arena_block;
+
+#define ARENA_HDR \
+    ((sizeof(arena_block) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/*
+ * xconf_arena -- bump allocator backing arena-allocated xconf trees.
+ *
+ * Fields:
+ *   blocks - singly-linked chain of all blocks (newest regular block first).
+ *   pos    - next free byte in the current block.
+ *   end    - one past the last byte of the current block.
+ */
+struct _xconf_arena {
+    arena_block *blocks;
+    gchar *pos;
+    gchar *end;
+};
+
+/*
+ * xconf_arena_new -- create an empty arena.
+ *
+ * No block is allocated until the first node is created.
+ *
+ * Returns: new arena; free with xconf_arena_free().
+ */
+xconf_arena *
+xconf_arena_new(void)
+{
+    return g_new0(xconf_arena, 1);
+}
+
+/*
+ * xconf_arena_free -- free every block of @a and @a itself.
+ *
+ * Parameters:
+ *   a - arena to free (may be NULL; no-op in that case).
+ *
+ * WARNING: every xconf node allocated in @a is dangling after this call.
+ */
+void
+xconf_arena_free(xconf_arena *a)
+{
+    arena_block *b;
+
+    if (!a)
+        return;
+    while ((b = a->blocks))
+    {
+        a->blocks = b->next;
+        g_free(b);
+    }
+    g_free(a);
+}
+
+/*
+ * arena_alloc -- carve @size bytes aligned to @align out of @a.
+ *
+ * Requests that do not fit into what is left of the current block start a
+ * new ARENA_BLOCK_SIZE block.  Requests larger than a block get a block of
+ * their own which is chained behind the current one, so the remaining space
+ * of the current block is not wasted.
+ *
+ * Parameters:
+ *   a     - arena to allocate from.
+ *   size  - number of bytes needed.
+ *   align - required alignment (power of two; 1 for strings).
+ *
+ * Returns: uninitialised memory owned by @a.
+ */
+static gpointer
+arena_alloc(xconf_arena *a, gsize size, gsize align)
+{
+    arena_block *b;
+    gchar *p;
+
+    p = (gchar *) (((gsize) a->pos + align - 1) & ~(align - 1));
+    if (a->pos && p + size <= a->end)
+    {
+        a->pos = p + size;
+        return p;
+    }
+    if (size + ARENA_HDR > ARENA_BLOCK_SIZE)
+    {
+        /* oversized request: dedicated block, keep the current one open */
+        b = g_malloc(size + ARENA_HDR);
+        if (a->blocks)
+        {
+            b->next = a->blocks->next;
+            a->blocks->next = b;
+        }
+        else
+        {
+            b->next = NULL;
+            a->blocks = b;
+        }
+        return (gchar *) b + ARENA_HDR;
+    }
+    b = g_malloc(ARENA_BLOCK_SIZE);
+    b->next = a->blocks;
+    a->blocks = b;
+    p = (gchar *) b + ARENA_HDR;
+    a->pos = p + size;
+    a->end = (gchar *) b + ARENA_BLOCK_SIZE;
+    return p;
+}
+
+/*
+ * arena_strdup -- copy @str into @a.
+ *
+ * Returns: arena-owned copy, or NULL if @str is NULL.
+ */
+static gchar *
+arena_strdup(xconf_arena *a, const gchar *str)
+{
+    gsize len;
+    gchar *ret;
+
+    if (!str)
+        return NULL;
+    len = strlen(str) + 1;
+    ret = arena_alloc(a, len, 1);
+    memcpy(ret, str, len);
+    return ret;
+}
+
+/*
+ * xconf_strdup -- copy @str into the storage class of node @x.
+ *
+ * Arena nodes get an arena copy, heap nodes a g_strdup'd one.
+ */
+static gchar *
+xconf_strdup(xconf *x, const gchar *str)
+{
+    return x->arena ? arena_strdup(x->arena, str) : g_strdup(str);
+}
+
+/*
+ * xconf_free_value -- release x->value if it was heap-allocated.
+ */
+static void
+xconf_free_value(xconf *x)
+{
+    if (!x->arena)
+        g_free(x->value);
+    x->value = NULL;
+}
+
 /*
  * xconf_new -- allocate a new xconf node.
  *
@@ -104,6 +276,32 @@ xconf *xconf_new(gchar *name, gchar *value)
     return x;
 }
 
+/*
+ * xconf_new_in -- allocate a new xconf node inside arena @a.
+ *
+ * Parameters:
+ *   a     - arena to allocate from; NULL falls back to xconf_new().
+ *   name  - node name; copied into the arena.
+ *   value - node value (NULL for block nodes); copied into the arena.
+ *
+ * Returns: new node owned by @a; released by xconf_arena_free(a).
+ */
+xconf *
+xconf_new_in(xconf_arena *a, gchar *name, gchar *value)
+{
+    xconf *x;
+
+    if (!a)
+        return xconf_new(name, value);
+    x = arena_alloc(a, sizeof(xconf), ARENA_ALIGN);
+    x->name = arena_strdup(a, name);
+    x->value = arena_strdup(a, value);
+    x->sons = NULL;
+    x->parent = NULL;
+    x->arena = a;
+    return x;
+}
+
 /*
  * xconf_append_sons -- move all sons of @src to @dst.
  *
@@ -137,6 +335,7 @@ void xconf_append_sons(xconf *dst, xconf *src)
  *
  * Sets son->parent and appends to parent->sons.
  * Note: g_slist_append traverses the entire list — O(n).
+ * For arena parents the list link is taken from the arena as well.
  *
  * Parameters:
  *   parent - the node to receive the new child.
@@ -147,6 +346,19 @@ void xconf_append(xconf *parent, xconf *son)
     if (!parent || !son)
         return;
     son->parent = parent;
+    if (parent->arena)
+    {
+        GSList *link, *last;
+
+        link = arena_alloc(parent->arena, sizeof(GSList), ARENA_ALIGN);
+        link->data = son;
+        link->next = NULL;
+        if ((last = g_slist_last(parent->sons)))
+            last->next = link;
+        else
+            parent->sons = link;
+        return;
+    }
     /* appending requires traversing all list to the end, which is not
      * efficient, but for v 1.0 it's ok*/
     parent->sons = g_slist_append(parent->sons, son);
@@ -163,9 +375,22 @@ void xconf_append(xconf *parent, xconf *son)
  */
 void xconf_unlink(xconf *x)
 {
+    GSList **link;
+
     if (x && x->parent)
     {
-        x->parent->sons = g_slist_remove(x->parent->sons, x);
+        if (x->parent->arena)
+        {
+            /* arena links are not g_slist-allocated: splice, never free */
+            for (link = &x->parent->sons; *link; link = &(*link)->next)
+                if ((*link)->data == x)
+                {
+                    *link = (*link)->next;
+                    break;
+                }
+        }
+        else
+            x->parent->sons = g_slist_remove(x->parent->sons, x);
         x->parent = NULL;
     }
 }
@@ -183,6 +408,9 @@ void xconf_unlink(xconf *x)
  *
  * WARNING: After this call, any gchar* pointers obtained via
  *   xconf_get_str() on any node in this sub-tree are DANGLING POINTERS.
+ *
+ * Arena nodes are only detached; their memory is reclaimed when the arena
+ * is freed, so string pointers into them stay valid until then.
  */
 void xconf_del(xconf *x, gboolean sons_only)
 {
@@ -192,6 +420,13 @@ void xconf_del(xconf *x, gboolean sons_only)
     if (!x)
         return;
     DBG("%s %s\n", x->name, x->value);
+    if (x->arena)
+    {
+        x->sons = NULL;
+        if (!sons_only)
+            xconf_unlink(x);
+        return;
+    }
     /* delete all sons recursively */
     for (s = x->sons; s; s = g_slist_delete_link(s, s))
     {
@@ -221,8 +456,8 @@ void xconf_del(xconf *x, gboolean sons_only)
 void xconf_set_value(xconf *x, gchar *value)
 {
     xconf_del(x, TRUE);      /* remove any son nodes */
-    g_free(x->value);
-    x->value = g_strdup(value);
+    xconf_free_value(x);
+    x->value = xconf_strdup(x, value);
 }
 
 /*
@@ -238,7 +473,14 @@ void xconf_set_value(xconf *x, gchar *value)
 void xconf_set_value_ref(xconf *x, gchar *value)
 {
     xconf_del(x, TRUE);
-    g_free(x->value);
+    xconf_free_value(x);
+    if (x->arena)
+    {
+        /* arena nodes cannot adopt heap strings: copy, then drop ours */
+        x->value = arena_strdup(x->arena, value);
+        g_free(value);
+        return;
+    }
     x->value = value;   /* take ownership; do NOT g_strdup */
 }
 
@@ -251,9 +493,7 @@ void xconf_set_value_ref(xconf *x, gchar *value)
  */
 void xconf_set_int(xconf *x, int i)
 {
-    xconf_del(x, TRUE);
-    g_free(x->value);
-    x->value = g_strdup_printf("%d", i);
+    xconf_set_value_ref(x, g_strdup_printf("%d", i));
 }
 
 /*
@@ -278,8 +518,8 @@ xconf_get(xconf *xc, gchar *name)
         return NULL;
     if ((ret = xconf_find(xc, name, 0)))
         return ret;
-    /* not found: create and append */
-    ret = xconf_new(name, NULL);
+    /* not found: create and append (in the parent's arena, if any) */
+    ret = xconf_new_in(xc->arena, name, NULL);
     xconf_append(xc, ret);
     return ret;
 }
@@ -578,6 +818,7 @@ read_line(FILE *fp, line *s)
  * Parameters:
  *   fp   - open FILE* positioned inside a block (after the `{`).
  *   name - name for the new block node.
+ *   a    - arena to allocate nodes from; NULL for heap nodes.
  *
  * Returns: the newly created xconf node with all parsed children.
  *
@@ -586,24 +827,24 @@ read_line(FILE *fp, line *s)
  *   an immediate crash rather than a graceful parse error.
  */
 static xconf *
-read_block(FILE *fp, gchar *name)
+read_block(FILE *fp, gchar *name, xconf_arena *a)
 {
     line s;
     xconf *x, *xs;
 
-    x = xconf_new(name, NULL);
+    x = xconf_new_in(a, name, NULL);
     while (read_line(fp, &s) != LINE_NONE)
     {
         if (s.type == LINE_BLOCK_START)
         {
-            xs = read_block(fp, s.t[0]);   /* recurse into nested block */
+            xs = read_block(fp, s.t[0], a);   /* recurse into nested block */
             xconf_append(x, xs);
         }
         else if (s.type == LINE_BLOCK_END)
             break;                          /* end of this block */
         else if (s.type == LINE_VAR)
         {
-            xs = xconf_new(s.t[0], s.t[1]);
+            xs = xconf_new_in(a, s.t[0], s.t[1]);
             xconf_append(x, xs);
         }
         else
@@ -630,12 +871,25 @@ read_block(FILE *fp, gchar *name)
  *          or NULL if the file cannot be opened.
  */
 xconf *xconf_new_from_file(gchar *fname, gchar *name)
+{
+    return xconf_new_from_file_in(NULL, fname, name);
+}
+
+/*
+ * xconf_new_from_file_in -- parse a config file into arena @a.
+ *
+ * Same as xconf_new_from_file() but every node is allocated in @a
+ * (NULL = heap).
+ *
+ * Returns: root node, or NULL if the file cannot be opened.
+ */
+xconf *xconf_new_from_file_in(xconf_arena *a, gchar *fname, gchar *name)
 {
     FILE *fp = fopen(fname, "r");
     xconf *ret = NULL;
     if (fp)
     {
-        ret = read_block(fp, name);
+        ret = read_block(fp, name, a);
         fclose(fp);
     }
     return ret;
@@ -688,17 +942,31 @@ xconf_save_to_profile(xconf *xc)
  * Returns: root of the new tree (caller owns it; free with xconf_del(ret, FALSE)).
  */
 xconf *xconf_dup(xconf *xc)
+{
+    return xconf_dup_in(NULL, xc);
+}
+
+/*
+ * xconf_dup_in -- deep-copy an xconf tree into arena @a.
+ *
+ * Parameters:
+ *   a  - destination arena; NULL produces an ordinary heap copy.
+ *   xc - root of the tree to duplicate (may be NULL; returns NULL).
+ *
+ * Returns: root of the new tree.
+ */
+xconf *xconf_dup_in(xconf_arena *a, xconf *xc)
 {
     xconf *ret, *son;
     GSList *s;
 
     if (!xc)
         return NULL;
-    ret = xconf_new(xc->name, xc->value);
+    ret = xconf_new_in(a, xc->name, xc->value);
     for (s = xc->sons; s; s = g_slist_next(s))
     {
         son = s->data;
-        xconf_append(ret, xconf_dup(son));   /* recursive deep copy */
+        xconf_append(ret, xconf_dup_in(a, son));   /* recursive deep copy */
     }
     return ret;
 }
@@ -32,6 +32,15 @@
  *     frees all descendants.
  *   - Plugins receive a pointer into the panel's config tree (p->xc).
  *     They must NOT free or modify p->xc — it is owned by the panel.
+ *
+ * Arena-allocated trees:
+ *   Large, short-lived generated trees (the XDG system menu, expanded menu
+ *   configs) can be built inside an xconf_arena instead.  Nodes, sons-list
+ *   links and name/value strings are then bump-allocated from a few large
+ *   blocks and released all at once by xconf_arena_free().  The regular
+ *   API works on such nodes unchanged; xconf_del() merely unlinks them and
+ *   the memory is reclaimed with the arena.  Do not mix heap and arena
+ *   nodes within one tree.
  */
 #ifndef _XCONF_H_
 #define _XCONF_H_
@@ -39,6 +48,13 @@
 #include <glib.h>
 #include <stdio.h>
 
+/*
+ * xconf_arena -- opaque region allocator for xconf trees.
+ *
+ * See xconf_arena_new() / xconf_arena_free() below.
+ */
+typedef struct _xconf_arena xconf_arena;
+
 /*
  * xconf -- one node in the configuration tree.
  *
@@ -49,6 +65,8 @@
  *   sons   - GSList of child xconf* pointers (in config-file order).
  *            Empty list for leaf nodes.
  *   parent - back-pointer to parent node; NULL for the root node.
+ *   arena  - region the node (and its strings and sons links) lives in;
+ *            NULL for ordinary heap-allocated nodes.
  */
 typedef struct _xconf
 {
@@ -56,6 +74,7 @@ typedef struct _xconf
     gchar *value;          /* node value; g_malloc'd; may be NULL */
     GSList *sons;          /* child nodes (GSList of xconf*) */
     struct _xconf *parent; /* parent node; NULL at root */
+    xconf_arena *arena;    /* owning arena; NULL for heap nodes */
 } xconf;
 
 /*
@@ -127,6 +146,41 @@ void xconf_unlink(xconf *x);
  */
 void xconf_del(xconf *x, gboolean sons_only);
 
+/* --- Arena-allocated trees --- */
+
+/*
+ * xconf_arena_new -- create an empty arena.
+ *
+ * Returns: a new arena.  Free with xconf_arena_free().
+ */
+xconf_arena *xconf_arena_new(void);
+
+/*
+ * xconf_arena_free -- release an arena and every node allocated in it.
+ *
+ * All xconf nodes created with xconf_new_in(a, ...) (directly or via
+ * xconf_dup_in / xconf_new_from_file_in) become invalid.  NULL is a no-op.
+ */
+void xconf_arena_free(xconf_arena *a);
+
+/*
+ * xconf_new_in -- allocate a new node inside arena @a.
+ *
+ * Like xconf_new(), but the node and copies of name/value are carved out
+ * of @a.  With a == NULL this is exactly xconf_new().
+ */
+xconf *xconf_new_in(xconf_arena *a, gchar *name, gchar *value);
+
+/*
+ * xconf_dup_in -- deep-copy a subtree into arena @a (NULL = heap).
+ */
+xconf *xconf_dup_in(xconf_arena *a, xconf *xc);
+
+/*
+ * xconf_new_from_file_in -- parse a config file into arena @a (NULL = heap).
+ */
+xconf *xconf_new_from_file_in(xconf_arena *a, gchar *fname, gchar *name);
+
 /* --- Value access --- */
 
 /*
@@ -0,0 +1,485 @@
+/*
+ * batterychart.c -- fbpanel battery power-draw chart plugin.
+ *
+ * Plots the battery's power draw over time as a scrolling strip chart,
+ * using the shared "chart" plugin as the rendering backend (same pattern
+ * as the cpu, net and diskio plugins), and estimates time to empty/full.
+ *
+ * Data source:
+ *   /sys/class/power_supply/<Battery>/ attributes, opened ONCE in the
+ *   constructor and re-read every tick with pread() at offset 0 (sysfs
+ *   regenerates the value on each read from offset 0).  No per-tick
+ *   open/fopen/close and no uevent parsing.
+ *     energy_now, energy_full (uWh) + power_now (uW), or
+ *       current_now (uA) * voltage_now (uV) when power_now is missing;
+ *     charge_now, charge_full (uAh) + current_now (uA) on batteries that
+ *       only report charge.  The chart and tooltip then show A and Ah.
+ *     status -- "Charging", "Discharging", "Full", ...
+ *   If a read fails (battery removed) the files are closed and re-opened
+ *   on the following ticks.
+ *
+ * Estimates:
+ *   draw -- exponentially weighted moving average of the instantaneous
+ *           rate, time constant Smoothing seconds.  Plotted and shown.
+ *   rate -- slope of energy_now over a rolling window of the last Window
+ *           seconds (ring of samples).  Tracks what the battery actually
+ *           loses, independent of how well the firmware reports power_now.
+ *           Time to empty = now / rate, time to full = (full - now) / rate.
+ *           Until the window spans MIN_SPAN seconds, or if the counter did
+ *           not move, the smoothed draw is used instead.
+ *   The window and the average restart when the status changes.
+ *
+ * Configuration (xconf keys):
+ *   Battery        -- power_supply name (default: first "Battery" found).
+ *   MaxDraw        -- chart full scale in W (A for charge batteries),
+ *                     default 30.
+ *   Smoothing      -- EWMA time constant in seconds (default 30).
+ *   Window         -- time-to-empty window in seconds (default 300).
+ *   DischargeColor -- chart colour while discharging (default "red").
+ *   ChargeColor    -- chart colour while charging (default "green").
+ *
+ * Struct layout (C-style inheritance):
+ *   batterychart_priv embeds chart_priv as its FIRST member, allowing safe
+ *   cast to plugin_instance* and chart_priv*.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../chart/chart.h"
+
+//#define DEBUGPRN
+#include "dbg.h"
+
+/* Sampling interval in seconds. */
+#define CHECK_PERIOD 2
+
+/* Sysfs class directory. */
+#define PS_DIR "/sys/class/power_supply"
+
+/* Ring capacity; Window is clamped to MAX_SAMPLES * CHECK_PERIOD. */
+#define MAX_SAMPLES 1800
+
+/* Shortest window span, in seconds, trusted for the energy slope. */
+#define MIN_SPAN 60
+
+/* Attribute files kept open. */
+enum { F_NOW, F_FULL, F_RATE, F_CURRENT, F_VOLTAGE, F_STATUS, F_COUNT };
+
+enum { ST_UNKNOWN, ST_DISCHARGING, ST_CHARGING, ST_FULL };
+
+/*
+ * bc_sample -- one point of the rolling window.
+ *
+ * t   -- g_get_monotonic_time() of the sample, in microseconds.
+ * now -- energy_now (uWh) or charge_now (uAh).
+ */
+typedef struct {
+    gint64 t;
+    gint64 now;
+} bc_sample;
+
+/*
+ * batterychart_priv -- per-instance private state.
+ *
+ * chart    -- embedded chart base class (MUST be first field).
+ * dir      -- battery sysfs directory; heap, freed in destructor.
+ * fd       -- attribute fds, -1 when absent or closed.
+ * charge   -- TRUE: charge_* attributes (A, Ah) instead of energy_* (W, Wh).
+ * ring     -- rolling window, nsamples entries; head is the next slot,
+ *             count the filled ones.  Heap, freed in destructor.
+ * draw     -- EWMA of the rate in W (or A); < 0 until the first sample.
+ * last     -- monotonic time of the last EWMA update.
+ */
+typedef struct {
+    chart_priv  chart;   /* MUST be first */
+    int         timer;
+    gchar      *dir;
+    int         fd[F_COUNT];
+    gboolean    charge;
+    int         status;
+    bc_sample  *ring;
+    int         nsamples, head, count;
+    gdouble     draw;
+    gint64      last;
+    gchar      *battery;
+    gint        max_draw;
+    gint        smoothing;
+    gint        window;
+    gchar      *colors[2];
+} batterychart_priv;
+
+/* Module-level chart class pointer, obtained via class_get("chart"). */
+static chart_class *k;
+
+/* Attribute names per mode; NULL: not used in that mode. */
+static const gchar *energy_files[F_COUNT] = {
+    "energy_now", "energy_full", "power_now", "current_now", "voltage_now",
+    "status"
+};
+static const gchar *charge_files[F_COUNT] = {
+    "charge_now", "charge_full", NULL, "current_now", NULL, "status"
+};
+
+/*
+ * bc_pread -- read an attribute from its open fd into buf.
+ *
+ * Returns: bytes read (buf is NUL-terminated), or -1.
+ */
+static int
+bc_pread(int fd, gchar *buf, int len)
+{
+    ssize_t n;
+
+    if (fd < 0)
+        return -1;
+    do
+        n = pread(fd, buf, len - 1, 0);
+    while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+/*
+ * bc_read -- read an integer attribute.
+ *
+ * Returns: TRUE and the value in *val, or FALSE if the fd is closed or the
+ *          read/parse failed.
+ */
+static gboolean
+bc_read(int fd, gint64 *val)
+{
+    gchar buf[32], *end;
+
+    if (bc_pread(fd, buf, sizeof(buf)) <= 0)
+        return FALSE;
+    *val = g_ascii_strtoll(buf, &end, 10);
+    return end != buf;
+}
+
+/*
+ * bc_find_battery -- name of the first power supply of type "Battery".
+ *
+ * Returns: newly allocated name, or NULL.
+ */
+static gchar *
+bc_find_battery(void)
+{
+    const gchar *name;
+    gchar *path, *type, *ret = NULL;
+    GDir *dir;
+
+    if (!(dir = g_dir_open(PS_DIR, 0, NULL)))
+        return NULL;
+    while (!ret && (name = g_dir_read_name(dir))) {
+        path = g_build_filename(PS_DIR, name, "type", NULL);
+        if (g_file_get_contents(path, &type, NULL, NULL)) {
+            if (g_str_has_prefix(type, "Battery"))
+                ret = g_strdup(name);
+            g_free(type);
+        }
+        g_free(path);
+    }
+    g_dir_close(dir);
+    return ret;
+}
+
+static void
+bc_close(batterychart_priv *c)
+{
+    int i;
+
+    for (i = 0; i < F_COUNT; i++) {
+        if (c->fd[i] >= 0)
+            close(c->fd[i]);
+        c->fd[i] = -1;
+    }
+}
+
+/*
+ * bc_open -- open the attribute files of c->dir, choosing energy or charge
+ * mode by which "now" attribute exists.
+ *
+ * Returns: TRUE if the "now" attribute and a rate source are open.
+ */
+static gboolean
+bc_open(batterychart_priv *c)
+{
+    const gchar **files;
+    gchar *path;
+    int i;
+
+    ENTER;
+    bc_close(c);
+    path = g_build_filename(c->dir, "energy_now", NULL);
+    c->charge = access(path, R_OK) != 0;
+    g_free(path);
+    files = c->charge ? charge_files : energy_files;
+    for (i = 0; i < F_COUNT; i++) {
+        if (!files[i])
+            continue;
+        path = g_build_filename(c->dir, files[i], NULL);
+        c->fd[i] = open(path, O_RDONLY | O_CLOEXEC);
+        DBG("%s: %d\n", path, c->fd[i]);
+        g_free(path);
+    }
+    if (c->fd[F_NOW] < 0 || (c->fd[F_RATE] < 0 && (c->fd[F_CURRENT] < 0
+                || (!c->charge && c->fd[F_VOLTAGE] < 0)))) {
+        bc_close(c);
+        RET(FALSE);
+    }
+    RET(TRUE);
+}
+
+static int
+bc_read_status(batterychart_priv *c)
+{
+    gchar buf[32];
+
+    if (bc_pread(c->fd[F_STATUS], buf, sizeof(buf)) <= 0)
+        return ST_UNKNOWN;
+    if (g_str_has_prefix(buf, "Discharging"))
+        return ST_DISCHARGING;
+    if (g_str_has_prefix(buf, "Charging"))
+        return ST_CHARGING;
+    if (g_str_has_prefix(buf, "Full"))
+        return ST_FULL;
+    return ST_UNKNOWN;
+}
+
+/*
+ * bc_read_rate -- instantaneous draw in W (A in charge mode), as a
+ * magnitude; some firmware reports it negative while discharging.
+ */
+static gboolean
+bc_read_rate(batterychart_priv *c, gdouble *rate)
+{
+    gint64 p, i, v;
+
+    if (bc_read(c->fd[F_RATE], &p)) {
+        *rate = fabs(p / 1e6);
+        return TRUE;
+    }
+    if (!bc_read(c->fd[F_CURRENT], &i))
+        return FALSE;
+    if (c->charge) {
+        *rate = fabs(i / 1e6);
+        return TRUE;
+    }
+    if (!bc_read(c->fd[F_VOLTAGE], &v))
+        return FALSE;
+    *rate = fabs((i / 1e6) * (v / 1e6));
+    return TRUE;
+}
+
+/*
+ * bc_slope -- rate of change of the "now" counter over the window, in
+ * W (A), as a magnitude.  Returns 0 if the window is too short or flat.
+ */
+static gdouble
+bc_slope(batterychart_priv *c)
+{
+    bc_sample *first, *last;
+    gdouble dt;
+
+    if (c->count < 2)
+        return 0;
+    last = &c->ring[(c->head + c->nsamples - 1) % c->nsamples];
+    first = &c->ring[(c->head + c->nsamples - c->count) % c->nsamples];
+    dt = (last->t - first->t) / (gdouble) G_USEC_PER_SEC;
+    if (dt < MIN_SPAN)
+        return 0;
+    /* uWh per second -> W: * 3600 / 1e6 */
+    return fabs((last->now - first->now) / dt * 3600 / 1e6);
+}
+
+static void
+bc_format_time(gchar *buf, int len, gdouble hours)
+{
+    int min = (int) (hours * 60 + 0.5);
+
+    g_snprintf(buf, len, "%d:%02d", min / 60, min % 60);
+}
+
+/*
+ * batterychart_update -- sample the battery and push one tick to the chart.
+ *
+ * Returns: TRUE to keep the GLib timer alive.
+ */
+static int
+batterychart_update(batterychart_priv *c)
+{
+    gchar tooltip[256], eta[32], *what;
+    gdouble rate, alpha, dt, slope, est, level;
+    gint64 now, full, t;
+    float val[2] = { 0, 0 };
+    int status;
+
+    ENTER;
+    if (c->fd[F_NOW] < 0 && !bc_open(c))
+        goto na;
+    if (!bc_read(c->fd[F_NOW], &now) || !bc_read_rate(c, &rate)) {
+        bc_close(c);
+        goto na;
+    }
+    if (!bc_read(c->fd[F_FULL], &full) || full <= 0)
+        full = 0;
+    status = bc_read_status(c);
+    t = g_get_monotonic_time();
+
+    /* charging <-> discharging: old samples say nothing about the new state */
+    if (status != c->status) {
+        c->status = status;
+        c->count = 0;
+        c->draw = -1;
+    }
+    if (c->draw < 0)
+        c->draw = rate;
+    else {
+        dt = (t - c->last) / (gdouble) G_USEC_PER_SEC;
+        alpha = 1 - exp(-dt / MAX(c->smoothing, 1));
+        c->draw += alpha * (rate - c->draw);
+    }
+    c->last = t;
+
+    c->ring[c->head].t = t;
+    c->ring[c->head].now = now;
+    c->head = (c->head + 1) % c->nsamples;
+    if (c->count < c->nsamples)
+        c->count++;
+
+    if (c->max_draw > 0)
+        val[status == ST_CHARGING] = c->draw / c->max_draw;
+
+    eta[0] = '\0';
+    slope = bc_slope(c);
+    est = slope > 0 ? slope : c->draw;
+    /* counters are in u*h, the rate in whole units */
+    if (est > 0 && status == ST_DISCHARGING) {
+        bc_format_time(eta, sizeof(eta), now / 1e6 / est);
+    } else if (est > 0 && status == ST_CHARGING && full > now)
+        bc_format_time(eta, sizeof(eta), (full - now) / 1e6 / est);
+
+    level = full ? 100.0 * now / full : -1;
+    what = status == ST_DISCHARGING ? "Discharging"
+        : status == ST_CHARGING ? "Charging"
+        : status == ST_FULL ? "Full" : "Unknown";
+    g_snprintf(tooltip, sizeof(tooltip),
+        "<b>Battery:</b> %.0f%%\n%s: %.1f %s%s%s%s",
+        MAX(level, 0), what, c->draw, c->charge ? "A" : "W",
+        eta[0] ? "\n" : "",
+        eta[0] ? (status == ST_CHARGING ? "Full in " : "Empty in ") : "",
+        eta);
+    DBG("now=%lld rate=%.2f draw=%.2f slope=%.2f\n",
+        (long long) now, rate, c->draw, slope);
+    gtk_widget_set_tooltip_markup(((plugin_instance *) c)->pwid, tooltip);
+    k->add_tick(&c->chart, val);
+    RET(TRUE);
+
+na:
+    c->status = ST_UNKNOWN;
+    c->count = 0;
+    c->draw = -1;
+    gtk_widget_set_tooltip_markup(((plugin_instance *) c)->pwid,
+        "<b>Battery:</b> N/A");
+    k->add_tick(&c->chart, val);
+    RET(TRUE);
+}
+
+static void
+batterychart_destructor(plugin_instance *p)
+{
+    batterychart_priv *c = (batterychart_priv *) p;
+
+    ENTER;
+    if (c->timer)
+        g_source_remove(c->timer);
+    bc_close(c);
+    g_free(c->ring);
+    g_free(c->dir);
+    PLUGIN_CLASS(k)->destructor(p);
+    class_put("chart");
+    RET();
+}
+
+/*
+ * batterychart_constructor -- initialise the battery chart plugin.
+ *
+ * Returns: 1 on success, 0 on soft-disable (no chart class, no battery).
+ */
+static int
+batterychart_constructor(plugin_instance *p)
+{
+    batterychart_priv *c;
+    gchar *name;
+    int i;
+
+    ENTER;
+    if (!(k = class_get("chart"))) {
+        g_message("batterychart: 'chart' plugin unavailable — plugin disabled");
+        RET(0);
+    }
+    if (!PLUGIN_CLASS(k)->constructor(p)) {
+        g_message("batterychart: chart constructor failed — plugin disabled");
+        RET(0);
+    }
+    c = (batterychart_priv *) p;
+    for (i = 0; i < F_COUNT; i++)
+        c->fd[i] = -1;
+
+    c->battery   = NULL;
+    c->max_draw  = 30;
+    c->smoothing = 30;
+    c->window    = 300;
+    c->colors[0] = "red";
+    c->colors[1] = "green";
+    XCG(p->xc, "Battery",        &c->battery,   str);
+    XCG(p->xc, "MaxDraw",        &c->max_draw,  int);
+    XCG(p->xc, "Smoothing",      &c->smoothing, int);
+    XCG(p->xc, "Window",         &c->window,    int);
+    XCG(p->xc, "DischargeColor", &c->colors[0], str);
+    XCG(p->xc, "ChargeColor",    &c->colors[1], str);
+
+    name = c->battery ? g_strdup(c->battery) : bc_find_battery();
+    if (name)
+        c->dir = g_build_filename(PS_DIR, name, NULL);
+    g_free(name);
+    if (!c->dir || !bc_open(c)) {
+        g_message("batterychart: no readable battery in " PS_DIR
+            " — plugin disabled");
+        g_free(c->dir);
+        c->dir = NULL;
+        PLUGIN_CLASS(k)->destructor(p);
+        class_put("chart");
+        RET(0);
+    }
+    c->nsamples = CLAMP(c->window / CHECK_PERIOD, 2, MAX_SAMPLES);
+    c->ring = g_new(bc_sample, c->nsamples);
+    c->draw = -1;
+
+    k->set_rows(&c->chart, 2, c->colors);
+    batterychart_update(c);
+    c->timer = g_timeout_add(CHECK_PERIOD * 1000,
+        (GSourceFunc) batterychart_update, c);
+    RET(1);
+}
+
+static plugin_class class = {
+    .count       = 0,
+    .type        = "batterychart",
+    .name        = "Battery chart",
+    .version     = "1.0",
+    .description = "Chart battery power draw and estimate time to empty/full",
+    .priv_size   = sizeof(batterychart_priv),
+    .constructor = batterychart_constructor,
+    .destructor  = batterychart_destructor,
+};
+
+static plugin_class *class_ptr = (plugin_class *) &class;
@@ -2,25 +2,42 @@
  * cpufreq.c -- fbpanel CPU frequency plugin.
  *
  * Displays the current CPU clock frequency for a configured core as a
- * text label (e.g. "3.40 GHz" or "800 MHz").
+ * text label (e.g. "3.40 GHz" or "800 MHz"), or, with AllCores, a heat
+ * strip of every core: one column (CoreWidth pixels) per core, coloured
+ * from blue (cpuinfo_min_freq) to red (cpuinfo_max_freq), with
+ * min/avg/max in the tooltip.
  *
  * Soft-disable behaviour:
  *   If the cpufreq sysfs node for the configured CPU index does not exist
  *   (e.g. running in a VM, container, or on a CPU without frequency scaling
- *   support), the constructor emits g_message() and returns 0.  The panel
- *   skips the plugin and continues loading normally.
+ *   support), or no core has one in AllCores mode, the constructor emits
+ *   g_message() and returns 0.  The panel skips the plugin and continues
+ *   loading normally.
  *
  * Configuration (xconf keys):
- *   CpuIndex -- CPU core index to read (default: 0, meaning cpu0).
- *   Period   -- update interval in milliseconds (default: 2000).
+ *   CpuIndex  -- CPU core index to read (default: 0, meaning cpu0).
+ *   AllCores  -- draw the heat strip of all cores (default: false).
+ *   CoreWidth -- strip pixels per core; 0 = fit about 32 px (default: 0).
+ *   Period    -- update interval in milliseconds (default: 2000).
  *
  * Data source:
  *   /sys/devices/system/cpu/cpu<N>/cpufreq/scaling_cur_freq
  *   Value is in kHz.  Divided by 1000 to get MHz; by 1000000 to get GHz.
+ *   Each file is opened once and re-read with pread() at offset 0, so a
+ *   tick costs one read syscall per core and no stdio.
+ *
+ * Heat strip drawing:
+ *   The strip is a GtkDrawingArea.  A tick only invalidates the columns
+ *   whose colour level changed; the expose handler fills the exposed
+ *   columns from a palette of LEVELS GdkGCs allocated on realize.
  */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "panel.h"
 #include "misc.h"
@@ -29,30 +46,307 @@
 //#define DEBUGPRN
 #include "dbg.h"
 
+#define CPU_DIR "/sys/devices/system/cpu"
+
+/* Heat strip palette size. */
+#define LEVELS 16
+
+/* Upper bound on cores in the strip. */
+#define MAX_CORES 4096
+
+/*
+ * cpufreq_core -- one CPU with an open scaling_cur_freq.
+ *
+ * cpu      -- kernel CPU number.
+ * fd       -- open scaling_cur_freq, -1 if unreadable.
+ * min, max -- cpuinfo_min_freq / cpuinfo_max_freq in kHz (0 if unknown).
+ * cur      -- last reading in kHz; 0 if the read failed.
+ * level    -- palette index last shown for this core.
+ */
+typedef struct {
+    int     cpu;
+    int     fd;
+    gulong  min, max;
+    gulong  cur;
+    int     level;
+} cpufreq_core;
+
 /*
  * cpufreq_priv -- per-instance private state.
  *
- * plugin   -- base class (MUST be first).
- * label    -- GtkLabel showing the formatted frequency string.
- * timer    -- GLib timeout source ID; 0 when inactive.
- * cpu_idx  -- CPU core index (0-based).
- * period   -- polling interval in milliseconds.
- * path     -- full sysfs path to scaling_cur_freq; heap-allocated, g_free in dtor.
+ * plugin    -- base class (MUST be first).
+ * label     -- GtkLabel showing the formatted frequency (label mode).
+ * strip     -- GtkDrawingArea heat strip (AllCores mode).
+ * timer     -- GLib timeout source ID; 0 when inactive.
+ * cpu_idx   -- CPU core index (0-based) in label mode.
+ * period    -- polling interval in milliseconds.
+ * cores     -- ncores entries, by CPU number; heap, freed in dtor.
+ * gc        -- strip palette, valid while the strip is realized.
  */
 typedef struct {
     plugin_instance  plugin;
     GtkWidget       *label;
+    GtkWidget       *strip;
     guint            timer;
     int              cpu_idx;
     int              period;
-    gchar           *path;
+    gboolean         all_cores;
+    int              core_width;
+    cpufreq_core    *cores;
+    int              ncores;
+    GdkGC           *gc[LEVELS];
 } cpufreq_priv;
 
 /*
- * cpufreq_update -- read the current CPU frequency and update the label.
+ * cpufreq_read_file -- read a kHz value once by path (limits).
+ */
+static gulong
+cpufreq_read_file(int cpu, const gchar *name)
+{
+    gchar *path, *buf;
+    gulong val = 0;
+
+    path = g_strdup_printf(CPU_DIR "/cpu%d/cpufreq/%s", cpu, name);
+    if (g_file_get_contents(path, &buf, NULL, NULL)) {
+        val = strtoul(buf, NULL, 10);
+        g_free(buf);
+    }
+    g_free(path);
+    return val;
+}
+
+/*
+ * cpufreq_core_open -- open cpu@cpu's scaling_cur_freq.
+ *
+ * Returns: TRUE if it could be opened.
+ */
+static gboolean
+cpufreq_core_open(cpufreq_core *c, int cpu)
+{
+    gchar *path;
+
+    path = g_strdup_printf(CPU_DIR "/cpu%d/cpufreq/scaling_cur_freq", cpu);
+    c->fd = open(path, O_RDONLY | O_CLOEXEC);
+    g_free(path);
+    if (c->fd < 0)
+        return FALSE;
+    c->cpu = cpu;
+    c->min = cpufreq_read_file(cpu, "cpuinfo_min_freq");
+    c->max = cpufreq_read_file(cpu, "cpuinfo_max_freq");
+    c->level = -1;
+    return TRUE;
+}
+
+/*
+ * cpufreq_core_read -- re-read the current frequency; 0 on failure.
+ */
+static gulong
+cpufreq_core_read(cpufreq_core *c)
+{
+    gchar buf[24];
+    ssize_t n;
+
+    do
+        n = pread(c->fd, buf, sizeof(buf) - 1, 0);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        return c->cur = 0;
+    buf[n] = '\0';
+    return c->cur = strtoul(buf, NULL, 10);
+}
+
+static gint
+cpufreq_int_cmp(gconstpointer a, gconstpointer b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+/*
+ * cpufreq_open_all -- open every cpu<N> with cpufreq, by CPU number.
+ */
+static void
+cpufreq_open_all(cpufreq_priv *priv)
+{
+    const gchar *name;
+    GArray *cpus;
+    GDir *dir;
+    int cpu, i;
+    char rest;
+
+    ENTER;
+    cpus = g_array_new(FALSE, FALSE, sizeof(int));
+    if ((dir = g_dir_open(CPU_DIR, 0, NULL))) {
+        while ((name = g_dir_read_name(dir)))
+            if (sscanf(name, "cpu%d%c", &cpu, &rest) == 1)
+                g_array_append_val(cpus, cpu);
+        g_dir_close(dir);
+    }
+    g_array_sort(cpus, cpufreq_int_cmp);
+    priv->cores = g_new0(cpufreq_core, MIN(cpus->len, MAX_CORES));
+    for (i = 0; i < (int) cpus->len && priv->ncores < MAX_CORES; i++)
+        if (cpufreq_core_open(&priv->cores[priv->ncores],
+                g_array_index(cpus, int, i)))
+            priv->ncores++;
+    g_array_free(cpus, TRUE);
+    RET();
+}
+
+static void
+cpufreq_format(gchar *buf, int len, gulong khz)
+{
+    if (khz >= 1000000)
+        g_snprintf(buf, len, "%.2f GHz", (double) khz / 1000000.0);
+    else
+        g_snprintf(buf, len, "%lu MHz", khz / 1000);
+}
+
+/*
+ * cpufreq_core_rect -- strip rectangle of core @i.
+ */
+static void
+cpufreq_core_rect(cpufreq_priv *priv, int i, GdkRectangle *r)
+{
+    GtkAllocation *a = &priv->strip->allocation;
+
+    if (priv->plugin.panel->orientation == GTK_ORIENTATION_HORIZONTAL) {
+        r->x = i * priv->core_width;
+        r->y = 0;
+        r->width = priv->core_width;
+        r->height = a->height;
+    } else {
+        r->x = 0;
+        r->y = i * priv->core_width;
+        r->width = a->width;
+        r->height = priv->core_width;
+    }
+}
+
+/*
+ * cpufreq_strip_expose -- fill the exposed core columns.
+ */
+static gboolean
+cpufreq_strip_expose(GtkWidget *widget, GdkEventExpose *event,
+    cpufreq_priv *priv)
+{
+    GdkRectangle r;
+    int i, first, last;
+
+    ENTER;
+    if (!priv->gc[0])
+        RET(FALSE);
+    if (priv->plugin.panel->orientation == GTK_ORIENTATION_HORIZONTAL) {
+        first = event->area.x;
+        last = event->area.x + event->area.width - 1;
+    } else {
+        first = event->area.y;
+        last = event->area.y + event->area.height - 1;
+    }
+    first /= priv->core_width;
+    last = MIN(last / priv->core_width, priv->ncores - 1);
+    for (i = first; i <= last; i++) {
+        cpufreq_core_rect(priv, i, &r);
+        gdk_draw_rectangle(widget->window,
+            priv->gc[MAX(priv->cores[i].level, 0)], TRUE,
+            r.x, r.y, r.width, r.height);
+    }
+    RET(FALSE);
+}
+
+/*
+ * cpufreq_strip_realize -- allocate the palette: blue, yellow, red.
+ */
+static void
+cpufreq_strip_realize(GtkWidget *widget, cpufreq_priv *priv)
+{
+    GdkColor color;
+    double t;
+    int i;
+
+    ENTER;
+    for (i = 0; i < LEVELS; i++) {
+        t = (double) i / (LEVELS - 1);
+        color.red   = 0xffff * MIN(1.0, 2 * t);
+        color.green = 0xffff * (1.0 - ABS(2 * t - 1));
+        color.blue  = 0xffff * MAX(0.0, 1 - 2 * t);
+        priv->gc[i] = gdk_gc_new(widget->window);
+        gdk_gc_set_rgb_fg_color(priv->gc[i], &color);
+    }
+    RET();
+}
+
+static void
+cpufreq_strip_unrealize(GtkWidget *widget, cpufreq_priv *priv)
+{
+    int i;
+
+    ENTER;
+    for (i = 0; i < LEVELS; i++) {
+        if (priv->gc[i])
+            g_object_unref(priv->gc[i]);
+        priv->gc[i] = NULL;
+    }
+    RET();
+}
+
+/*
+ * cpufreq_update_strip -- read all cores, invalidate changed columns and
+ * set the min/avg/max tooltip.
+ */
+static void
+cpufreq_update_strip(cpufreq_priv *priv)
+{
+    cpufreq_core *c;
+    GdkRectangle r;
+    gulong lo = G_MAXULONG, hi = 0, sum = 0, span;
+    gchar tooltip[160], smin[16], savg[16], smax[16];
+    int i, level, n = 0;
+
+    ENTER;
+    for (i = 0; i < priv->ncores; i++) {
+        c = &priv->cores[i];
+        if (!cpufreq_core_read(c)) {
+            level = 0;
+        } else {
+            n++;
+            sum += c->cur;
+            lo = MIN(lo, c->cur);
+            hi = MAX(hi, c->cur);
+            span = c->max > c->min ? c->max - c->min : 0;
+            if (!span)
+                level = LEVELS - 1;
+            else if (c->cur <= c->min)
+                level = 0;
+            else
+                level = MIN((c->cur - c->min) * (LEVELS - 1) / span,
+                    LEVELS - 1);
+        }
+        if (level == c->level)
+            continue;
+        c->level = level;
+        if (GTK_WIDGET_DRAWABLE(priv->strip)) {
+            cpufreq_core_rect(priv, i, &r);
+            gdk_window_invalidate_rect(priv->strip->window, &r, FALSE);
+        }
+    }
+    if (!n) {
+        gtk_widget_set_tooltip_markup(priv->plugin.pwid,
+            "<b>CPU frequency:</b> n/a");
+        RET();
+    }
+    cpufreq_format(smin, sizeof(smin), lo);
+    cpufreq_format(savg, sizeof(savg), sum / n);
+    cpufreq_format(smax, sizeof(smax), hi);
+    g_snprintf(tooltip, sizeof(tooltip),
+        "<b>%d cores:</b>\nMin: %s\nAvg: %s\nMax: %s", n, smin, savg, smax);
+    gtk_widget_set_tooltip_markup(priv->plugin.pwid, tooltip);
+    RET();
+}
+
+/*
+ * cpufreq_update -- read the current CPU frequency and update the display.
  *
- * Reads the sysfs scaling_cur_freq file and formats the result in GHz
- * (if >= 1 GHz) or MHz.  Updates the tooltip with the raw kHz value.
+ * Label mode: formats the frequency in GHz (if >= 1 GHz) or MHz and
+ * updates the tooltip with the raw kHz value.
  *
  * Parameters:
  *   priv -- cpufreq_priv instance.
@@ -62,27 +356,21 @@ typedef struct {
 static gboolean
 cpufreq_update(cpufreq_priv *priv)
 {
-    FILE  *f;
-    gulong khz = 0;
+    gulong khz;
     gchar  display[32];
     gchar  tooltip[64];
 
     ENTER;
-
-    f = fopen(priv->path, "r");
-    if (!f) {
-        gtk_label_set_text(GTK_LABEL(priv->label), "n/a");
+    if (priv->all_cores) {
+        cpufreq_update_strip(priv);
         RET(TRUE);
     }
-    (void) fscanf(f, "%lu", &khz);
-    fclose(f);
 
-    if (khz >= 1000000) {
-        g_snprintf(display, sizeof(display), "%.2f GHz",
-                   (double) khz / 1000000.0);
-    } else {
-        g_snprintf(display, sizeof(display), "%lu MHz", khz / 1000);
+    if (!(khz = cpufreq_core_read(&priv->cores[0]))) {
+        gtk_label_set_text(GTK_LABEL(priv->label), "n/a");
+        RET(TRUE);
     }
+    cpufreq_format(display, sizeof(display), khz);
 
     gtk_label_set_text(GTK_LABEL(priv->label), display);
 
@@ -97,8 +385,8 @@ cpufreq_update(cpufreq_priv *priv)
 /*
  * cpufreq_constructor -- initialise the CPU frequency plugin.
  *
- * Reads config, constructs the sysfs path, and probes it.  Returns 0
- * (soft-disable) if the path does not exist.
+ * Reads config and opens the scaling_cur_freq file(s).  Returns 0
+ * (soft-disable) if none exists.
  *
  * Returns: 1 on success, 0 on soft-disable.
  */
@@ -106,38 +394,67 @@ static int
 cpufreq_constructor(plugin_instance *p)
 {
     cpufreq_priv *priv;
-    FILE         *probe;
+    int           len;
 
     ENTER;
 
     priv = (cpufreq_priv *) p;
-    priv->cpu_idx = 0;
-    priv->period  = 2000;
+    priv->cpu_idx    = 0;
+    priv->period     = 2000;
+    priv->all_cores  = FALSE;
+    priv->core_width = 0;
 
-    XCG(p->xc, "CpuIndex", &priv->cpu_idx, int);
-    XCG(p->xc, "Period",   &priv->period,   int);
+    XCG(p->xc, "CpuIndex",  &priv->cpu_idx,    int);
+    XCG(p->xc, "AllCores",  &priv->all_cores,  enum, bool_enum);
+    XCG(p->xc, "CoreWidth", &priv->core_width, int);
+    XCG(p->xc, "Period",    &priv->period,     int);
 
     if (priv->period < 250)
         priv->period = 250;
     if (priv->cpu_idx < 0)
         priv->cpu_idx = 0;
 
-    priv->path = g_strdup_printf(
-        "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq",
-        priv->cpu_idx);
-
-    probe = fopen(priv->path, "r");
-    if (!probe) {
-        g_message("cpufreq: %s not available — plugin disabled", priv->path);
-        g_free(priv->path);
-        priv->path = NULL;
+    if (priv->all_cores) {
+        cpufreq_open_all(priv);
+    } else {
+        priv->cores = g_new0(cpufreq_core, 1);
+        if (cpufreq_core_open(&priv->cores[0], priv->cpu_idx))
+            priv->ncores = 1;
+    }
+    if (!priv->ncores) {
+        if (priv->all_cores)
+            g_message("cpufreq: no " CPU_DIR "/cpu*/cpufreq"
+                " — plugin disabled");
+        else
+            g_message("cpufreq: " CPU_DIR "/cpu%d/cpufreq/scaling_cur_freq"
+                " not available — plugin disabled", priv->cpu_idx);
+        g_free(priv->cores);
+        priv->cores = NULL;
         RET(0);
     }
-    fclose(probe);
 
-    priv->label = gtk_label_new("...");
-    gtk_container_add(GTK_CONTAINER(p->pwid), priv->label);
-    gtk_widget_show(priv->label);
+    if (priv->all_cores) {
+        if (priv->core_width <= 0)
+            priv->core_width = CLAMP(32 / priv->ncores, 1, 6);
+        len = priv->ncores * priv->core_width;
+        priv->strip = gtk_drawing_area_new();
+        if (p->panel->orientation == GTK_ORIENTATION_HORIZONTAL)
+            gtk_widget_set_size_request(priv->strip, len, -1);
+        else
+            gtk_widget_set_size_request(priv->strip, -1, len);
+        g_signal_connect(G_OBJECT(priv->strip), "realize",
+            G_CALLBACK(cpufreq_strip_realize), priv);
+        g_signal_connect(G_OBJECT(priv->strip), "unrealize",
+            G_CALLBACK(cpufreq_strip_unrealize), priv);
+        g_signal_connect(G_OBJECT(priv->strip), "expose-event",
+            G_CALLBACK(cpufreq_strip_expose), priv);
+        gtk_container_add(GTK_CONTAINER(p->pwid), priv->strip);
+        gtk_widget_show(priv->strip);
+    } else {
+        priv->label = gtk_label_new("...");
+        gtk_container_add(GTK_CONTAINER(p->pwid), priv->label);
+        gtk_widget_show(priv->label);
+    }
 
     cpufreq_update(priv);
     priv->timer = g_timeout_add(priv->period,
@@ -148,7 +465,8 @@ cpufreq_constructor(plugin_instance *p)
 /*
  * cpufreq_destructor -- clean up CPU frequency plugin resources.
  *
- * Cancels the timer and frees the heap-allocated sysfs path.
+ * Cancels the timer, destroys the strip (which frees its palette) and
+ * closes the sysfs files.
  *
  * Parameters:
  *   p -- plugin_instance pointer.
@@ -157,14 +475,19 @@ static void
 cpufreq_destructor(plugin_instance *p)
 {
     cpufreq_priv *priv = (cpufreq_priv *) p;
+    int i;
 
     ENTER;
     if (priv->timer) {
         g_source_remove(priv->timer);
         priv->timer = 0;
     }
-    g_free(priv->path);
-    priv->path = NULL;
+    if (priv->strip)
+        gtk_widget_destroy(priv->strip);
+    for (i = 0; i < priv->ncores; i++)
+        close(priv->cores[i].fd);
+    g_free(priv->cores);
+    priv->cores = NULL;
     RET();
 }
 
@@ -172,8 +495,8 @@ static plugin_class class = {
     .count       = 0,
     .type        = "cpufreq",
     .name        = "CPU Frequency",
-    .version     = "1.0",
-    .description = "Display current CPU clock frequency from cpufreq sysfs",
+    .version     = "1.1",
+    .description = "Display CPU clock frequency from cpufreq sysfs",
     .priv_size   = sizeof(cpufreq_priv),
     .constructor = cpufreq_constructor,
     .destructor  = cpufreq_destructor,
@@ -6,11 +6,16 @@
  * 12/24h time formats, optional seconds display, configurable color,
  * a click action (or toggle-calendar fallback), and a date tooltip.
  *
- * Timer: a 1-second g_timeout_add fires clock_update() continuously.
+ * Timer: clock_update() is a shared-clock (clock.h) subscriber at the finest
+ *        resolution of the clock and tooltip formats: once a minute unless
+ *        ShowSeconds is set.
  * Memory: dc->clock (GdkPixbuf) is allocated in dclock_create_pixbufs and
  *         must NOT be explicitly freed here because GTK holds a reference
- *         through the GtkImage widget; dc->glyphs must be freed manually
- *         but the destructor does not do so -- see BUG below.
+ *         through the GtkImage widget.  The glyph sheet is a dclock_atlas
+ *         shared by every instance with the same colour and orientation;
+ *         each instance holds one reference, dropped in the destructor.
+ * Drawing: only the character cells that differ from the last rendered
+ *         string are blitted, and only their rectangle is invalidated.
  */
 
 #include <time.h>
@@ -25,6 +30,8 @@
 #include "panel.h"
 #include "misc.h"
 #include "plugin.h"
+#include "clock.h"
+#include "calendar.h"
 
 //#define DEBUGPRN
 #include "dbg.h"
@@ -72,7 +79,8 @@ xconf_enum hours_view_enum[] = {
  * allocates sizeof(dclock_priv) bytes for each instance.
  *
  * Memory ownership:
- *   glyphs  -- owned here; NOT freed in destructor (bug).
+ *   atlas   -- one reference, dropped with dclock_atlas_unref in destructor.
+ *   cal     -- popup calendar (calendar.h), or NULL; freed in destructor.
  *   clock   -- owned by GtkImage after gtk_image_new_from_pixbuf; do NOT
  *              g_object_unref separately unless you also drop the widget ref.
  *   tfmt    -- points into xconf storage; do not free.
@@ -83,57 +91,37 @@ typedef struct
 {
     plugin_instance plugin;       /* must be first -- base class fields        */
     GtkWidget *main;              /* GtkImage displaying dc->clock pixbuf      */
-    GtkWidget *calendar_window;   /* popup calendar window, or NULL            */
+    fb_calendar *cal;             /* popup calendar, or NULL if Action is set  */
     gchar *tfmt, tstr[STR_SIZE];  /* tooltip strftime format & last rendered   */
     gchar *cfmt, cstr[STR_SIZE];  /* clock  strftime format & last rendered    */
     char *action;                 /* optional shell command on click           */
-    int timer;                    /* g_timeout_add handle, 0 = not running     */
-    GdkPixbuf *glyphs;            /* source glyph sheet: vert row of '0'-'9', ':' */
+    guint timer;                  /* fb_clock_add id, 0 = not running          */
+    struct dclock_atlas *atlas;   /* shared, recoloured glyph sheet            */
     GdkPixbuf *clock;             /* destination pixbuf rendered into GtkImage */
     guint32 color;                /* AARRGGBB glyph color (default: opaque black) */
     gboolean show_seconds;        /* TRUE if seconds digit pair is shown       */
     gboolean hours_view;          /* DC_24H or DC_12H                          */
+    int calendar_months;          /* months shown side by side in the calendar */
+    gboolean week_numbers;        /* calendar shows week numbers               */
     GtkOrientation orientation;   /* copied from panel at construction time    */
 } dclock_priv;
 
 //static dclock_priv me;  /* left from single-instance era; no longer used */
 
-/*
- * dclock_create_calendar -- create and return a transient popup calendar window.
- *
- * Returns: GtkWidget* (GtkWindow) containing a GtkCalendar.
- *          Caller owns the widget; destroy it with gtk_widget_destroy().
- *
- * The window is positioned near the mouse pointer, is undecorated, sticky
- * (visible on all desktops), and excluded from the taskbar and pager.
- * No calendar_window pointer is stored here; the caller (clicked()) stores it.
- */
-static GtkWidget *
-dclock_create_calendar()
+/* Recoloured glyph sheet shared by all instances with the same colour and
+ * orientation.  Glyph slots are 20px apart: '0'-'9' at 0..9*20, ':' at
+ * 10*20 (pre-rotated for the vertical layout). */
+typedef struct dclock_atlas
 {
-    GtkWidget *calendar, *win;
-
-    win = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-    gtk_window_set_default_size(GTK_WINDOW(win), 180, 180);
-    gtk_window_set_decorated(GTK_WINDOW(win), FALSE);     // no title bar
-    gtk_window_set_resizable(GTK_WINDOW(win), FALSE);
-    gtk_container_set_border_width(GTK_CONTAINER(win), 5);
-    gtk_window_set_skip_taskbar_hint(GTK_WINDOW(win), TRUE); // hide in taskbar
-    gtk_window_set_skip_pager_hint(GTK_WINDOW(win), TRUE);   // hide in pager
-    gtk_window_set_position(GTK_WINDOW(win), GTK_WIN_POS_MOUSE);
-    gtk_window_set_title(GTK_WINDOW(win), "calendar");
-    gtk_window_stick(GTK_WINDOW(win)); // show on all virtual desktops
-
-    calendar = gtk_calendar_new();
-    // Display week numbers, day name header row, and month/year heading
-    gtk_calendar_display_options(
-        GTK_CALENDAR(calendar),
-        GTK_CALENDAR_SHOW_WEEK_NUMBERS | GTK_CALENDAR_SHOW_DAY_NAMES
-        | GTK_CALENDAR_SHOW_HEADING);
-    gtk_container_add(GTK_CONTAINER(win), GTK_WIDGET(calendar));
-
-    return win; // caller takes ownership
-}
+    guint32 color;                /* as in dclock_priv.color                   */
+    GtkOrientation orientation;   /* layout the colon glyph is prepared for    */
+    int refcount;
+    GdkPixbuf *glyphs;
+} dclock_atlas;
+
+static GSList *atlases;           /* live dclock_atlas entries                 */
+
+static void clock_update(const struct tm *detail, dclock_priv *dc);
 
 /*
  * clicked -- GdkEventButton callback for mouse clicks on the plugin widget.
@@ -148,7 +136,7 @@ dclock_create_calendar()
  * Behaviour:
  *   - Control+RightClick: propagates to panel (FALSE) for panel context menu.
  *   - If dc->action is set: runs the shell command asynchronously.
- *   - Otherwise: toggles the popup calendar window on/off.
+ *   - Otherwise: maps/unmaps the prebuilt popup calendar (calendar.h).
  *     When the calendar is open, the tooltip is suppressed (set to NULL) so it
  *     does not overlap the calendar popup.
  *
@@ -170,61 +158,118 @@ clicked(GtkWidget *widget, GdkEventButton *event, dclock_priv *dc)
         g_spawn_command_line_async(dc->action, NULL);
     else
     {
-        if (dc->calendar_window == NULL)
-        {
-            // First click: create and show the calendar popup
-            dc->calendar_window = dclock_create_calendar();
-            gtk_widget_show_all(dc->calendar_window);
-            // While calendar is open, clear the tooltip to avoid overlap
-            gtk_widget_set_tooltip_markup(dc->plugin.pwid, NULL);
-        }
-        else
-        {
-            // Second click: destroy the calendar window
-            gtk_widget_destroy(dc->calendar_window);
-            // NOTE: GTK will emit "destroy" and the widget is gone; set to NULL
-            // to avoid a dangling pointer. clock_update() checks this field.
-            dc->calendar_window = NULL;
-        }
+        fb_calendar_toggle(dc->cal);
+        // Re-render now so the tooltip follows the calendar state
+        clock_update(fb_clock_localtime(), dc);
     }
     RET(TRUE);
 }
 
 /*
- * clock_update -- periodic 1-second timer callback; updates the clock image
- *                 and tooltip.
+ * dclock_cell -- glyph slot and destination rectangle of one character.
  *
  * Parameters:
- *   dc -- dclock_priv instance cast from the GSourceFunc gpointer.
+ *   dc   -- dclock_priv instance (orientation is read).
+ *   c    -- character to place: a digit or ':'.
+ *   x, y -- pen position; advanced past the character.
+ *   cell -- out: destination rectangle in dc->clock; width 0 for a
+ *           character that has no glyph.
  *
- * Returns: TRUE (keep the timer alive), always.
+ * Returns: x offset of the glyph in the atlas sheet.
+ */
+static int
+dclock_cell(dclock_priv *dc, char c, int *x, int *y, GdkRectangle *cell)
+{
+    cell->x = *x;
+    cell->y = *y;
+    cell->width = cell->height = 0;
+    if (isdigit(c))
+    {
+        cell->width = DIGIT_WIDTH;
+        cell->height = DIGIT_HEIGHT;
+        *x += DIGIT_WIDTH;
+        return (c - '0') * 20;
+    }
+    if (c != ':')
+        return 0;
+    if (dc->orientation == GTK_ORIENTATION_HORIZONTAL) {
+        // Horizontal mode: colon glyph inline, offset 2px down
+        cell->y += 2;
+        cell->width = COLON_WIDTH;
+        cell->height = DIGIT_HEIGHT - 2;
+        *x += COLON_WIDTH;
+    } else {
+        // Vertical mode: new row below the digits, colon centred
+        *x = SHADOW;
+        *y += DIGIT_HEIGHT;
+        cell->x = *x + DIGIT_WIDTH / 2;
+        cell->y = *y;
+        cell->width = VCOLON_WIDTH;
+        cell->height = VCOLON_HEIGHT;
+        *y += VCOLON_HEIGHT;
+    }
+    return 10 * 20;
+}
+
+/*
+ * dclock_queue_draw -- invalidate @area of dc->clock on screen.
+ *
+ * GtkImage draws its pixbuf at allocation + padding, shifted by the
+ * alignment share of any extra space (see gtk_image_expose), so the same
+ * offset is applied here.  Before the first allocation the whole widget
+ * is queued.
+ */
+static void
+dclock_queue_draw(dclock_priv *dc, GdkRectangle *area)
+{
+    GtkWidget *w = dc->main;
+    GtkMisc *misc = GTK_MISC(w);
+    int x, y;
+
+    if (!GTK_WIDGET_DRAWABLE(w) || w->allocation.width <= 1)
+    {
+        gtk_widget_queue_draw(w);
+        return;
+    }
+    x = w->allocation.x + misc->xpad
+        + (w->allocation.width - w->requisition.width) * misc->xalign;
+    y = w->allocation.y + misc->ypad
+        + (w->allocation.height - w->requisition.height) * misc->yalign;
+    gtk_widget_queue_draw_area(w, x + area->x, y + area->y,
+        area->width, area->height);
+}
+
+/*
+ * clock_update -- fb_clock callback; updates the clock image and tooltip.
+ *
+ * Parameters:
+ *   detail -- local time to render (shared, do not modify).
+ *   dc     -- dclock_priv instance.
  *
  * Algorithm:
  *   1. Call strftime with dc->cfmt to get the current time string.
- *   2. If the string has changed since last update, re-render the glyph pixbuf
- *      into dc->clock character-by-character using gdk_pixbuf_copy_area.
- *      Digit glyphs are at offsets 0*20 through 9*20 in dc->glyphs.
- *      The colon glyph is at offset 10*20.
- *   3. Queue a GTK redraw of dc->main (the GtkImage).
+ *   2. Compare it with dc->cstr character by character and blit the glyph
+ *      of each changed cell from the atlas into dc->clock.  Cell positions
+ *      depend only on the preceding characters, so with equal lengths a
+ *      cell is at the same place in both strings; a length change (or the
+ *      first update) redraws every cell.
+ *   3. Invalidate the bounding box of the changed cells only: a minute
+ *      tick of "%R" repaints one or two digits, not the whole face.
  *   4. Separately, update the tooltip once per day (or clear it while the
  *      calendar popup is open).
  *
- * Potential issue: if strftime returns 0 (buffer too small or empty format),
- * the fallback "  :  " is written to output. The dc->cstr copy uses strncpy
- * without explicitly null-terminating if the string fills exactly STR_SIZE-1
- * characters -- see BUG entry.
+ * If strftime returns 0 (buffer too small or empty format), the fallback
+ * "  :  " is rendered; its blanks have no glyph and are reported by ERR.
  */
-static gint
-clock_update(dclock_priv *dc)
+static void
+clock_update(const struct tm *detail, dclock_priv *dc)
 {
-    char output[STR_SIZE], *tmp, *utf8;
-    time_t now;
-    struct tm * detail;
-    int i, x, y;
+    char output[STR_SIZE], *utf8;
+    GdkRectangle cell, dirty;
+    gboolean all;
+    int i, x, y, gx;
 
     ENTER;
-    time(&now);
-    detail = localtime(&now); // NOTE: returns pointer to static buffer -- not thread-safe
 
     // Format the clock face string; fall back to "  :  " on failure
     if (!strftime(output, sizeof(output), dc->cfmt, detail))
@@ -232,56 +277,40 @@ clock_update(dclock_priv *dc)
     // Only re-render the pixbuf if the displayed time actually changed
     if (strcmp(dc->cstr, output))
     {
-        // Save new rendered string for next comparison
-        strncpy(dc->cstr, output, sizeof(dc->cstr));
-        // BUG: strncpy does not null-terminate if strlen(output) == STR_SIZE
+        all = strlen(dc->cstr) != strlen(output);
+        dirty.width = 0;
         x = y = SHADOW; // start drawing after the shadow offset
-        for (tmp = output; *tmp; tmp++)
+        for (i = 0; output[i]; i++)
         {
-            DBGE("%c", *tmp);
-            if (isdigit(*tmp))
-            {
-                // Map '0'-'9' to glyph column index 0-9; each glyph is 20px wide
-                i = *tmp - '0';
-                gdk_pixbuf_copy_area(dc->glyphs, i * 20, 0,
-                    DIGIT_WIDTH, DIGIT_HEIGHT,
-                    dc->clock, x, y);
-                x += DIGIT_WIDTH; // advance cursor right by digit width
-            }
-            else if (*tmp == ':')
-            {
-                if (dc->orientation == GTK_ORIENTATION_HORIZONTAL) {
-                    // Horizontal mode: draw colon glyph inline, offset 2px down
-                    gdk_pixbuf_copy_area(dc->glyphs, 10 * 20, 0,
-                        COLON_WIDTH, DIGIT_HEIGHT - 2,
-                        dc->clock, x, y + 2);
-                    x += COLON_WIDTH;
-                } else {
-                    // Vertical mode: reset x, move y down past the digit row,
-                    // draw the colon glyph centred horizontally, then advance y
-                    x = SHADOW;
-                    y += DIGIT_HEIGHT;
-                    gdk_pixbuf_copy_area(dc->glyphs, 10 * 20, 0,
-                        VCOLON_WIDTH, VCOLON_HEIGHT,
-                        dc->clock, x + DIGIT_WIDTH / 2, y);
-                    y += VCOLON_HEIGHT;
-                }
-            }
-            else
+            DBGE("%c", output[i]);
+            gx = dclock_cell(dc, output[i], &x, &y, &cell);
+            if (!cell.width)
             {
                 // Only digits and ':' are expected; anything else is a format bug
-                ERR("dclock: got %c while expecting for digit or ':'\n", *tmp);
+                ERR("dclock: got %c while expecting for digit or ':'\n",
+                    output[i]);
+                continue;
             }
+            if (!all && output[i] == dc->cstr[i])
+                continue;
+            gdk_pixbuf_copy_area(dc->atlas->glyphs, gx, 0,
+                cell.width, cell.height, dc->clock, cell.x, cell.y);
+            if (dirty.width)
+                gdk_rectangle_union(&dirty, &cell, &dirty);
+            else
+                dirty = cell;
         }
         DBG("\n");
-        // Schedule a GTK expose event so the GtkImage redraws
-        gtk_widget_queue_draw(dc->main);
+        // Save new rendered string for next comparison
+        g_strlcpy(dc->cstr, output, sizeof(dc->cstr));
+        if (dirty.width)
+            dclock_queue_draw(dc, &dirty);
     }
 
     // --- Tooltip update ---
     // While the calendar popup is open we suppress the tooltip entirely;
     // also suppress if strftime produces an empty string (e.g. tfmt="").
-    if (dc->calendar_window || !strftime(output, sizeof(output),
+    if (fb_calendar_visible(dc->cal) || !strftime(output, sizeof(output),
             dc->tfmt, detail))
         output[0] = 0;    // empty string means "no tooltip"
     if (strcmp(dc->tstr, output))
@@ -297,7 +326,7 @@ clock_update(dclock_priv *dc)
         else
             gtk_widget_set_tooltip_markup(dc->plugin.pwid, NULL);
     }
-    RET(TRUE); // TRUE keeps the g_timeout_add timer running
+    RET();
 }
 
 /*
@@ -312,8 +341,7 @@ clock_update(dclock_priv *dc)
  * desired colour. This keeps the anti-aliased edges intact as long as they are
  * not exactly black.
  *
- * WARNING: this mutates the source glyph buffer permanently for the lifetime of
- * the plugin instance. Only call once per construction.
+ * Called once per atlas, on a freshly loaded sheet (see dclock_atlas_get).
  */
 static void
 dclock_set_color(GdkPixbuf *glyphs, guint32 color)
@@ -356,7 +384,7 @@ dclock_set_color(GdkPixbuf *glyphs, guint32 color)
  *                          the current orientation and show_seconds setting.
  *
  * Parameters:
- *   dc -- dclock_priv instance; orientation, show_seconds, glyphs, and
+ *   dc -- dclock_priv instance; orientation, show_seconds, and
  *         dc->plugin.panel->aw (available width) are read.
  *
  * Side-effects:
@@ -370,21 +398,13 @@ dclock_set_color(GdkPixbuf *glyphs, guint32 color)
  *   Total height = SHADOW + DIGIT_HEIGHT
  *
  * Pixel layout (vertical): two-row layout, digits stacked.
- *   The colon glyph is rotated 270 degrees and blit back into dc->glyphs
- *   at offset (200, 0) — the same glyph slot used for ':' — so the vertical
- *   colon is a modified version of the horizontal one.
- *
- * BUG: the rotated colon pixbuf (ch/cv) is created and immediately freed but
- *   the rotation result is copied back into the ORIGINAL glyphs buffer at
- *   offset (200,0), permanently altering it. If show_seconds is later toggled
- *   (which this plugin does not support at runtime) the colon would already
- *   be rotated.
+ *   The colon comes from the vertical atlas, where it is pre-rotated
+ *   (see dclock_atlas_get).
  */
 static void
 dclock_create_pixbufs(dclock_priv *dc)
 {
     int width, height;
-    GdkPixbuf *ch, *cv;
 
     ENTER;
     // Start with the shadow margin applied to both axes
@@ -403,15 +423,6 @@ dclock_create_pixbufs(dclock_priv *dc)
         }
         // Recalculate for vertical (stacked) layout
         width = height = SHADOW;
-        // Extract the 8x8 colon glyph from offset (200, 0) in the glyph sheet
-        ch = gdk_pixbuf_new_subpixbuf(dc->glyphs, 200, 0, 8, 8);
-        cv = gdk_pixbuf_rotate_simple(ch, 270); // rotate for vertical display
-        // Blit the rotated colon back onto the original glyph sheet in-place
-        // BUG: permanently modifies dc->glyphs at (0,0) within the subpixbuf ch,
-        //      but ch is a subpixbuf so writes go to dc->glyphs offset (200,0).
-        gdk_pixbuf_copy_area(cv, 0, 0, 8, 8, ch, 0, 0);
-        g_object_unref(cv);
-        g_object_unref(ch);
         // Vertical canvas: two rows of digits separated by the colon height
         height += DIGIT_HEIGHT * 2 + VCOLON_HEIGHT;
         width += DIGIT_WIDTH * 2;
@@ -426,6 +437,74 @@ done:
     RET();
 }
 
+/*
+ * dclock_atlas_get -- reference the glyph atlas for @color and @orientation,
+ *                     loading and preparing it on first use.
+ *
+ * The sheet is loaded from dclock_glyphs.png, recoloured (unless @color is
+ * the default opaque black) and, for the vertical layout, its 8x8 colon
+ * glyph at (200, 0) is rotated 270 degrees in place.  All of this happens
+ * once per (colour, orientation), not per instance or per frame.
+ *
+ * Returns: a referenced atlas, or NULL if the glyph PNG can't be loaded.
+ */
+static dclock_atlas *
+dclock_atlas_get(guint32 color, GtkOrientation orientation)
+{
+    dclock_atlas *a;
+    GdkPixbuf *ch, *cv;
+    GSList *l;
+
+    ENTER;
+    for (l = atlases; l; l = l->next)
+    {
+        a = l->data;
+        if (a->color == color && a->orientation == orientation)
+        {
+            a->refcount++;
+            RET(a);
+        }
+    }
+    a = g_new0(dclock_atlas, 1);
+    a->glyphs = gdk_pixbuf_new_from_file(IMGPREFIX "/dclock_glyphs.png", NULL);
+    if (!a->glyphs)
+    {
+        g_free(a);
+        RET(NULL);
+    }
+    a->color = color;
+    a->orientation = orientation;
+    a->refcount = 1;
+    if (color != 0xff000000)
+        dclock_set_color(a->glyphs, color);
+    if (orientation == GTK_ORIENTATION_VERTICAL)
+    {
+        // Writes through the subpixbuf land at (200, 0) in the sheet
+        ch = gdk_pixbuf_new_subpixbuf(a->glyphs, 200, 0, 8, 8);
+        cv = gdk_pixbuf_rotate_simple(ch, 270);
+        gdk_pixbuf_copy_area(cv, 0, 0, 8, 8, ch, 0, 0);
+        g_object_unref(cv);
+        g_object_unref(ch);
+    }
+    atlases = g_slist_prepend(atlases, a);
+    RET(a);
+}
+
+/*
+ * dclock_atlas_unref -- drop a reference; the last one frees the atlas.
+ */
+static void
+dclock_atlas_unref(dclock_atlas *a)
+{
+    ENTER;
+    if (!a || --a->refcount > 0)
+        RET();
+    atlases = g_slist_remove(atlases, a);
+    g_object_unref(a->glyphs);
+    g_free(a);
+    RET();
+}
+
 /*
  * dclock_destructor -- release resources when the plugin is unloaded.
  *
@@ -433,11 +512,10 @@ done:
  *   p -- plugin_instance pointer (upcast to dclock_priv internally).
  *
  * Cleanup:
- *   - Removes the 1-second timer via g_source_remove.
+ *   - Cancels the clock subscription via fb_clock_remove.
  *   - Destroys the main GtkImage widget (which drops the clock pixbuf ref).
- *
- * BUG: dc->glyphs is never g_object_unref'd here -- memory leak.
- * BUG: dc->calendar_window is not destroyed here if it was left open.
+ *   - Drops the glyph atlas reference.
+ *   - Frees the popup calendar, open or not.
  */
 static void
 dclock_destructor(plugin_instance *p)
@@ -445,12 +523,12 @@ dclock_destructor(plugin_instance *p)
     dclock_priv *dc = (dclock_priv *)p;
 
     ENTER;
-    // Stop the periodic timer before destroying the widget it references
-    if (dc->timer)
-        g_source_remove(dc->timer);
+    // Unsubscribe before destroying the widget clock_update() draws into
+    fb_clock_remove(dc->timer);
     gtk_widget_destroy(dc->main);
-    // NOTE: dc->glyphs and dc->clock are NOT freed here (dc->clock is owned
-    //       by the GtkImage; dc->glyphs leaks -- see bug list).
+    // dc->clock is owned by the GtkImage and went with it
+    dclock_atlas_unref(dc->atlas);
+    fb_calendar_free(dc->cal);
     RET();
 }
 
@@ -469,11 +547,13 @@ dclock_destructor(plugin_instance *p)
  *   HoursView   -- "12" | "24" (default "24")
  *   Action      -- shell command to run on click (default: none)
  *   Color       -- CSS-style colour string (default: opaque black)
+ *   CalendarMonths -- months shown in the popup calendar (default 1)
+ *   WeekNumbers -- bool: calendar shows week numbers (default true)
  *
  * Signals connected:
  *   "button_press_event" on p->pwid -> clicked()
  *
- * Timer: dc->timer is a 1-second recurring g_timeout_add handle.
+ * Timer: dc->timer is the shared-clock subscription (see clock.h).
  *        Must be removed in dclock_destructor.
  */
 static int
@@ -486,10 +566,6 @@ dclock_constructor(plugin_instance *p)
     ENTER;
     DBG("dclock: use 'tclock' plugin for text version of a time and date\n");
     dc = (dclock_priv *) p;
-    // Load the glyph sprite sheet; return failure if the file is missing
-    dc->glyphs = gdk_pixbuf_new_from_file(IMGPREFIX "/dclock_glyphs.png", NULL);
-    if (!dc->glyphs)
-        RET(0); // caller (plugin loader) will free p
 
     // Defaults before reading user configuration
     dc->cfmt = NULL;
@@ -498,6 +574,8 @@ dclock_constructor(plugin_instance *p)
     dc->color = 0xff000000; // opaque black (AARRGGBB)
     dc->show_seconds = FALSE;
     dc->hours_view = DC_24H;
+    dc->calendar_months = 1;
+    dc->week_numbers = TRUE;
     dc->orientation = p->panel->orientation; // inherit from panel
     color_str = NULL;
     XCG(p->xc, "TooltipFmt", &dc->tfmt, str);
@@ -506,6 +584,8 @@ dclock_constructor(plugin_instance *p)
     XCG(p->xc, "HoursView", &dc->hours_view, enum, hours_view_enum);
     XCG(p->xc, "Action", &dc->action, str);
     XCG(p->xc, "Color", &color_str, str);
+    XCG(p->xc, "CalendarMonths", &dc->calendar_months, int);
+    XCG(p->xc, "WeekNumbers", &dc->week_numbers, enum, bool_enum);
     if (dc->cfmt)
     {
         // ClockFmt was replaced by ShowSeconds + HoursView; warn and strip it
@@ -530,9 +610,13 @@ dclock_constructor(plugin_instance *p)
         dc->cfmt = (dc->show_seconds) ? CLOCK_12H_SEC_FMT : CLOCK_12H_FMT;
     // Allocate the clock destination pixbuf sized to fit the chosen format
     dclock_create_pixbufs(dc);
-    // Recolour glyphs only if the user changed the colour from the default
-    if (dc->color != 0xff000000)
-        dclock_set_color(dc->glyphs, dc->color);
+    // Share the glyph sheet for the final colour and layout; fail if the
+    // glyph PNG is missing
+    if (!(dc->atlas = dclock_atlas_get(dc->color, dc->orientation)))
+    {
+        g_object_unref(dc->clock);
+        RET(0); // caller (plugin loader) will free p
+    }
 
     // Create the GtkImage backed by dc->clock; GtkImage takes a reference
     dc->main = gtk_image_new_from_pixbuf(dc->clock);
@@ -544,9 +628,15 @@ dclock_constructor(plugin_instance *p)
     g_signal_connect (G_OBJECT (p->pwid), "button_press_event",
             G_CALLBACK (clicked), (gpointer) dc);
     gtk_widget_show_all(dc->main);
-    // Start the 1-second recurring timer; handle stored for later removal
-    dc->timer = g_timeout_add(1000, (GSourceFunc) clock_update, (gpointer)dc);
-    clock_update(dc); // render immediately so there is no blank frame at start
+    // Without an Action a click opens the calendar: build it in the background
+    if (!dc->action)
+        dc->cal = fb_calendar_new(dc->calendar_months, dc->week_numbers);
+    // Wake up only when the clock face or the tooltip can change
+    dc->timer = fb_clock_add(MIN(fb_clock_format_resolution(dc->cfmt),
+            fb_clock_format_resolution(dc->tfmt)),
+        (fb_clock_func) clock_update, dc);
+    // render immediately so there is no blank frame at start
+    clock_update(fb_clock_localtime(), dc);
 
     RET(1);
 }
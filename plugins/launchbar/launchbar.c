@@ -3,16 +3,25 @@
  *
  * Displays a row of icon buttons, each launching a command when clicked.
  * Supports drag-and-drop: dropping a URI or a Mozilla-style URL onto a
- * button appends the path/URL to that button's action command and runs it.
+ * button runs that button's action command with the path/URL as argument.
  *
  * Configuration (in the "button" xconf sub-blocks):
  *   image   - path to a pixmap file (expanded with expand_tilda).
  *   icon    - named icon (from icon theme).
- *   action  - shell command to execute on click (expanded with expand_tilda).
+ *   action  - command to execute on click (expanded with expand_tilda and
+ *             parsed once into an fb_launcher, see run.h).
  *   tooltip - tooltip markup for the button.
+ * and in the plugin config block:
+ *   MaxVisible - at most this many buttons on the bar (0 = no limit).
  *
  * Layout:
- *   pwid → GtkAlignment → GtkBar → N × fb_button
+ *   pwid → GtkAlignment → GtkBar → N × fb_button [+ overflow button]
+ *
+ *   The configured buttons form a model (lb->btns) of any size; only the
+ *   entries shown on the bar own an fb_button.  With expand = true the
+ *   plugin takes the space the panel leaves it and shows as many entries
+ *   as fit; the rest, and any beyond MaxVisible, are reachable from an
+ *   overflow button whose menu is built when it is clicked.
  *
  *   GtkBar is the custom multi-row bar widget; launchbar_size_alloc
  *   recalculates the number of rows/columns (dimension) when the widget
@@ -20,8 +29,8 @@
  *
  * Drag-and-drop:
  *   Accepts text/uri-list (whitespace-separated URIs) and text/x-moz-url
- *   (UTF-16 encoded "URL\nTitle").  Each received URI is appended to the
- *   button's action string before spawning the command.
+ *   (UTF-16 encoded "URL\nTitle").  The received files/URLs are passed as
+ *   extra arguments to the button's command.
  *
  * Fixed bugs:
  *   Fixed (BUG-003): Removed explicit gtk_widget_destroy(lb->box) from
@@ -81,42 +90,53 @@ static const GtkTargetEntry target_table[] = {
 struct launchbarb;  /* forward declaration (unused; kept for legacy) */
 
 /*
- * btn -- per-button state.
+ * btn -- one launcher entry of the model.
  *
- * lb     - back-pointer to the containing launchbar_priv.
- * action - shell command to execute (g_strdup'd; freed in destructor).
+ * lb       - back-pointer to the containing launchbar_priv.
+ * launcher - parsed action command (freed in destructor); NULL if none.
+ * iname    - icon name (g_strdup'd), or NULL.
+ * fname    - image file path (expand_tilda'd), or NULL.
+ * tooltip  - tooltip markup (g_strdup'd), or NULL.
+ * label    - plain-text name used in the overflow popup.
+ * button   - fb_button while the entry is shown on the bar, else NULL.
  */
 typedef struct btn {
     struct launchbar_priv *lb;
-    gchar *action;
+    fb_launcher *launcher;
+    gchar *iname;
+    gchar *fname;
+    gchar *tooltip;
+    gchar *label;
+    GtkWidget *button;
 } btn;
 
-#define MAXBUTTONS 40   /* hard limit on number of launcher buttons */
-
 /*
  * launchbar_priv -- private state for one launchbar plugin instance.
  *
  * plugin               - embedded plugin_instance (MUST be first).
- * box                  - GtkBar holding all buttons.
- * btns[MAXBUTTONS]     - per-button data (action strings etc.).
- * btn_num              - number of buttons currently configured.
+ * box                  - GtkBar holding the visible buttons.
+ * btns                 - model: all configured entries (btn *), in order.
+ * nvis                 - entries btns[0 .. nvis-1] have a button widget.
+ * max_visible          - MaxVisible config key; 0 = no fixed limit.
+ * more                 - overflow button, shown when nvis < btns->len.
  * iconsize             - icon pixel size (derived from panel->max_elem_height).
  * discard_release_event - set when Ctrl+RMB fires to suppress the matching release.
  */
 typedef struct launchbar_priv {
     plugin_instance plugin;
     GtkWidget *box;
-    btn btns[MAXBUTTONS];
-    int btn_num;
+    GPtrArray *btns;
+    guint nvis;
+    int max_visible;
+    GtkWidget *more;
     int iconsize;
     unsigned int discard_release_event : 1;
 } launchbar_priv;
 
-
 /*
  * my_button_pressed -- "button-press-event" / "button-release-event" handler.
  *
- * Runs b->action via run_app() on a left button release when the pointer
+ * Runs b->launcher on a left button release when the pointer
  * is still inside the button.
  *
  * Ctrl+RMB press is silently consumed and the matching release is
@@ -153,7 +173,7 @@ my_button_pressed(GtkWidget *widget, GdkEventButton *event, btn *b )
         if ((event->x >=0 && event->x < widget->allocation.width)
             && (event->y >=0 && event->y < widget->allocation.height))
         {
-            run_app(b->action);
+            fb_launcher_run(b->launcher, NULL);
         }
     }
     RET(TRUE);
@@ -162,25 +182,35 @@ my_button_pressed(GtkWidget *widget, GdkEventButton *event, btn *b )
 /*
  * launchbar_destructor -- free all launchbar resources.
  *
- * Frees each button's action string.
+ * Frees the model: each entry's launcher and strings.
  *
  * Parameters:
  *   p - plugin_instance.
  *
  * Note: lb->box is a child of p->pwid; the framework destroys p->pwid
- *   (and all its children) after this destructor returns, so no explicit
- *   gtk_widget_destroy(lb->box) is needed here.
+ *   (and all its children, including the visible buttons) after this
+ *   destructor returns, so no explicit gtk_widget_destroy(lb->box) is
+ *   needed here.
  */
 static void
 launchbar_destructor(plugin_instance *p)
 {
     launchbar_priv *lb = (launchbar_priv *) p;
-    int i;
+    btn *b;
+    guint i;
 
     ENTER;
-    for (i = 0; i < lb->btn_num; i++)
-        g_free(lb->btns[i].action);     /* action was g_strdup'd by expand_tilda */
-
+    for (i = 0; i < lb->btns->len; i++)
+    {
+        b = g_ptr_array_index(lb->btns, i);
+        fb_launcher_free(b->launcher);
+        g_free(b->iname);
+        g_free(b->fname);
+        g_free(b->tooltip);
+        g_free(b->label);
+        g_free(b);
+    }
+    g_ptr_array_free(lb->btns, TRUE);
     RET();
 }
 
@@ -188,10 +218,10 @@ launchbar_destructor(plugin_instance *p)
 /*
  * drag_data_received_cb -- "drag_data_received" handler for launcher buttons.
  *
- * Appends each dragged URI / URL to the button's action string and spawns it.
+ * Runs the button's command with the dragged files / URL as extra arguments.
  *
  * text/uri-list:  whitespace-separated URIs; each is converted from URI to
- *   filename with g_filename_from_uri() before appending.
+ *   filename with g_filename_from_uri() when possible.
  * text/x-moz-url: UTF-16 "URL\nTitle"; only the URL part (before the first \n)
  *   is appended.
  *
@@ -214,7 +244,8 @@ drag_data_received_cb (GtkWidget *widget,
     guint time,
     btn *b)
 {
-    gchar *s, *str, *tmp, *tok, *tok2;
+    GPtrArray *args;
+    gchar *s, *tok, *tok2;
 
     ENTER;
     if (sd->length <= 0)
@@ -225,19 +256,16 @@ drag_data_received_cb (GtkWidget *widget,
     {
         /* text/uri-list: whitespace-separated list of URIs */
         s = g_strdup((gchar *)sd->data);
-        str = g_strdup(b->action);
+        args = g_ptr_array_new_with_free_func(g_free);
         for (tok = strtok(s, "\n \t\r"); tok; tok = strtok(NULL, "\n \t\r"))
         {
             tok2 = g_filename_from_uri(tok, NULL, NULL);
             /* use the local filename if conversion succeeded, else use raw URI */
-            tmp = g_strdup_printf("%s '%s'", str, tok2 ? tok2 : tok);
-            g_free(str);
-            g_free(tok2);
-            str = tmp;
+            g_ptr_array_add(args, tok2 ? tok2 : g_strdup(tok));
         }
-        DBG("cmd=<%s>\n", str);
-        g_spawn_command_line_async(str, NULL);
-        g_free(str);
+        g_ptr_array_add(args, NULL);
+        fb_launcher_run(b->launcher, (gchar **) args->pdata);
+        g_ptr_array_free(args, TRUE);
         g_free(s);
     }
     else if (info == TARGET_MOZ_URL)
@@ -256,66 +284,37 @@ drag_data_received_cb (GtkWidget *widget,
             RET();
 	}
 	*tmp = '\0';   /* terminate at the \n; everything before is the URL */
-        tmp = g_strdup_printf("%s %s", b->action, utf8);
-        g_spawn_command_line_async(tmp, NULL);
-        DBG("%s %s\n", b->action, utf8);
+        {
+            gchar *url[] = { utf8, NULL };
+
+            fb_launcher_run(b->launcher, url);
+        }
+        DBG("%s\n", utf8);
         g_free(utf8);
-        g_free(tmp);
     }
     RET();
 }
 
 /*
- * read_button -- parse one "button" xconf block and create a launcher button.
- *
- * Reads image/icon/action/tooltip from @xc, creates an fb_button, connects
- * event and DnD handlers, and packs it into lb->box.
- *
- * Parameters:
- *   p  - plugin_instance (cast to launchbar_priv*).
- *   xc - xconf node for one "button" block.
+ * lb_button_new -- create the bar widget for model entry @b.
  *
- * Returns: 1 on success, 0 if the button limit was reached.
- *
- * Memory notes:
- *   action: expand_tilda() returns a g_strdup'd copy → stored in btns[].action,
- *     freed in launchbar_destructor.
- *   fname:  expand_tilda() returns a g_strdup'd copy → g_free'd at end.
- *   iname:  XCG with str → non-owning pointer into xconf tree → NOT freed.
- *   tooltip: XCG with str → non-owning → NOT freed (used only during setup).
+ * Creates an fb_button, connects event and DnD handlers, and packs it
+ * at the end of lb->box (before the overflow button).
  */
-static int
-read_button(plugin_instance *p, xconf *xc)
+static void
+lb_button_new(launchbar_priv *lb, btn *b)
 {
-    launchbar_priv *lb = (launchbar_priv *) p;
-    gchar *iname, *fname, *tooltip, *action;
     GtkWidget *button;
 
     ENTER;
-    if (lb->btn_num >= MAXBUTTONS)
-    {
-        ERR("launchbar: max number of buttons (%d) was reached."
-            "skipping the rest\n", lb->btn_num );
-        RET(0);
-    }
-    iname = tooltip = fname = action = NULL;
-    XCG(xc, "image",   &fname,   str);   /* non-owning pointer into xconf */
-    XCG(xc, "icon",    &iname,   str);   /* non-owning pointer into xconf */
-    XCG(xc, "action",  &action,  str);   /* non-owning pointer into xconf */
-    XCG(xc, "tooltip", &tooltip, str);   /* non-owning pointer into xconf */
-
-    action = expand_tilda(action);   /* returns g_strdup'd copy */
-    fname  = expand_tilda(fname);    /* returns g_strdup'd copy */
-    /* iname is not expand_tilda'd — stays as non-owning xconf pointer */
-
-    button = fb_button_new(iname, fname, lb->iconsize,
+    button = fb_button_new(b->iname, b->fname, lb->iconsize,
         lb->iconsize, 0x202020, NULL);
 
     /* connect both press and release so we can filter Ctrl+RMB */
     g_signal_connect (G_OBJECT (button), "button-release-event",
-          G_CALLBACK (my_button_pressed), (gpointer) &lb->btns[lb->btn_num]);
+          G_CALLBACK (my_button_pressed), (gpointer) b);
     g_signal_connect (G_OBJECT (button), "button-press-event",
-          G_CALLBACK (my_button_pressed), (gpointer) &lb->btns[lb->btn_num]);
+          G_CALLBACK (my_button_pressed), (gpointer) b);
 
     GTK_WIDGET_UNSET_FLAGS (button, GTK_CAN_FOCUS);
     /* configure button as DnD destination for all accepted target types */
@@ -324,34 +323,196 @@ read_button(plugin_instance *p, xconf *xc)
         target_table, G_N_ELEMENTS (target_table),
         GDK_ACTION_COPY);
     g_signal_connect (G_OBJECT(button), "drag_data_received",
-        G_CALLBACK (drag_data_received_cb),
-        (gpointer) &lb->btns[lb->btn_num]);
+        G_CALLBACK (drag_data_received_cb), (gpointer) b);
 
     gtk_box_pack_start(GTK_BOX(lb->box), button, FALSE, FALSE, 0);
+    if (lb->more)
+        gtk_box_reorder_child(GTK_BOX(lb->box), lb->more, -1);
     gtk_widget_show(button);
 
-    if (p->panel->transparent)
+    if (lb->plugin.panel->transparent)
         gtk_bgbox_set_background(button, BG_INHERIT,
-            p->panel->tintcolor, p->panel->alpha);
-    gtk_widget_set_tooltip_markup(button, tooltip);
+            lb->plugin.panel->tintcolor, lb->plugin.panel->alpha);
+    gtk_widget_set_tooltip_markup(button, b->tooltip);
+    b->button = button;
+    RET();
+}
+
+/*
+ * lb_set_visible -- give the first @nvis entries a bar widget.
+ *
+ * Widgets are created or destroyed only for the entries that enter or
+ * leave the visible range; the overflow button is shown while entries
+ * remain outside it.
+ */
+static void
+lb_set_visible(launchbar_priv *lb, guint nvis)
+{
+    btn *b;
+    guint i;
+
+    ENTER;
+    nvis = MIN(nvis, lb->btns->len);
+    for (i = lb->nvis; i > nvis; i--)
+    {
+        b = g_ptr_array_index(lb->btns, i - 1);
+        gtk_widget_destroy(b->button);
+        b->button = NULL;
+    }
+    for (i = lb->nvis; i < nvis; i++)
+        lb_button_new(lb, g_ptr_array_index(lb->btns, i));
+    DBG("visible %u -> %u of %u\n", lb->nvis, nvis, lb->btns->len);
+    lb->nvis = nvis;
+    if (nvis < lb->btns->len)
+        gtk_widget_show(lb->more);
+    else
+        gtk_widget_hide(lb->more);
+    RET();
+}
+
+/*
+ * lb_fit -- show as many entries as fit in @slots bar positions.
+ *
+ * Applies MaxVisible and keeps one slot for the overflow button when
+ * entries are left over.
+ */
+static void
+lb_fit(launchbar_priv *lb, guint slots)
+{
+    if (lb->max_visible > 0)
+        slots = MIN(slots, (guint) lb->max_visible);
+    if (slots < lb->btns->len)
+        slots = MAX(slots, 2) - 1;   /* room for the overflow button */
+    else
+        slots = lb->btns->len;
+    if (slots != lb->nvis || !lb->nvis)
+        lb_set_visible(lb, slots);
+}
 
-    g_free(fname);   /* fname was g_strdup'd by expand_tilda */
-    /* iname: NOT freed — non-owning pointer from XCG str */
-    //g_free(iname);   /* correctly commented out; iname is non-owning */
-    DBG("here\n");
+/* Overflow popup item activated: run the entry's command. */
+static void
+lb_more_item_activate(GtkMenuItem *mi, btn *b)
+{
+    fb_launcher_run(b->launcher, NULL);
+}
+
+/*
+ * lb_more_clicked -- overflow button handler.
+ *
+ * Builds a menu of the entries that did not fit on the bar.  The menu is
+ * built on demand and destroyed when it closes, so hidden entries cost no
+ * widgets.
+ */
+static gboolean
+lb_more_clicked(GtkWidget *widget, GdkEventButton *event, launchbar_priv *lb)
+{
+    GtkWidget *menu, *mi;
+    GdkPixbuf *pb;
+    btn *b;
+    guint i;
+    gint w, h;
+
+    ENTER;
+    if (event->type != GDK_BUTTON_PRESS || event->button != 1)
+        RET(FALSE);
+    gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, &w, &h);
+    menu = gtk_menu_new();
+    for (i = lb->nvis; i < lb->btns->len; i++)
+    {
+        b = g_ptr_array_index(lb->btns, i);
+        mi = gtk_image_menu_item_new_with_label(b->label);
+        if ((pb = fb_pixbuf_new(b->iname, b->fname, w, h, FALSE)))
+        {
+            gtk_image_menu_item_set_image(GTK_IMAGE_MENU_ITEM(mi),
+                gtk_image_new_from_pixbuf(pb));
+            g_object_unref(G_OBJECT(pb));
+        }
+        g_signal_connect(G_OBJECT(mi), "activate",
+            G_CALLBACK(lb_more_item_activate), b);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), mi);
+    }
+    gtk_widget_show_all(menu);
+    g_signal_connect(G_OBJECT(menu), "selection-done",
+        G_CALLBACK(gtk_widget_destroy), NULL);
+    gtk_menu_popup(GTK_MENU(menu), NULL, NULL,
+        (GtkMenuPositionFunc) menu_pos, widget,
+        event->button, event->time);
+    RET(TRUE);
+}
+
+/*
+ * read_button -- parse one "button" xconf block into a model entry.
+ *
+ * Reads image/icon/action/tooltip from @xc and appends a btn to lb->btns.
+ * No widget is created here; see lb_set_visible().
+ *
+ * Returns: 1.
+ *
+ * Memory notes:
+ *   action: expand_tilda() returns a g_strdup'd copy → parsed into
+ *     btn->launcher (which keeps its own copy) and g_free'd at end;
+ *     the launcher is freed in launchbar_destructor.
+ *   fname:  expand_tilda() returns a g_strdup'd copy → owned by btn.
+ *   iname, tooltip: XCG str pointers into xconf → g_strdup'd into btn.
+ */
+static int
+read_button(plugin_instance *p, xconf *xc)
+{
+    launchbar_priv *lb = (launchbar_priv *) p;
+    gchar *iname, *fname, *tooltip, *action;
+    btn *b;
+
+    ENTER;
+    iname = tooltip = fname = action = NULL;
+    XCG(xc, "image",   &fname,   str);   /* non-owning pointer into xconf */
+    XCG(xc, "icon",    &iname,   str);   /* non-owning pointer into xconf */
+    XCG(xc, "action",  &action,  str);   /* non-owning pointer into xconf */
+    XCG(xc, "tooltip", &tooltip, str);   /* non-owning pointer into xconf */
 
-    lb->btns[lb->btn_num].action = action;   /* transfer ownership of action */
-    lb->btns[lb->btn_num].lb     = lb;
-    lb->btn_num++;
+    b = g_new0(btn, 1);
+    b->lb      = lb;
+    b->iname   = g_strdup(iname);
+    b->fname   = expand_tilda(fname);    /* returns g_strdup'd copy */
+    b->tooltip = g_strdup(tooltip);
+    /* overflow label: tooltip without markup, else the command itself */
+    if (!tooltip || !pango_parse_markup(tooltip, -1, 0, NULL, &b->label,
+            NULL, NULL))
+        b->label = g_strdup(action ? action : "");
 
+    action = expand_tilda(action);   /* returns g_strdup'd copy */
+    /* parse the command once; the icon doubles as startup-notify ICON */
+    b->launcher = fb_launcher_new(action, NULL, iname);
+    g_free(action);
+    g_ptr_array_add(lb->btns, b);
     RET(1);
 }
 
+/*
+ * launchbar_size_req -- "size-request" handler (after) on the GtkAlignment.
+ *
+ * When the plugin expands, ask for a single icon along the panel so the
+ * panel hands us whatever space is left; launchbar_size_alloc then fills
+ * that space with as many buttons as fit.
+ */
+static void
+launchbar_size_req(GtkWidget *widget, GtkRequisition *req,
+    launchbar_priv *lb)
+{
+    if (lb->plugin.panel->orientation == GTK_ORIENTATION_HORIZONTAL)
+        req->width = MIN(req->width, lb->iconsize);
+    else
+        req->height = MIN(req->height, lb->iconsize);
+}
+
 /*
  * launchbar_size_alloc -- "size-allocate" handler on the GtkAlignment.
  *
  * Recalculates how many icon rows (horizontal panel) or columns (vertical
  * panel) fit in the current allocation, and updates the GtkBar dimension.
+ * Then decides how many entries get a button: all of them (up to
+ * MaxVisible) for a fixed-size plugin, or as many as fit in the
+ * allocation for an expanding one.  One slot is kept for the overflow
+ * button when entries are left over.
  *
  * Parameters:
  *   widget - the GtkAlignment (unused; we use lb->iconsize instead).
@@ -362,16 +523,28 @@ static void
 launchbar_size_alloc(GtkWidget *widget, GtkAllocation *a,
     launchbar_priv *lb)
 {
-    int dim;
+    int dim, len;
+    guint slots;
 
     ENTER;
     if (lb->plugin.panel->orientation == GTK_ORIENTATION_HORIZONTAL)
+    {
         dim = a->height / lb->iconsize;   /* rows for a horizontal panel */
+        len = a->width;
+    }
     else
+    {
         dim = a->width / lb->iconsize;    /* columns for a vertical panel */
+        len = a->height;
+    }
     DBG("width=%d height=%d iconsize=%d -> dim=%d\n",
         a->width, a->height, lb->iconsize, dim);
     gtk_bar_set_dimension(GTK_BAR(lb->box), dim);
+
+    slots = G_MAXUINT;
+    if (lb->plugin.expand)
+        slots = MAX(dim, 1) * MAX(len / lb->iconsize, 1);
+    lb_fit(lb, slots);
     RET();
 }
 
@@ -411,6 +584,7 @@ launchbar_constructor(plugin_instance *p)
     lb = (launchbar_priv *) p;
     lb->iconsize = p->panel->max_elem_height;
     DBG("iconsize=%d\n", lb->iconsize);
+    XCG(p->xc, "MaxVisible", &lb->max_visible, int);
 
     gtk_widget_set_name(p->pwid, "launchbar");
     gtk_rc_parse_string(launchbar_rc);
@@ -419,6 +593,9 @@ launchbar_constructor(plugin_instance *p)
     ali = gtk_alignment_new(0.5, 0.5, 0, 0);
     g_signal_connect(G_OBJECT(ali), "size-allocate",
         (GCallback) launchbar_size_alloc, lb);
+    if (p->expand)
+        g_signal_connect_after(G_OBJECT(ali), "size-request",
+            (GCallback) launchbar_size_req, lb);
     gtk_container_set_border_width(GTK_CONTAINER(ali), 0);
     gtk_container_add(GTK_CONTAINER(p->pwid), ali);
 
@@ -429,9 +606,25 @@ launchbar_constructor(plugin_instance *p)
     gtk_container_set_border_width(GTK_CONTAINER (lb->box), 0);
     gtk_widget_show_all(ali);
 
+    /* overflow button: last child of the bar, hidden until needed */
+    lb->more = gtk_button_new();
+    gtk_button_set_relief(GTK_BUTTON(lb->more), GTK_RELIEF_NONE);
+    GTK_WIDGET_UNSET_FLAGS (lb->more, GTK_CAN_FOCUS);
+    gtk_container_add(GTK_CONTAINER(lb->more),
+        gtk_arrow_new((p->panel->orientation == GTK_ORIENTATION_HORIZONTAL)
+            ? GTK_ARROW_DOWN : GTK_ARROW_RIGHT, GTK_SHADOW_NONE));
+    gtk_widget_show(gtk_bin_get_child(GTK_BIN(lb->more)));
+    gtk_widget_set_tooltip_text(lb->more, _("More launchers"));
+    g_signal_connect(G_OBJECT(lb->more), "button-press-event",
+        G_CALLBACK(lb_more_clicked), lb);
+    gtk_box_pack_start(GTK_BOX(lb->box), lb->more, FALSE, FALSE, 0);
+
     /* iterate over all "button" sub-blocks in the plugin config */
+    lb->btns = g_ptr_array_new();
     for (i = 0; (pxc = xconf_find(p->xc, "button", i)); i++)
         read_button(p, pxc);
+    /* widgets for the initial request; launchbar_size_alloc adjusts */
+    lb_fit(lb, p->expand ? 1 : G_MAXUINT);
     RET(1);
 }
 
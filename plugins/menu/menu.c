@@ -31,7 +31,7 @@
  *
  * EXTERNAL SYMBOLS CONSUMED (from system_menu.c)
  * -----------------------------------------------
- *   xconf_new_from_systemmenu()  -- build xconf tree from XDG .desktop files
+ *   xconf_new_from_systemmenu(a) -- build xconf tree from XDG .desktop files
  *   systemmenu_changed(btime)    -- check whether .desktop files changed
  */
 
@@ -54,7 +54,7 @@
 #include "dbg.h"
 
 /* Forward declarations for functions defined later in this file. */
-xconf *xconf_new_from_systemmenu();
+xconf *xconf_new_from_systemmenu(xconf_arena *a);
 gboolean systemmenu_changed(time_t btime);
 static void menu_create(plugin_instance *p);
 static void menu_destroy(menu_priv *m);
@@ -73,18 +73,18 @@ static gboolean check_system_menu(plugin_instance *p);
  * Parameters:
  *   xc  -- source xconf node (read-only, not modified).
  *   m   -- current menu_priv instance; m->has_system_menu is set to TRUE
- *          if a <systemmenu> node is encountered.
+ *          if a <systemmenu> node is encountered.  Every node of the result
+ *          is allocated in m->arena.
  *
  * Returns:
- *   A newly allocated xconf tree.  The caller owns the returned tree and
- *   must free it with xconf_del(result, FALSE) when done.
+ *   A newly allocated xconf tree living in m->arena; it is released as a
+ *   whole by xconf_arena_free(m->arena) in menu_destroy().
  *   Returns NULL if @xc is NULL.
  *
  * Memory notes:
- *   - smenu_xc returned by xconf_new_from_systemmenu() / xconf_new_from_file()
- *     is appended into @nxc (transferring ownership of children) and then freed
- *     with xconf_del(smenu_xc, FALSE) -- the FALSE means "do not free children
- *     recursively", which is correct since children were moved.
+ *   - smenu_xc returned by xconf_new_from_systemmenu() / xconf_new_from_file_in()
+ *     is built directly in m->arena, so moving its children into @nxc is a
+ *     plain list splice; the empty wrapper node is simply left in the arena.
  *   - Recursive calls for non-special nodes are via menu_expand_xc(), whose
  *     return value is appended directly into @nxc (ownership transferred).
  */
@@ -99,7 +99,7 @@ menu_expand_xc(xconf *xc, menu_priv *m)
         RET(NULL);
 
     /* Create a new node mirroring the current node (copies name & value). */
-    nxc = xconf_new(xc->name, xc->value);
+    nxc = xconf_new_in(m->arena, xc->name, xc->value);
     DBG("new node:%s\n", nxc->name);
 
     /* Iterate over all children of the source node. */
@@ -110,10 +110,9 @@ menu_expand_xc(xconf *xc, menu_priv *m)
         /* <systemmenu> -- replace with dynamically generated system menu. */
         if (!strcmp(cxc->name, "systemmenu"))
         {
-            smenu_xc = xconf_new_from_systemmenu();
-            /* Move children of smenu_xc into nxc, then free the wrapper node. */
+            smenu_xc = xconf_new_from_systemmenu(m->arena);
+            /* Move children of smenu_xc into nxc; the wrapper stays in the arena. */
             xconf_append_sons(nxc, smenu_xc);
-            xconf_del(smenu_xc, FALSE); /* FALSE = do not free already-moved children */
             m->has_system_menu = TRUE;
             continue;
         }
@@ -121,9 +120,8 @@ menu_expand_xc(xconf *xc, menu_priv *m)
         /* <include value="path"> -- load and inline an external config file. */
         if (!strcmp(cxc->name, "include"))
         {
-            smenu_xc = xconf_new_from_file(cxc->value, "include");
+            smenu_xc = xconf_new_from_file_in(m->arena, cxc->value, "include");
             xconf_append_sons(nxc, smenu_xc);
-            xconf_del(smenu_xc, FALSE); /* FALSE = children already moved */
             continue;
         }
 
@@ -162,6 +160,13 @@ menu_create_separator()
     return gtk_separator_menu_item_new();
 }
 
+/* "activate" handler of action items: run the item's launcher. */
+static void
+menu_item_launch(fb_launcher *l)
+{
+    fb_launcher_run(l, NULL);
+}
+
 /*
  * menu_create_item -- create a single GtkImageMenuItem from an xconf node.
  *
@@ -187,8 +192,9 @@ menu_create_separator()
  * Memory notes:
  *   - fname is the result of expand_tilda(XCG result); freed via g_free() at
  *     the end of this function.
- *   - action after expand_tilda() is owned by the GObject data slot "activate"
- *     with g_free as the destroy notifier; it is NOT freed here explicitly.
+ *   - action after expand_tilda() is parsed into an fb_launcher and freed
+ *     here; the launcher is owned by the GObject data slot "activate" with
+ *     fb_launcher_free as the destroy notifier.
  *   - The GdkPixbuf pb is unreferenced after being set on the widget (the
  *     widget holds its own reference).
  *
@@ -248,15 +254,17 @@ menu_create_item(xconf *xc, GtkWidget *menu, menu_priv *m)
     XCG(xc, "action", &action, str);
     if (action)
     {
-        action = expand_tilda(action); /* ownership of returned string moves below */
+        fb_launcher *l;
 
-        /* run_app is called with `action` as argument when item is activated. */
+        /* Parse the command once; the launcher is run when the item is
+         * activated and freed (object data destroy) with the widget. */
+        action = expand_tilda(action);
+        l = fb_launcher_new(action, name, iname);
+        g_free(action);
         g_signal_connect_swapped(G_OBJECT(mi), "activate",
-                (GCallback)run_app, action);
-        /* Store `action` string as object data; g_free is the destroy handler,
-         * so the string is freed when the widget is destroyed. */
+                (GCallback)menu_item_launch, l);
         g_object_set_data_full(G_OBJECT(mi), "activate",
-            action, g_free);
+            l, (GDestroyNotify)fb_launcher_free);
         goto done;
     }
 
@@ -378,7 +386,7 @@ menu_unmap(GtkWidget *menu, plugin_instance *p)
  *   p -- plugin_instance* (cast to menu_priv* internally).
  *
  * Side effects:
- *   Sets m->menu, m->xc, m->has_system_menu, m->btime, m->tout.
+ *   Sets m->menu, m->arena, m->xc, m->has_system_menu, m->btime, m->tout.
  *   Connects the "unmap" signal on m->menu to menu_unmap().
  */
 static void
@@ -391,7 +399,9 @@ menu_create(plugin_instance *p)
     if (m->menu)
         menu_destroy(m);
 
-    /* Expand raw xconf (resolving <systemmenu> and <include>) into m->xc. */
+    /* Expand raw xconf (resolving <systemmenu> and <include>) into m->xc;
+     * the whole expanded tree lives in one arena. */
+    m->arena = xconf_arena_new();
     m->xc = menu_expand_xc(p->xc, m);
 
     /* Build GTK menu hierarchy from the expanded tree. */
@@ -421,7 +431,8 @@ menu_create(plugin_instance *p)
  *
  * Side effects:
  *   Destroys m->menu widget, removes m->tout and m->rtout GLib timers,
- *   frees m->xc.  All four fields are set to 0/NULL afterwards.
+ *   frees m->xc together with m->arena.  All fields are set to 0/NULL
+ *   afterwards.
  */
 static void
 menu_destroy(menu_priv *m)
@@ -440,8 +451,9 @@ menu_destroy(menu_priv *m)
         g_source_remove(m->rtout);  /* cancel 2-second deferred rebuild */
         m->rtout = 0;
     }
-    if (m->xc) {
-        xconf_del(m->xc, FALSE);    /* free xconf wrapper node (children already owned) */
+    if (m->arena) {
+        xconf_arena_free(m->arena); /* frees the whole expanded tree at once */
+        m->arena = NULL;
         m->xc = NULL;
     }
     RET();
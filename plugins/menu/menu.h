@@ -44,8 +44,9 @@
  *             Created lazily in menu_create(), destroyed in menu_destroy().
  *   bg    -- GtkWidget (toolbar button) owned by GTK, child of plugin->pwid.
  *             Created in make_button(), destroyed in menu_destructor().
- *   xc    -- Expanded xconf tree owned by this struct.
- *             Created in menu_create(), freed (deep=FALSE) in menu_destroy().
+ *   xc    -- Expanded xconf tree allocated in arena.
+ *             Created in menu_create(), freed with the arena in menu_destroy().
+ *   arena -- xconf_arena backing xc; owned by this struct.
  *   tout  -- GLib timer source ID; 0 means no active source.
  *   rtout -- GLib timer source ID; 0 means no active source.
  */
@@ -77,10 +78,16 @@ typedef struct {
 
     /* Expanded xconf configuration tree produced by menu_expand_xc().  All
      * <systemmenu> and <include> directives have already been resolved.
-     * Owned by this struct; freed with xconf_del(xc, FALSE) in menu_destroy().
+     * Allocated in `arena`; never freed node by node.
      */
     xconf *xc;
 
+    /* Region holding every node and string of `xc`.  Created in menu_create()
+     * and released in one call by xconf_arena_free() in menu_destroy(), so
+     * rebuilding a large system menu does not cost one malloc/free pair per
+     * node and string. */
+    xconf_arena *arena;
+
     /* GLib timeout ID for the 30-second periodic system-menu staleness poll.
      * Started in menu_create() when has_system_menu is TRUE.
      * Cancelled via g_source_remove() in menu_destroy(); 0 when inactive. */
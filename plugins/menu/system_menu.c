@@ -28,9 +28,10 @@
  *
  * PUBLIC API
  * ----------
- *   xconf *xconf_new_from_systemmenu(void)
- *     Build and return a fresh xconf tree.  Caller owns the result and must
- *     free it with xconf_del(result, TRUE).
+ *   xconf *xconf_new_from_systemmenu(xconf_arena *a)
+ *     Build and return a fresh xconf tree allocated in arena @a (NULL for
+ *     heap nodes).  Arena trees are released with xconf_arena_free(a); heap
+ *     trees with xconf_del(result, FALSE).
  *
  *   gboolean systemmenu_changed(time_t btime)
  *     Return TRUE if any XDG application directory or .desktop file has been
@@ -126,7 +127,8 @@ static cat_info main_cats[] = {
  * Memory notes:
  *   - name, icon, action, cats are all g_free/g_strfreev'd before return.
  *   - xconf nodes created here are owned by the tree rooted at the category
- *     mxc node in the hash table; no additional cleanup needed here.
+ *     mxc node in the hash table and are allocated in the same arena as
+ *     mxc; no additional cleanup needed here.
  *
  * BUG: The Exec field-code stripping loop (while strchr) does not terminate
  *      if the last character of the string is '%' (i.e. a bare trailing
@@ -240,18 +242,19 @@ do_app_file(GHashTable *ht, const gchar *file)
     }
 
     /* Build the <item> xconf node and append to the matched category menu. */
-    ixc = xconf_new("item", NULL);
+    ixc = xconf_new_in(mxc->arena, "item", NULL);
     xconf_append(mxc, ixc);
 
     if (icon)
     {
         /* Use "image" key for absolute paths, "icon" key for theme names. */
-        vxc = xconf_new((icon[0] == '/') ? "image" : "icon", icon);
+        vxc = xconf_new_in(mxc->arena,
+            (icon[0] == '/') ? "image" : "icon", icon);
         xconf_append(ixc, vxc);
     }
-    vxc = xconf_new("name", name);
+    vxc = xconf_new_in(mxc->arena, "name", name);
     xconf_append(ixc, vxc);
-    vxc = xconf_new("action", action);
+    vxc = xconf_new_in(mxc->arena, "action", action);
     xconf_append(ixc, vxc);
 
 out:
@@ -568,13 +571,19 @@ systemmenu_changed(time_t btime)
  * application directories for .desktop files, assigns applications to their
  * categories, removes empty categories, and sorts the result.
  *
+ * Parameters:
+ *   a -- arena to build the tree in, or NULL for heap-allocated nodes.  With
+ *        an arena every node, sons link and string of the (possibly
+ *        thousands of entries large) menu comes from a few arena blocks.
+ *
  * Returns:
  *   A newly allocated xconf tree rooted at a "systemmenu" node.
- *   Caller owns the result and must eventually free it with xconf_del(result, TRUE).
+ *   Heap trees are freed with xconf_del(result, FALSE); arena trees go away
+ *   with xconf_arena_free(a).
  *
  * Memory notes:
  *   - All xconf nodes (mxc, tmp, ixc, vxc) become children of the returned
- *     tree and are freed by xconf_del(result, TRUE).
+ *     tree and share its storage (heap or arena).
  *   - @ht maps category-name strings (static lifetime) to xconf* pointers
  *     that are part of the returned tree; @ht is destroyed before return,
  *     which does NOT free the keys or values (the GHashTable does not own them
@@ -595,7 +604,7 @@ systemmenu_changed(time_t btime)
  *        conceptual design is fragile).
  */
 xconf *
-xconf_new_from_systemmenu()
+xconf_new_from_systemmenu(xconf_arena *a)
 {
     xconf *xc, *mxc, *tmp;
     GSList *w;
@@ -605,19 +614,19 @@ xconf_new_from_systemmenu()
 
     /* ---- Phase 1: Create empty category menu nodes ---- */
     ht = g_hash_table_new(g_str_hash, g_str_equal);
-    xc = xconf_new("systemmenu", NULL);
+    xc = xconf_new_in(a, "systemmenu", NULL);
 
     for (i = 0; i < G_N_ELEMENTS(main_cats); i++)
     {
-        mxc = xconf_new("menu", NULL);
+        mxc = xconf_new_in(a, "menu", NULL);
         xconf_append(xc, mxc);
 
         /* Add localised name node as child of the category menu. */
-        tmp = xconf_new("name", _(main_cats[i].local_name));
+        tmp = xconf_new_in(a, "name", _(main_cats[i].local_name));
         xconf_append(mxc, tmp);
 
         /* Add icon node for the category. */
-        tmp = xconf_new("icon", main_cats[i].icon);
+        tmp = xconf_new_in(a, "icon", main_cats[i].icon);
         xconf_append(mxc, tmp);
 
         /* Register this category xconf node in the lookup table. */
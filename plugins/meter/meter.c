@@ -16,11 +16,22 @@
  * where round() uses roundf() from <math.h> (declared but not #included here;
  * the declaration is provided inline -- see BUG below).
  *
+ * ICON SET CACHE
+ * --------------
+ * set_icons() does not just remember the names: every icon of the set is
+ * rendered once at the meter's size into a meter_icon_set, which is shared
+ * through a refcounted, process-wide hash table by all meters asking for
+ * the same names at the same size.  set_level() then only swaps the pixbuf
+ * shown by the GtkImage -- scrolling the volume costs no stat(), icon cache
+ * lookup or SVG rasterisation.
+ *
  * ICON THEME CHANGE HANDLING
  * --------------------------
- * When the GTK icon theme changes (global icon_theme "changed" signal), the
- * update_view() function forces a reload of the current icon by resetting
- * cur_icon to -1 and calling meter_set_level() with the existing level.
+ * The cache connects one handler to the global icon_theme "changed" signal
+ * that re-renders every cached set.  Each meter's update_view() is connected
+ * *after* it (G_CONNECT_AFTER), so by the time it forces a redisplay by
+ * resetting cur_icon to -1 and calling meter_set_level(), the set already
+ * holds the new theme's pixbufs.
  *
  * PUBLIC API (through meter_class vtable)
  * ----------------------------------------
@@ -31,6 +42,8 @@
  * exported via the class vtable.
  */
 
+#include <string.h>
+
 #include "plugin.h"
 #include "panel.h"
 #include "meter.h"
@@ -48,11 +61,141 @@
  */
 float roundf(float x);
 
+/*
+ * icon_sets -- process-wide cache of meter_icon_set, keyed by set->key.
+ * Created with the first set, destroyed with the last one.
+ */
+static GHashTable *icon_sets;
+
+/* Handler ID of icon_sets_theme_changed() on icon_theme "changed". */
+static gulong icon_sets_itc_id;
+
+/*
+ * icon_set_load -- (re)render every icon of @set from the current theme.
+ *
+ * Icons come from the shared fb_pixbuf_new() cache, so sets that overlap
+ * (or other widgets showing the same icon) rasterise it once; that cache
+ * is flushed before this runs on a theme change.
+ * Drops pixbufs from a previous load first.  Icons that fail to load leave
+ * a NULL entry, which set_level() shows as a blank image.
+ */
+static void
+icon_set_load(meter_icon_set *set)
+{
+    int i;
+
+    for (i = 0; i < set->num; i++)
+    {
+        if (set->pixbufs[i])
+            g_object_unref(G_OBJECT(set->pixbufs[i]));
+        set->pixbufs[i] = fb_pixbuf_new(set->names[i], NULL, set->size,
+            set->size, FALSE);
+        DBG("loading icon '%s' %s\n", set->names[i],
+            set->pixbufs[i] ? "ok" : "failed");
+    }
+}
+
+/*
+ * icon_sets_theme_changed -- icon_theme "changed" handler of the cache.
+ *
+ * Runs before every meter's update_view() (those are connected AFTER), so
+ * meters redisplay from freshly rendered sets.
+ */
+static void
+icon_sets_theme_changed(GtkIconTheme *theme, gpointer data)
+{
+    GHashTableIter iter;
+    gpointer set;
+
+    ENTER;
+    g_hash_table_iter_init(&iter, icon_sets);
+    while (g_hash_table_iter_next(&iter, NULL, &set))
+        icon_set_load(set);
+    RET();
+}
+
+/*
+ * icon_set_get -- return a referenced icon set for @icons at @size.
+ *
+ * Looks the set up in the shared cache and loads it on a miss.
+ *
+ * Parameters:
+ *   icons -- NULL-terminated icon-name array (copied on a miss).
+ *   size  -- icon size in pixels.
+ *
+ * Returns: the set with its refcount incremented; release with icon_set_put().
+ */
+static meter_icon_set *
+icon_set_get(gchar **icons, gint size)
+{
+    meter_icon_set *set;
+    gchar *names, *key;
+
+    ENTER;
+    names = g_strjoinv("\n", icons);
+    key = g_strdup_printf("%d\n%s", size, names);
+    g_free(names);
+    if (!icon_sets)
+    {
+        icon_sets = g_hash_table_new(g_str_hash, g_str_equal);
+        icon_sets_itc_id = g_signal_connect(G_OBJECT(icon_theme), "changed",
+            G_CALLBACK(icon_sets_theme_changed), NULL);
+    }
+    else if ((set = g_hash_table_lookup(icon_sets, key)))
+    {
+        g_free(key);
+        set->refcount++;
+        RET(set);
+    }
+    set = g_new0(meter_icon_set, 1);
+    set->key = key;
+    set->names = g_strdupv(icons);
+    set->num = g_strv_length(icons);
+    set->size = size;
+    set->pixbufs = g_new0(GdkPixbuf *, set->num);
+    set->refcount = 1;
+    icon_set_load(set);
+    g_hash_table_insert(icon_sets, set->key, set);
+    DBG("new icon set %d icons at %dpx\n", set->num, size);
+    RET(set);
+}
+
+/*
+ * icon_set_put -- drop one reference to @set; free it with the last one.
+ *
+ * When the cache becomes empty its theme handler is disconnected and the
+ * table destroyed, so an unused meter plugin holds no pixbufs.
+ */
+static void
+icon_set_put(meter_icon_set *set)
+{
+    int i;
+
+    ENTER;
+    if (--set->refcount > 0)
+        RET();
+    g_hash_table_remove(icon_sets, set->key);
+    for (i = 0; i < set->num; i++)
+        if (set->pixbufs[i])
+            g_object_unref(G_OBJECT(set->pixbufs[i]));
+    g_free(set->pixbufs);
+    g_strfreev(set->names);
+    g_free(set->key);
+    g_free(set);
+    if (!g_hash_table_size(icon_sets))
+    {
+        g_signal_handler_disconnect(G_OBJECT(icon_theme), icon_sets_itc_id);
+        g_hash_table_destroy(icon_sets);
+        icon_sets = NULL;
+    }
+    RET();
+}
+
 /*
  * meter_set_level -- update the meter's displayed level.
  *
  * Maps @level (0..100) to an index into m->icons[] using rounding, then
- * loads and displays the corresponding icon from the GTK icon theme.
+ * displays the corresponding preloaded pixbuf of m->set.
  * If the computed icon index equals the currently displayed one, the
  * function returns early without touching the GtkImage.
  *
@@ -64,15 +207,13 @@ float roundf(float x);
  *
  * Side effects:
  *   - Updates m->cur_icon and m->level.
- *   - Calls gtk_image_set_from_pixbuf() to refresh the widget.
- *   - Loads an icon from icon_theme; if loading fails, the image is set to
- *     NULL (blank / empty image).
+ *   - Calls gtk_image_set_from_pixbuf() to refresh the widget.  No icon is
+ *     loaded here; if the icon failed to load when the set was rendered,
+ *     the image is set to NULL (blank / empty image).
  *
  * Memory notes:
- *   - The GdkPixbuf `pb` returned by gtk_icon_theme_load_icon() is owned by
- *     the caller; after being set on the GtkImage (which takes a reference),
- *     pb is unreferenced here.  If pb is NULL (icon load failure), the
- *     gtk_image_set_from_pixbuf(NULL) call clears the image.
+ *   - The pixbuf is owned by the shared icon set; the GtkImage takes its
+ *     own reference.
  *
  * BUG: m->level is declared as gfloat but @level is an int.  The no-change
  *      check "m->level == level" compares a float to an int via implicit
@@ -90,7 +231,6 @@ static void
 meter_set_level(meter_priv *m, int level)
 {
     int i;
-    GdkPixbuf *pb;
 
     ENTER;
     /* Early exit if the level is unchanged AND the icon cache is still valid.
@@ -117,14 +257,8 @@ meter_set_level(meter_priv *m, int level)
 
     if (i != m->cur_icon) {
         m->cur_icon = i;
-        /* Load the icon at the required size from the current theme. */
-        pb = gtk_icon_theme_load_icon(icon_theme, m->icons[i],
-            m->size, GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
-        DBG("loading icon '%s' %s\n", m->icons[i], pb ? "ok" : "failed");
-        /* Update the GtkImage; passing NULL clears the image. */
-        gtk_image_set_from_pixbuf(GTK_IMAGE(m->meter), pb);
-        if (pb)
-            g_object_unref(G_OBJECT(pb)); /* release our reference */
+        /* Pointer swap to the preloaded pixbuf; NULL clears the image. */
+        gtk_image_set_from_pixbuf(GTK_IMAGE(m->meter), m->set->pixbufs[i]);
     }
     m->level = level; /* record new level (stored as gfloat from int) */
     RET();
@@ -137,6 +271,10 @@ meter_set_level(meter_priv *m, int level)
  * current-icon tracking state to force a full redraw on the next
  * set_level() call regardless of the current level.
  *
+ * The matching pixbuf set is taken from the sets this meter already holds
+ * or, failing that, from the shared cache (rendering it on a miss), so
+ * flipping between a client's icon arrays never touches the icon theme.
+ *
  * Parameters:
  *   m     -- the meter_priv instance to configure.
  *   icons -- NULL-terminated array of GTK icon-theme name strings.
@@ -147,7 +285,8 @@ meter_set_level(meter_priv *m, int level)
  * Returns: void.
  *
  * Side effects:
- *   Sets m->num, m->icons, m->cur_icon (-1), m->level (-1).
+ *   Sets m->num, m->icons, m->set, m->cur_icon (-1), m->level (-1).
+ *   May add a set reference to m->sets.
  *
  * Memory note:
  *   The old m->icons array is NOT freed here (it is not owned by meter_priv).
@@ -164,6 +303,9 @@ static void
 meter_set_icons(meter_priv *m, gchar **icons)
 {
     gchar **s;
+    GSList *l;
+    meter_icon_set *set;
+    int i;
 
     ENTER;
     /* No-op if the exact same array pointer is already registered. */
@@ -176,6 +318,24 @@ meter_set_icons(meter_priv *m, gchar **icons)
     m->num = (s - icons); /* number of non-NULL entries */
     DBG("total %d icons\n", m->num);
 
+    /* Reuse a set this meter already holds, else get one from the cache. */
+    for (l = m->sets; l; l = g_slist_next(l))
+    {
+        set = l->data;
+        if (set->num != m->num)
+            continue;
+        for (i = 0; i < set->num && !strcmp(set->names[i], icons[i]); i++);
+        if (i == set->num)
+            break;
+    }
+    if (l)
+        m->set = l->data;
+    else
+    {
+        m->set = icon_set_get(icons, m->size);
+        m->sets = g_slist_prepend(m->sets, m->set);
+    }
+
     m->icons = icons;    /* store non-owning pointer */
     m->cur_icon = -1;    /* force icon reload on next set_level() */
     m->level = -1;       /* mark level as unset so any value triggers redraw */
@@ -185,9 +345,9 @@ meter_set_icons(meter_priv *m, gchar **icons)
 /*
  * update_view -- force a redisplay of the current icon after a theme change.
  *
- * Connected to the global icon_theme "changed" signal.  Resets m->cur_icon
- * to -1 so that meter_set_level() will reload the icon from the new theme
- * even if the level value has not changed.
+ * Connected AFTER the icon-set cache's handler to the global icon_theme
+ * "changed" signal.  Resets m->cur_icon to -1 so that meter_set_level()
+ * shows the re-rendered pixbuf even if the level value has not changed.
  *
  * Parameters:
  *   m -- the meter_priv instance (passed as gpointer by GLib signal machinery).
@@ -244,9 +404,11 @@ meter_constructor(plugin_instance *p)
     /* Use panel's icon height as the target icon size. */
     m->size = p->panel->max_elem_height;
 
-    /* Reload the icon whenever the user switches GTK icon themes. */
-    m->itc_id = g_signal_connect_swapped(G_OBJECT(icon_theme),
-        "changed", (GCallback) update_view, m);
+    /* Redisplay whenever the user switches GTK icon themes.  Connected
+     * AFTER so the shared icon sets have been re-rendered by then. */
+    m->itc_id = g_signal_connect_data(G_OBJECT(icon_theme),
+        "changed", (GCallback) update_view, m, NULL,
+        G_CONNECT_SWAPPED | G_CONNECT_AFTER);
     RET(1);
 }
 
@@ -262,6 +424,7 @@ meter_constructor(plugin_instance *p)
  *
  * Side effects:
  *   Disconnects icon_theme "changed" signal using stored m->itc_id.
+ *   Drops this meter's references to the shared icon sets.
  *
  * FIXME: m->icons is not freed here, which is correct only if the client
  *        plugin frees it separately.  There is no documented contract forcing
@@ -275,6 +438,11 @@ meter_destructor(plugin_instance *p)
     ENTER;
     /* Disconnect the icon-theme-changed handler to prevent calls after teardown. */
     g_signal_handler_disconnect(G_OBJECT(icon_theme), m->itc_id);
+    /* Release shared icon sets; the last user frees the pixbufs. */
+    g_slist_foreach(m->sets, (GFunc) icon_set_put, NULL);
+    g_slist_free(m->sets);
+    m->sets = NULL;
+    m->set = NULL;
     RET();
 }
 
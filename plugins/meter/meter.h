@@ -32,8 +32,10 @@
  *
  * KEY DATA STRUCTURES
  * -------------------
- *   meter_priv  -- per-instance state (icon cache, current level, etc.)
- *   meter_class -- per-type vtable with set_level / set_icons ops
+ *   meter_icon_set -- preloaded pixbufs for one (icon names, size) pair,
+ *                     shared by every meter that uses the same set
+ *   meter_priv     -- per-instance state (icon cache, current level, etc.)
+ *   meter_class    -- per-type vtable with set_level / set_icons ops
  */
 
 #ifndef meter_H
@@ -42,6 +44,32 @@
 #include "plugin.h"   /* plugin_instance, plugin_class */
 #include "panel.h"    /* panel struct, icon_theme global */
 
+/*
+ * meter_icon_set -- one fully loaded icon set, shared between meters.
+ *
+ * All icons of a set are rendered once at `size` pixels when the set is
+ * first requested and kept as pixbufs, so a level change is a pointer swap
+ * on the GtkImage.  Sets live in a process-wide hash table keyed by `key`
+ * and are refcounted by the meters using them; they are re-rendered only
+ * when the icon theme changes.
+ *
+ * Fields:
+ *   key      -- hash key: size and icon names; g_malloc'd.
+ *   names    -- private copy of the icon names (g_strdupv).
+ *   num      -- number of icons in the set.
+ *   size     -- icon size in pixels.
+ *   pixbufs  -- num pixbufs (an entry is NULL if its icon failed to load).
+ *   refcount -- number of meter_priv references.
+ */
+typedef struct {
+    gchar *key;
+    gchar **names;
+    gint num;
+    gint size;
+    GdkPixbuf **pixbufs;
+    gint refcount;
+} meter_icon_set;
+
 /*
  * meter_priv -- per-instance private state for the meter plugin.
  *
@@ -58,6 +86,8 @@
  *               (the parent container destroys it).
  *   itc_id   -- GLib signal handler ID connecting icon_theme "changed" to
  *               update_view().  Disconnected in meter_destructor().
+ *   set/sets -- shared icon sets; one reference per entry of `sets`,
+ *               dropped in meter_destructor().
  */
 typedef struct {
     /* Base class -- MUST be first field (fbpanel casting convention). */
@@ -91,9 +121,18 @@ typedef struct {
     gint cur_icon;
 
     /* Icon size in pixels, taken from panel->max_elem_height at construction.
-     * Used in the gtk_icon_theme_load_icon() call inside meter_set_level(). */
+     * Part of the key of the shared icon sets requested by meter_set_icons(). */
     gint size;
 
+    /* Icon set currently displayed; one of the entries of `sets`. */
+    meter_icon_set *set;
+
+    /* Every icon set this meter has been given (GSList of meter_icon_set*),
+     * each holding one reference.  Clients flip between a few sets
+     * (charging / discharging, muted / unmuted), so keeping them avoids
+     * re-rendering on every flip. */
+    GSList *sets;
+
     /* GLib signal handler ID for the icon-theme "changed" connection.
      * Stored so meter_destructor() can disconnect it cleanly via
      * g_signal_handler_disconnect(). */
@@ -124,8 +163,8 @@ typedef struct {
      * Behaviour:
      *   - If val equals the current level, the call is a no-op.
      *   - Maps val to an icon index: round(val/100 * (num-1)).
-     *   - Loads the icon from the GTK icon theme at m->size pixels.
-     *   - If the icon load fails, the GtkImage is set to NULL (blank).
+     *   - Shows the preloaded pixbuf for that index (no theme lookup).
+     *   - If the icon failed to load, the GtkImage is set to NULL (blank).
      *
      * Thread safety: must be called from the GLib main thread.
      */
@@ -143,6 +182,7 @@ typedef struct {
      *
      * Behaviour:
      *   - Records the pointer and counts the elements.
+     *   - Looks up (or loads) the shared pixbuf set for these names.
      *   - Resets cur_icon to -1 and level to -1 to force a full redraw on
      *     the next set_level() call.
      *   - If icons == m->icons (same pointer), the call is a no-op.
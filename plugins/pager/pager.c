@@ -53,6 +53,7 @@
 #include "plugin.h"
 #include "data/images/default.xpm"
 #include "gtkbgbox.h"
+#include "probe.h"
 
 //#define DEBUGPRN
 #include "dbg.h"
@@ -127,7 +128,8 @@ struct _desk {
  * curdesk    - current desktop index.
  * wallpaper  - non-zero if root pixmap should be shown in thumbnails.
  * ratio      - screen_width / screen_height (used to size thumbnails).
- * wins       - XFree-able window list from _NET_CLIENT_LIST_STACKING.
+ * wins       - _NET_CLIENT_LIST_STACKING, borrowed from the FbEv cache;
+ *              valid until the next "client_list_stacking" signal.
  * winnum     - number of entries in wins.
  * dirty      - unused (kept for potential future use).
  * htable     - GHashTable mapping Window → task*.
@@ -1095,14 +1097,14 @@ get_wm_icon(Window tkwin, int iw, int ih)
 static void
 do_net_active_window(FbEv *ev, pager_priv *p)
 {
-    Window *fwin;
+    Window fwin;
     task *t;
 
     ENTER;
-    fwin = get_xaproperty(GDK_ROOT_WINDOW(), a_NET_ACTIVE_WINDOW, XA_WINDOW, 0);
-    DBG("win=%lx\n", fwin ? *fwin : 0);
-    if (fwin) {
-        t = g_hash_table_lookup(p->htable, fwin);
+    fwin = fb_ev_active_window(fbev);
+    DBG("win=%lx\n", fwin);
+    if (fwin != None) {
+        t = g_hash_table_lookup(p->htable, &fwin);
         if (t != p->focusedtask) {
             if (p->focusedtask)
                 desk_set_dirty_by_win(p, p->focusedtask);   /* redraw old focus */
@@ -1110,7 +1112,6 @@ do_net_active_window(FbEv *ev, pager_priv *p)
             if (t)
                 desk_set_dirty_by_win(p, t);                /* redraw new focus */
         }
-        XFree(fwin);
     } else {
         if (p->focusedtask) {
             desk_set_dirty_by_win(p, p->focusedtask);
@@ -1156,10 +1157,8 @@ do_net_client_list_stacking(FbEv *ev, pager_priv *p)
     task *t;
 
     ENTER;
-    if (p->wins)
-        XFree(p->wins);
-    p->wins = get_xaproperty (GDK_ROOT_WINDOW(), a_NET_CLIENT_LIST_STACKING,
-          XA_WINDOW, &p->winnum);
+    /* shared with the other pagers of the process */
+    p->wins = fb_ev_client_list_stacking(fbev, &p->winnum);
     if (!p->wins || !p->winnum)
         RET();
 
@@ -1194,6 +1193,7 @@ do_net_client_list_stacking(FbEv *ev, pager_priv *p)
     }
     /* remove windows that are no longer in the stacking list */
     g_hash_table_foreach_remove(p->htable, (GHRFunc) task_remove_stale, (gpointer)p);
+    FB_PROBE("pager.stacking", None);
     RET();
 }
 
@@ -1255,6 +1255,8 @@ pager_propertynotify(pager_priv *p, XEvent *ev)
         RET();
     }
     desk_set_dirty_by_win(p, t);
+    if (at == a_NET_WM_DESKTOP)
+        FB_PROBE("pager.desktop", win);
     RET();
 }
 
@@ -1472,8 +1474,6 @@ pager_destructor(plugin_instance *p)
     }
     if (pg->gen_pixbuf)
         g_object_unref(pg->gen_pixbuf);
-    if (pg->wins)
-        XFree(pg->wins);   /* free window list from _NET_CLIENT_LIST_STACKING */
     RET();
 }
 
@@ -12,18 +12,51 @@
  *   FbEv signals: current_desktop, active_window, number_of_desktops,
  *                 client_list, desktop_names.
  *   GDK filter: tb_event_filter() handles PropertyNotify on client windows
- *     (window name, icon, state, type, desktop, urgency changes).
+ *     (window name, icon, state, type, desktop, urgency changes) and the
+ *     startup-notification messages on the root window.
  *
  * Rendering:
- *   Each task has a GtkButton containing an image and (optionally) a label.
+ *   Task buttons (GtkButton containing an image and optionally a label) are
+ *   kept in a pool (tb->pool) and bound to the tasks that are currently
+ *   shown; tb_display() walks the tasks in order and rebinds only the
+ *   buttons whose task changed.  Tasks that are not shown (other desktop,
+ *   filtered, or beyond the capacity) own no widget.
  *   The GtkBar widget lays buttons in a grid; taskbar_size_alloc recomputes
  *   the number of rows/columns when the widget is resized.
  *
+ * Desktop index:
+ *   Besides tb->tasks, every task sits in the list of its desktop
+ *   (tb->desk_tasks) or in tb->sticky, kept in tb->tasks order by a
+ *   sequence number and moved on _NET_WM_DESKTOP.  tb_display() merges the
+ *   current desktop's list with the sticky one (and, grouped, collects the
+ *   groups of the windows found there), so a desktop switch only looks at
+ *   the windows of the incoming desktop; the rebinding is done under one
+ *   freeze of the bar's window so it is painted once.
+ *
+ * Grouping (groupedtasks = true):
+ *   Windows sharing WM_CLASS are collapsed into one tkgroup shown on one
+ *   button, with a count badge when it stands for several windows.  The
+ *   group icon is fetched once and shared by all members; urgency and
+ *   focus are tracked per group incrementally (nurgent, active).  Clicking
+ *   a group of several windows pops up a list of them.
+ *
+ * Virtualisation (mintaskwidth > 0):
+ *   Only as many buttons as fit in the allocation at mintaskwidth pixels
+ *   each are shown; the remaining tasks are listed in a popup behind an
+ *   overflow ("+N") button.  The popup is built when it is opened.
+ *
  * Urgency (XUrgencyHint):
  *   When a window sets the urgency hint, tk_flash_window() starts a timeout
  *   that alternates the button's state between GTK_STATE_SELECTED and
  *   normal, creating a flashing effect.
  *
+ * Launch feedback:
+ *   The "new:" and "remove:" startup-notification messages
+ *   (_NET_STARTUP_INFO_BEGIN/_NET_STARTUP_INFO, sent by fbpanel's own
+ *   launchers and by other launchers) are reassembled per source window;
+ *   while any sequence is open the taskbar shows a busy cursor.  A sequence
+ *   the application never completes is dropped after TB_SN_TIMEOUT seconds.
+ *
  * Mouse behaviour:
  *   LMB release: raise (or iconify if already focused).
  *   MMB: toggle shaded.
@@ -58,6 +91,7 @@
 #include "plugin.h"
 #include "data/images/default.xpm"
 #include "gtkbar.h"
+#include "probe.h"
 
 //#define DEBUGPRN
 #include "dbg.h"
@@ -71,11 +105,11 @@ struct _taskbar;
  * win            - X11 Window ID.
  * name           - window title with leading/trailing space " title ".
  * iname          - iconified title "[title]".
- * button         - GtkButton widget representing this task.
- * label          - GtkLabel inside button (only if !icons_only).
- * eb             - unused (reserved for event box).
- * image          - GtkImage showing the task icon.
+ * btn            - pooled button currently bound to this task, or NULL
+ *                  when the task is not shown (always NULL when grouped).
+ * grp            - group this task belongs to (groupedtasks only).
  * pixbuf         - task icon pixbuf (always non-NULL after tk_build_gui).
+ * seq            - creation order; sorts the per-desktop lists.
  * refcount       - stale-task detection counter.
  * ch             - XClassHint (unused currently).
  * pos_x,width    - not used for layout (GtkBar handles that).
@@ -94,9 +128,10 @@ typedef struct _task{
     struct _taskbar *tb;
     Window win;
     char *name, *iname;
-    GtkWidget *button, *label, *eb;
-    GtkWidget *image;
+    struct _tkbtn *btn;
+    struct _tkgroup *grp;
     GdkPixbuf *pixbuf;
+    guint seq;
 
     int refcount;
     XClassHint ch;
@@ -114,13 +149,64 @@ typedef struct _task{
     unsigned int flash_state:1;
 } task;
 
+/*
+ * tkgroup -- windows sharing one WM_CLASS (groupedtasks mode).
+ *
+ * key           - WM_CLASS res_class; hash key in tb->group_list.
+ * members       - member tasks in order of appearance.
+ * pixbuf        - icon shared by all members (each member holds a ref).
+ * btn           - pooled button currently bound to this group, or NULL.
+ * active        - the focused member, or NULL.
+ * nurgent       - number of members with the urgency hint.
+ * flash_timeout - group flash timer; runs while nurgent > 0.
+ * seq           - seq of the first member; sorts groups in tb->groups order.
+ * stamp         - tb->collect_stamp of the last tb_collect that took it.
+ */
+typedef struct _tkgroup{
+    struct _taskbar *tb;
+    gchar *key;
+    GList *members;
+    GdkPixbuf *pixbuf;
+    struct _tkbtn *btn;
+    task *active;
+    int nurgent;
+    guint flash_timeout;
+    guint seq;
+    guint stamp;
+    unsigned int flash_state:1;
+} tkgroup;
+
+/*
+ * tkbtn -- one pooled task button.
+ *
+ * Buttons are created on demand, packed into the bar once and then reused:
+ * binding a button to another task only changes its label, icon, tooltip
+ * and state.  Signal handlers receive the tkbtn and act on its current
+ * task.
+ *
+ * tb     - back-pointer to taskbar_priv.
+ * tk     - task currently bound to this button, or NULL.
+ * grp    - group currently bound to this button, or NULL.
+ *          (both NULL: button hidden).
+ * button - the GtkButton.
+ * image  - GtkImage showing the task icon.
+ * badge  - member count of a group; hidden otherwise.
+ * label  - GtkLabel inside button (only if !icons_only).
+ */
+typedef struct _tkbtn{
+    struct _taskbar *tb;
+    task *tk;
+    tkgroup *grp;
+    GtkWidget *button, *image, *badge, *label;
+} tkbtn;
+
 
 
 /*
  * taskbar_priv -- private state for one taskbar plugin instance.
  *
  * plugin          - embedded plugin_instance (MUST be first).
- * wins            - XFree-able window list from _NET_CLIENT_LIST.
+ * wins            - _NET_CLIENT_LIST, borrowed from the FbEv cache (not freed here).
  * topxwin         - panel's top-level X11 Window ID (to detect own focus).
  * win_num         - number of entries in wins.
  * task_list       - GHashTable mapping Window → task*.
@@ -141,6 +227,23 @@ typedef struct _task{
  * use_mouse_wheel - if 1, scroll events map/iconify windows.
  * use_urgency_hint - if 1, flash urgent windows.
  * discard_release_event - set after Ctrl+RMB to eat the matching release.
+ * tasks           - all tasks in _NET_CLIENT_LIST order of appearance.
+ * pool            - GPtrArray of tkbtn; pool[i] is the i-th button of the bar.
+ * nshown          - pool[0 .. nshown-1] are bound and visible.
+ * more            - overflow button, shown while tasks do not fit.
+ * min_task_width  - mintaskwidth config; 0 disables virtualisation.
+ * capacity        - bar cells available (G_MAXUINT when not virtualised).
+ * grouped         - groupedtasks config.
+ * group_list      - GHashTable mapping WM_CLASS → tkgroup* (grouped only).
+ * groups          - groups in order of appearance (grouped only).
+ * next_seq        - seq of the next new task.
+ * collect_stamp   - bumped by every tb_collect (see tkgroup.stamp).
+ * desk_tasks      - GHashTable mapping desktop → GQueue of its tasks.
+ * sticky          - tasks shown on all desktops (desktop 0xFFFFFFFF).
+ * shown           - scratch array of what tb_display binds, in bar order.
+ * sn_partial      - GHashTable: source Window → GString of a startup
+ *                   message being reassembled.
+ * sn_seqs         - GHashTable: open startup sequence ID → timeout id.
  */
 typedef struct _taskbar{
     plugin_instance plugin;
@@ -181,6 +284,23 @@ typedef struct _taskbar{
     int use_urgency_hint;
     int discard_release_event;
     gboolean use_net_active;   /* TRUE if WM supports _NET_ACTIVE_WINDOW */
+
+    GList *tasks;
+    GPtrArray *pool;
+    guint nshown;
+    GtkWidget *more;
+    int min_task_width;
+    guint capacity;
+    int grouped;
+    GHashTable *group_list;
+    GList *groups;
+    guint next_seq;
+    guint collect_stamp;
+    GHashTable *desk_tasks;
+    GQueue sticky;
+    GPtrArray *shown;
+    GHashTable *sn_partial;
+    GHashTable *sn_seqs;
 } taskbar_priv;
 
 
@@ -205,7 +325,15 @@ static gchar *taskbar_rc = "style 'taskbar-style'\n"
 #define TASK_WIDTH_MAX   200   /* default maximum task button width in pixels */
 #define TASK_HEIGHT_MAX  28    /* hard cap on task button height */
 #define TASK_PADDING     4     /* unused; kept for reference */
+
+#define TB_SN_TIMEOUT    15    /* seconds a startup sequence may stay open */
+#define TB_SN_MSG_MAX    4096  /* longest startup message reassembled */
+#define TB_SN_SEQ_MAX    32    /* startup sequences tracked at once */
 static void tk_display(taskbar_priv *tb, task *tk);
+static void tb_display(taskbar_priv *tb);
+static void grp_refresh(tkgroup *grp);
+static void grp_flash(tkgroup *grp, int urgent);
+static void grp_del_task(task *tk);
 static void tb_propertynotify(taskbar_priv *tb, XEvent *ev);
 static GdkFilterReturn tb_event_filter( XEvent *, GdkEvent *, taskbar_priv *);
 static void taskbar_destructor(plugin_instance *p);
@@ -342,11 +470,17 @@ tk_set_names(task *tk)
     char *name;
 
     ENTER;
+    if (tk->grp) {
+        grp_refresh(tk->grp);
+        RET();
+    }
+    if (!tk->btn)
+        RET();   /* not shown; the button is labelled when bound */
     name = tk->iconified ? tk->iname : tk->name;
     if (!tk->tb->icons_only)
-        gtk_label_set_text(GTK_LABEL(tk->label), name);
+        gtk_label_set_text(GTK_LABEL(tk->btn->label), name);
     if (tk->tb->tooltips)
-        gtk_widget_set_tooltip_text(tk->button, tk->name);
+        gtk_widget_set_tooltip_text(tk->btn->button, tk->name);
     RET();
 }
 
@@ -365,11 +499,58 @@ find_task (taskbar_priv * tb, Window win)
 }
 
 
+/* List of the tasks of @desktop (tb->sticky for all desktops). */
+static GQueue *
+tb_desk_queue(taskbar_priv *tb, guint desktop)
+{
+    GQueue *q;
+
+    if (desktop == 0xFFFFFFFF)
+        return &tb->sticky;
+    q = g_hash_table_lookup(tb->desk_tasks, GUINT_TO_POINTER(desktop));
+    if (!q) {
+        q = g_queue_new();
+        g_hash_table_insert(tb->desk_tasks, GUINT_TO_POINTER(desktop), q);
+    }
+    return q;
+}
+
+static gint
+tk_seq_cmp(task *a, task *b, gpointer unused)
+{
+    return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+/*
+ * tk_desk_add -- index @tk under its desktop.
+ *
+ * New tasks have the highest seq and are appended; a task moved from
+ * another desktop is inserted at its place in tb->tasks order.
+ */
+static void
+tk_desk_add(taskbar_priv *tb, task *tk)
+{
+    GQueue *q = tb_desk_queue(tb, tk->desktop);
+    task *last = g_queue_peek_tail(q);
+
+    if (!last || last->seq < tk->seq)
+        g_queue_push_tail(q, tk);
+    else
+        g_queue_insert_sorted(q, tk, (GCompareDataFunc) tk_seq_cmp, NULL);
+}
+
+static void
+tk_desk_remove(taskbar_priv *tb, task *tk)
+{
+    g_queue_remove(tb_desk_queue(tb, tk->desktop), tk);
+}
+
 /*
  * del_task -- remove a task from the taskbar.
  *
- * Stops any flash timeout, destroys the button widget, frees names,
+ * Stops any flash timeout, returns the button to the pool, frees names,
  * clears focused pointer, and optionally removes from the hash table.
+ * The caller refreshes the bar with tb_display().
  *
  * Parameters:
  *   tb   - taskbar_priv.
@@ -383,11 +564,22 @@ del_task (taskbar_priv * tb, task *tk, int hdel)
     DBG("deleting(%d)  %08x %s\n", hdel, tk->win, tk->name);
     if (tk->flash_timeout)
         g_source_remove(tk->flash_timeout);   /* stop urgency flash timer */
-    gtk_widget_destroy(tk->button);
+    if (tk->btn) {
+        tk->btn->tk = NULL;   /* rebound or hidden by the next tb_display */
+        tk->btn = NULL;
+    }
+    if (tk->grp)
+        grp_del_task(tk);
+    tk_desk_remove(tb, tk);
+    tb->tasks = g_list_remove(tb->tasks, tk);
     tb->num_tasks--;
     tk_free_names(tk);
     if (tb->focused == tk)
         tb->focused = NULL;
+    if (tb->ptk == tk)
+        tb->ptk = NULL;
+    if (tb->menutask == tk)
+        tb->menutask = NULL;
     if (hdel)
         g_hash_table_remove(tb->task_list, &tk->win);
     g_free(tk);
@@ -786,9 +978,11 @@ static gboolean
 on_flash_win( task *tk )
 {
     tk->flash_state = !tk->flash_state;
-    gtk_widget_set_state(tk->button,
-          tk->flash_state ? GTK_STATE_SELECTED : tk->tb->normal_state);
-    gtk_widget_queue_draw(tk->button);
+    if (tk->btn) {
+        gtk_widget_set_state(tk->btn->button,
+              tk->flash_state ? GTK_STATE_SELECTED : tk->tb->normal_state);
+        gtk_widget_queue_draw(tk->btn->button);
+    }
     return TRUE;
 }
 
@@ -803,11 +997,19 @@ static void
 tk_flash_window( task *tk )
 {
     gint interval;
+
+    if (tk->grp) {
+        /* grouped: the group button flashes while any member is urgent */
+        if (!tk->flash)
+            grp_flash(tk->grp, 1);
+        tk->flash = 1;
+        return;
+    }
     tk->flash = 1;
     tk->flash_state = !tk->flash_state;
     if (tk->flash_timeout)
         return;   /* already flashing */
-    g_object_get( gtk_widget_get_settings(tk->button),
+    g_object_get( gtk_settings_get_default(),
           "gtk-cursor-blink-time", &interval, NULL );
     tk->flash_timeout = g_timeout_add(interval, (GSourceFunc)on_flash_win, tk);
 }
@@ -818,6 +1020,8 @@ tk_flash_window( task *tk )
 static void
 tk_unflash_window( task *tk )
 {
+    if (tk->grp && tk->flash)
+        grp_flash(tk->grp, 0);
     tk->flash = tk->flash_state = 0;
     if (tk->flash_timeout) {
         g_source_remove(tk->flash_timeout);
@@ -855,6 +1059,316 @@ tk_raise_window( task *tk, guint32 time )
     DBG("XRaiseWindow %x\n", tk->win);
 }
 
+/*****************************************************
+ * task groups (groupedtasks)                        *
+ *****************************************************/
+
+/* Number of members of @grp that pass task_visible(). */
+static int
+grp_nvisible(tkgroup *grp)
+{
+    GList *l;
+    int n = 0;
+
+    for (l = grp->members; l; l = l->next)
+        if (task_visible(grp->tb, l->data))
+            n++;
+    return n;
+}
+
+/*
+ * grp_task -- the member a group button acts on.
+ *
+ * The focused member if it is visible, else the first visible member,
+ * or NULL when no member is visible.
+ */
+static task *
+grp_task(tkgroup *grp)
+{
+    GList *l;
+
+    if (grp->active && task_visible(grp->tb, grp->active))
+        return grp->active;
+    for (l = grp->members; l; l = l->next)
+        if (task_visible(grp->tb, l->data))
+            return l->data;
+    return NULL;
+}
+
+/* Button state of @grp: flashing, focused or normal. */
+static GtkStateType
+grp_state(tkgroup *grp)
+{
+    if (grp->nurgent && grp->flash_state)
+        return GTK_STATE_SELECTED;
+    return grp->active ? grp->tb->focused_state : grp->tb->normal_state;
+}
+
+/*
+ * grp_refresh -- update the button of @grp (if it has one).
+ *
+ * A group showing one window looks like a plain task button; several
+ * windows show the class name and a count badge.
+ */
+static void
+grp_refresh(tkgroup *grp)
+{
+    taskbar_priv *tb = grp->tb;
+    tkbtn *b = grp->btn;
+    task *tk;
+    gchar *buf;
+    int n;
+
+    if (!b)
+        return;
+    n = grp_nvisible(grp);
+    tk = grp_task(grp);
+    gtk_image_set_from_pixbuf(GTK_IMAGE(b->image), grp->pixbuf);
+    if (n > 1) {
+        buf = g_strdup_printf("<small><b>%d</b></small>", n);
+        gtk_label_set_markup(GTK_LABEL(b->badge), buf);
+        g_free(buf);
+        gtk_widget_show(b->badge);
+        if (!tb->icons_only)
+            gtk_label_set_text(GTK_LABEL(b->label), grp->key);
+        if (tb->tooltips) {
+            buf = g_strdup_printf("%s (%d)", grp->key, n);
+            gtk_widget_set_tooltip_text(b->button, buf);
+            g_free(buf);
+        }
+    } else {
+        gtk_widget_hide(b->badge);
+        if (tk && !tb->icons_only)
+            gtk_label_set_text(GTK_LABEL(b->label),
+                tk->iconified ? tk->iname : tk->name);
+        if (tk && tb->tooltips)
+            gtk_widget_set_tooltip_text(b->button, tk->name);
+    }
+    gtk_widget_set_state(b->button, grp_state(grp));
+}
+
+/* Group flash timer: toggle the group button like on_flash_win(). */
+static gboolean
+grp_on_flash(tkgroup *grp)
+{
+    grp->flash_state = !grp->flash_state;
+    if (grp->btn) {
+        gtk_widget_set_state(grp->btn->button, grp_state(grp));
+        gtk_widget_queue_draw(grp->btn->button);
+    }
+    return TRUE;
+}
+
+/*
+ * grp_flash -- account for a member becoming urgent (@urgent = 1) or
+ * losing urgency (@urgent = 0).  The timer runs while nurgent > 0.
+ */
+static void
+grp_flash(tkgroup *grp, int urgent)
+{
+    gint interval;
+
+    if (urgent) {
+        if (grp->nurgent++)
+            return;
+        g_object_get(gtk_settings_get_default(),
+              "gtk-cursor-blink-time", &interval, NULL);
+        grp->flash_timeout = g_timeout_add(interval,
+            (GSourceFunc) grp_on_flash, grp);
+        return;
+    }
+    if (--grp->nurgent)
+        return;
+    g_source_remove(grp->flash_timeout);
+    grp->flash_timeout = 0;
+    grp->flash_state = 0;
+    if (grp->btn)
+        gtk_widget_set_state(grp->btn->button, grp_state(grp));
+}
+
+/*
+ * grp_add_task -- put a new task into the group of its WM_CLASS.
+ *
+ * The first member of a group fetches the icon; later members share it,
+ * so N windows of one application cost one icon fetch.
+ */
+static void
+grp_add_task(taskbar_priv *tb, task *tk)
+{
+    tkgroup *grp;
+    XClassHint ch;
+    gchar *key = NULL;
+
+    ENTER;
+    if (XGetClassHint(GDK_DISPLAY(), tk->win, &ch)) {
+        if (ch.res_class && *ch.res_class)
+            key = g_strdup(ch.res_class);
+        XFree(ch.res_name);
+        XFree(ch.res_class);
+    }
+    if (!key)   /* no class: a group of its own */
+        key = g_strdup_printf("0x%lx", tk->win);
+    if (!(grp = g_hash_table_lookup(tb->group_list, key))) {
+        grp = g_new0(tkgroup, 1);
+        grp->tb = tb;
+        grp->key = key;
+        grp->seq = tb->next_seq;   /* tk->seq, assigned by our caller */
+        tk_update_icon(tb, tk, None);
+        grp->pixbuf = g_object_ref(tk->pixbuf);
+        g_hash_table_insert(tb->group_list, grp->key, grp);
+        tb->groups = g_list_append(tb->groups, grp);
+    } else {
+        g_free(key);
+        tk->pixbuf = g_object_ref(grp->pixbuf);
+    }
+    grp->members = g_list_append(grp->members, tk);
+    tk->grp = grp;
+    RET();
+}
+
+/*
+ * grp_del_task -- remove a task from its group; the last member frees the
+ * group and releases its button.
+ */
+static void
+grp_del_task(task *tk)
+{
+    tkgroup *grp = tk->grp;
+    taskbar_priv *tb = grp->tb;
+
+    ENTER;
+    if (tk->flash)
+        grp_flash(grp, 0);
+    tk->flash = 0;
+    tk->grp = NULL;
+    grp->members = g_list_remove(grp->members, tk);
+    if (grp->active == tk)
+        grp->active = NULL;
+    if (grp->members) {
+        grp_refresh(grp);
+        RET();
+    }
+    if (grp->btn)
+        grp->btn->grp = NULL;   /* hidden by the next tb_display */
+    g_hash_table_remove(tb->group_list, grp->key);
+    tb->groups = g_list_remove(tb->groups, grp);
+    g_object_unref(grp->pixbuf);
+    g_free(grp->key);
+    g_free(grp);
+    RET();
+}
+
+/*
+ * grp_update_icon -- a member's icon property changed.
+ *
+ * Refetches the icon from that member and makes it the group icon for
+ * every member.
+ */
+static void
+grp_update_icon(taskbar_priv *tb, task *tk, Atom a)
+{
+    tkgroup *grp = tk->grp;
+    GList *l;
+    task *m;
+
+    ENTER;
+    tk_update_icon(tb, tk, a);
+    if (tk->pixbuf == grp->pixbuf)
+        RET();
+    g_object_unref(grp->pixbuf);
+    grp->pixbuf = g_object_ref(tk->pixbuf);
+    for (l = grp->members; l; l = l->next) {
+        m = l->data;
+        if (m == tk)
+            continue;
+        g_object_unref(m->pixbuf);
+        m->pixbuf = g_object_ref(grp->pixbuf);
+    }
+    grp_refresh(grp);
+    RET();
+}
+
+/*
+ * grp_item_activate -- group list / overflow item activated.
+ *
+ * Raises the window stored as "win" on the item; it may have gone away
+ * while the menu was open.
+ */
+static void
+grp_item_activate(GtkMenuItem *mi, taskbar_priv *tb)
+{
+    task *tk;
+
+    ENTER;
+    tk = find_task(tb, (Window) GPOINTER_TO_SIZE(
+        g_object_get_data(G_OBJECT(mi), "win")));
+    if (tk)
+        tk_raise_window(tk, gtk_get_current_event_time());
+    RET();
+}
+
+/*
+ * grp_popup -- pop up the list of the visible members of @grp.
+ *
+ * Built on demand and destroyed when closed.
+ */
+static void
+grp_popup(tkgroup *grp, GtkWidget *widget, GdkEventButton *event)
+{
+    GtkWidget *menu, *mi;
+    GdkPixbuf *pb;
+    GList *l;
+    task *tk;
+    gint w, h;
+
+    ENTER;
+    gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, &w, &h);
+    pb = gdk_pixbuf_scale_simple(grp->pixbuf, w, h, GDK_INTERP_BILINEAR);
+    menu = gtk_menu_new();
+    for (l = grp->members; l; l = l->next) {
+        tk = l->data;
+        if (!task_visible(grp->tb, tk))
+            continue;
+        mi = gtk_image_menu_item_new_with_label(
+            tk->name ? (tk->iconified ? tk->iname : tk->name) : "");
+        gtk_image_menu_item_set_image(GTK_IMAGE_MENU_ITEM(mi),
+            gtk_image_new_from_pixbuf(pb));
+        g_object_set_data(G_OBJECT(mi), "win", GSIZE_TO_POINTER(tk->win));
+        g_signal_connect(G_OBJECT(mi), "activate",
+            G_CALLBACK(grp_item_activate), grp->tb);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), mi);
+    }
+    g_object_unref(pb);
+    gtk_widget_show_all(menu);
+    g_signal_connect(G_OBJECT(menu), "selection-done",
+        G_CALLBACK(gtk_widget_destroy), NULL);
+    gtk_menu_popup(GTK_MENU(menu), NULL, NULL,
+        (GtkMenuPositionFunc) menu_pos, widget, event->button, event->time);
+    RET();
+}
+
+/*
+ * tkbtn_task -- the task a button acts on (see grp_task for groups).
+ */
+static task *
+tkbtn_task(tkbtn *b)
+{
+    if (b->grp)
+        return grp_task(b->grp);
+    return b->tk;
+}
+
+/* Button state of @b from its task's or group's focus (not flashing). */
+static GtkStateType
+tkbtn_state(tkbtn *b)
+{
+    if (b->grp)
+        return grp_state(b->grp);
+    if (b->tk)
+        return b->tk->focused ? b->tb->focused_state : b->tb->normal_state;
+    return b->tb->normal_state;
+}
+
 /*
  * tk_callback_leave/enter -- restore button state on pointer enter/leave.
  *
@@ -862,21 +1376,19 @@ tk_raise_window( task *tk, guint32 time )
  * focused_state or normal_state based on keyboard focus.
  */
 static void
-tk_callback_leave( GtkWidget *widget, task *tk)
+tk_callback_leave( GtkWidget *widget, tkbtn *b)
 {
     ENTER;
-    gtk_widget_set_state(widget,
-          (tk->focused) ? tk->tb->focused_state : tk->tb->normal_state);
+    gtk_widget_set_state(widget, tkbtn_state(b));
     RET();
 }
 
 
 static void
-tk_callback_enter( GtkWidget *widget, task *tk )
+tk_callback_enter( GtkWidget *widget, tkbtn *b )
 {
     ENTER;
-    gtk_widget_set_state(widget,
-          (tk->focused) ? tk->tb->focused_state : tk->tb->normal_state);
+    gtk_widget_set_state(widget, tkbtn_state(b));
     RET();
 }
 
@@ -904,10 +1416,12 @@ static gboolean
 tk_callback_drag_motion( GtkWidget *widget,
       GdkDragContext *drag_context,
       gint x, gint y,
-      guint time, task *tk)
+      guint time, tkbtn *b)
 {
+    task *tk = tkbtn_task(b);
+
     /* prevent excessive motion notification */
-    if (!tk->tb->dnd_activate) {
+    if (tk && !tk->tb->dnd_activate) {
         tk->tb->dnd_activate = g_timeout_add(DRAG_ACTIVE_DELAY,
               (GSourceFunc)delay_active_win, tk);
     }
@@ -921,11 +1435,11 @@ tk_callback_drag_motion( GtkWidget *widget,
 static void
 tk_callback_drag_leave (GtkWidget *widget,
       GdkDragContext *drag_context,
-      guint time, task *tk)
+      guint time, tkbtn *b)
 {
-    if (tk->tb->dnd_activate) {
-        g_source_remove(tk->tb->dnd_activate);
-        tk->tb->dnd_activate = 0;
+    if (b->tb->dnd_activate) {
+        g_source_remove(b->tb->dnd_activate);
+        b->tb->dnd_activate = 0;
     }
     return;
 }
@@ -938,9 +1452,13 @@ tk_callback_drag_leave (GtkWidget *widget,
  * Only active when use_mouse_wheel is set.
  */
 static gint
-tk_callback_scroll_event (GtkWidget *widget, GdkEventScroll *event, task *tk)
+tk_callback_scroll_event (GtkWidget *widget, GdkEventScroll *event, tkbtn *b)
 {
+    task *tk = tkbtn_task(b);
+
     ENTER;
+    if (!tk)
+        RET(FALSE);
     if (event->direction == GDK_SCROLL_UP) {
         GdkWindow *gdkwindow;
 
@@ -970,13 +1488,13 @@ tk_callback_scroll_event (GtkWidget *widget, GdkEventScroll *event, task *tk)
  */
 static gboolean
 tk_callback_button_press_event(GtkWidget *widget, GdkEventButton *event,
-    task *tk)
+    tkbtn *b)
 {
     ENTER;
     if (event->type == GDK_BUTTON_PRESS && event->button == 3
           && event->state & GDK_CONTROL_MASK) {
-        tk->tb->discard_release_event = 1;
-        gtk_propagate_event(tk->tb->bar, (GdkEvent *)event);
+        b->tb->discard_release_event = 1;
+        gtk_propagate_event(b->tb->bar, (GdkEvent *)event);
         RET(TRUE);
     }
     RET(FALSE);
@@ -994,16 +1512,25 @@ tk_callback_button_press_event(GtkWidget *widget, GdkEventButton *event,
  */
 static gboolean
 tk_callback_button_release_event(GtkWidget *widget, GdkEventButton *event,
-    task *tk)
+    tkbtn *b)
 {
+    task *tk = tkbtn_task(b);
+
     ENTER;
 
-    if (event->type == GDK_BUTTON_RELEASE && tk->tb->discard_release_event) {
-        tk->tb->discard_release_event = 0;
+    if (event->type == GDK_BUTTON_RELEASE && b->tb->discard_release_event) {
+        b->tb->discard_release_event = 0;
         RET(TRUE);   /* eat the Ctrl+RMB release */
     }
-    if ((event->type != GDK_BUTTON_RELEASE) || (!GTK_BUTTON(widget)->in_button))
+    if ((event->type != GDK_BUTTON_RELEASE) || (!GTK_BUTTON(widget)->in_button)
+        || !tk)
         RET(FALSE);
+    if (b->grp && event->button != 2 && grp_nvisible(b->grp) > 1) {
+        /* several windows behind this button: let the user pick one */
+        grp_popup(b->grp, widget, event);
+        gtk_button_released(GTK_BUTTON(widget));
+        RET(TRUE);
+    }
     DBG("win=%x\n", tk->win);
     if (event->button == 1) {
         if (tk->iconified)    {
@@ -1053,71 +1580,348 @@ tk_callback_button_release_event(GtkWidget *widget, GdkEventButton *event,
 
 
 /*
- * tk_update -- show or hide a task's button based on current visibility rules.
+ * tk_display -- refresh the state of a task's button after a focus change.
  *
- * Called from tb_display (via g_hash_table_foreach) and directly after
- * focus changes.  Sets button state to focused/normal and shows/hides it.
+ * Does nothing for tasks that are not shown.
  */
 static void
-tk_update(gpointer key, task *tk, taskbar_priv *tb)
+tk_display(taskbar_priv *tb, task *tk)
 {
-    ENTER;
-    g_assert ((tb != NULL) && (tk != NULL));
-    if (task_visible(tb, tk)) {
-        gtk_widget_set_state (tk->button,
-              (tk->focused) ? tb->focused_state : tb->normal_state);
-        gtk_widget_queue_draw(tk->button);
-        gtk_widget_show(tk->button);
+    tkgroup *grp = tk->grp;
 
-        if (tb->tooltips) {
-            gtk_widget_set_tooltip_text(tk->button, tk->name);
+    ENTER;
+    if (grp) {
+        if (tk->focused)
+            grp->active = tk;
+        else if (grp->active == tk)
+            grp->active = NULL;
+        if (grp->btn && !grp->nurgent) {
+            gtk_widget_set_state(grp->btn->button, grp_state(grp));
+            gtk_widget_queue_draw(grp->btn->button);
         }
         RET();
     }
-    gtk_widget_hide(tk->button);
+    if (!tk->btn || tk->flash)
+        RET();
+    gtk_widget_set_state(tk->btn->button,
+          (tk->focused) ? tb->focused_state : tb->normal_state);
+    gtk_widget_queue_draw(tk->btn->button);
     RET();
 }
 
 /*
- * tk_display -- refresh a single task's button visibility.
+ * tkbtn_new -- create a pooled task button and pack it into the bar.
+ *
+ * Builds: GtkButton → GtkHBox → GtkImage + badge GtkLabel [+ GtkLabel]
+ * The badge carries the window count of a group and is hidden otherwise.
+ * Connects button event handlers and sets up the DnD drag destination.
+ * The button is appended to tb->pool and stays hidden until bound.
  */
-static void
-tk_display(taskbar_priv *tb, task *tk)
+static tkbtn *
+tkbtn_new(taskbar_priv *tb)
 {
+    tkbtn *b;
+    GtkWidget *w1;
+
     ENTER;
-    tk_update(NULL, tk, tb);
-    RET();
+    b = g_new0(tkbtn, 1);
+    b->tb = tb;
+    b->button = gtk_button_new();
+    gtk_button_set_alignment(GTK_BUTTON(b->button), 0.5, 0.5);
+    gtk_container_set_border_width(GTK_CONTAINER(b->button), 0);
+    gtk_widget_add_events (b->button, GDK_BUTTON_RELEASE_MASK
+            | GDK_BUTTON_PRESS_MASK);
+    g_signal_connect(G_OBJECT(b->button), "button_release_event",
+          G_CALLBACK(tk_callback_button_release_event), (gpointer)b);
+    g_signal_connect(G_OBJECT(b->button), "button_press_event",
+           G_CALLBACK(tk_callback_button_press_event), (gpointer)b);
+    g_signal_connect_after (G_OBJECT (b->button), "leave",
+          G_CALLBACK (tk_callback_leave), (gpointer) b);
+    g_signal_connect_after (G_OBJECT (b->button), "enter",
+          G_CALLBACK (tk_callback_enter), (gpointer) b);
+    /* configure drag destination for drag-over window activation */
+    gtk_drag_dest_set( b->button, 0, NULL, 0, 0);
+    g_signal_connect (G_OBJECT (b->button), "drag-motion",
+          G_CALLBACK (tk_callback_drag_motion), (gpointer) b);
+    g_signal_connect (G_OBJECT (b->button), "drag-leave",
+          G_CALLBACK (tk_callback_drag_leave), (gpointer) b);
+    if (tb->use_mouse_wheel)
+        g_signal_connect_after(G_OBJECT(b->button), "scroll-event",
+              G_CALLBACK(tk_callback_scroll_event), (gpointer)b);
+
+    /* icon image + group count badge */
+    w1 = gtk_hbox_new(FALSE, 1);
+    gtk_container_set_border_width(GTK_CONTAINER(w1), 0);
+    b->image = gtk_image_new();
+    gtk_misc_set_alignment(GTK_MISC(b->image), 0.5, 0.5);
+    gtk_misc_set_padding(GTK_MISC(b->image), 0, 0);
+    gtk_box_pack_start(GTK_BOX(w1), b->image, tb->icons_only,
+        TRUE, 0);
+    b->badge = gtk_label_new(NULL);
+    gtk_widget_set_no_show_all(b->badge, TRUE);
+    gtk_box_pack_start(GTK_BOX(w1), b->badge, FALSE, FALSE, 0);
+
+    if (!tb->icons_only) {
+        /* icon + label layout */
+        b->label = gtk_label_new(NULL);
+        gtk_label_set_ellipsize(GTK_LABEL(b->label), PANGO_ELLIPSIZE_END);
+        gtk_misc_set_alignment(GTK_MISC(b->label), 0.0, 0.5);
+        gtk_misc_set_padding(GTK_MISC(b->label), 0, 0);
+        gtk_box_pack_start(GTK_BOX(w1), b->label, TRUE, TRUE, 0);
+    }
+
+    gtk_container_add (GTK_CONTAINER (b->button), w1);
+    gtk_widget_show_all(w1);
+    gtk_box_pack_start(GTK_BOX(tb->bar), b->button, FALSE, TRUE, 0);
+    /* keep the overflow button last */
+    gtk_box_reorder_child(GTK_BOX(tb->bar), tb->more, -1);
+    GTK_WIDGET_UNSET_FLAGS (b->button, GTK_CAN_FOCUS);
+    GTK_WIDGET_UNSET_FLAGS (b->button, GTK_CAN_DEFAULT);
+    g_ptr_array_add(tb->pool, b);
+    RET(b);
 }
 
 /*
- * tb_display -- refresh all task buttons.
+ * tkbtn_unbind -- detach whatever @b shows; its previous task or group is
+ * rebound or left buttonless by the caller.
+ */
+static void
+tkbtn_unbind(tkbtn *b)
+{
+    if (b->tk)
+        b->tk->btn = NULL;
+    if (b->grp)
+        b->grp->btn = NULL;
+    b->tk = NULL;
+    b->grp = NULL;
+}
+
+/*
+ * tkbtn_bind -- show task @tk on pooled button @b.
+ *
+ * Detaches @tk from its previous button and the previous task from @b
+ * (either will be rebound or hidden later in the same tb_display pass),
+ * then copies the task's icon, label, tooltip and state to the widgets.
+ * Does nothing if @b already shows @tk.
+ */
+static void
+tkbtn_bind(tkbtn *b, task *tk)
+{
+    taskbar_priv *tb = b->tb;
+
+    if (b->tk == tk)
+        return;
+    if (tk->btn)
+        tk->btn->tk = NULL;
+    tkbtn_unbind(b);
+    b->tk = tk;
+    tk->btn = b;
+    gtk_image_set_from_pixbuf(GTK_IMAGE(b->image), tk->pixbuf);
+    tk_set_names(tk);
+    gtk_widget_set_state(b->button,
+        (tk->flash && tk->flash_state) ? GTK_STATE_SELECTED
+        : (tk->focused) ? tb->focused_state : tb->normal_state);
+    gtk_widget_show(b->button);
+}
+
+/*
+ * tkbtn_bind_group -- show group @grp on pooled button @b (see tkbtn_bind).
+ */
+static void
+tkbtn_bind_group(tkbtn *b, tkgroup *grp)
+{
+    if (b->grp == grp)
+        return;
+    if (grp->btn)
+        grp->btn->grp = NULL;
+    tkbtn_unbind(b);
+    b->grp = grp;
+    grp->btn = b;
+    grp_refresh(grp);
+    gtk_widget_show(b->button);
+}
+
+static gint
+grp_seq_cmp(gconstpointer a, gconstpointer b)
+{
+    const tkgroup *ga = *(tkgroup * const *) a, *gb = *(tkgroup * const *) b;
+
+    return (ga->seq > gb->seq) - (ga->seq < gb->seq);
+}
+
+/*
+ * tb_collect -- fill tb->shown with what gets a button, in bar order.
+ *
+ * Unless showalldesks is set, only the current desktop's list and the
+ * sticky list are walked, merged by seq.  With groupedtasks the groups of
+ * the visible tasks found that way are collected instead, each once, and
+ * sorted back into tb->groups order; groups with no window on the current
+ * desktop are not looked at.
+ */
+static void
+tb_collect(taskbar_priv *tb)
+{
+    GQueue *q;
+    GList *a, *s, *l;
+    task *tk;
+
+    g_ptr_array_set_size(tb->shown, 0);
+    if (tb->show_all_desks) {
+        if (tb->grouped) {
+            for (l = tb->groups; l; l = l->next)
+                if (grp_nvisible(l->data))
+                    g_ptr_array_add(tb->shown, l->data);
+        } else {
+            for (l = tb->tasks; l; l = l->next)
+                if (task_visible(tb, l->data))
+                    g_ptr_array_add(tb->shown, l->data);
+        }
+        return;
+    }
+    tb->collect_stamp++;
+    q = g_hash_table_lookup(tb->desk_tasks, GUINT_TO_POINTER(tb->cur_desk));
+    a = q ? q->head : NULL;
+    s = tb->sticky.head;
+    while (a || s) {
+        if (!s || (a && ((task *) a->data)->seq < ((task *) s->data)->seq)) {
+            tk = a->data;
+            a = a->next;
+        } else {
+            tk = s->data;
+            s = s->next;
+        }
+        if (!task_visible(tb, tk))
+            continue;
+        if (!tb->grouped)
+            g_ptr_array_add(tb->shown, tk);
+        else if (tk->grp->stamp != tb->collect_stamp) {
+            tk->grp->stamp = tb->collect_stamp;
+            g_ptr_array_add(tb->shown, tk->grp);
+        }
+    }
+    if (tb->grouped)
+        g_ptr_array_sort(tb->shown, grp_seq_cmp);
+}
+
+/*
+ * tb_display -- bind the pool to the tasks that are shown.
+ *
+ * Assigns the entries collected by tb_collect() to pool[0], pool[1], ...
+ * When they exceed tb->capacity, one cell is left for the overflow button
+ * and the remaining entries get no button.  Only buttons whose task
+ * changes are touched; spare buttons are hidden and kept for reuse.  The
+ * whole pass runs with the bar's window updates frozen, so a desktop
+ * switch is painted once rather than per button.  The freeze does not
+ * cover layout: each rebind only queues a resize, and GTK runs the queued
+ * resizes together once control returns to the main loop.
  */
 static void
 tb_display(taskbar_priv *tb)
 {
+    GdkWindow *win = NULL;
+    tkbtn *b;
+    guint nvis, nshow, i;
+    gchar *buf;
+
     ENTER;
-    if (tb->wins)
-        g_hash_table_foreach(tb->task_list, (GHFunc) tk_update, (gpointer) tb);
+    tb_collect(tb);
+    nvis = tb->shown->len;
+    nshow = nvis;
+    if (nvis > tb->capacity)
+        nshow = MAX(tb->capacity, 2) - 1;   /* room for the overflow button */
+
+    if (GTK_WIDGET_REALIZED(tb->bar)) {
+        win = tb->bar->window;
+        gdk_window_freeze_updates(win);
+    }
+    for (i = 0; i < nshow; i++) {
+        b = (i < tb->pool->len) ? g_ptr_array_index(tb->pool, i)
+            : tkbtn_new(tb);
+        if (tb->grouped) {
+            tkbtn_bind_group(b, g_ptr_array_index(tb->shown, i));
+            grp_refresh(b->grp);   /* member visibility may have changed */
+        } else
+            tkbtn_bind(b, g_ptr_array_index(tb->shown, i));
+    }
+    /* buttons past nshow that were shown last time are released */
+    for (; i < tb->nshown; i++) {
+        b = g_ptr_array_index(tb->pool, i);
+        tkbtn_unbind(b);
+        gtk_widget_hide(b->button);
+    }
+    tb->nshown = nshow;
+
+    if (nshow < nvis) {
+        buf = g_strdup_printf("+%u", nvis - nshow);
+        gtk_button_set_label(GTK_BUTTON(tb->more), buf);
+        g_free(buf);
+        gtk_widget_show(tb->more);
+    } else
+        gtk_widget_hide(tb->more);
+    if (win)
+        gdk_window_thaw_updates(win);
     RET();
+}
 
+/*
+ * tb_more_clicked -- overflow button handler.
+ *
+ * Pops up a menu of the visible tasks that have no button.  It is built
+ * when opened and destroyed when closed; GtkMenu scrolls when it is
+ * taller than the screen.
+ */
+static gboolean
+tb_more_clicked(GtkWidget *widget, GdkEventButton *event, taskbar_priv *tb)
+{
+    GtkWidget *menu, *mi;
+    GdkPixbuf *pb;
+    GList *l;
+    task *tk;
+    gint w, h;
+
+    ENTER;
+    if (event->type != GDK_BUTTON_PRESS || event->button != 1)
+        RET(FALSE);
+    gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, &w, &h);
+    menu = gtk_menu_new();
+    for (l = tb->tasks; l; l = l->next) {
+        tk = l->data;
+        if ((tk->grp ? (gpointer) tk->grp->btn : (gpointer) tk->btn)
+            || !task_visible(tb, tk))
+            continue;   /* already on a button */
+        mi = gtk_image_menu_item_new_with_label(
+            tk->name ? (tk->iconified ? tk->iname : tk->name) : "");
+        pb = gdk_pixbuf_scale_simple(tk->pixbuf, w, h, GDK_INTERP_BILINEAR);
+        gtk_image_menu_item_set_image(GTK_IMAGE_MENU_ITEM(mi),
+            gtk_image_new_from_pixbuf(pb));
+        g_object_unref(pb);
+        g_object_set_data(G_OBJECT(mi), "win", GSIZE_TO_POINTER(tk->win));
+        g_signal_connect(G_OBJECT(mi), "activate",
+            G_CALLBACK(grp_item_activate), tb);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), mi);
+    }
+    gtk_widget_show_all(menu);
+    g_signal_connect(G_OBJECT(menu), "selection-done",
+        G_CALLBACK(gtk_widget_destroy), NULL);
+    gtk_menu_popup(GTK_MENU(menu), NULL, NULL,
+        (GtkMenuPositionFunc) menu_pos, widget, event->button, event->time);
+    RET(TRUE);
 }
 
 /*
- * tk_build_gui -- create all GTK widgets for one task.
+ * tk_build_gui -- prepare a new task for display.
  *
- * Builds: GtkButton → GtkHBox → GtkImage [+ GtkLabel]
- * Connects button event handlers, sets up DnD drag destination,
- * and starts urgency flashing if tk->urgency is set.
+ * Subscribes to the window's property changes, fetches its icon, and
+ * starts urgency flashing if tk->urgency is set.  The button itself comes
+ * from the pool in tb_display().
  *
  * Parameters:
  *   tb - taskbar_priv.
- *   tk - task for which to build the button.
+ *   tk - task to prepare.
  */
 static void
 tk_build_gui(taskbar_priv *tb, task *tk)
 {
-    GtkWidget *w1;
-
     ENTER;
     g_assert ((tb != NULL) && (tk != NULL));
 
@@ -1126,58 +1930,13 @@ tk_build_gui(taskbar_priv *tb, task *tk)
         XSelectInput(GDK_DISPLAY(), tk->win,
                 PropertyChangeMask | StructureNotifyMask);
 
-    /* create the button */
-    tk->button = gtk_button_new();
-    gtk_button_set_alignment(GTK_BUTTON(tk->button), 0.5, 0.5);
-    gtk_widget_show(tk->button);
-    gtk_container_set_border_width(GTK_CONTAINER(tk->button), 0);
-    gtk_widget_add_events (tk->button, GDK_BUTTON_RELEASE_MASK
-            | GDK_BUTTON_PRESS_MASK);
-    g_signal_connect(G_OBJECT(tk->button), "button_release_event",
-          G_CALLBACK(tk_callback_button_release_event), (gpointer)tk);
-    g_signal_connect(G_OBJECT(tk->button), "button_press_event",
-           G_CALLBACK(tk_callback_button_press_event), (gpointer)tk);
-    g_signal_connect_after (G_OBJECT (tk->button), "leave",
-          G_CALLBACK (tk_callback_leave), (gpointer) tk);
-    g_signal_connect_after (G_OBJECT (tk->button), "enter",
-          G_CALLBACK (tk_callback_enter), (gpointer) tk);
-    /* configure drag destination for drag-over window activation */
-    gtk_drag_dest_set( tk->button, 0, NULL, 0, 0);
-    g_signal_connect (G_OBJECT (tk->button), "drag-motion",
-          G_CALLBACK (tk_callback_drag_motion), (gpointer) tk);
-    g_signal_connect (G_OBJECT (tk->button), "drag-leave",
-          G_CALLBACK (tk_callback_drag_leave), (gpointer) tk);
-    if (tb->use_mouse_wheel)
-        g_signal_connect_after(G_OBJECT(tk->button), "scroll-event",
-              G_CALLBACK(tk_callback_scroll_event), (gpointer)tk);
-
-    /* icon image */
-    tk_update_icon(tb, tk, None);
-    w1 = tk->image = gtk_image_new_from_pixbuf(tk->pixbuf);
-    gtk_misc_set_alignment(GTK_MISC(tk->image), 0.5, 0.5);
-    gtk_misc_set_padding(GTK_MISC(tk->image), 0, 0);
-
-    if (!tb->icons_only) {
-        /* icon + label layout */
-        w1 = gtk_hbox_new(FALSE, 1);
-        gtk_container_set_border_width(GTK_CONTAINER(w1), 0);
-        gtk_box_pack_start(GTK_BOX(w1), tk->image, FALSE, FALSE, 0);
-        tk->label = gtk_label_new(tk->iconified ? tk->iname : tk->name);
-        gtk_label_set_ellipsize(GTK_LABEL(tk->label), PANGO_ELLIPSIZE_END);
-        gtk_misc_set_alignment(GTK_MISC(tk->label), 0.0, 0.5);
-        gtk_misc_set_padding(GTK_MISC(tk->label), 0, 0);
-        gtk_box_pack_start(GTK_BOX(w1), tk->label, TRUE, TRUE, 0);
-    }
-
-    gtk_container_add (GTK_CONTAINER (tk->button), w1);
-    gtk_box_pack_start(GTK_BOX(tb->bar), tk->button, FALSE, TRUE, 0);
-    GTK_WIDGET_UNSET_FLAGS (tk->button, GTK_CAN_FOCUS);
-    GTK_WIDGET_UNSET_FLAGS (tk->button, GTK_CAN_DEFAULT);
-
-    gtk_widget_show_all(tk->button);
-    if (!task_visible(tb, tk)) {
-        gtk_widget_hide(tk->button);
-    }
+    if (tb->grouped)
+        grp_add_task(tb, tk);   /* shares the group icon */
+    else
+        tk_update_icon(tb, tk, None);
+    tk->seq = tb->next_seq++;
+    tb->tasks = g_list_append(tb->tasks, tk);
+    tk_desk_add(tb, tk);
 
     if (tk->urgency) {
         /* start flashing for windows with urgency hint set */
@@ -1235,10 +1994,8 @@ tb_net_client_list(GtkWidget *widget, taskbar_priv *tb)
     task *tk;
 
     ENTER;
-    if (tb->wins)
-        XFree(tb->wins);
-    tb->wins = get_xaproperty (GDK_ROOT_WINDOW(),
-        a_NET_CLIENT_LIST, XA_WINDOW, &tb->win_num);
+    /* shared with the other taskbars of the process */
+    tb->wins = fb_ev_client_list(fbev, &tb->win_num);
     if (!tb->wins)
         RET();
     for (i = 0; i < tb->win_num; i++) {
@@ -1282,6 +2039,7 @@ tb_net_client_list(GtkWidget *widget, taskbar_priv *tb)
     g_hash_table_foreach_remove(tb->task_list, (GHRFunc) task_remove_stale,
         NULL);
     tb_display(tb);
+    FB_PROBE("tb.clientlist", None);
     RET();
 }
 
@@ -1329,7 +2087,7 @@ tb_net_number_of_desktops(GtkWidget *widget, taskbar_priv *tb)
 static void
 tb_net_active_window(GtkWidget *widget, taskbar_priv *tb)
 {
-    Window *f;
+    Window f;
     task *ntk, *ctk;
     int drop_old, make_new;
 
@@ -1338,14 +2096,14 @@ tb_net_active_window(GtkWidget *widget, taskbar_priv *tb)
     drop_old = make_new = 0;
     ctk = tb->focused;
     ntk = NULL;
-    f = get_xaproperty(GDK_ROOT_WINDOW(), a_NET_ACTIVE_WINDOW, XA_WINDOW, 0);
-    DBG("FOCUS=%x\n", f ? *f : 0);
-    if (!f) {
+    f = fb_ev_active_window(fbev);
+    DBG("FOCUS=%x\n", f);
+    if (f == None) {
         /* no active window — drop focus entirely */
         drop_old = 1;
         tb->ptk = NULL;
     } else {
-        if (*f == tb->topxwin) {
+        if (f == tb->topxwin) {
             /* panel itself gained focus — remember which task was focused */
             if (ctk) {
                 tb->ptk = ctk;
@@ -1353,13 +2111,12 @@ tb_net_active_window(GtkWidget *widget, taskbar_priv *tb)
             }
         } else {
             tb->ptk = NULL;
-            ntk = find_task(tb, *f);
+            ntk = find_task(tb, f);
             if (ntk != ctk) {
                 drop_old = 1;
                 make_new = 1;
             }
         }
-        XFree(f);
     }
     if (ctk && drop_old) {
         ctk->focused = 0;
@@ -1432,18 +2189,32 @@ tb_propertynotify(taskbar_priv *tb, XEvent *ev)
         if (!tk) RET();
         DBG("win=%x\n", ev->xproperty.window);
         if (at == a_NET_WM_DESKTOP) {
+            guint desk;
+
             DBG("NET_WM_DESKTOP\n");
-            tk->desktop = get_net_wm_desktop(win);
-            tb_display(tb);
+            desk = get_net_wm_desktop(win);
+            if (desk != tk->desktop) {
+                tk_desk_remove(tb, tk);
+                tk->desktop = desk;
+                tk_desk_add(tb, tk);
+                tb_display(tb);
+            }
+            FB_PROBE("tb.desktop", win);
         } else if (at == XA_WM_NAME) {
             DBG("WM_NAME\n");
             tk_get_names(tk);
             tk_set_names(tk);
+            FB_PROBE("tb.name", win);
         } else if (at == XA_WM_HINTS)   {
             /* some windows set their WM_HINTS icon after mapping */
             DBG("XA_WM_HINTS\n");
-            tk_update_icon (tb, tk, XA_WM_HINTS);
-            gtk_image_set_from_pixbuf (GTK_IMAGE(tk->image), tk->pixbuf);
+            if (tk->grp)
+                grp_update_icon(tb, tk, XA_WM_HINTS);
+            else
+                tk_update_icon (tb, tk, XA_WM_HINTS);
+            if (tk->btn)
+                gtk_image_set_from_pixbuf (GTK_IMAGE(tk->btn->image),
+                    tk->pixbuf);
             if (tb->use_urgency_hint) {
                 if (tk_has_urgency(tk)) {
                     tk_flash_window(tk);
@@ -1459,14 +2230,23 @@ tb_propertynotify(taskbar_priv *tb, XEvent *ev)
             if (!accept_net_wm_state(&nws, tb->accept_skip_pager)) {
                 del_task(tb, tk, 1);
                 tb_display(tb);
-            } else {
+            } else if (tk->iconified != nws.hidden) {
                 tk->iconified = nws.hidden;
                 tk_set_names(tk);
+                /* showiconified / showmapped may hide or reveal it */
+                if (!tb->show_iconified || !tb->show_mapped)
+                    tb_display(tb);
             }
         } else if (at == a_NET_WM_ICON) {
             DBG("_NET_WM_ICON\n");
-            tk_update_icon (tb, tk, a_NET_WM_ICON);
-            gtk_image_set_from_pixbuf (GTK_IMAGE(tk->image), tk->pixbuf);
+            if (tk->grp)
+                grp_update_icon(tb, tk, a_NET_WM_ICON);
+            else
+                tk_update_icon (tb, tk, a_NET_WM_ICON);
+            if (tk->btn)
+                gtk_image_set_from_pixbuf (GTK_IMAGE(tk->btn->image),
+                    tk->pixbuf);
+            FB_PROBE("tb.icon", win);
         } else if (at == a_NET_WM_WINDOW_TYPE) {
             net_wm_window_type nwwt;
 
@@ -1483,11 +2263,175 @@ tb_propertynotify(taskbar_priv *tb, XEvent *ev)
     RET();
 }
 
+/* One open startup sequence; the value in tb->sn_seqs, keyed by id. */
+typedef struct {
+    taskbar_priv *tb;
+    gchar *id;
+    guint timeout;    /* TB_SN_TIMEOUT source */
+} tb_sn_seq;
+
+static void
+tb_sn_partial_free(GString *msg)
+{
+    g_string_free(msg, TRUE);
+}
+
+static void
+tb_sn_seq_free(tb_sn_seq *seq)
+{
+    if (seq->timeout)
+        g_source_remove(seq->timeout);
+    g_free(seq->id);
+    g_free(seq);
+}
+
 /*
- * tb_event_filter -- GDK event filter for X11 PropertyNotify on client windows.
+ * tb_sn_cursor -- show the busy cursor while a startup sequence is open.
  *
- * Dispatches to tb_propertynotify for all PropertyNotify events.
- * Root-window events are ignored here (FbEv handles those separately).
+ * Set on the plugin's window; the task buttons' input windows have no
+ * cursor of their own and so inherit it.
+ */
+static void
+tb_sn_cursor(taskbar_priv *tb)
+{
+    GtkWidget *pwid = tb->plugin.pwid;
+    GdkCursor *cursor;
+
+    if (!GTK_WIDGET_REALIZED(pwid))
+        return;
+    if (g_hash_table_size(tb->sn_seqs)) {
+        cursor = gdk_cursor_new(GDK_WATCH);
+        gdk_window_set_cursor(pwid->window, cursor);
+        gdk_cursor_unref(cursor);
+    } else
+        gdk_window_set_cursor(pwid->window, NULL);
+}
+
+/*
+ * tb_sn_expire -- TB_SN_TIMEOUT: the application never closed the sequence.
+ */
+static gboolean
+tb_sn_expire(tb_sn_seq *seq)
+{
+    taskbar_priv *tb = seq->tb;
+
+    ENTER;
+    DBG("%s timed out\n", seq->id);
+    seq->timeout = 0;
+    g_hash_table_remove(tb->sn_seqs, seq->id);
+    tb_sn_cursor(tb);
+    RET(FALSE);
+}
+
+/*
+ * tb_sn_id -- the value of ID in a startup message, or NULL; g_free() it.
+ *
+ * Values are either quoted ("..." with \" and \\ escapes) or run to the
+ * next space.
+ */
+static gchar *
+tb_sn_id(const gchar *msg)
+{
+    const gchar *p, *key;
+    GString *val;
+    gboolean quoted;
+
+    if (!(p = strchr(msg, ':')))
+        return NULL;
+    for (p++; *p; ) {
+        while (*p == ' ')
+            p++;
+        for (key = p; *p && *p != '='; p++)
+            ;
+        if (!*p)
+            break;
+        quoted = (*++p == '"');
+        if (quoted)
+            p++;
+        val = g_string_new(NULL);
+        for (; *p && (quoted ? *p != '"' : *p != ' '); p++) {
+            if (*p == '\\' && p[1])
+                p++;
+            g_string_append_c(val, *p);
+        }
+        if (*p == '"')
+            p++;
+        if (!strncmp(key, "ID=", 3))
+            return g_string_free(val, FALSE);
+        g_string_free(val, TRUE);
+    }
+    return NULL;
+}
+
+/*
+ * tb_sn_message -- one complete startup message: open or close a sequence.
+ * "change:" messages carry no information the taskbar uses.
+ */
+static void
+tb_sn_message(taskbar_priv *tb, const gchar *msg)
+{
+    tb_sn_seq *seq;
+    gchar *id;
+
+    ENTER;
+    DBG("%s\n", msg);
+    if (!(id = tb_sn_id(msg)))
+        RET();
+    if (g_str_has_prefix(msg, "new:")) {
+        if (!g_hash_table_lookup(tb->sn_seqs, id)
+            && g_hash_table_size(tb->sn_seqs) < TB_SN_SEQ_MAX) {
+            seq = g_new0(tb_sn_seq, 1);
+            seq->tb = tb;
+            seq->id = id;
+            seq->timeout = g_timeout_add_seconds(TB_SN_TIMEOUT,
+                (GSourceFunc) tb_sn_expire, seq);
+            g_hash_table_insert(tb->sn_seqs, seq->id, seq);
+            id = NULL;
+        }
+    } else if (g_str_has_prefix(msg, "remove:"))
+        g_hash_table_remove(tb->sn_seqs, id);
+    g_free(id);
+    tb_sn_cursor(tb);
+    RET();
+}
+
+/*
+ * tb_sn_clientmessage -- collect the 20-byte chunks of startup messages.
+ *
+ * _NET_STARTUP_INFO_BEGIN starts a message from its source window,
+ * _NET_STARTUP_INFO continues it; the message ends at the first NUL.
+ */
+static void
+tb_sn_clientmessage(taskbar_priv *tb, XClientMessageEvent *xev)
+{
+    gpointer key = GUINT_TO_POINTER(xev->window);
+    GString *msg;
+    gsize len;
+
+    if (xev->format != 8)
+        return;
+    if (xev->message_type == a_NET_STARTUP_INFO_BEGIN) {
+        msg = g_string_new(NULL);
+        g_hash_table_replace(tb->sn_partial, key, msg);
+    } else if (!(msg = g_hash_table_lookup(tb->sn_partial, key)))
+        return;
+    len = strnlen(xev->data.b, sizeof(xev->data.b));
+    g_string_append_len(msg, xev->data.b, len);
+    if (msg->len > TB_SN_MSG_MAX)
+        g_hash_table_remove(tb->sn_partial, key);
+    else if (len < sizeof(xev->data.b)) {
+        tb_sn_message(tb, msg->str);
+        g_hash_table_remove(tb->sn_partial, key);
+    }
+}
+
+/*
+ * tb_event_filter -- GDK event filter for X11 PropertyNotify on client
+ * windows and startup-notification messages on the root window.
+ *
+ * Dispatches PropertyNotify to tb_propertynotify and _NET_STARTUP_INFO*
+ * client messages to tb_sn_clientmessage.  Root-window property changes
+ * are ignored here (FbEv handles those separately).
  *
  * Returns: GDK_FILTER_CONTINUE (never consumes events).
  */
@@ -1499,6 +2443,10 @@ tb_event_filter( XEvent *xev, GdkEvent *event, taskbar_priv *tb)
     g_assert(tb != NULL);
     if (xev->type == PropertyNotify )
         tb_propertynotify(tb, xev);
+    else if (xev->type == ClientMessage
+        && (xev->xclient.message_type == a_NET_STARTUP_INFO_BEGIN
+            || xev->xclient.message_type == a_NET_STARTUP_INFO))
+        tb_sn_clientmessage(tb, &xev->xclient);
     RET(GDK_FILTER_CONTINUE);
 }
 
@@ -1676,13 +2624,15 @@ tb_make_menu(GtkWidget *widget, taskbar_priv *tb)
  * taskbar_size_alloc -- "size-allocate" handler on the GtkAlignment.
  *
  * Recomputes the GtkBar dimension (rows or columns) when the taskbar
- * changes size.
+ * changes size.  With mintaskwidth set, also recomputes how many buttons
+ * fit and rebinds the pool if that changed.
  */
 static void
 taskbar_size_alloc(GtkWidget *widget, GtkAllocation *a,
     taskbar_priv *tb)
 {
-    int dim;
+    int dim, per_line;
+    guint capacity;
 
     ENTER;
     if (tb->plugin.panel->orientation == GTK_ORIENTATION_HORIZONTAL)
@@ -1692,6 +2642,19 @@ taskbar_size_alloc(GtkWidget *widget, GtkAllocation *a,
     DBG("width=%d height=%d task_height_max=%d -> dim=%d\n",
         a->width, a->height, tb->task_height_max, dim);
     gtk_bar_set_dimension(GTK_BAR(tb->bar), dim);
+    if (tb->min_task_width > 0) {
+        /* cells along the panel at mintaskwidth (or one row height) */
+        if (tb->plugin.panel->orientation == GTK_ORIENTATION_HORIZONTAL)
+            per_line = a->width / (tb->min_task_width + tb->spacing);
+        else
+            per_line = a->height / (tb->task_height_max + tb->spacing);
+        capacity = MAX(dim, 1) * MAX(per_line, 1);
+        if (capacity != tb->capacity) {
+            DBG("capacity %u -> %u\n", tb->capacity, capacity);
+            tb->capacity = capacity;
+            tb_display(tb);
+        }
+    }
     RET();
 }
 
@@ -1728,6 +2691,15 @@ taskbar_build_gui(plugin_instance *p)
     gtk_container_add(GTK_CONTAINER(ali), tb->bar);
     gtk_widget_show_all(ali);
 
+    /* overflow button: always the last child of the bar */
+    tb->more = gtk_button_new_with_label("");
+    gtk_button_set_relief(GTK_BUTTON(tb->more), GTK_RELIEF_NONE);
+    GTK_WIDGET_UNSET_FLAGS (tb->more, GTK_CAN_FOCUS);
+    gtk_widget_set_tooltip_text(tb->more, _("More windows"));
+    g_signal_connect(G_OBJECT(tb->more), "button-press-event",
+        G_CALLBACK(tb_more_clicked), tb);
+    gtk_box_pack_start(GTK_BOX(tb->bar), tb->more, FALSE, TRUE, 0);
+
     /* default icon used when a window has no icon of its own */
     tb->gen_pixbuf = gdk_pixbuf_new_from_xpm_data((const char **)icon_xpm);
 
@@ -1755,7 +2727,7 @@ taskbar_build_gui(plugin_instance *p)
 
     tb_make_menu(NULL, tb);   /* initial context menu build */
     gtk_container_set_border_width(GTK_CONTAINER(p->pwid), 0);
-    gtk_widget_show_all(tb->bar);
+    gtk_widget_show(tb->bar);
     RET();
 }
 
@@ -1823,6 +2795,19 @@ taskbar_constructor(plugin_instance *p)
     tb->spacing           = 0;
     tb->use_mouse_wheel   = 1;
     tb->use_urgency_hint  = 1;
+    tb->min_task_width    = 0;
+    tb->capacity          = G_MAXUINT;
+    tb->pool              = g_ptr_array_new();
+    tb->grouped           = 0;
+    tb->group_list        = g_hash_table_new(g_str_hash, g_str_equal);
+    tb->desk_tasks        = g_hash_table_new_full(g_direct_hash,
+        g_direct_equal, NULL, (GDestroyNotify) g_queue_free);
+    g_queue_init(&tb->sticky);
+    tb->shown             = g_ptr_array_new();
+    tb->sn_partial        = g_hash_table_new_full(g_direct_hash,
+        g_direct_equal, NULL, (GDestroyNotify) tb_sn_partial_free);
+    tb->sn_seqs           = g_hash_table_new_full(g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) tb_sn_seq_free);
 
     /* read config overrides */
     XCG(xc, "tooltips",        &tb->tooltips,          enum, bool_enum);
@@ -1834,6 +2819,8 @@ taskbar_constructor(plugin_instance *p)
     XCG(xc, "usemousewheel",   &tb->use_mouse_wheel,    enum, bool_enum);
     XCG(xc, "useurgencyhint",  &tb->use_urgency_hint,   enum, bool_enum);
     XCG(xc, "maxtaskwidth",    &tb->task_width_max,     int);
+    XCG(xc, "mintaskwidth",    &tb->min_task_width,     int);
+    XCG(xc, "groupedtasks",    &tb->grouped,            enum, bool_enum);
 
     /* FIXME: cap at TASK_HEIGHT_MAX until per-plugin height limit is ready */
     if (tb->task_height_max > TASK_HEIGHT_MAX)
@@ -1842,6 +2829,8 @@ taskbar_constructor(plugin_instance *p)
         tb->iconsize = MIN(p->panel->ah, tb->task_height_max) - req.height;
         if (tb->icons_only)
             tb->task_width_max = tb->iconsize + req.width;
+        if (tb->min_task_width > tb->task_width_max)
+            tb->min_task_width = tb->task_width_max;
     } else {
         /* narrow vertical panels go icons-only automatically */
         if (p->panel->aw <= 30)
@@ -1886,8 +2875,15 @@ taskbar_destructor(plugin_instance *p)
     g_hash_table_foreach_remove(tb->task_list, (GHRFunc) task_remove_every,
             NULL);
     g_hash_table_destroy(tb->task_list);
-    if (tb->wins)
-        XFree(tb->wins);
+    /* the last del_task of each group freed it */
+    g_hash_table_destroy(tb->group_list);
+    g_hash_table_destroy(tb->desk_tasks);
+    g_hash_table_destroy(tb->sn_partial);
+    g_hash_table_destroy(tb->sn_seqs);
+    g_ptr_array_free(tb->shown, TRUE);
+    /* pooled widgets die with tb->bar; free the bookkeeping only */
+    g_ptr_array_foreach(tb->pool, (GFunc) g_free, NULL);
+    g_ptr_array_free(tb->pool, TRUE);
     /* tb->bar is a child of p->pwid — destroyed by framework; no explicit destroy needed */
     gtk_widget_destroy(tb->menu);
     DBG("alloc_no=%d\n", tb->alloc_no);
@@ -8,10 +8,12 @@
  *     Calendar and transparency support
  *     See patch "2981313: Enhancements to 'tclock' plugin" on sf.net
  *
- * Timer: a 1-second g_timeout_add fires clock_update() continuously.
+ * Timer: clock_update() is a shared-clock (clock.h) subscriber at the
+ *         resolution of the clock format, so "%R" wakes once a minute,
+ *         exactly when the minute changes.
  * Memory: dc->main and dc->clockw are regular GTK child widgets; the parent
- *         container manages their lifetime. Timer handle dc->timer must be
- *         removed in tclock_destructor.
+ *         container manages their lifetime. Subscription dc->timer and the
+ *         popup calendar dc->cal are released in tclock_destructor.
  */
 
 #include <time.h>
@@ -25,6 +27,8 @@
 #include "panel.h"
 #include "misc.h"
 #include "plugin.h"
+#include "clock.h"
+#include "calendar.h"
 
 //#define DEBUGPRN
 #include "dbg.h"
@@ -42,68 +46,34 @@
  * Memory ownership:
  *   main        -- GtkEventBox; owned by GTK widget tree.
  *   clockw      -- GtkLabel child of main; owned by GTK widget tree.
- *   calendar_window -- GtkWindow popup, or NULL; owned by this struct.
- *                     Must be destroyed when the plugin unloads if non-NULL.
+ *   cal         -- popup calendar (calendar.h), or NULL; owned by this
+ *                  struct, freed in tclock_destructor.
  *   tfmt, cfmt  -- point into xconf storage (not heap); do not free.
  *   action      -- points into xconf storage; do not free.
- *   timer       -- GSource handle from g_timeout_add; 0 when not running.
+ *   timer       -- fb_clock_add subscription id; 0 when not running.
  */
 typedef struct {
     plugin_instance plugin;    /* base class -- must be first member          */
     GtkWidget *main;           /* outer event box catching button events      */
     GtkWidget *clockw;         /* GtkLabel displaying the formatted time      */
-    GtkWidget *calendar_window;/* popup calendar, or NULL                     */
+    fb_calendar *cal;          /* popup calendar, or NULL                     */
     char *tfmt;                /* strftime format for tooltip string          */
     char *cfmt;                /* strftime format for clock face (may include Pango markup) */
     char *action;              /* shell command on click, or NULL             */
     short lastDay;             /* day-of-month when tooltip was last rebuilt  */
-    int timer;                 /* g_timeout_add handle; 0 = not running       */
+    guint timer;               /* fb_clock_add id; 0 = not running            */
     int show_calendar;         /* non-zero = toggle calendar on click         */
+    int calendar_months;       /* months shown side by side in the calendar   */
+    int week_numbers;          /* non-zero = calendar shows week numbers      */
     int show_tooltip;          /* non-zero = show date tooltip                */
 } tclock_priv;
 
 /*
- * tclock_create_calendar -- construct and return an undecorated popup calendar.
- *
- * Returns: GtkWidget* (GtkWindow) with a GtkCalendar inside.
- *          Caller takes ownership; destroy with gtk_widget_destroy().
- *
- * The window: undecorated, non-resizable, positioned near the mouse,
- * sticky (all desktops), excluded from taskbar and pager.
- */
-static GtkWidget *
-tclock_create_calendar(void)
-{
-    GtkWidget *calendar, *win;
-
-    win = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-    gtk_window_set_default_size(GTK_WINDOW(win), 180, 180);
-    gtk_window_set_decorated(GTK_WINDOW(win), FALSE);   // no title bar
-    gtk_window_set_resizable(GTK_WINDOW(win), FALSE);
-    gtk_container_set_border_width(GTK_CONTAINER(win), 5);
-    gtk_window_set_skip_taskbar_hint(GTK_WINDOW(win), TRUE);
-    gtk_window_set_skip_pager_hint(GTK_WINDOW(win), TRUE);
-    gtk_window_set_position(GTK_WINDOW(win), GTK_WIN_POS_MOUSE);
-    gtk_window_set_title(GTK_WINDOW(win), "calendar");
-    gtk_window_stick(GTK_WINDOW(win)); // visible on all virtual desktops
-
-    calendar = gtk_calendar_new();
-    gtk_calendar_display_options(
-        GTK_CALENDAR(calendar),
-        GTK_CALENDAR_SHOW_WEEK_NUMBERS | GTK_CALENDAR_SHOW_DAY_NAMES
-        | GTK_CALENDAR_SHOW_HEADING);
-    gtk_container_add(GTK_CONTAINER(win), GTK_WIDGET(calendar));
-
-    return win;
-}
-
-/*
- * clock_update -- timer callback; refreshes the clock label and tooltip.
+ * clock_update -- fb_clock callback; refreshes the clock label and tooltip.
  *
  * Parameters:
- *   data -- gpointer cast of tclock_priv*.
- *
- * Returns: TRUE (always), to keep the g_timeout_add timer alive.
+ *   detail -- local time to render (shared, do not modify).
+ *   data   -- gpointer cast of tclock_priv*.
  *
  * Clock face: calls strftime with dc->cfmt; passes the result directly to
  *   gtk_label_set_markup so Pango markup in cfmt (e.g. "<b>%R</b>") is
@@ -113,15 +83,11 @@ tclock_create_calendar(void)
  * Tooltip: updated only once per day (when detail->tm_mday changes) unless
  *   the calendar popup is open, in which case the tooltip is cleared to avoid
  *   overlap.  The converted UTF-8 string is freed after being passed to GTK.
- *
- * localtime() is not thread-safe but fbpanel is single-threaded so this is OK.
  */
-static gint
-clock_update(gpointer data)
+static void
+clock_update(const struct tm *detail, gpointer data)
 {
     char output[256]; // strftime output buffer
-    time_t now;
-    struct tm * detail;
     tclock_priv *dc;
     gchar *utf8;
     size_t rc;
@@ -130,8 +96,6 @@ clock_update(gpointer data)
     g_assert(data != NULL);
     dc = (tclock_priv *)data;
 
-    time(&now);
-    detail = localtime(&now); // returns pointer to static buffer
     // Format the clock face; rc == 0 means the buffer was too small or format is empty
     rc = strftime(output, sizeof(output), dc->cfmt, detail) ;
     if (rc) {
@@ -140,7 +104,7 @@ clock_update(gpointer data)
     }
 
     if (dc->show_tooltip) {
-        if (dc->calendar_window) {
+        if (fb_calendar_visible(dc->cal)) {
             // Calendar is open: clear tooltip to prevent overlap
             gtk_widget_set_tooltip_markup(dc->main, NULL);
             dc->lastDay = 0; // force tooltip rebuild when calendar closes
@@ -159,7 +123,7 @@ clock_update(gpointer data)
         }
     }
 
-    RET(TRUE); // keep timer running
+    RET();
 }
 
 /*
@@ -174,7 +138,8 @@ clock_update(gpointer data)
  *
  * Behaviour:
  *   If dc->action is set, runs it asynchronously.
- *   Otherwise, if show_calendar is enabled, toggles the popup calendar.
+ *   Otherwise, if show_calendar is enabled, toggles the popup calendar
+ *   (maps or unmaps the prebuilt window; see calendar.h).
  *   After toggling the calendar, calls clock_update() immediately to refresh
  *   the tooltip state (clear it while calendar is open).
  *
@@ -191,22 +156,10 @@ clicked(GtkWidget *widget, GdkEventButton *event, tclock_priv *dc)
     if (dc->action) {
         // Run configured command; errors are silently ignored
         g_spawn_command_line_async(dc->action, NULL);
-    } else if (dc->show_calendar) {
-        if (dc->calendar_window == NULL)
-        {
-            // Open the calendar popup
-            dc->calendar_window = tclock_create_calendar();
-            gtk_widget_show_all(dc->calendar_window);
-        }
-        else
-        {
-            // Close the calendar popup
-            gtk_widget_destroy(dc->calendar_window);
-            // Set to NULL so clock_update() knows the calendar is gone
-            dc->calendar_window = NULL;
-        }
+    } else if (dc->cal) {
+        fb_calendar_toggle(dc->cal);
         // Immediately refresh tooltip (clear while open, restore when closed)
-        clock_update(dc);
+        clock_update(fb_clock_localtime(), dc);
     }
     RET(TRUE);
 }
@@ -224,6 +177,8 @@ clicked(GtkWidget *widget, GdkEventButton *event, tclock_priv *dc)
  *   ClockFmt      -- strftime/Pango format for label (default CLOCK_24H_FMT)
  *   Action        -- optional shell command on click
  *   ShowCalendar  -- bool: show popup calendar on click (default TRUE)
+ *   CalendarMonths -- int: months shown in the calendar (default 1)
+ *   WeekNumbers   -- bool: calendar shows week numbers (default TRUE)
  *   ShowTooltip   -- bool: show date tooltip (default TRUE)
  *
  * Widget hierarchy:
@@ -234,7 +189,9 @@ clicked(GtkWidget *widget, GdkEventButton *event, tclock_priv *dc)
  * Signal: "button_press_event" on dc->main -> clicked() (only connected if
  *         action or show_calendar is configured).
  *
- * Timer: dc->timer starts the 1-second periodic update.
+ * Timer: dc->timer subscribes clock_update() to the shared clock at the
+ *        resolution of ClockFmt.  The tooltip is rebuilt once a day anyway,
+ *        and every resolution includes the midnight boundary.
  *        Must be cancelled in tclock_destructor.
  */
 static int
@@ -249,17 +206,24 @@ tclock_constructor(plugin_instance *p)
     dc->tfmt = TOOLTIP_FMT;
     dc->action = NULL;
     dc->show_calendar = TRUE;
+    dc->calendar_months = 1;
+    dc->week_numbers = TRUE;
     dc->show_tooltip = TRUE;
     // Read per-instance configuration overrides
     XCG(p->xc, "TooltipFmt", &dc->tfmt, str);
     XCG(p->xc, "ClockFmt", &dc->cfmt, str);
     XCG(p->xc, "Action", &dc->action, str);
     XCG(p->xc, "ShowCalendar", &dc->show_calendar, enum, bool_enum);
+    XCG(p->xc, "CalendarMonths", &dc->calendar_months, int);
+    XCG(p->xc, "WeekNumbers", &dc->week_numbers, enum, bool_enum);
     XCG(p->xc, "ShowTooltip", &dc->show_tooltip, enum, bool_enum);
 
     // Create an event box as the outer widget (invisible, catches events)
     dc->main = gtk_event_box_new();
     gtk_event_box_set_visible_window(GTK_EVENT_BOX(dc->main), FALSE);
+    // The calendar popup is built in the background and reused
+    if (!dc->action && dc->show_calendar)
+        dc->cal = fb_calendar_new(dc->calendar_months, dc->week_numbers);
     // Only hook the click handler if there is something to do on click
     if (dc->action || dc->show_calendar)
         g_signal_connect (G_OBJECT (dc->main), "button_press_event",
@@ -268,7 +232,7 @@ tclock_constructor(plugin_instance *p)
     // Create the text label; will be populated by clock_update()
     dc->clockw = gtk_label_new(NULL);
 
-    clock_update(dc); // render once immediately before showing the widget
+    clock_update(fb_clock_localtime(), dc); // render once before showing
 
     // Configure label appearance
     gtk_misc_set_alignment(GTK_MISC(dc->clockw), 0.5, 0.5); // centre text
@@ -276,8 +240,9 @@ tclock_constructor(plugin_instance *p)
     gtk_label_set_justify(GTK_LABEL(dc->clockw), GTK_JUSTIFY_CENTER);
     gtk_container_add(GTK_CONTAINER(dc->main), dc->clockw);
     gtk_widget_show_all(dc->main);
-    // Start 1-second recurring timer; handle stored for removal in destructor
-    dc->timer = g_timeout_add(1000, (GSourceFunc) clock_update, (gpointer)dc);
+    // Wake up only when the rendered text can change
+    dc->timer = fb_clock_add(fb_clock_format_resolution(dc->cfmt),
+        clock_update, dc);
     gtk_container_add(GTK_CONTAINER(p->pwid), dc->main);
     RET(1);
 }
@@ -289,12 +254,9 @@ tclock_constructor(plugin_instance *p)
  *   p -- plugin_instance pointer.
  *
  * Cleanup:
- *   - Cancels the timer via g_source_remove.
+ *   - Cancels the clock subscription via fb_clock_remove.
  *   - Destroys dc->main (GTK cascade destroys dc->clockw as well).
- *
- * BUG: dc->calendar_window is not explicitly destroyed here. If the user
- *      unloads the plugin while the calendar is open, the window is orphaned
- *      until the process exits.
+ *   - Frees the popup calendar, open or not.
  */
 static void
 tclock_destructor( plugin_instance *p )
@@ -302,11 +264,10 @@ tclock_destructor( plugin_instance *p )
     tclock_priv *dc = (tclock_priv *) p;
 
     ENTER;
-    // Remove the periodic timer before the widget it references is destroyed
-    if (dc->timer)
-        g_source_remove(dc->timer);
+    // Unsubscribe before the widget it references is destroyed
+    fb_clock_remove(dc->timer);
     gtk_widget_destroy(dc->main);
-    // NOTE: dc->calendar_window is NOT closed here if it remains open (bug).
+    fb_calendar_free(dc->cal);
     RET();
 }
 
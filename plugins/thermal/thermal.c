@@ -1,73 +1,352 @@
 /*
  * thermal.c -- fbpanel CPU/board temperature plugin.
  *
- * Reads a thermal zone temperature from the kernel's thermal sysfs
- * interface and displays it as a text label (e.g. "45°C").
+ * Shows the hottest temperature sensor of the machine as a text label
+ * (e.g. "45°C"), or as a scrolling chart, with a table of all sensors and
+ * fans in the tooltip.
+ *
+ * Sensors:
+ *   hwmon (default) -- every /sys/class/hwmon/hwmon<N>/temp<I>_input, named
+ *     "<chip>/<label>" from the chip's "name" and temp<I>_label (or
+ *     "temp<I>"), and every fan<I>_input, shown in the tooltip only.  Old
+ *     kernels keep the attributes in hwmon<N>/device/, which is tried too.
+ *     Sensors lists glob patterns on those names to pick a subset.
+ *   thermal zone -- if ThermalZone is set, or if no hwmon temperature is
+ *     found, /sys/class/thermal/thermal_zone<N>/temp is the only sensor.
+ *
+ * Every chosen file is opened once in the constructor and re-read with
+ * pread() at offset 0 each period; nothing is opened or parsed per tick
+ * except the integers.  The tooltip text is built only when GTK asks for
+ * it ("query-tooltip"), not every period.
  *
  * Soft-disable behaviour:
- *   If the requested thermal zone does not exist (e.g. running inside a
- *   container, on hardware without thermal sensors, or when the relevant
- *   kernel module is not loaded), the constructor emits g_message() and
- *   returns 0.  The panel skips the plugin and continues loading.
+ *   If no sensor can be opened (e.g. running inside a container, on
+ *   hardware without sensors, or when the relevant kernel module is not
+ *   loaded), the constructor emits g_message() and returns 0.  The panel
+ *   skips the plugin and continues loading.
  *
  * Configuration (xconf keys):
- *   ThermalZone -- integer zone index N (default: 0).
- *                  Reads /sys/class/thermal/thermal_zone<N>/temp.
+ *   ThermalZone -- integer zone index N; use the thermal zone only.
+ *   Sensors     -- comma-separated glob patterns on "<chip>/<label>"
+ *                  (e.g. "coretemp/Package*, k10temp/Tctl, it87/fan*");
+ *                  default: all hwmon temperatures and fans.
+ *   ShowFans    -- list fan speeds in the tooltip (default: true).
+ *   Chart       -- plot the hottest temperature with the chart plugin
+ *                  instead of the label (default: false).
  *   WarnTemp    -- temperature in °C at which the label turns orange
  *                  (default: 70).
  *   CritTemp    -- temperature in °C at which the label turns red
- *                  (default: 90).
+ *                  (default: 90); also the chart's full scale.  The
+ *                  chart is green up to WarnTemp and orange above.
  *   Period      -- update interval in milliseconds (default: 5000).
  *
  * Data source:
- *   /sys/class/thermal/thermal_zone<N>/temp
- *   Value is in millidegrees Celsius.  Divided by 1000 to get °C.
+ *   temp*_input, thermal_zone<N>/temp -- millidegrees Celsius.
+ *   fan*_input                        -- RPM.
  *
  * Colour coding:
  *   < WarnTemp  -- no markup (default theme foreground)
  *   >= WarnTemp -- orange
  *   >= CritTemp -- red
+ *
+ * Struct layout (C-style inheritance):
+ *   thermal_priv embeds chart_priv as its FIRST member so the chart class
+ *   can drive it when Chart is set; otherwise the chart part is unused.
  */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "panel.h"
 #include "misc.h"
 #include "plugin.h"
+#include "../chart/chart.h"
 
 //#define DEBUGPRN
 #include "dbg.h"
 
+#define HWMON_DIR "/sys/class/hwmon"
+
+/* Upper bound on open sensor files per instance. */
+#define MAX_SENSORS 256
+
+/*
+ * thermal_sensor -- one open sensor file.
+ *
+ * name  -- "<chip>/<label>"; heap, freed with the sensor.
+ * fd    -- open attribute file.
+ * fan   -- TRUE for fan*_input (RPM), FALSE for a temperature.
+ * value -- last reading (millidegrees or RPM); valid if ok.
+ */
+typedef struct {
+    gchar    *name;
+    int       fd;
+    gboolean  fan;
+    gboolean  ok;
+    long      value;
+} thermal_sensor;
+
 /*
  * thermal_priv -- per-instance private state.
  *
- * plugin    -- base class (MUST be first).
- * label     -- GtkLabel showing the temperature string.
+ * chart     -- chart base class (MUST be first); used only if Chart is set.
+ * label     -- GtkLabel showing the temperature string; NULL in chart mode.
  * timer     -- GLib timeout source ID; 0 when inactive.
- * zone      -- thermal zone index.
+ * sensors   -- thermal_sensor* array, sorted by name; owned here.
+ * hottest   -- sensor shown in the label, or NULL if none could be read.
+ * zone      -- thermal zone index, or -1 for hwmon discovery.
+ * patterns  -- Sensors key value (non-owning xconf pointer), or NULL.
  * warn_temp -- °C threshold for orange colour.
  * crit_temp -- °C threshold for red colour.
  * period    -- polling interval in milliseconds.
- * path      -- heap-allocated sysfs path; g_free'd in destructor.
  */
 typedef struct {
-    plugin_instance  plugin;
+    chart_priv       chart;
     GtkWidget       *label;
     guint            timer;
+    GPtrArray       *sensors;
+    thermal_sensor  *hottest;
     int              zone;
+    gchar           *patterns;
+    gboolean         show_fans;
+    gboolean         use_chart;
     int              warn_temp;
     int              crit_temp;
     int              period;
-    gchar           *path;
+    gchar           *colors[2];
 } thermal_priv;
 
+/* Chart class, held only by instances with Chart set. */
+static chart_class *k;
+
+static void
+thermal_sensor_free(thermal_sensor *s)
+{
+    close(s->fd);
+    g_free(s->name);
+    g_free(s);
+}
+
+static gint
+thermal_sensor_cmp(gconstpointer a, gconstpointer b)
+{
+    const thermal_sensor *s1 = *(thermal_sensor **) a;
+    const thermal_sensor *s2 = *(thermal_sensor **) b;
+
+    if (s1->fan != s2->fan)
+        return s1->fan - s2->fan;
+    return g_strcmp0(s1->name, s2->name);
+}
+
+/*
+ * thermal_read -- re-read a sensor from offset 0 of its open file.
+ */
+static void
+thermal_read(thermal_sensor *s)
+{
+    gchar buf[24], *end;
+    ssize_t n;
+
+    do
+        n = pread(s->fd, buf, sizeof(buf) - 1, 0);
+    while (n < 0 && errno == EINTR);
+    s->ok = FALSE;
+    if (n <= 0)
+        return;
+    buf[n] = '\0';
+    s->value = strtol(buf, &end, 10);
+    s->ok = end != buf;
+}
+
+/*
+ * thermal_add -- open @path as a sensor named @name.
+ */
+static void
+thermal_add(thermal_priv *priv, const gchar *path, gchar *name, gboolean fan)
+{
+    thermal_sensor *s;
+    int fd;
+
+    if (priv->sensors->len >= MAX_SENSORS) {
+        g_free(name);
+        return;
+    }
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        DBG("%s: %s\n", path, strerror(errno));
+        g_free(name);
+        return;
+    }
+    s = g_new0(thermal_sensor, 1);
+    s->name = name;
+    s->fd = fd;
+    s->fan = fan;
+    g_ptr_array_add(priv->sensors, s);
+}
+
+/*
+ * thermal_wanted -- TRUE if @name matches one of the Sensors patterns
+ * (always TRUE without Sensors).
+ */
+static gboolean
+thermal_wanted(gchar **patterns, const gchar *name)
+{
+    if (!patterns)
+        return TRUE;
+    for (; *patterns; patterns++)
+        if (g_pattern_match_simple(g_strstrip(*patterns), name))
+            return TRUE;
+    return FALSE;
+}
+
+/*
+ * thermal_scan_dir -- add the temp*_input / fan*_input files of one hwmon
+ * attribute directory.
+ */
+static void
+thermal_scan_dir(thermal_priv *priv, const gchar *dir, const gchar *chip,
+    gchar **patterns)
+{
+    const gchar *file;
+    gchar *path, *label, *name, *kind;
+    gboolean fan;
+    GDir *d;
+    int idx;
+
+    if (!(d = g_dir_open(dir, 0, NULL)))
+        return;
+    while ((file = g_dir_read_name(d))) {
+        if (!g_str_has_suffix(file, "_input"))
+            continue;
+        if (sscanf(file, "temp%d_input", &idx) == 1)
+            fan = FALSE;
+        else if (sscanf(file, "fan%d_input", &idx) == 1)
+            fan = TRUE;
+        else
+            continue;
+        if (fan && !priv->show_fans)
+            continue;
+        kind = fan ? "fan" : "temp";
+        path = g_strdup_printf("%s/%s%d_label", dir, kind, idx);
+        if (g_file_get_contents(path, &label, NULL, NULL))
+            g_strstrip(label);
+        else
+            label = g_strdup_printf("%s%d", kind, idx);
+        g_free(path);
+        name = g_strdup_printf("%s/%s", chip, label);
+        g_free(label);
+        if (!thermal_wanted(patterns, name)) {
+            g_free(name);
+            continue;
+        }
+        path = g_build_filename(dir, file, NULL);
+        thermal_add(priv, path, name, fan);
+        g_free(path);
+    }
+    g_dir_close(d);
+}
+
 /*
- * thermal_update -- read current temperature and refresh the label.
+ * thermal_scan_hwmon -- discover all hwmon chips.
+ */
+static void
+thermal_scan_hwmon(thermal_priv *priv)
+{
+    const gchar *entry;
+    gchar *dir, *path, *chip, **patterns = NULL;
+    GDir *d;
+
+    ENTER;
+    if (!(d = g_dir_open(HWMON_DIR, 0, NULL)))
+        RET();
+    if (priv->patterns)
+        patterns = g_strsplit(priv->patterns, ",", 0);
+    while ((entry = g_dir_read_name(d))) {
+        dir = g_build_filename(HWMON_DIR, entry, NULL);
+        path = g_build_filename(dir, "name", NULL);
+        if (!g_file_get_contents(path, &chip, NULL, NULL)) {
+            /* pre-3.x drivers: attributes live in the device directory */
+            g_free(path);
+            path = g_build_filename(dir, "device", "name", NULL);
+            if (g_file_get_contents(path, &chip, NULL, NULL)) {
+                g_free(dir);
+                dir = g_build_filename(HWMON_DIR, entry, "device", NULL);
+            } else
+                chip = g_strdup(entry);
+        }
+        g_free(path);
+        g_strstrip(chip);
+        thermal_scan_dir(priv, dir, chip, patterns);
+        g_free(chip);
+        g_free(dir);
+    }
+    g_dir_close(d);
+    g_strfreev(patterns);
+    RET();
+}
+
+static gboolean
+thermal_has_temp(thermal_priv *priv)
+{
+    guint i;
+
+    for (i = 0; i < priv->sensors->len; i++)
+        if (!((thermal_sensor *) g_ptr_array_index(priv->sensors, i))->fan)
+            return TRUE;
+    return FALSE;
+}
+
+/*
+ * thermal_query_tooltip -- build the sensor table on demand.
+ */
+static gboolean
+thermal_query_tooltip(GtkWidget *widget, gint x, gint y, gboolean keyboard,
+    GtkTooltip *tooltip, thermal_priv *priv)
+{
+    thermal_sensor *s;
+    GString *str;
+    gchar *name;
+    guint i;
+
+    ENTER;
+    str = g_string_new(NULL);
+    if (priv->hottest) {
+        name = g_markup_escape_text(priv->hottest->name, -1);
+        g_string_append_printf(str, "<b>%s:</b> %ld°C\n", name,
+            priv->hottest->value / 1000);
+        g_free(name);
+    }
+    g_string_append_printf(str, "Warn: %d°C  Critical: %d°C",
+        priv->warn_temp, priv->crit_temp);
+    if (priv->sensors->len > 1) {
+        g_string_append(str, "\n");
+        for (i = 0; i < priv->sensors->len; i++) {
+            s = g_ptr_array_index(priv->sensors, i);
+            name = g_markup_escape_text(s->name, -1);
+            if (!s->ok)
+                g_string_append_printf(str, "\n%s: n/a", name);
+            else if (s->fan)
+                g_string_append_printf(str, "\n%s: %ld RPM", name, s->value);
+            else
+                g_string_append_printf(str, "\n%s: %ld°C", name,
+                    s->value / 1000);
+            g_free(name);
+        }
+    }
+    gtk_tooltip_set_markup(tooltip, str->str);
+    g_string_free(str, TRUE);
+    RET(TRUE);
+}
+
+/*
+ * thermal_update -- read all sensors and refresh the label or chart.
  *
  * Applies colour markup based on WarnTemp and CritTemp thresholds.
- * If the sysfs file is unreadable (e.g. hardware removed at runtime),
- * the label shows "n/a" without colour.
+ * If no temperature can be read (e.g. hardware removed at runtime), the
+ * label shows "n/a" without colour.
  *
  * Parameters:
  *   priv -- thermal_priv instance.
@@ -77,25 +356,40 @@ typedef struct {
 static gboolean
 thermal_update(thermal_priv *priv)
 {
-    FILE  *f;
-    long   millideg = 0;
-    int    deg;
+    thermal_sensor *s;
     gchar  markup[64];
-    gchar  tooltip[80];
+    float  val[2];
+    int    deg;
+    guint  i;
 
     ENTER;
+    priv->hottest = NULL;
+    for (i = 0; i < priv->sensors->len; i++) {
+        s = g_ptr_array_index(priv->sensors, i);
+        thermal_read(s);
+        if (s->ok && !s->fan
+                && (!priv->hottest || s->value > priv->hottest->value))
+            priv->hottest = s;
+    }
 
-    f = fopen(priv->path, "r");
-    if (!f) {
-        gtk_label_set_markup(GTK_LABEL(priv->label), "n/a");
+    if (priv->use_chart) {
+        val[0] = val[1] = 0;
+        if (priv->hottest && priv->crit_temp > 0) {
+            deg = priv->hottest->value / 1000;
+            val[0] = (float) MIN(deg, priv->warn_temp) / priv->crit_temp;
+            val[1] = (float) MAX(deg - priv->warn_temp, 0) / priv->crit_temp;
+        }
+        k->add_tick(&priv->chart, val);
         RET(TRUE);
     }
-    (void) fscanf(f, "%ld", &millideg);
-    fclose(f);
 
-    deg = (int)(millideg / 1000);
+    if (!priv->hottest) {
+        gtk_label_set_markup(GTK_LABEL(priv->label), "n/a");
+        RET(TRUE);
+    }
+    deg = (int)(priv->hottest->value / 1000);
 
-    DBG("thermal: zone%d = %d°C\n", priv->zone, deg);
+    DBG("thermal: %s = %d°C\n", priv->hottest->name, deg);
 
     if (deg >= priv->crit_temp) {
         g_snprintf(markup, sizeof(markup),
@@ -108,21 +402,14 @@ thermal_update(thermal_priv *priv)
     }
 
     gtk_label_set_markup(GTK_LABEL(priv->label), markup);
-
-    g_snprintf(tooltip, sizeof(tooltip),
-               "<b>Thermal zone %d:</b> %d°C\n"
-               "Warn: %d°C  Critical: %d°C",
-               priv->zone, deg, priv->warn_temp, priv->crit_temp);
-    gtk_widget_set_tooltip_markup(priv->plugin.pwid, tooltip);
-
     RET(TRUE);
 }
 
 /*
  * thermal_constructor -- initialise the thermal plugin.
  *
- * Reads config, builds the sysfs path, and probes it.  Returns 0
- * (soft-disable) if the path does not exist.
+ * Reads config, opens the sensor files and builds the label or chart.
+ * Returns 0 (soft-disable) if no temperature sensor can be opened.
  *
  * Returns: 1 on success, 0 on soft-disable.
  */
@@ -130,41 +417,73 @@ static int
 thermal_constructor(plugin_instance *p)
 {
     thermal_priv *priv;
-    FILE         *probe;
+    gchar        *path;
 
     ENTER;
 
     priv = (thermal_priv *) p;
-    priv->zone      = 0;
+    priv->zone      = -1;
+    priv->patterns  = NULL;
+    priv->show_fans = TRUE;
+    priv->use_chart = FALSE;
     priv->warn_temp = 70;
     priv->crit_temp = 90;
     priv->period    = 5000;
+    priv->colors[0] = "green";
+    priv->colors[1] = "orange";
 
     XCG(p->xc, "ThermalZone", &priv->zone,      int);
+    XCG(p->xc, "Sensors",     &priv->patterns,  str);
+    XCG(p->xc, "ShowFans",    &priv->show_fans, enum, bool_enum);
+    XCG(p->xc, "Chart",       &priv->use_chart, enum, bool_enum);
     XCG(p->xc, "WarnTemp",    &priv->warn_temp,  int);
     XCG(p->xc, "CritTemp",    &priv->crit_temp,  int);
     XCG(p->xc, "Period",      &priv->period,      int);
 
     if (priv->period < 500)
         priv->period = 500;
-    if (priv->zone < 0)
-        priv->zone = 0;
 
-    priv->path = g_strdup_printf(
-        "/sys/class/thermal/thermal_zone%d/temp", priv->zone);
-
-    probe = fopen(priv->path, "r");
-    if (!probe) {
-        g_message("thermal: %s not available — plugin disabled", priv->path);
-        g_free(priv->path);
-        priv->path = NULL;
-        RET(0);
+    priv->sensors = g_ptr_array_new_with_free_func(
+        (GDestroyNotify) thermal_sensor_free);
+    if (priv->zone < 0)
+        thermal_scan_hwmon(priv);
+    if (!thermal_has_temp(priv)) {
+        if (priv->zone < 0)
+            priv->zone = 0;
+        path = g_strdup_printf(
+            "/sys/class/thermal/thermal_zone%d/temp", priv->zone);
+        thermal_add(priv, path,
+            g_strdup_printf("thermal_zone%d", priv->zone), FALSE);
+        if (!thermal_has_temp(priv)) {
+            g_message("thermal: no hwmon sensor and %s not available"
+                " — plugin disabled", path);
+            g_free(path);
+            g_ptr_array_free(priv->sensors, TRUE);
+            priv->sensors = NULL;
+            RET(0);
+        }
+        g_free(path);
     }
-    fclose(probe);
+    g_ptr_array_sort(priv->sensors, thermal_sensor_cmp);
 
-    priv->label = gtk_label_new("...");
-    gtk_container_add(GTK_CONTAINER(p->pwid), priv->label);
-    gtk_widget_show(priv->label);
+    if (priv->use_chart) {
+        if (!(k = class_get("chart"))) {
+            g_message("thermal: 'chart' plugin unavailable — using label");
+            priv->use_chart = FALSE;
+        } else if (!PLUGIN_CLASS(k)->constructor(p)) {
+            class_put("chart");
+            priv->use_chart = FALSE;
+        } else
+            k->set_rows(&priv->chart, 2, priv->colors);
+    }
+    if (!priv->use_chart) {
+        priv->label = gtk_label_new("...");
+        gtk_container_add(GTK_CONTAINER(p->pwid), priv->label);
+        gtk_widget_show(priv->label);
+    }
+    gtk_widget_set_has_tooltip(p->pwid, TRUE);
+    g_signal_connect(G_OBJECT(p->pwid), "query-tooltip",
+        G_CALLBACK(thermal_query_tooltip), priv);
 
     thermal_update(priv);
     priv->timer = g_timeout_add(priv->period,
@@ -175,7 +494,7 @@ thermal_constructor(plugin_instance *p)
 /*
  * thermal_destructor -- clean up thermal plugin resources.
  *
- * Cancels the timer and frees the heap-allocated sysfs path.
+ * Cancels the timer, closes the sensor files and releases the chart.
  *
  * Parameters:
  *   p -- plugin_instance pointer.
@@ -190,8 +509,14 @@ thermal_destructor(plugin_instance *p)
         g_source_remove(priv->timer);
         priv->timer = 0;
     }
-    g_free(priv->path);
-    priv->path = NULL;
+    g_signal_handlers_disconnect_by_func(G_OBJECT(p->pwid),
+        thermal_query_tooltip, priv);
+    if (priv->use_chart) {
+        PLUGIN_CLASS(k)->destructor(p);
+        class_put("chart");
+    }
+    g_ptr_array_free(priv->sensors, TRUE);
+    priv->sensors = NULL;
     RET();
 }
 
@@ -199,8 +524,8 @@ static plugin_class class = {
     .count       = 0,
     .type        = "thermal",
     .name        = "Thermal Monitor",
-    .version     = "1.0",
-    .description = "Display CPU/board temperature from thermal sysfs",
+    .version     = "2.0",
+    .description = "Display the hottest hwmon/thermal sensor, with fans",
     .priv_size   = sizeof(thermal_priv),
     .constructor = thermal_constructor,
     .destructor  = thermal_destructor,
@@ -26,7 +26,10 @@
  *   - Receive _NET_SYSTEM_TRAY_OPCODE ClientMessage events (dock requests,
  *     balloon messages, message cancellations)
  *   - Create GtkSocket widgets and embed tray client windows via XEMBED
+ *   - Advertise a 32-bit ARGB visual via _NET_SYSTEM_TRAY_VISUAL and host
+ *     ARGB clients in composited sockets (see "ARGB icons" below)
  *   - Reassemble multi-packet balloon messages from MESSAGE_DATA events
+ *     (one in-flight message per client, at most MESSAGE_MAX_LEN bytes kept)
  *   - Emit GObject signals to notify the host application (fbpanel main.c)
  *   - Release the selection and clean up on finalize or SelectionClear
  *
@@ -37,6 +40,17 @@
  *   XEMBED_FOCUS_OUT, XEMBED_WINDOW_ACTIVATE, etc.  The plug reparents its
  *   window into the socket's X window.  GTK handles most of this internally.
  *
+ * ARGB icons:
+ *   When the display supports compositing and the screen has an RGBA
+ *   visual, that visual is advertised in _NET_SYSTEM_TRAY_VISUAL on the
+ *   manager window (otherwise the default visual is).  A client whose
+ *   icon window uses the RGBA visual gets a socket with the RGBA colormap,
+ *   a transparent background and gdk_window_set_composited(): the X server
+ *   (XComposite) keeps it offscreen and the host paints it over the panel
+ *   background with cairo (XRender), see egg_tray_manager_child_is_alpha()
+ *   and tray_expose_icons() in main.c.  Such icons never re-sample the
+ *   background.  Clients with other visuals keep the ParentRelative path.
+ *
  * GTK2 API usage (not compatible with GTK3):
  *   - GTK_WIDGET_NO_WINDOW() macro (use gtk_widget_get_has_window() in GTK3)
  *   - widget->window direct field access (use gtk_widget_get_window() in GTK3)
@@ -49,6 +63,7 @@
  */
 
 #include <string.h>
+#include <X11/Xatom.h>
 #include <gdk/gdkx.h>
 #include <gtk/gtkinvisible.h>
 #include <gtk/gtksocket.h>
@@ -90,9 +105,16 @@ enum
  *                   0 means "display until dismissed"
  *   window        - X Window ID of the sending tray client (used to match
  *                   subsequent MESSAGE_DATA events to this pending entry)
- *   str           - heap-allocated buffer of size (len+1); partially filled
+ *   size          - bytes actually kept: MIN(len, MESSAGE_MAX_LEN); data
+ *                   past that is counted down but discarded
+ *   str           - heap-allocated buffer of size (size+1); partially filled
  *                   as MESSAGE_DATA events arrive; NUL-terminated up front
- *                   (str[len] = '\0' set at allocation time)
+ *                   (str[size] = '\0' set at allocation time)
+ *
+ * A client has at most one PendingMessage: MESSAGE_DATA carries no id, so
+ * fragments are matched by sender window only, and a new BEGIN_MESSAGE
+ * abandons whatever that client had in flight.  Together with the size cap
+ * this bounds what a client can make us allocate to MESSAGE_MAX_LEN bytes.
  *
  * Memory: allocated via g_new0, freed by pending_message_free().
  * str is allocated via g_malloc and freed in pending_message_free().
@@ -101,6 +123,7 @@ typedef struct
 {
   long id, len;
   long remaining_len;
+  long size;
 
   long timeout;
   Window window;
@@ -124,6 +147,9 @@ static guint manager_signals[LAST_SIGNAL] = { 0 };
 #define SYSTEM_TRAY_BEGIN_MESSAGE   1  /* client starts a balloon message */
 #define SYSTEM_TRAY_CANCEL_MESSAGE  2  /* client cancels a balloon message */
 
+/* Longest balloon text kept; the rest of a longer message is dropped.    */
+#define MESSAGE_MAX_LEN  4096
+
 /* Forward declarations for functions used before they are defined. */
 static gboolean egg_tray_manager_check_running_xscreen (Screen *xscreen);
 
@@ -133,6 +159,7 @@ static void egg_tray_manager_class_init (EggTrayManagerClass *klass);
 static void egg_tray_manager_finalize (GObject *object);
 
 static void egg_tray_manager_unmanage (EggTrayManager *manager);
+static void pending_message_drop (EggTrayManager *manager, Window window);
 
 /*
  * egg_tray_manager_get_type - register and return the GType for EggTrayManager.
@@ -304,9 +331,7 @@ egg_tray_manager_class_init (EggTrayManagerClass *klass)
  *   object - the GObject being finalized; cast to EggTrayManager *
  *
  * Note: After egg_tray_manager_unmanage() the invisible window is destroyed
- * and manager->invisible is set to NULL.  Pending messages are NOT freed
- * here - this is a bug; memory is leaked if messages are in flight when
- * the manager is finalized.
+ * and manager->invisible is set to NULL; in-flight messages are freed there.
  */
 static void
 egg_tray_manager_finalize (GObject *object)
@@ -385,6 +410,8 @@ egg_tray_manager_plug_removed (GtkSocket       *socket,
     // on 64-bit systems only the lower 32 bits are used, which is sufficient
     // for X11 XIDs (they are 29-bit values per the X protocol).
     g_hash_table_remove (manager->socket_table, GINT_TO_POINTER (*window));
+    // A half-received balloon from this client can never complete now.
+    pending_message_drop (manager, *window);
 
     // Clear the object data; this triggers g_free on the Window * buffer via
     // the destroy notify registered in g_object_set_data_full.
@@ -429,6 +456,8 @@ egg_tray_manager_socket_exposed (GtkWidget      *widget,
       gpointer        user_data)
 {
     ENTER;
+    if (egg_tray_manager_child_is_alpha ((EggTrayManagerChild *) widget))
+        RET(FALSE);   /* composited: the client draws, the host blends */
     // Clear only the damaged region (event->area) rather than the whole socket,
     // using the window's inherited background pixmap (set to parent's background).
     gdk_window_clear_area (widget->window,
@@ -468,6 +497,16 @@ egg_tray_manager_make_socket_transparent (GtkWidget *widget,
     // Skip widgets that do not have their own GdkWindow (share parent's window).
     if (GTK_WIDGET_NO_WINDOW (widget))
         RET();
+    if (egg_tray_manager_child_is_alpha ((EggTrayManagerChild *) widget))
+      {
+        GdkColor transparent = { 0, 0, 0, 0 };  /* pixel 0: alpha 0 */
+
+        /* ParentRelative across depths is BadMatch; an ARGB socket is
+         * cleared to transparent and composited by the host instead. */
+        gdk_window_set_background (widget->window, &transparent);
+        gdk_window_set_composited (widget->window, TRUE);
+        RET();
+      }
     // NULL pixmap + TRUE (parent_relative) = use parent window's background.
     // This is the classic GTK2 pattern for pseudo-transparency.
     gdk_window_set_back_pixmap (widget->window, NULL, TRUE);
@@ -568,10 +607,31 @@ egg_tray_manager_handle_dock_request(EggTrayManager *manager,
 {
     GtkWidget *socket;
     Window *window;
+    XWindowAttributes wa;
+    GdkVisual *rgba;
 
     ENTER;
+    // Look at the icon window first: its visual decides how it is hosted.
+    gdk_error_trap_push();
+    XGetWindowAttributes(GDK_DISPLAY(), xevent->data.l[2], &wa);
+    if (gdk_error_trap_pop()) {
+        ERR("can't embed window %lx\n", xevent->data.l[2]);
+        RET();
+    }
     // Create a new GtkSocket to host the tray client's X window.
     socket = gtk_socket_new ();
+    rgba = manager->composited ? gdk_screen_get_rgba_visual (manager->screen)
+        : NULL;
+    if (rgba && XVisualIDFromVisual (wa.visual)
+          == XVisualIDFromVisual (GDK_VISUAL_XVISUAL (rgba)))
+      {
+        // ARGB client: the socket must share its depth to embed it.
+        DBG("ARGB icon %lx\n", xevent->data.l[2]);
+        gtk_widget_set_colormap (socket,
+            gdk_screen_get_rgba_colormap (manager->screen));
+        g_object_set_data (G_OBJECT (socket), "egg-tray-child-alpha",
+            GINT_TO_POINTER (1));
+      }
     // app_paintable=TRUE prevents GTK from erasing the socket background
     // before expose events, which would interfere with our transparency trick.
     gtk_widget_set_app_paintable (socket, TRUE);
@@ -622,7 +682,6 @@ egg_tray_manager_handle_dock_request(EggTrayManager *manager,
     // be returned if the socket has no parent).
     if (GTK_IS_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(socket)))) {
         GtkRequisition req;
-        XWindowAttributes wa;
 
         DBG("socket has window. going on\n");
         // Initiate XEMBED: reparent the client's X window into this socket.
@@ -683,6 +742,36 @@ pending_message_free (PendingMessage *message)
   g_free (message);
 }
 
+/*
+ * pending_message_find - return the messages list node of a client's
+ * in-flight message, or NULL if it has none.
+ */
+static GList *
+pending_message_find (EggTrayManager *manager, Window window)
+{
+  GList *p;
+
+  for (p = manager->messages; p; p = p->next)
+    if (((PendingMessage *) p->data)->window == window)
+      return p;
+  return NULL;
+}
+
+/*
+ * pending_message_drop - free a client's in-flight message, if any.
+ */
+static void
+pending_message_drop (EggTrayManager *manager, Window window)
+{
+  GList *p;
+
+  if ((p = pending_message_find (manager, window)))
+    {
+      pending_message_free (p->data);
+      manager->messages = g_list_delete_link (manager->messages, p);
+    }
+}
+
 /*
  * egg_tray_manager_handle_message_data - process _NET_SYSTEM_TRAY_MESSAGE_DATA.
  *
@@ -701,76 +790,54 @@ pending_message_free (PendingMessage *message)
  *   how much is actually valid.  Only MIN(remaining_len, 20) bytes are
  *   copied into msg->str to avoid buffer overrun.
  *
+ * Bytes past msg->size (MESSAGE_MAX_LEN) are counted but not stored, so an
+ * over-long message still completes, truncated.  Fragments from a client
+ * with no message in flight (never begun, cancelled or abandoned) are
+ * ignored.
+ *
  * Memory: The PendingMessage is removed from manager->messages and freed
- * via pending_message_free when the message is complete.  The GList node
- * is freed by g_list_remove_link.
- *
- * NOTE: g_list_remove_link removes the GList node but does NOT free it.
- * The node 'p' is leaked here.  Should be g_list_delete_link instead.
- * (This is a minor memory leak: one GList node per completed message.)
- *
- * BUG: memcpy copies from &xevent->data (the XClientMessageEvent data union
- * start) which is correct - the 20 bytes of data.b[] are at that address.
- * However, if the client sends more data events than expected (i.e. sends
- * data after remaining_len has hit 0 from a previous message), the extra
- * events are silently ignored because the PendingMessage has been freed
- * and removed from the list.
+ * via pending_message_free when the message is complete.
  */
 static void
 egg_tray_manager_handle_message_data (EggTrayManager       *manager,
 				       XClientMessageEvent  *xevent)
 {
+  PendingMessage *msg;
   GList *p;
+  long off;
   int len;
 
-  /* Try to see if we can find the
-   * pending message in the list
-   */
-  for (p = manager->messages; p; p = p->next)
+  if (!(p = pending_message_find (manager, xevent->window)))
+    return;
+  msg = p->data;
+
+  // Clamp to at most 20 bytes (XClientMessageEvent data payload size)
+  // and at most the remaining bytes we expect.
+  len = MIN (msg->remaining_len, 20);
+  // Offset of this fragment in the message; store only what fits.
+  off = msg->len - msg->remaining_len;
+  if (off < msg->size)
+    memcpy (msg->str + off, &xevent->data, MIN (len, msg->size - off));
+  msg->remaining_len -= len;
+
+  if (msg->remaining_len == 0)
     {
-      PendingMessage *msg = p->data;
-
-      if (xevent->window == msg->window)
-	{
-	  /* Append the message */
-          // Clamp to at most 20 bytes (XClientMessageEvent data payload size)
-          // and at most the remaining bytes we expect.
-	  len = MIN (msg->remaining_len, 20);
-
-          // Append 'len' bytes from the event data into the correct position
-          // in msg->str.  The offset (msg->len - msg->remaining_len) gives
-          // the number of bytes already received.
-	  memcpy ((msg->str + msg->len - msg->remaining_len),
-		  &xevent->data, len);
-	  msg->remaining_len -= len;
-
-	  if (msg->remaining_len == 0)
-	    {
-	      GtkSocket *socket;
-
-              // Locate the socket for the window that sent this message
-              // using the XID->socket hash table.
-	      socket = g_hash_table_lookup (manager->socket_table, GINT_TO_POINTER (msg->window));
-
-	      if (socket)
-		{
-                  // Full message assembled; notify the host application.
-                  // msg->str is NUL-terminated (set at allocation time in
-                  // handle_begin_message: msg->str[msg->len] = '\0').
-		  g_signal_emit (manager, manager_signals[MESSAGE_SENT], 0,
-				 socket, msg->str, msg->id, msg->timeout);
-		}
-              // Remove this PendingMessage from the in-flight list.
-              // g_list_remove_link removes the node but does NOT free it;
-              // the node 'p' is a GList cell leak here (minor).
-	      manager->messages = g_list_remove_link (manager->messages,
-						      p);
-
-	      pending_message_free (msg);
-	    }
-
-	  return;
-	}
+      GtkSocket *socket;
+
+      // Locate the socket for the window that sent this message
+      // using the XID->socket hash table.
+      socket = g_hash_table_lookup (manager->socket_table,
+          GINT_TO_POINTER (msg->window));
+      manager->messages = g_list_delete_link (manager->messages, p);
+      if (socket)
+        {
+          // Full message assembled; notify the host application.
+          // msg->str is NUL-terminated (set at allocation time in
+          // handle_begin_message: msg->str[msg->size] = '\0').
+          g_signal_emit (manager, manager_signals[MESSAGE_SENT], 0,
+              socket, msg->str, msg->id, msg->timeout);
+        }
+      pending_message_free (msg);
     }
 }
 
@@ -779,8 +846,8 @@ egg_tray_manager_handle_message_data (EggTrayManager       *manager,
  *
  * Called when a tray client starts a balloon message via opcode 1.
  * Creates a new PendingMessage structure and prepends it to manager->messages.
- * If a message with the same id from the same window is already pending
- * (e.g. client re-sent before completion), the old one is replaced.
+ * Any message the client still has in flight is abandoned first (see
+ * PendingMessage).  Empty or negative-length messages are ignored.
  *
  * ClientMessage data layout for BEGIN_MESSAGE:
  *   data.l[0] = timestamp (unused here)
@@ -794,58 +861,30 @@ egg_tray_manager_handle_message_data (EggTrayManager       *manager,
  *   xevent  - the XClientMessageEvent with the begin-message opcode
  *
  * Memory: Allocates a PendingMessage (g_new0) and a string buffer
- * (g_malloc of len+1 bytes).  Both are freed by pending_message_free when
- * the message completes or is cancelled.
- *
- * BUG: If msg->len is 0 (the client sends a zero-length message), g_malloc(1)
- * is called and msg->str[0] = '\0' is set.  Zero subsequent MESSAGE_DATA
- * events will arrive so remaining_len starts at 0 and the message completes
- * immediately in handle_message_data.  However, because no MESSAGE_DATA
- * arrives, the completion code in handle_message_data is NEVER triggered -
- * the zero-length message sits in manager->messages forever (memory leak).
- *
- * BUG: g_list_remove_link in handle_message_data leaks the GList node 'p'.
- * Should use g_list_delete_link.
+ * (g_malloc of MIN(len, MESSAGE_MAX_LEN)+1 bytes).  Both are freed by
+ * pending_message_free when the message completes or is dropped.
  */
 static void
 egg_tray_manager_handle_begin_message (EggTrayManager       *manager,
 				       XClientMessageEvent  *xevent)
 {
-  GList *p;
   PendingMessage *msg;
 
-  /* Check if the same message is
-   * already in the queue and remove it if so
-   */
-  for (p = manager->messages; p; p = p->next)
-    {
-      PendingMessage *msg = p->data;
-
-      // Match on both window and message id to identify duplicate begins.
-      if (xevent->window == msg->window &&
-	  xevent->data.l[4] == msg->id)
-	{
-	  /* Hmm, we found it, now remove it */
-          // Free the old PendingMessage and its string buffer.
-	  pending_message_free (msg);
-          // Remove the GList node; g_list_remove_link does NOT free 'p'.
-          // Minor memory leak: the GList node cell is not freed.
-	  manager->messages = g_list_remove_link (manager->messages, p);
-	  break;
-	}
-    }
+  pending_message_drop (manager, xevent->window);
+  if (xevent->data.l[3] <= 0)
+    return;
 
-  /* Now add the new message to the queue */
   msg = g_new0 (PendingMessage, 1);
   msg->window = xevent->window;       // X Window ID of the sending tray client
   msg->timeout = xevent->data.l[2];   // requested display duration (ms)
   msg->len = xevent->data.l[3];       // total message byte count
   msg->id = xevent->data.l[4];        // client-assigned message identifier
   msg->remaining_len = msg->len;       // starts equal to total length
+  msg->size = MIN (msg->len, MESSAGE_MAX_LEN);
   // Allocate buffer with NUL terminator; g_malloc (not g_malloc0) so
   // contents are undefined until filled by MESSAGE_DATA events.
-  msg->str = g_malloc (msg->len + 1);
-  msg->str[msg->len] = '\0';           // ensure NUL termination up front
+  msg->str = g_malloc (msg->size + 1);
+  msg->str[msg->size] = '\0';          // ensure NUL termination up front
   // Prepend is O(1); list order doesn't matter for lookup-by-window.
   manager->messages = g_list_prepend (manager->messages, msg);
 }
@@ -866,16 +905,19 @@ egg_tray_manager_handle_begin_message (EggTrayManager       *manager,
  *   manager - the EggTrayManager
  *   xevent  - the XClientMessageEvent with the cancel opcode
  *
- * NOTE: This does NOT search and remove any matching PendingMessage from
- * manager->messages.  If the message is still in-flight (not yet fully
- * received), it will continue to accumulate data and eventually emit
- * "message_sent" even though it was supposedly cancelled.  This is a bug.
+ * A matching message still in flight is dropped as well, so it never
+ * reaches "message_sent".
  */
 static void
 egg_tray_manager_handle_cancel_message (EggTrayManager       *manager,
 					XClientMessageEvent  *xevent)
 {
   GtkSocket *socket;
+  GList *p;
+
+  if ((p = pending_message_find (manager, xevent->window)) &&
+      ((PendingMessage *) p->data)->id == xevent->data.l[2])
+    pending_message_drop (manager, xevent->window);
 
   // Look up the socket that corresponds to the cancelling window.
   socket = g_hash_table_lookup (manager->socket_table, GINT_TO_POINTER (xevent->window));
@@ -1021,9 +1063,7 @@ egg_tray_manager_window_filter (GdkXEvent *xev, GdkEvent *event, gpointer data)
  * them.  The hash table is created in init but never destroyed in finalize -
  * this is a memory leak (the hash table itself is not freed).
  *
- * NOTE: Pending messages (manager->messages GList) are not freed here;
- * this is a memory leak if there are in-flight balloon messages when
- * unmanage is called.
+ * In-flight balloon messages (manager->messages) are freed here.
  *
  * GTK2 note: GTK_WIDGET_REALIZED() is a deprecated macro in GTK2 and
  * does not exist in GTK3; use gtk_widget_get_realized() instead.
@@ -1064,6 +1104,10 @@ egg_tray_manager_unmanage (EggTrayManager *manager)
   gdk_window_remove_filter (invisible->window, egg_tray_manager_window_filter, manager);
 
   manager->invisible = NULL; /* prior to destroy for reentrancy paranoia */
+  g_list_foreach (manager->messages, (GFunc) pending_message_free, NULL);
+  g_list_free (manager->messages);
+  manager->messages = NULL;
+  manager->screen = NULL;
   // Destroy the GTK widget (destroys the underlying X window).
   gtk_widget_destroy (invisible);
   // Release the extra GObject reference we took in manage_xscreen to keep
@@ -1071,6 +1115,39 @@ egg_tray_manager_unmanage (EggTrayManager *manager)
   g_object_unref (G_OBJECT (invisible));
 }
 
+/*
+ * egg_tray_manager_set_visual_property - set _NET_SYSTEM_TRAY_VISUAL.
+ *
+ * Advertises the screen's RGBA visual when the display can composite
+ * (XComposite) and one exists, so clients may create ARGB icon windows;
+ * the default visual otherwise.  Records the choice in manager->composited.
+ *
+ * Parameters:
+ *   manager - the EggTrayManager; manager->screen must be set
+ *   window  - the selection owner window (the manager's GtkInvisible)
+ */
+static void
+egg_tray_manager_set_visual_property (EggTrayManager *manager,
+    GdkWindow *window)
+{
+  GdkVisual *visual;
+  Atom visual_atom;
+  gulong data[1];
+
+  visual = gdk_screen_get_rgba_visual (manager->screen);
+  manager->composited = visual != NULL
+      && gdk_display_supports_composite (gdk_screen_get_display (manager->screen));
+  if (!manager->composited)
+    visual = gdk_screen_get_system_visual (manager->screen);
+  DBG("tray visual: %s\n", manager->composited ? "ARGB" : "default");
+
+  visual_atom = XInternAtom (GDK_WINDOW_XDISPLAY (window),
+      "_NET_SYSTEM_TRAY_VISUAL", False);
+  data[0] = XVisualIDFromVisual (GDK_VISUAL_XVISUAL (visual));
+  XChangeProperty (GDK_WINDOW_XDISPLAY (window), GDK_WINDOW_XWINDOW (window),
+      visual_atom, XA_VISUALID, 32, PropModeReplace, (guchar *) data, 1);
+}
+
 /*
  * egg_tray_manager_manage_xscreen - low-level screen management on a Screen *.
  *
@@ -1080,8 +1157,7 @@ egg_tray_manager_unmanage (EggTrayManager *manager)
  *
  * Parameters:
  *   manager - the EggTrayManager (must not already be managing a screen;
- *             checked by manager->screen == NULL guard - BUT screen is never
- *             assigned, so this guard is effectively non-functional)
+ *             checked by the manager->screen == NULL guard)
  *   xscreen - the Xlib Screen * to manage
  *
  * Returns: TRUE on success (selection acquired), FALSE if selection acquisition
@@ -1092,7 +1168,8 @@ egg_tray_manager_unmanage (EggTrayManager *manager)
  *   2. Intern "_NET_SYSTEM_TRAY_S<n>" atom.
  *   3. XSetSelectionOwner with a fresh server timestamp.
  *   4. Verify ownership with XGetSelectionOwner (TOCTOU race possible).
- *   5. If owned, broadcast MANAGER ClientMessage to root window with
+ *   5. If owned, set manager->screen, publish _NET_SYSTEM_TRAY_VISUAL and
+ *      broadcast MANAGER ClientMessage to root window with
  *      StructureNotifyMask so all clients receive it.
  *   6. Intern opcode and message_data atoms.
  *   7. Install GDK window filter on the invisible window.
@@ -1104,11 +1181,6 @@ egg_tray_manager_unmanage (EggTrayManager *manager)
  *
  * Memory: invisible is g_object_ref'd after creation (refcount becomes 2);
  * the extra ref is dropped in egg_tray_manager_unmanage.
- *
- * BUG: manager->screen is never assigned in this function; the precondition
- * `g_return_val_if_fail(manager->screen == NULL, FALSE)` in manage_screen
- * always passes (since screen starts NULL and is never set).  Calling
- * manage_screen twice on the same manager is NOT prevented.
  */
 static gboolean
 egg_tray_manager_manage_xscreen (EggTrayManager *manager, Screen *xscreen)
@@ -1119,8 +1191,7 @@ egg_tray_manager_manage_xscreen (EggTrayManager *manager, Screen *xscreen)
   GdkScreen *screen;
 
   g_return_val_if_fail (EGG_IS_TRAY_MANAGER (manager), FALSE);
-  // This guard is meant to prevent managing a screen twice, but since
-  // manager->screen is never assigned anywhere, it always passes.
+  // Prevents managing a screen twice; manager->screen is set on success.
   g_return_val_if_fail (manager->screen == NULL, FALSE);
 
   /* If there's already a manager running on the screen
@@ -1174,6 +1245,11 @@ egg_tray_manager_manage_xscreen (EggTrayManager *manager, Screen *xscreen)
       // Broadcast MANAGER announcement to the root window so that tray
       // clients waiting for a manager (via SubstructureNotifyMask/StructureNotifyMask)
       // will know they can now send dock requests.
+      // Publish the icon visual before announcing ourselves: clients read
+      // it when they see MANAGER.
+      manager->screen = screen;
+      egg_tray_manager_set_visual_property (manager, invisible->window);
+
       xev.type = ClientMessage;
       xev.window = RootWindowOfScreen (xscreen);
       xev.message_type = XInternAtom (DisplayOfScreen (xscreen), "MANAGER", False);
@@ -1229,23 +1305,18 @@ egg_tray_manager_manage_xscreen (EggTrayManager *manager, Screen *xscreen)
  *
  * Parameters:
  *   manager - the EggTrayManager; must not be NULL and must not already
- *             be managing a screen (manager->screen == NULL - but see BUG)
+ *             be managing a screen (manager->screen == NULL)
  *   screen  - the GdkScreen to manage; must be a valid GDK X11 screen
  *
  * Returns: TRUE if the selection was acquired and management started,
  *          FALSE otherwise.
- *
- * BUG: manager->screen is checked (== NULL) but never set, so the guard
- * g_return_val_if_fail(manager->screen == NULL) is always TRUE and provides
- * no protection against double-managing.
  */
 gboolean
 egg_tray_manager_manage_screen (EggTrayManager *manager,
 				GdkScreen      *screen)
 {
   g_return_val_if_fail (GDK_IS_SCREEN (screen), FALSE);
-  // This guard is meant to prevent re-managing the same manager but is
-  // ineffective because manager->screen is never set (see above).
+  // Prevents re-managing the same manager.
   g_return_val_if_fail (manager->screen == NULL, FALSE);
 
   return egg_tray_manager_manage_xscreen (manager,
@@ -1403,3 +1474,19 @@ egg_tray_manager_get_child_title (EggTrayManager *manager,
   return retval;  // caller must g_free() this
 
 }
+
+/*
+ * egg_tray_manager_child_is_alpha - is this icon an ARGB (composited) one?
+ *
+ * Parameters:
+ *   child - a GtkSocket delivered via "tray_icon_added"
+ *
+ * Returns: TRUE if the client uses the advertised RGBA visual; its socket
+ *          is composited and must be painted by the host in its expose
+ *          handler (e.g. with gdk_cairo_set_source_pixmap on child->window).
+ */
+gboolean
+egg_tray_manager_child_is_alpha (EggTrayManagerChild *child)
+{
+  return g_object_get_data (G_OBJECT (child), "egg-tray-child-alpha") != NULL;
+}
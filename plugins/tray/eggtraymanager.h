@@ -105,9 +105,10 @@ typedef struct _EggTrayManagerChild  EggTrayManagerChild;
  *   invisible  - GtkInvisible widget whose underlying X window is used as
  *                the selection owner window.  Holds one extra GObject ref
  *                (see egg_tray_manager_manage_xscreen).  NULL after unmanage.
- *   screen     - the GdkScreen being managed; NULL until manage_screen() is
- *                called.  Currently set in egg_tray_manager_manage_xscreen
- *                but never actually assigned to manager->screen (BUG).
+ *   screen     - the GdkScreen being managed; NULL until manage_screen()
+ *                succeeds and again after unmanage.
+ *   composited - TRUE if an ARGB visual is advertised in
+ *                _NET_SYSTEM_TRAY_VISUAL (RGBA visual + XComposite).
  *
  *   messages     - GList of PendingMessage * for in-flight balloon messages;
  *                  each entry is freed when all data arrives or on unmanage
@@ -127,6 +128,7 @@ struct _EggTrayManager
 
   GtkWidget *invisible;
   GdkScreen *screen;
+  gboolean composited;
 
   GList *messages;
   GHashTable *socket_table;
@@ -249,11 +251,10 @@ EggTrayManager *egg_tray_manager_new             (void);
  *   - Installs a GDK window filter to receive ClientMessage events
  *   - Interns the _NET_SYSTEM_TRAY_OPCODE and _NET_SYSTEM_TRAY_MESSAGE_DATA
  *     atoms for later ClientMessage identification
+ *   - Publishes _NET_SYSTEM_TRAY_VISUAL (ARGB when the display composites)
  *
- * NOTE: manager->screen is never assigned (BUG in implementation); the
- * precondition check `manager->screen == NULL` in egg_tray_manager_manage_screen
- * will always pass on a fresh manager, but the field is never set, so calling
- * manage_screen() twice on the same manager will not be prevented by the guard.
+ * Calling manage_screen() twice on the same manager fails the
+ * manager->screen == NULL precondition.
  */
 gboolean        egg_tray_manager_manage_screen   (EggTrayManager      *manager,
 						  GdkScreen           *screen);
@@ -282,6 +283,13 @@ gboolean        egg_tray_manager_manage_screen   (EggTrayManager      *manager,
 char           *egg_tray_manager_get_child_title (EggTrayManager      *manager,
 						  EggTrayManagerChild *child);
 
+/*
+ * egg_tray_manager_child_is_alpha - TRUE if the icon uses the advertised
+ * ARGB visual.  Its socket window is composited (offscreen) and the host
+ * must paint it over its own background in an expose handler.
+ */
+gboolean        egg_tray_manager_child_is_alpha  (EggTrayManagerChild *child);
+
 G_END_DECLS
 
 #endif /* __EGG_TRAY_MANAGER_H__ */
@@ -20,7 +20,7 @@
  */
 
 /*
- * fixedtip.c -- singleton fixed tooltip window positioned adjacent to the panel.
+ * fixedtip.c -- fixed tooltip window positioned adjacent to the panel.
  *
  * Unlike standard GTK tooltips (which follow the mouse and use
  * screen-relative timers), this tooltip is placed at an explicit
@@ -28,42 +28,59 @@
  *
  * Derived from Metacity's fixed-tip implementation.
  *
- * Singleton state:
- *   tip          - the popup GtkWindow (NULL when not visible)
- *   label        - the GtkLabel child of tip
- *   screen_width / screen_height - cached screen dimensions (for push-onscreen)
+ * Each owner has its own FixedTip (see struct _FixedTip below).  Its
+ * window is created once and then only shown, re-labelled and hidden, so a
+ * stream of balloon messages does not create a window per message.
  *
  * Public API:
- *   fixed_tip_show() - create or update the tooltip window
- *   fixed_tip_hide() - destroy the tooltip window
+ *   fixed_tip_new()     - create a tip with its dismiss callback
+ *   fixed_tip_show()    - create or update the tooltip window
+ *   fixed_tip_hide()    - hide the tooltip window (kept for reuse)
+ *   fixed_tip_destroy() - destroy the tooltip window and free the tip
  */
 
 #include "fixedtip.h"
 
-/* Singleton tooltip window.  NULL when no tooltip is currently visible.
- * The "destroy" signal connects gtk_widget_destroyed(&tip) so this is
- * also zeroed if the window is destroyed externally.                     */
-static GtkWidget *tip = NULL;
-
-/* Label child of tip; carries the Pango markup text.                     */
-static GtkWidget *label = NULL;
-
-/* Screen dimensions cached at tip-creation time for push-onscreen math.  */
-static int screen_width = 0;
-static int screen_height = 0;
+/*
+ * One owner's tip.
+ *
+ *   tip          - the popup GtkWindow (NULL until first shown).  The
+ *                  "destroy" signal connects gtk_widget_destroyed(&ft->tip)
+ *                  so this is also zeroed if the window is destroyed
+ *                  externally.
+ *   label        - the GtkLabel child of tip; carries the Pango markup text
+ *   screen_width / screen_height - screen dimensions cached at creation
+ *                  time (for push-onscreen)
+ *   dismiss_func, dismiss_data - called when the user clicks the tip away
+ */
+struct _FixedTip
+{
+  GtkWidget *tip;
+  GtkWidget *label;
+  int screen_width;
+  int screen_height;
+  FixedTipDismissFunc dismiss_func;
+  gpointer dismiss_data;
+};
 
 /*
  * button_press_handler -- dismiss the tooltip on any button press.
  *
- * Connected to the "button_press_event" signal of the tip window.
- * Returns FALSE so the event continues to propagate normally.
+ * Connected to the "button_press_event" signal of the tip window, with
+ * the FixedTip as data.  Hides the tip and notifies its owner's dismiss
+ * callback, if any.  Returns FALSE so the event continues to propagate
+ * normally.
  */
 static gboolean
 button_press_handler (GtkWidget *tip,
                       GdkEvent  *event,
                       void      *data)
 {
-  fixed_tip_hide ();
+  FixedTip *ft = data;
+
+  fixed_tip_hide (ft);
+  if (ft->dismiss_func)
+    ft->dismiss_func (ft->dismiss_data);
 
   return FALSE;
 }
@@ -74,27 +91,40 @@ button_press_handler (GtkWidget *tip,
  * Connected to the "expose_event" signal of the tip window.
  *
  * Paints the tooltip background chrome using the GTK "tooltip" style.
- * Uses the file-scope static `tip` for widget/window references.
  */
 static gboolean
 expose_handler (GtkWidget *widget, GdkEventExpose *event, gpointer data)
 {
-  gtk_paint_flat_box (tip->style, tip->window,
+  gtk_paint_flat_box (widget->style, widget->window,
                       GTK_STATE_NORMAL, GTK_SHADOW_OUT,
-                      NULL, tip, "tooltip",
+                      NULL, widget, "tooltip",
                       0, 0, -1, -1);
 
   return FALSE;
 }
 
 /*
- * fixed_tip_show -- create or update the singleton tooltip window.
+ * fixed_tip_new -- create a tip for one owner; see fixedtip.h.
+ */
+FixedTip *
+fixed_tip_new (FixedTipDismissFunc dismiss_func, gpointer dismiss_data)
+{
+  FixedTip *ft = g_new0 (FixedTip, 1);
+
+  ft->dismiss_func = dismiss_func;
+  ft->dismiss_data = dismiss_data;
+  return ft;
+}
+
+/*
+ * fixed_tip_show -- create or update the owner's tooltip window.
  *
  * On the first call a GTK_WINDOW_POPUP is created, styled as a tooltip,
  * and the screen dimensions are cached.  Subsequent calls just update
  * the markup text and reposition the window.
  *
  * Parameters:
+ *   ft                - the owner's tip
  *   screen_number     - X screen index (used only under HAVE_GTK_MULTIHEAD)
  *   root_x, root_y   - root-window coordinate the tip should point at
  *   strut_is_vertical - TRUE if panel has a left/right strut
@@ -108,18 +138,20 @@ expose_handler (GtkWidget *widget, GdkEventExpose *event, gpointer data)
  *   Then push on-screen if the window would extend past the right/bottom edge.
  */
 void
-fixed_tip_show (int screen_number,
+fixed_tip_show (FixedTip *ft,
+                int screen_number,
                 int root_x, int root_y,
                 gboolean strut_is_vertical,
                 int strut,
                 const char *markup_text)
 {
+  GtkWidget *tip = ft->tip;
   int w, h;
 
   if (tip == NULL)
     {
       /* --- First call: create the tooltip window --- */
-      tip = gtk_window_new (GTK_WINDOW_POPUP);
+      tip = ft->tip = gtk_window_new (GTK_WINDOW_POPUP);
 
 #ifdef HAVE_GTK_MULTIHEAD
       {
@@ -131,13 +163,13 @@ fixed_tip_show (int screen_number,
                                              screen_number);
         gtk_window_set_screen (GTK_WINDOW (tip),
                                gdk_screen);
-        screen_width = gdk_screen_get_width (gdk_screen);
-        screen_height = gdk_screen_get_height (gdk_screen);
+        ft->screen_width = gdk_screen_get_width (gdk_screen);
+        ft->screen_height = gdk_screen_get_height (gdk_screen);
       }
 #else
       /* Single-head fallback: use the default screen dimensions.          */
-      screen_width = gdk_screen_width ();
-      screen_height = gdk_screen_height ();
+      ft->screen_width = gdk_screen_width ();
+      ft->screen_height = gdk_screen_height ();
 #endif
 
       /* Make the window app-paintable so expose_handler can draw freely.  */
@@ -164,27 +196,27 @@ fixed_tip_show (int screen_number,
       g_signal_connect (G_OBJECT (tip),
             "button_press_event",
             G_CALLBACK (button_press_handler),
-            NULL);
+            ft);
 
       /* Create the label widget.  Markup is set in every call below.      */
-      label = gtk_label_new (NULL);
-      gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
-      gtk_misc_set_alignment (GTK_MISC (label), 0.5, 0.5);
-      gtk_widget_show (label);
+      ft->label = gtk_label_new (NULL);
+      gtk_label_set_line_wrap (GTK_LABEL (ft->label), TRUE);
+      gtk_misc_set_alignment (GTK_MISC (ft->label), 0.5, 0.5);
+      gtk_widget_show (ft->label);
 
-      gtk_container_add (GTK_CONTAINER (tip), label);
+      gtk_container_add (GTK_CONTAINER (tip), ft->label);
 
       /* When the window is destroyed externally (e.g. if another piece of
-       * code calls gtk_widget_destroy on tip), zero the static pointer so
-       * the next call to fixed_tip_show() recreates it correctly.         */
+       * code calls gtk_widget_destroy on it), zero ft->tip so the next
+       * call to fixed_tip_show() recreates it correctly.                  */
       g_signal_connect (G_OBJECT (tip),
             "destroy",
             G_CALLBACK (gtk_widget_destroyed),
-            &tip);
+            &ft->tip);
     }
 
   /* Update the label text (Pango markup).                                 */
-  gtk_label_set_markup (GTK_LABEL (label), markup_text);
+  gtk_label_set_markup (GTK_LABEL (ft->label), markup_text);
 
   /* FIXME should also handle Xinerama here, just to be
    * really cool
@@ -225,11 +257,11 @@ fixed_tip_show (int screen_number,
 
   /* Push on-screen: if the window extends past the right or bottom edge,
    * pull it back just enough to stay on screen.                           */
-  if ((root_x + w) > screen_width)
-    root_x -= (root_x + w) - screen_width;
+  if ((root_x + w) > ft->screen_width)
+    root_x -= (root_x + w) - ft->screen_width;
 
-  if ((root_y + h) > screen_height)
-    root_y -= (root_y + h) - screen_height;
+  if ((root_y + h) > ft->screen_height)
+    root_y -= (root_y + h) - ft->screen_height;
 
   gtk_window_move (GTK_WINDOW (tip), root_x, root_y);
 
@@ -238,19 +270,30 @@ fixed_tip_show (int screen_number,
 }
 
 /*
- * fixed_tip_hide -- destroy the singleton tooltip window.
+ * fixed_tip_hide -- hide the owner's tooltip window.
  *
- * Safe to call when no tooltip is visible (tip == NULL).
- * After this call tip is NULL (also zeroed by the gtk_widget_destroyed
- * "destroy" callback registered in fixed_tip_show, so the explicit
- * `tip = NULL` below is redundant but harmless).
+ * The window and label are kept for the next fixed_tip_show().
+ * Safe to call when no window exists yet (ft->tip == NULL).
  */
 void
-fixed_tip_hide (void)
+fixed_tip_hide (FixedTip *ft)
 {
-  if (tip)
-    {
-      gtk_widget_destroy (tip);
-      tip = NULL;  /* redundant: gtk_widget_destroyed already zeroes this */
-    }
+  if (ft->tip)
+    gtk_widget_hide (ft->tip);
+}
+
+/*
+ * fixed_tip_destroy -- destroy the owner's tooltip window and free ft.
+ *
+ * gtk_widget_destroy() runs the gtk_widget_destroyed "destroy" callback,
+ * which still points into ft, so ft is freed only afterwards.
+ */
+void
+fixed_tip_destroy (FixedTip *ft)
+{
+  if (!ft)
+    return;
+  if (ft->tip)
+    gtk_widget_destroy (ft->tip);
+  g_free (ft);
 }
@@ -23,11 +23,15 @@
  * "pointing" at a specific location adjacent to the panel edge.
  *
  * Public API:
- *   fixed_tip_show() -- show (or update) the tooltip window near the panel.
- *   fixed_tip_hide() -- destroy the tooltip window.
+ *   fixed_tip_new()     -- create a tip for one owner (no window yet).
+ *   fixed_tip_show()    -- show (or update) the tooltip window near the panel.
+ *   fixed_tip_hide()    -- hide the tooltip window; it is reused by the next
+ *                          fixed_tip_show().
+ *   fixed_tip_destroy() -- destroy the tooltip window and free the tip.
  *
- * The tooltip is a singleton popup window (static file-scope globals tip
- * and label); only one can be visible at a time.
+ * Every owner (tray plugin instance) has its own FixedTip, holding its
+ * popup window and its dismiss callback, so several trays can show
+ * messages at the same time without taking each other's window.
  */
 
 #ifndef FIXED_TIP_H
@@ -36,6 +40,20 @@
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 
+typedef struct _FixedTip FixedTip;
+
+/* Callback run after the user dismissed the tip by clicking it.          */
+typedef void (*FixedTipDismissFunc) (gpointer data);
+
+/*
+ * fixed_tip_new -- create a tip; the window is made on the first show.
+ *
+ * dismiss_func(dismiss_data) is called after a button press hid the tip;
+ * dismiss_func may be NULL.  Free with fixed_tip_destroy().
+ */
+FixedTip *fixed_tip_new (FixedTipDismissFunc dismiss_func,
+                         gpointer dismiss_data);
+
 /*
  * fixed_tip_show -- show a tooltip at a panel-relative position.
  *
@@ -43,6 +61,7 @@
  * the position and markup text.
  *
  * Parameters:
+ *   ft               - the owner's tip
  *   screen_number    - screen index (for multi-head support via
  *                      HAVE_GTK_MULTIHEAD; falls back to default screen).
  *   root_x, root_y  - root-window coordinate the tooltip should "point to"
@@ -58,19 +77,27 @@
  *   If horizontal:        tip is placed above or below the strut.
  *   The tip is pushed on-screen if it would extend beyond screen bounds.
  */
-void fixed_tip_show (int screen_number,
+void fixed_tip_show (FixedTip *ft,
+                     int screen_number,
                      int root_x, int root_y,
                      gboolean strut_is_vertical,
                      int strut,
                      const char *markup_text);
 
 /*
- * fixed_tip_hide -- destroy the tooltip window.
+ * fixed_tip_hide -- hide the tooltip window.
+ *
+ * Safe to call even if no tooltip is currently shown.  The window is kept
+ * and reused by the next fixed_tip_show().
+ */
+void fixed_tip_hide (FixedTip *ft);
+
+/*
+ * fixed_tip_destroy -- destroy the tooltip window, if any, and free ft.
  *
- * Safe to call even if no tooltip is currently shown.
- * After this call the static "tip" pointer is NULL.
+ * The dismiss callback is never called after this.  ft may be NULL.
  */
-void fixed_tip_hide (void);
+void fixed_tip_destroy (FixedTip *ft);
 
 
 #endif /* FIXED_TIP_H */
@@ -19,6 +19,22 @@
  *   "message_sent"        -> message_sent()
  *   "message_cancelled"   -> message_cancelled()
  *
+ * Balloon messages ("message_sent") go through a queue with per-client
+ * limits (see tray_msg_*): at most MSG_QUEUE_MAX messages / MSG_QUEUE_BYTES
+ * bytes waiting per icon, MSG_RATE_MAX accepted per MSG_RATE_WINDOW seconds,
+ * and a repeat of the client's last message only refreshes it.  They are
+ * shown one at a time in the single fixedtip window.
+ *
+ * StatusNotifierItems (sni.c) are hosted in the same bar as windowless
+ * GtkImages, unless "StatusNotifier = false".  They do not need the
+ * XEMBED selection, so they work even when another XEMBED tray runs.
+ * Code walking tr->box must therefore check GTK_IS_SOCKET().
+ *
+ * ARGB icons (egg_tray_manager_child_is_alpha) live in composited sockets:
+ * the server keeps them offscreen and tray_expose_icons() blends them over
+ * the panel background with cairo whenever the bar is exposed or an icon
+ * reports damage.  Legacy icons use ParentRelative sockets instead.
+ *
  * Memory ownership notes:
  *   - tray_priv embeds plugin_instance by value (first member), so it is
  *     allocated/freed by the plugin framework.
@@ -47,6 +63,7 @@
 
 #include "eggtraymanager.h"
 #include "fixedtip.h"
+#include "sni.h"
 
 
 //#define DEBUGPRN
@@ -69,6 +86,13 @@
  *             we hold one reference, released in destructor
  *   sid     - GObject signal handler ID for the "changed" signal on tr->bg;
  *             must be disconnected before dropping the bg reference
+ *   refresh_id - idle source of a pending tray_refresh(), or 0
+ *   msgs    - balloon messages waiting to be shown (tray_msg *, FIFO)
+ *   shown   - the balloon message on screen, or NULL
+ *   msg_timer - timeout source that retires 'shown', or 0
+ *   clients - GtkSocket * -> tray_client (queue and rate accounting)
+ *   tip     - this tray's balloon popup (see fixedtip.h)
+ *   sni     - StatusNotifierItem host, or NULL (disabled / no session bus)
  */
 typedef struct {
     plugin_instance plugin;
@@ -76,46 +100,327 @@ typedef struct {
     EggTrayManager *tray_manager;
     FbBg *bg;
     gulong sid;
+    guint refresh_id;
+    GQueue msgs;
+    struct _tray_msg *shown;
+    guint msg_timer;
+    GHashTable *clients;
+    FixedTip *tip;
+    SniHost *sni;
 } tray_priv;
 
+/* Balloon message limits, per tray client. */
+#define MSG_QUEUE_MAX     4       /* messages waiting */
+#define MSG_QUEUE_BYTES   4096    /* bytes of text waiting */
+#define MSG_RATE_MAX      5       /* messages accepted ... */
+#define MSG_RATE_WINDOW   10      /* ... per this many seconds */
+
+/* Display time in ms: clients' timeouts are clamped to MIN..MAX, and 0
+ * ("until dismissed") becomes DEF so the queue keeps moving. */
+#define MSG_TIMEOUT_MIN   2000
+#define MSG_TIMEOUT_MAX   30000
+#define MSG_TIMEOUT_DEF   10000
+
+/*
+ * tray_msg - one balloon message, queued or shown.
+ *
+ *   icon    - GtkSocket of the sender (borrowed; messages are dropped
+ *             in tray_removed before it goes away)
+ *   id      - client-assigned id, for cancellation
+ *   timeout - display time in ms, already clamped
+ *   text    - the message as received (for de-duplication)
+ *   markup  - text escaped for the tip's markup label
+ */
+typedef struct _tray_msg {
+    GtkWidget *icon;
+    glong id;
+    guint timeout;
+    gchar *text;
+    gchar *markup;
+} tray_msg;
+
+/*
+ * tray_client - per-icon accounting for the balloon queue.
+ *
+ *   queued, bytes - messages and text bytes of this icon in tr->msgs
+ *   since    - start of the current rate window (g_get_monotonic_time)
+ *   accepted - messages accepted since 'since'
+ */
+typedef struct {
+    guint queued;
+    gsize bytes;
+    gint64 since;
+    guint accepted;
+} tray_client;
+
+/*
+ * tray_refresh_icon - repaint one docked icon over the current background.
+ *
+ * Re-asserts the socket window's ParentRelative background so it samples
+ * the parent's new pixmap, then clears the socket window and the client's
+ * plug window with exposures.  The X server repaints the backgrounds and
+ * the client gets a single Expose; nothing is unmapped.
+ *
+ * Parameters:
+ *   icon - a GtkSocket packed in tr->box (gtk_container_foreach callback)
+ *   data - unused
+ */
+static void
+tray_refresh_icon(GtkWidget *icon, gpointer data)
+{
+    GdkWindow *plug;
+
+    if (!GTK_IS_SOCKET(icon) || !GTK_WIDGET_REALIZED(icon)
+        || !GTK_WIDGET_MAPPED(icon))
+        return;
+    if (egg_tray_manager_child_is_alpha((EggTrayManagerChild *) icon))
+        return;   /* composited over the bar's background on expose */
+    gdk_window_set_back_pixmap(icon->window, NULL, TRUE);
+    XClearArea(GDK_WINDOW_XDISPLAY(icon->window),
+        GDK_WINDOW_XID(icon->window), 0, 0, 0, 0, True);
+    plug = GTK_SOCKET(icon)->plug_window;
+    if (plug) {
+        /* the client may have destroyed its window already */
+        gdk_error_trap_push();
+        XClearArea(GDK_WINDOW_XDISPLAY(plug), GDK_WINDOW_XID(plug),
+            0, 0, 0, 0, True);
+        gdk_flush();
+        gdk_error_trap_pop();
+    }
+}
+
+/*
+ * tray_refresh - idle callback: repaint every docked icon once.
+ *
+ * Runs at idle priority, after GTK's pending resize and redraw, so the
+ * panel background (GtkBgbox) and the icon positions are already final.
+ */
+static gboolean
+tray_refresh(tray_priv *tr)
+{
+    ENTER;
+    tr->refresh_id = 0;
+    gtk_container_foreach(GTK_CONTAINER(tr->box), tray_refresh_icon, NULL);
+    RET(FALSE);
+}
+
+/*
+ * tray_expose_icon - blend one ARGB icon onto the bar.
+ *
+ * gtk_container_foreach callback of tray_expose_icons(); @cr is already
+ * clipped to the exposed region.  The composited socket window is used as
+ * the source (XComposite keeps its contents, cairo blends with XRender).
+ */
+static void
+tray_expose_icon(GtkWidget *icon, cairo_t *cr)
+{
+    if (!GTK_IS_SOCKET(icon)
+        || !egg_tray_manager_child_is_alpha((EggTrayManagerChild *) icon)
+        || !GTK_WIDGET_DRAWABLE(icon))
+        return;
+    gdk_cairo_set_source_pixmap(cr, icon->window,
+        icon->allocation.x, icon->allocation.y);
+    cairo_paint(cr);
+}
+
+/*
+ * tray_expose_icons - "expose-event" handler (connected AFTER) of tr->box.
+ *
+ * Runs once the background has been drawn and paints every ARGB icon over
+ * it.  Returns FALSE so the expose continues normally.
+ */
+static gboolean
+tray_expose_icons(GtkWidget *widget, GdkEventExpose *event, tray_priv *tr)
+{
+    cairo_t *cr;
+
+    cr = gdk_cairo_create(widget->window);
+    gdk_cairo_region(cr, event->region);
+    cairo_clip(cr);
+    gtk_container_foreach(GTK_CONTAINER(widget),
+        (GtkCallback) tray_expose_icon, cr);
+    cairo_destroy(cr);
+    return FALSE;
+}
+
+/*
+ * tray_icon_damaged - "damage-event" handler of ARGB icon sockets.
+ *
+ * The client drew into its offscreen window: repaint that part of the bar,
+ * which re-blends the icon in tray_expose_icons().
+ */
+static gboolean
+tray_icon_damaged(GtkWidget *icon, GdkEventExpose *event, tray_priv *tr)
+{
+    gtk_widget_queue_draw_area(tr->box,
+        icon->allocation.x + event->area.x, icon->allocation.y + event->area.y,
+        event->area.width, event->area.height);
+    return TRUE;
+}
+
 /*
- * tray_bg_changed - callback for desktop background changes.
+ * tray_bg_changed - desktop background changed, or icons were added or
+ * removed.
  *
- * When the desktop background changes we need to repaint any transparent
- * tray icon sockets.  The approach used is a hide/show cycle which forces
- * GTK to re-expose the widget and redraw with the new background.
+ * Transparent icons (ParentRelative sockets) must be repainted over the
+ * new background or at their new position.  The repaint is scheduled for
+ * idle time so a burst of changes costs one pass.
  *
  * Parameters:
- *   bg     - the FbBg object that emitted "changed" (unused; may be NULL
- *            when called directly from tray_added/tray_removed)
- *   widget - the panel's top-level plugin widget (tr->plugin.pwid)
- *
- * NOTE: gtk_main_iteration() is called conditionally to flush pending
- * expose events between hide and show.  This is a pattern that can cause
- * re-entrant signal delivery and subtle GTK state corruption if any other
- * events arrive during that iteration.  The size-request lock (set_size_request
- * to current size, then back to -1,-1) prevents the widget from resizing
- * during the cycle, but does not prevent re-entrant destruction if the panel
- * is being torn down concurrently.
+ *   bg - the FbBg object that emitted "changed" (unused; NULL when called
+ *        from tray_added/tray_removed)
+ *   tr - plugin private data
  */
 static void
-tray_bg_changed(FbBg *bg, GtkWidget *widget)
+tray_bg_changed(FbBg *bg, tray_priv *tr)
 {
     ENTER;
-    // Lock the widget to its current allocated size to prevent layout shifts
-    // during the hide/show redraw cycle.
-    gtk_widget_set_size_request(widget, widget->allocation.width,
-        widget->allocation.height);
-    gtk_widget_hide(widget);
-    // Drain one pending event to process expose events before re-showing.
-    // BUG: If a destroy event is pending for 'widget', this call may free
-    // the widget while we still hold a pointer to it (use-after-free).
-    if (gtk_events_pending())
-        gtk_main_iteration();
-    gtk_widget_show(widget);
-    // Restore unconstrained sizing so the widget can respond to future
-    // size negotiations normally.
-    gtk_widget_set_size_request(widget, -1, -1);
+    if (!tr->refresh_id)
+        tr->refresh_id = g_idle_add((GSourceFunc) tray_refresh, tr);
+    RET();
+}
+
+/*
+ * tray_msg_free - free a tray_msg and its strings.
+ */
+static void
+tray_msg_free(tray_msg *msg)
+{
+    g_free(msg->text);
+    g_free(msg->markup);
+    g_free(msg);
+}
+
+/*
+ * tray_client_get - return the accounting record of an icon, creating it.
+ */
+static tray_client *
+tray_client_get(tray_priv *tr, GtkWidget *icon)
+{
+    tray_client *c;
+
+    if (!(c = g_hash_table_lookup(tr->clients, icon))) {
+        c = g_new0(tray_client, 1);
+        g_hash_table_insert(tr->clients, icon, c);
+    }
+    return c;
+}
+
+/*
+ * tray_msg_unqueue - remove a waiting message from tr->msgs and free it.
+ */
+static void
+tray_msg_unqueue(tray_priv *tr, GList *link)
+{
+    tray_msg *msg = link->data;
+    tray_client *c;
+
+    if ((c = g_hash_table_lookup(tr->clients, msg->icon))) {
+        c->queued--;
+        c->bytes -= strlen(msg->text);
+    }
+    g_queue_delete_link(&tr->msgs, link);
+    tray_msg_free(msg);
+}
+
+static gboolean tray_msg_expire(tray_priv *tr);
+
+/*
+ * tray_msg_show_next - retire the shown message and show the next one.
+ *
+ * Reuses the single fixedtip window; hides it when the queue is empty.
+ * The tip points at the sending icon and sits on the panel's inner edge.
+ */
+static void
+tray_msg_show_next(tray_priv *tr)
+{
+    panel *p = tr->plugin.panel;
+    tray_msg *msg;
+    tray_client *c;
+    int x, y, px, py;
+
+    ENTER;
+    if (tr->msg_timer) {
+        g_source_remove(tr->msg_timer);
+        tr->msg_timer = 0;
+    }
+    if (tr->shown) {
+        tray_msg_free(tr->shown);
+        tr->shown = NULL;
+    }
+    while ((msg = g_queue_peek_head(&tr->msgs))) {
+        if (GTK_WIDGET_REALIZED(msg->icon))
+            break;
+        tray_msg_unqueue(tr, g_queue_peek_head_link(&tr->msgs));
+    }
+    if (!msg) {
+        fixed_tip_hide(tr->tip);
+        RET();
+    }
+    /* detach from the queue without freeing: it is now tr->shown */
+    g_queue_pop_head(&tr->msgs);
+    c = tray_client_get(tr, msg->icon);
+    c->queued--;
+    c->bytes -= strlen(msg->text);
+    tr->shown = msg;
+
+    gdk_window_get_origin(msg->icon->window, &x, &y);
+    x += msg->icon->allocation.width / 2;
+    y += msg->icon->allocation.height / 2;
+    gdk_window_get_origin(p->topgwin->window, &px, &py);
+    if (p->orientation == GTK_ORIENTATION_HORIZONTAL)
+        fixed_tip_show(tr->tip, 0, x, y, FALSE,
+            (py < gdk_screen_height() / 2) ? py + p->ah : py, msg->markup);
+    else
+        fixed_tip_show(tr->tip, 0, x, y, TRUE,
+            (px < gdk_screen_width() / 2) ? px + p->aw : px, msg->markup);
+    tr->msg_timer = g_timeout_add(msg->timeout,
+        (GSourceFunc) tray_msg_expire, tr);
+    RET();
+}
+
+/*
+ * tray_msg_expire - timeout: the shown message has been up long enough.
+ */
+static gboolean
+tray_msg_expire(tray_priv *tr)
+{
+    ENTER;
+    tr->msg_timer = 0;
+    tray_msg_show_next(tr);
+    RET(FALSE);
+}
+
+/*
+ * tray_msg_dismissed - the user clicked the tip away: move on.
+ */
+static void
+tray_msg_dismissed(gpointer data)
+{
+    tray_msg_show_next((tray_priv *) data);
+}
+
+/*
+ * tray_msg_drop - forget messages of one icon.
+ *
+ * Drops the icon's waiting messages (all of them if 'all', else only the
+ * one with 'id') and advances the tip if the shown message matches.
+ */
+static void
+tray_msg_drop(tray_priv *tr, GtkWidget *icon, gboolean all, glong id)
+{
+    GList *l, *next;
+    tray_msg *msg;
+
+    ENTER;
+    for (l = tr->msgs.head; l; l = next) {
+        next = l->next;
+        msg = l->data;
+        if (msg->icon == icon && (all || msg->id == id))
+            tray_msg_unqueue(tr, l);
+    }
+    if (tr->shown && tr->shown->icon == icon && (all || tr->shown->id == id))
+        tray_msg_show_next(tr);
     RET();
 }
 
@@ -147,12 +452,15 @@ tray_added (EggTrayManager *manager, GtkWidget *icon, tray_priv *tr)
     // Pack the new tray icon socket at the end (right/bottom) of the bar.
     // FALSE, FALSE, 0 means: don't expand, don't fill, no padding.
     gtk_box_pack_end(GTK_BOX(tr->box), icon, FALSE, FALSE, 0);
+    if (egg_tray_manager_child_is_alpha((EggTrayManagerChild *) icon))
+        g_signal_connect(G_OBJECT(icon), "damage-event",
+            G_CALLBACK(tray_icon_damaged), tr);
     gtk_widget_show(icon);
     // Synchronize with the X server to ensure XEMBED reparenting is complete
     // before we trigger a repaint; without this the icon may not yet be visible.
     gdk_display_sync(gtk_widget_get_display(icon));
-    // Repaint the panel background to account for the new icon's space.
-    tray_bg_changed(NULL, tr->plugin.pwid);
+    // Repaint the icons once the bar has been laid out again.
+    tray_bg_changed(NULL, tr);
     RET();
 }
 
@@ -178,8 +486,10 @@ tray_removed (EggTrayManager *manager, GtkWidget *icon, tray_priv *tr)
 {
     ENTER;
     DBG("del icon\n");
-    // Trigger background repaint to redraw the area vacated by the removed icon.
-    tray_bg_changed(NULL, tr->plugin.pwid);
+    tray_msg_drop(tr, icon, TRUE, 0);
+    g_hash_table_remove(tr->clients, icon);
+    // The remaining icons may have moved: repaint them over the background.
+    tray_bg_changed(NULL, tr);
     RET();
 }
 
@@ -187,43 +497,102 @@ tray_removed (EggTrayManager *manager, GtkWidget *icon, tray_priv *tr)
  * message_sent - signal handler for EggTrayManager "message_sent".
  *
  * Called when a tray client has sent a complete balloon-message via the
- * _NET_SYSTEM_TRAY_BEGIN_MESSAGE / _NET_SYSTEM_TRAY_MESSAGE_DATA protocol.
- * This displays a custom tooltip-style popup window positioned near the
- * tray icon using fixed_tip_show().
+ * _NET_SYSTEM_TRAY_BEGIN_MESSAGE / _NET_SYSTEM_TRAY_MESSAGE_DATA protocol
+ * (at most MESSAGE_MAX_LEN bytes, see eggtraymanager.c).  The message is
+ * queued for the fixedtip popup, subject to the per-client limits:
+ *
+ *   - a repeat of the client's latest message (waiting or shown) only takes
+ *     over its id and timeout; a shown one gets its display time restarted;
+ *   - more than MSG_RATE_MAX messages in MSG_RATE_WINDOW seconds are dropped;
+ *   - beyond MSG_QUEUE_MAX messages or MSG_QUEUE_BYTES bytes waiting, the
+ *     client's oldest waiting messages are dropped.
  *
  * Parameters:
  *   manager - the EggTrayManager that emitted the signal (unused)
- *   icon    - the GtkSocket for the tray icon that sent the message;
- *             we read its X11 window origin to position the tooltip
- *   text    - the complete message string (NUL-terminated, UTF-8);
- *             owned by the EggTrayManager's PendingMessage which is freed
- *             after this signal returns - callee must NOT free or store it
+ *   icon    - the GtkSocket for the tray icon that sent the message
+ *   text    - the complete message string (NUL-terminated); owned by the
+ *             EggTrayManager and freed after this signal returns - copied
  *   id      - the client-assigned message identifier (for cancellation)
  *   timeout - duration in milliseconds the client requests the message be
- *             shown (currently ignored by fixed_tip_show)
- *   data    - user_data from g_signal_connect (tray_priv *; unused here)
+ *             shown; 0 means until dismissed (see MSG_TIMEOUT_*)
+ *   tr      - plugin private data
  *
  * FIXME (noted in original code): This does not handle multiple X11 screens
  * (multihead) - it always passes screen 0 to fixed_tip_show.
- *
- * NOTE: icon->window accesses the GdkWindow directly via the deprecated
- * GTK2 widget->window field; this is not compatible with GTK3.
  */
 static void
 message_sent (EggTrayManager *manager, GtkWidget *icon, const char *text,
-    glong id, glong timeout, void *data)
+    glong id, glong timeout, tray_priv *tr)
 {
-    /* FIXME multihead */
-    int x, y;
+    tray_client *c;
+    tray_msg *msg, *last;
+    GList *l;
+    gint64 now;
+    gsize len;
 
     ENTER;
-    // Get the absolute screen coordinates of the tray icon window so we
-    // can position the balloon message popup adjacent to the icon.
-    gdk_window_get_origin (icon->window, &x, &y);
-    // Display the balloon tooltip; strut=screen_height-50 positions it
-    // relative to a hypothetical bottom panel edge.  Hardcoding screen_height-50
-    // is incorrect for top panels or non-standard panel positions.
-    fixed_tip_show (0, x, y, FALSE, gdk_screen_height () - 50, text);
+    if (!g_utf8_validate(text, -1, NULL)) {
+        DBG("dropping non-UTF-8 message\n");
+        RET();
+    }
+    if (timeout <= 0)
+        timeout = MSG_TIMEOUT_DEF;
+    timeout = CLAMP(timeout, MSG_TIMEOUT_MIN, MSG_TIMEOUT_MAX);
+
+    /* coalesce a repeat of the client's latest message */
+    last = NULL;
+    for (l = tr->msgs.tail; l && !last; l = l->prev)
+        if (((tray_msg *) l->data)->icon == icon)
+            last = l->data;
+    if (!last && tr->shown && tr->shown->icon == icon)
+        last = tr->shown;
+    if (last && !strcmp(last->text, text)) {
+        DBG("coalescing repeated message %ld\n", id);
+        last->id = id;
+        last->timeout = timeout;
+        if (last == tr->shown) {
+            g_source_remove(tr->msg_timer);
+            tr->msg_timer = g_timeout_add(last->timeout,
+                (GSourceFunc) tray_msg_expire, tr);
+        }
+        RET();
+    }
+
+    /* rate limit */
+    c = tray_client_get(tr, icon);
+    now = g_get_monotonic_time();
+    if (now - c->since >= (gint64) MSG_RATE_WINDOW * G_USEC_PER_SEC) {
+        c->since = now;
+        c->accepted = 0;
+    }
+    if (c->accepted >= MSG_RATE_MAX) {
+        DBG("rate limit: dropping message %ld\n", id);
+        RET();
+    }
+    c->accepted++;
+
+    /* make room within the client's budget, oldest first */
+    len = strlen(text);
+    for (l = tr->msgs.head; l
+             && (c->queued >= MSG_QUEUE_MAX || c->bytes + len > MSG_QUEUE_BYTES);) {
+        GList *next = l->next;
+
+        if (((tray_msg *) l->data)->icon == icon)
+            tray_msg_unqueue(tr, l);
+        l = next;
+    }
+
+    msg = g_new0(tray_msg, 1);
+    msg->icon = icon;
+    msg->id = id;
+    msg->timeout = timeout;
+    msg->text = g_strdup(text);
+    msg->markup = g_markup_escape_text(text, len);
+    g_queue_push_tail(&tr->msgs, msg);
+    c->queued++;
+    c->bytes += len;
+    if (!tr->shown)
+        tray_msg_show_next(tr);
     RET();
 }
 
@@ -231,25 +600,21 @@ message_sent (EggTrayManager *manager, GtkWidget *icon, const char *text,
  * message_cancelled - signal handler for EggTrayManager "message_cancelled".
  *
  * Called when a tray client cancels a previously sent balloon message via
- * _NET_SYSTEM_TRAY_CANCEL_MESSAGE.  In a complete implementation this would
- * hide the popup if it corresponds to the cancelled message id.
+ * _NET_SYSTEM_TRAY_CANCEL_MESSAGE.  Drops the message if it is waiting,
+ * or moves on to the next one if it is on screen.
  *
  * Parameters:
  *   manager - the EggTrayManager that emitted the signal (unused)
- *   icon    - the GtkSocket for the icon that sent the cancellation (unused)
- *   id      - the message identifier to cancel (unused - not implemented)
- *   data    - user_data from g_signal_connect (unused)
- *
- * NOTE: This is a stub - it does not actually hide the balloon or check
- * the message id.  If the tooltip is visible for a different message it
- * will not be cancelled even when requested.
+ *   icon    - the GtkSocket for the icon that sent the cancellation
+ *   id      - the message identifier to cancel
+ *   tr      - plugin private data
  */
 static void
 message_cancelled (EggTrayManager *manager, GtkWidget *icon, glong id,
-    void *data)
+    tray_priv *tr)
 {
     ENTER;
-    // TODO: call fixed_tip_hide() if the displayed message matches 'id'.
+    tray_msg_drop(tr, icon, FALSE, id);
     RET();
 }
 
@@ -275,7 +640,7 @@ message_cancelled (EggTrayManager *manager, GtkWidget *icon, glong id,
  *   1. Disconnect bg signal (must precede unref to avoid stale callback)
  *   2. Unref bg singleton (balance the ref taken in constructor)
  *   3. Unref tray_manager (triggers finalize -> unmanage -> X selection release)
- *   4. Hide tooltip window
+ *   4. Free the balloon queue and destroy the tooltip window
  *
  * NOTE: The four GObject signals connected to tr->tray_manager in
  * tray_constructor are NOT explicitly disconnected here.  This is safe
@@ -293,6 +658,8 @@ tray_destructor(plugin_instance *p)
     // Disconnect the background "changed" signal before releasing tr->bg to
     // prevent a stale callback firing during or after unref.
     g_signal_handler_disconnect(tr->bg, tr->sid);
+    if (tr->refresh_id)
+        g_source_remove(tr->refresh_id);
     // Release our reference to the FbBg singleton.
     g_object_unref(tr->bg);
     /* Make sure we drop the manager selection */
@@ -302,8 +669,16 @@ tray_destructor(plugin_instance *p)
     // their parent GtkBar (tr->box) is destroyed by the plugin framework.
     if (tr->tray_manager)
         g_object_unref(G_OBJECT(tr->tray_manager));
-    // Destroy the balloon message popup window if currently visible.
-    fixed_tip_hide();
+    // Free the balloon queue and destroy the (reused) popup window.
+    if (tr->msg_timer)
+        g_source_remove(tr->msg_timer);
+    if (tr->shown)
+        tray_msg_free(tr->shown);
+    g_queue_foreach(&tr->msgs, (GFunc) tray_msg_free, NULL);
+    g_queue_clear(&tr->msgs);
+    g_hash_table_destroy(tr->clients);
+    fixed_tip_destroy(tr->tip);
+    sni_host_free(tr->sni);
     RET();
 }
 
@@ -371,8 +746,8 @@ tray_size_alloc(GtkWidget *widget, GtkAllocation *a,
  *   1 on success (even if another tray is running - a partial init path),
  *   but does NOT return 0 on failure; the caller treats non-zero as success.
  *   NOTE: returning 1 when egg_tray_manager_check_running() is true means the
- *   plugin "succeeds" while tr->tray_manager is NULL - the tray simply shows
- *   no icons.  This is intentional degraded-mode behaviour.
+ *   plugin "succeeds" while tr->tray_manager is NULL - the tray shows only
+ *   StatusNotifierItems.  This is intentional degraded-mode behaviour.
  *
  * Widget hierarchy created:
  *   p->pwid (provided by framework)
@@ -382,6 +757,7 @@ tray_size_alloc(GtkWidget *widget, GtkAllocation *a,
  *
  * Signals connected (and where they are disconnected):
  *   ali    "size-allocate" -> tray_size_alloc  [disconnected when ali destroyed]
+ *   tr->box "expose-event" -> tray_expose_icons (after) [dies with tr->box]
  *   tr->bg "changed"       -> tray_bg_changed  [disconnected in tray_destructor]
  *   tr->tray_manager "tray_icon_added"     -> tray_added    [auto on unref]
  *   tr->tray_manager "tray_icon_removed"   -> tray_removed  [auto on unref]
@@ -397,11 +773,16 @@ tray_constructor(plugin_instance *p)
     tray_priv *tr;
     GdkScreen *screen;
     GtkWidget *ali;
+    int sni;
 
     ENTER;
     tr = (tray_priv *) p;
     // Register plugin class metadata with the panel framework.
     class_get("tray");
+    g_queue_init(&tr->msgs);
+    tr->clients = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+        NULL, g_free);
+    tr->tip = fixed_tip_new(tray_msg_dismissed, tr);
     // Create a centering alignment widget with no padding and no expansion.
     // xalign=0.5, yalign=0.5, xscale=0, yscale=0 means the child is
     // centered and not stretched.
@@ -417,6 +798,8 @@ tray_constructor(plugin_instance *p)
     tr->box = gtk_bar_new(p->panel->orientation, 0,
         p->panel->max_elem_height, p->panel->max_elem_height);
     gtk_container_add(GTK_CONTAINER(ali), tr->box);
+    g_signal_connect_after(G_OBJECT(tr->box), "expose-event",
+        G_CALLBACK(tray_expose_icons), tr);
     gtk_container_set_border_width(GTK_CONTAINER (tr->box), 0);
     gtk_widget_show_all(ali);
     // Obtain (or create) the per-display FbBg singleton and hold a reference.
@@ -424,7 +807,13 @@ tray_constructor(plugin_instance *p)
     // can repaint transparent tray icon backgrounds.
     tr->bg = fb_bg_get_for_display();
     tr->sid = g_signal_connect(tr->bg, "changed",
-        G_CALLBACK(tray_bg_changed), p->pwid);
+        G_CALLBACK(tray_bg_changed), tr);
+
+    // StatusNotifierItems need no X selection: start them first.
+    sni = 1;
+    XCG(p->xc, "statusnotifier", &sni, enum, bool_enum);
+    if (sni)
+        tr->sni = sni_host_new(tr->box, p->pwid, p->panel->max_elem_height);
 
     // Determine which X11 screen the panel is displayed on.
     screen = gtk_widget_get_screen(p->panel->topgwin);
@@ -433,7 +822,7 @@ tray_constructor(plugin_instance *p)
     // bail out gracefully rather than fighting for the selection.
     if (egg_tray_manager_check_running(screen)) {
         tr->tray_manager = NULL;
-        g_message("tray: another systray already running — tray plugin inactive");
+        g_message("tray: another systray already running — XEMBED icons disabled");
         // Return 1 (success) so the plugin remains loaded but inactive.
         // tr->tray_manager is NULL; tray_destructor handles this safely.
         RET(1);
@@ -0,0 +1,1004 @@
+/*
+ * sni.c - StatusNotifierItem host (and fallback watcher) for the tray plugin.
+ *
+ * Protocol summary (org.kde.StatusNotifierItem, version 0):
+ *   - A StatusNotifierWatcher owns "org.kde.StatusNotifierWatcher".  Items
+ *     call RegisterStatusNotifierItem(service) on it, hosts call
+ *     RegisterStatusNotifierHost(name) and follow the watcher's
+ *     StatusNotifierItemRegistered/Unregistered signals.
+ *   - An item exports "org.kde.StatusNotifierItem" (by default at
+ *     /StatusNotifierItem) with properties such as Status, IconName,
+ *     IconPixmap and ToolTip, signals NewIcon, NewStatus, NewToolTip... that
+ *     carry no data, and methods Activate, SecondaryActivate, ContextMenu
+ *     and Scroll.
+ *
+ * Roles played here:
+ *   watcher - one per process, shared by all tray instances and
+ *             refcounted by their hosts.  The object is always exported;
+ *             the well-known name is only requested, so an existing watcher
+ *             (another panel, KDE) keeps it and we are just a host.  Items
+ *             are identified by "<bus name><object path>" strings and
+ *             dropped when their bus name vanishes.
+ *   host    - owns "org.kde.StatusNotifierHost-<pid>-<n>", follows whichever
+ *             watcher owns the name, and keeps one sni_item per registered
+ *             item.
+ *
+ * Cost control:
+ *   - Item signals only mark the item stale.  One GetAll per item is issued
+ *     SNI_REFRESH_DELAY ms later, and never more than one at a time, so a
+ *     burst of NewIcon/NewToolTip/NewStatus costs a single round trip.
+ *   - IconPixmap data is converted once: pixbufs are cached under the
+ *     (iiay) variant of the chosen pixmap, so an item re-sending the same
+ *     image (or several items sharing one) costs a hash lookup.  Icon names
+ *     go through the shared fb_pixbuf_new() cache.
+ *   - An item's IconThemePath goes into a host-private GtkIconTheme that
+ *     only searches those paths, so the shared icon_theme (and with it the
+ *     pixbuf cache) never changes behind the panel's back.
+ *   - The GtkImage is only touched when the pixbuf or tooltip changed.
+ *
+ * Not implemented: com.canonical.dbusmenu.  The right button calls the
+ * item's ContextMenu method, which items that draw their own menu honour.
+ *
+ * All D-Bus calls are asynchronous (the host may well be talking to its own
+ * watcher) and share host->cancel; items have their own cancellable for
+ * GetAll so a reply for a removed item is dropped.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+
+#include "misc.h"
+#include "sni.h"
+
+//#define DEBUGPRN
+#include "dbg.h"
+
+#define SNI_WATCHER_NAME   "org.kde.StatusNotifierWatcher"
+#define SNI_WATCHER_PATH   "/StatusNotifierWatcher"
+#define SNI_WATCHER_IFACE  "org.kde.StatusNotifierWatcher"
+#define SNI_ITEM_IFACE     "org.kde.StatusNotifierItem"
+#define SNI_ITEM_PATH      "/StatusNotifierItem"
+
+/* Item property-change signals are coalesced over this many ms. */
+#define SNI_REFRESH_DELAY  100
+/* Converted IconPixmaps kept; the cache is flushed when it is full. */
+#define SNI_PIXMAP_CACHE_MAX  64
+
+static const gchar sni_watcher_xml[] =
+    "<node>"
+    " <interface name='" SNI_WATCHER_IFACE "'>"
+    "  <method name='RegisterStatusNotifierItem'>"
+    "   <arg type='s' name='service' direction='in'/>"
+    "  </method>"
+    "  <method name='RegisterStatusNotifierHost'>"
+    "   <arg type='s' name='service' direction='in'/>"
+    "  </method>"
+    "  <property name='RegisteredStatusNotifierItems' type='as' access='read'/>"
+    "  <property name='IsStatusNotifierHostRegistered' type='b' access='read'/>"
+    "  <property name='ProtocolVersion' type='i' access='read'/>"
+    "  <signal name='StatusNotifierItemRegistered'>"
+    "   <arg type='s' name='service'/>"
+    "  </signal>"
+    "  <signal name='StatusNotifierItemUnregistered'>"
+    "   <arg type='s' name='service'/>"
+    "  </signal>"
+    "  <signal name='StatusNotifierHostRegistered'/>"
+    " </interface>"
+    "</node>";
+
+/*
+ * SniHost - host state of one tray plugin instance.
+ *
+ *   conn, cancel  - session bus; cancel aborts every pending call on free
+ *   box, evbox, size - see sni_host_new()
+ *   press_sid, scroll_sid - evbox handlers
+ *   has_watcher   - holds a reference on the process watcher
+ *   host_name, host_own - our host bus name and its own id
+ *   watcher_watch - g_bus_watch_name id following SNI_WATCHER_NAME
+ *   sig_added, sig_removed - watcher signal subscriptions
+ *   items         - host side: item id -> sni_item
+ *   pixmaps       - (iiay) GVariant -> GdkPixbuf of size x size
+ *   theme         - private icon theme searching only item IconThemePaths
+ *   theme_paths   - IconThemePath values already added to theme
+ */
+struct _SniHost {
+    GDBusConnection *conn;
+    GCancellable *cancel;
+    GtkWidget *box, *evbox;
+    int size;
+    gulong press_sid, scroll_sid;
+    gboolean has_watcher;
+
+    gchar *host_name;
+    guint host_own, watcher_watch;
+    guint sig_added, sig_removed;
+    GHashTable *items;
+    GHashTable *pixmaps;
+    GtkIconTheme *theme;
+    GHashTable *theme_paths;
+};
+
+/*
+ * sni_watcher - the process-wide watcher, see sni_watcher_ref().
+ *
+ *   conn      - session bus it is exported on
+ *   refs      - hosts using it
+ *   reg, own  - object registration id and g_bus_own_name id
+ *   watched   - item id -> sni_watched
+ *   host_seen - a host registered with us
+ */
+typedef struct {
+    GDBusConnection *conn;
+    guint refs;
+    guint reg, own;
+    GHashTable *watched;
+    gboolean host_seen;
+} sni_watcher;
+
+static sni_watcher *watcher;
+
+/* Watcher side: one registered item and the watch on its bus name. */
+typedef struct {
+    gchar *id;
+    guint watch;
+} sni_watched;
+
+/*
+ * sni_item - host side: one item shown in the tray.
+ *
+ *   id, bus, path - "<bus><path>" and its two parts
+ *   image    - windowless GtkImage in host->box (we hold a ref)
+ *   sig      - subscription to the item's signals
+ *   cancel   - cancels the in-flight GetAll when the item goes away
+ *   refresh_id - pending sni_item_refresh timeout, or 0
+ *   busy, stale - a GetAll is in flight / a signal arrived since it left
+ *   is_menu  - ItemIsMenu: the left button opens the menu too
+ *   tooltip  - current tooltip text, to skip no-op updates
+ */
+typedef struct {
+    SniHost *host;
+    gchar *id, *bus, *path;
+    GtkWidget *image;
+    guint sig;
+    GCancellable *cancel;
+    guint refresh_id;
+    gboolean busy, stale;
+    gboolean is_menu;
+    gchar *tooltip;
+} sni_item;
+
+static void sni_item_get_all(sni_item *item);
+
+
+/* --------------------------------------------------------------------------
+ * Icon pixmaps
+ * -------------------------------------------------------------------------- */
+
+/*
+ * sni_pixmap_hash / sni_pixmap_equal - hash table functions for (iiay)
+ * variants.  g_variant_hash() only handles basic types, so the serialised
+ * variant (size and pixels) is hashed here with FNV-1a.
+ */
+static guint
+sni_pixmap_hash(gconstpointer key)
+{
+    const guchar *data = g_variant_get_data((GVariant *) key);
+    gsize i, len = g_variant_get_size((GVariant *) key);
+    guint hash = 2166136261u;
+
+    for (i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+static gboolean
+sni_pixmap_equal(gconstpointer a, gconstpointer b)
+{
+    return g_variant_equal(a, b);
+}
+
+/*
+ * sni_pixmap_convert - make a size x size pixbuf from one (iiay) pixmap.
+ *
+ * SNI pixmaps are ARGB32 in network byte order, i.e. A, R, G, B bytes per
+ * pixel; GdkPixbuf wants R, G, B, A.  Returns NULL on malformed data.
+ */
+static GdkPixbuf *
+sni_pixmap_convert(GVariant *pixmap, int size)
+{
+    GVariant *bytes;
+    const guchar *src;
+    guchar *dst;
+    GdkPixbuf *pb, *scaled;
+    gint32 w, h;
+    gsize len, i;
+
+    g_variant_get_child(pixmap, 0, "i", &w);
+    g_variant_get_child(pixmap, 1, "i", &h);
+    bytes = g_variant_get_child_value(pixmap, 2);
+    src = g_variant_get_fixed_array(bytes, &len, 1);
+    if (w <= 0 || h <= 0 || len != (gsize) w * h * 4) {
+        g_variant_unref(bytes);
+        return NULL;
+    }
+    dst = g_malloc(len);
+    for (i = 0; i < len; i += 4) {
+        dst[i]     = src[i + 1];
+        dst[i + 1] = src[i + 2];
+        dst[i + 2] = src[i + 3];
+        dst[i + 3] = src[i];
+    }
+    g_variant_unref(bytes);
+    pb = gdk_pixbuf_new_from_data(dst, GDK_COLORSPACE_RGB, TRUE, 8, w, h,
+        w * 4, (GdkPixbufDestroyNotify) g_free, NULL);
+    if (w == size && h == size)
+        return pb;
+    scaled = gdk_pixbuf_scale_simple(pb, size, size, GDK_INTERP_BILINEAR);
+    g_object_unref(pb);
+    return scaled;
+}
+
+/*
+ * sni_pixmap_get - pick the best pixmap of an a(iiay) array and return its
+ * pixbuf from the cache, converting it on a miss.
+ *
+ * The best pixmap is the smallest one at least host->size wide, else the
+ * largest.  Returns a new reference, or NULL.
+ */
+static GdkPixbuf *
+sni_pixmap_get(SniHost *host, GVariant *pixmaps)
+{
+    GVariant *child, *best = NULL;
+    GdkPixbuf *pb;
+    gint32 w, bw = 0;
+    gsize i, n;
+
+    n = g_variant_n_children(pixmaps);
+    for (i = 0; i < n; i++) {
+        child = g_variant_get_child_value(pixmaps, i);
+        g_variant_get_child(child, 0, "i", &w);
+        if (!best || (bw < host->size && w > bw)
+            || (w >= host->size && w < bw)) {
+            if (best)
+                g_variant_unref(best);
+            best = child;
+            bw = w;
+        } else
+            g_variant_unref(child);
+    }
+    if (!best)
+        return NULL;
+    if ((pb = g_hash_table_lookup(host->pixmaps, best))) {
+        g_variant_unref(best);
+        return g_object_ref(pb);
+    }
+    if (!(pb = sni_pixmap_convert(best, host->size))) {
+        g_variant_unref(best);
+        return NULL;
+    }
+    if (g_hash_table_size(host->pixmaps) >= SNI_PIXMAP_CACHE_MAX)
+        g_hash_table_remove_all(host->pixmaps);
+    /* the table takes over 'best' and one pixbuf reference */
+    g_hash_table_insert(host->pixmaps, best, g_object_ref(pb));
+    return pb;
+}
+
+
+/*
+ * sni_icon_get - pixbuf for an item's IconName or AttentionIconName.
+ *
+ * If the item sent an IconThemePath (@themed) the name is looked up in the
+ * host's private theme first, so an application's own icons win for that
+ * application only.  Everything else goes through fb_pixbuf_new().
+ * Returns a new reference, or NULL.
+ */
+static GdkPixbuf *
+sni_icon_get(SniHost *host, const gchar *name, gboolean themed)
+{
+    GdkPixbuf *pb, *scaled;
+
+    if (name[0] == '/')
+        return fb_pixbuf_new((gchar *) name, (gchar *) name, host->size,
+            host->size, FALSE);
+    if (themed && (pb = gtk_icon_theme_load_icon(host->theme, name,
+                host->size, GTK_ICON_LOOKUP_FORCE_SIZE, NULL))) {
+        if (gdk_pixbuf_get_width(pb) == host->size
+            && gdk_pixbuf_get_height(pb) == host->size)
+            return pb;
+        /* older GTKs ignore FORCE_SIZE for unthemed files */
+        scaled = gdk_pixbuf_scale_simple(pb, host->size, host->size,
+            GDK_INTERP_BILINEAR);
+        g_object_unref(pb);
+        return scaled;
+    }
+    return fb_pixbuf_new((gchar *) name, NULL, host->size, host->size, FALSE);
+}
+
+
+/* --------------------------------------------------------------------------
+ * Host: items
+ * -------------------------------------------------------------------------- */
+
+/*
+ * sni_item_apply - update an item's widget from a GetAll reply (a{sv}).
+ */
+static void
+sni_item_apply(sni_item *item, GVariant *props)
+{
+    SniHost *host = item->host;
+    const gchar *status = NULL, *name = NULL, *aname = NULL;
+    const gchar *title = NULL, *path = NULL;
+    gchar *tip_title = NULL, *tip_body = NULL, *tip;
+    GVariant *pixmap = NULL, *apixmap = NULL, *tooltip = NULL;
+    GdkPixbuf *pb = NULL;
+    gboolean attention, themed;
+
+    ENTER;
+    g_variant_lookup(props, "Status", "&s", &status);
+    g_variant_lookup(props, "IconName", "&s", &name);
+    g_variant_lookup(props, "AttentionIconName", "&s", &aname);
+    g_variant_lookup(props, "Title", "&s", &title);
+    g_variant_lookup(props, "IconThemePath", "&s", &path);
+    g_variant_lookup(props, "ItemIsMenu", "b", &item->is_menu);
+    pixmap = g_variant_lookup_value(props, "IconPixmap",
+        G_VARIANT_TYPE("a(iiay)"));
+    apixmap = g_variant_lookup_value(props, "AttentionIconPixmap",
+        G_VARIANT_TYPE("a(iiay)"));
+    tooltip = g_variant_lookup_value(props, "ToolTip",
+        G_VARIANT_TYPE("(sa(iiay)ss)"));
+
+    if (status && !strcmp(status, "Passive")) {
+        gtk_widget_hide(item->image);
+        goto out;
+    }
+    themed = path && *path;
+    if (themed && !g_hash_table_lookup(host->theme_paths, path)) {
+        gtk_icon_theme_append_search_path(host->theme, path);
+        g_hash_table_insert(host->theme_paths, g_strdup(path),
+            GINT_TO_POINTER(1));
+    }
+    attention = status && !strcmp(status, "NeedsAttention");
+    if (attention && aname && *aname)
+        pb = sni_icon_get(host, aname, themed);
+    if (!pb && attention && apixmap)
+        pb = sni_pixmap_get(host, apixmap);
+    if (!pb && name && *name)
+        pb = sni_icon_get(host, name, themed);
+    if (!pb && pixmap)
+        pb = sni_pixmap_get(host, pixmap);
+    if (!pb)
+        pb = fb_pixbuf_new("image-missing", NULL, host->size, host->size,
+            TRUE);
+    if (gtk_image_get_storage_type(GTK_IMAGE(item->image)) != GTK_IMAGE_PIXBUF
+        || gtk_image_get_pixbuf(GTK_IMAGE(item->image)) != pb)
+        gtk_image_set_from_pixbuf(GTK_IMAGE(item->image), pb);
+    if (pb)
+        g_object_unref(pb);
+
+    if (tooltip)
+        g_variant_get(tooltip, "(&s@a(iiay)ss)", NULL, NULL,
+            &tip_title, &tip_body);
+    if (tip_title && *tip_title && tip_body && *tip_body)
+        tip = g_strdup_printf("%s\n%s", tip_title, tip_body);
+    else if (tip_title && *tip_title)
+        tip = g_strdup(tip_title);
+    else
+        tip = g_strdup(title);
+    if (g_strcmp0(tip, item->tooltip)) {
+        gtk_widget_set_tooltip_text(item->image, tip);
+        g_free(item->tooltip);
+        item->tooltip = tip;
+    } else
+        g_free(tip);
+    g_free(tip_title);
+    g_free(tip_body);
+    gtk_widget_show(item->image);
+
+out:
+    if (pixmap)
+        g_variant_unref(pixmap);
+    if (apixmap)
+        g_variant_unref(apixmap);
+    if (tooltip)
+        g_variant_unref(tooltip);
+    RET();
+}
+
+/*
+ * sni_item_got_all - GetAll reply.  Applies it, and asks again if a signal
+ * arrived while the call was in flight.
+ */
+static void
+sni_item_got_all(GObject *src, GAsyncResult *res, gpointer data)
+{
+    GVariant *ret, *props;
+    GError *err = NULL;
+    sni_item *item = data;
+
+    ENTER;
+    ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(src), res, &err);
+    if (!ret) {
+        /* a cancelled call means 'item' is gone */
+        if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            DBG("GetAll %s: %s\n", item->id, err->message);
+            item->busy = FALSE;
+        }
+        g_error_free(err);
+        RET();
+    }
+    item->busy = FALSE;
+    props = g_variant_get_child_value(ret, 0);
+    sni_item_apply(item, props);
+    g_variant_unref(props);
+    g_variant_unref(ret);
+    if (item->stale)
+        sni_item_get_all(item);
+    RET();
+}
+
+/*
+ * sni_item_get_all - fetch all item properties, unless a fetch is already
+ * in flight (then the reply handler fetches again).
+ */
+static void
+sni_item_get_all(sni_item *item)
+{
+    if (item->busy) {
+        item->stale = TRUE;
+        return;
+    }
+    item->busy = TRUE;
+    item->stale = FALSE;
+    g_dbus_connection_call(item->host->conn, item->bus, item->path,
+        "org.freedesktop.DBus.Properties", "GetAll",
+        g_variant_new("(s)", SNI_ITEM_IFACE), G_VARIANT_TYPE("(a{sv})"),
+        G_DBUS_CALL_FLAGS_NONE, -1, item->cancel, sni_item_got_all, item);
+}
+
+/*
+ * sni_item_refresh - SNI_REFRESH_DELAY timeout after the first of a burst
+ * of item signals.
+ */
+static gboolean
+sni_item_refresh(sni_item *item)
+{
+    item->refresh_id = 0;
+    sni_item_get_all(item);
+    return FALSE;
+}
+
+/*
+ * sni_item_signal - any signal of the item's interface (NewIcon,
+ * NewAttentionIcon, NewStatus, NewTitle, NewToolTip...).  They carry no
+ * useful data, so they only schedule a refresh.
+ */
+static void
+sni_item_signal(GDBusConnection *conn, const gchar *sender,
+    const gchar *path, const gchar *iface, const gchar *signal,
+    GVariant *params, gpointer data)
+{
+    sni_item *item = data;
+
+    DBG("%s %s\n", item->id, signal);
+    if (!item->refresh_id)
+        item->refresh_id = g_timeout_add(SNI_REFRESH_DELAY,
+            (GSourceFunc) sni_item_refresh, item);
+}
+
+/*
+ * sni_item_free - items hash table destroy notify.
+ */
+static void
+sni_item_free(sni_item *item)
+{
+    ENTER;
+    DBG("del %s\n", item->id);
+    g_cancellable_cancel(item->cancel);
+    g_object_unref(item->cancel);
+    g_dbus_connection_signal_unsubscribe(item->host->conn, item->sig);
+    if (item->refresh_id)
+        g_source_remove(item->refresh_id);
+    gtk_widget_destroy(item->image);
+    g_object_unref(item->image);
+    g_free(item->id);
+    g_free(item->bus);
+    g_free(item->path);
+    g_free(item->tooltip);
+    g_free(item);
+    RET();
+}
+
+/*
+ * sni_item_add - start showing a registered item.
+ *
+ * id is "<bus name>[<object path>]"; without a path the item lives at
+ * SNI_ITEM_PATH.  The icon stays hidden until the first GetAll reply.
+ */
+static void
+sni_item_add(SniHost *host, const gchar *id)
+{
+    sni_item *item;
+    const gchar *slash;
+
+    ENTER;
+    if (!*id || g_hash_table_lookup(host->items, id))
+        RET();
+    DBG("add %s\n", id);
+    item = g_new0(sni_item, 1);
+    item->host = host;
+    item->id = g_strdup(id);
+    if ((slash = strchr(id, '/'))) {
+        item->bus = g_strndup(id, slash - id);
+        item->path = g_strdup(slash);
+    } else {
+        item->bus = g_strdup(id);
+        item->path = g_strdup(SNI_ITEM_PATH);
+    }
+    item->cancel = g_cancellable_new();
+    item->image = gtk_image_new();
+    g_object_ref_sink(item->image);
+    gtk_box_pack_end(GTK_BOX(host->box), item->image, FALSE, FALSE, 0);
+    item->sig = g_dbus_connection_signal_subscribe(host->conn, item->bus,
+        SNI_ITEM_IFACE, NULL, item->path, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+        sni_item_signal, item, NULL);
+    g_hash_table_insert(host->items, item->id, item);
+    sni_item_get_all(item);
+    RET();
+}
+
+/*
+ * sni_watcher_signal - StatusNotifierItemRegistered/Unregistered from the
+ * watcher, whoever owns SNI_WATCHER_NAME.
+ */
+static void
+sni_watcher_signal(GDBusConnection *conn, const gchar *sender,
+    const gchar *path, const gchar *iface, const gchar *signal,
+    GVariant *params, gpointer data)
+{
+    SniHost *host = data;
+    const gchar *id;
+
+    if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(s)")))
+        return;
+    g_variant_get(params, "(&s)", &id);
+    if (!strcmp(signal, "StatusNotifierItemRegistered"))
+        sni_item_add(host, id);
+    else
+        g_hash_table_remove(host->items, id);
+}
+
+/*
+ * sni_host_got_items - reply to Get(RegisteredStatusNotifierItems).
+ */
+static void
+sni_host_got_items(GObject *src, GAsyncResult *res, gpointer data)
+{
+    GVariant *ret, *items;
+    GVariantIter iter;
+    GError *err = NULL;
+    const gchar *id;
+
+    ENTER;
+    ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(src), res, &err);
+    if (!ret) {
+        if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_message("tray: can't list StatusNotifierItems: %s",
+                err->message);
+        g_error_free(err);
+        RET();
+    }
+    g_variant_get(ret, "(v)", &items);
+    if (g_variant_is_of_type(items, G_VARIANT_TYPE("as"))) {
+        g_variant_iter_init(&iter, items);
+        while (g_variant_iter_next(&iter, "&s", &id))
+            sni_item_add((SniHost *) data, id);
+    }
+    g_variant_unref(items);
+    g_variant_unref(ret);
+    RET();
+}
+
+/*
+ * sni_watcher_appeared - a watcher (ours or another one) owns the name:
+ * register as host and pick up the items it already knows.
+ */
+static void
+sni_watcher_appeared(GDBusConnection *conn, const gchar *name,
+    const gchar *owner, gpointer data)
+{
+    SniHost *host = data;
+
+    ENTER;
+    DBG("watcher is %s\n", owner);
+    g_dbus_connection_call(conn, SNI_WATCHER_NAME, SNI_WATCHER_PATH,
+        SNI_WATCHER_IFACE, "RegisterStatusNotifierHost",
+        g_variant_new("(s)", host->host_name), NULL,
+        G_DBUS_CALL_FLAGS_NONE, -1, host->cancel, NULL, NULL);
+    g_dbus_connection_call(conn, SNI_WATCHER_NAME, SNI_WATCHER_PATH,
+        "org.freedesktop.DBus.Properties", "Get",
+        g_variant_new("(ss)", SNI_WATCHER_IFACE,
+            "RegisteredStatusNotifierItems"),
+        G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, -1, host->cancel,
+        sni_host_got_items, host);
+    RET();
+}
+
+/*
+ * sni_watcher_vanished - no watcher any more: every item is unregistered.
+ */
+static void
+sni_watcher_vanished(GDBusConnection *conn, const gchar *name,
+    gpointer data)
+{
+    SniHost *host = data;
+
+    ENTER;
+    g_hash_table_remove_all(host->items);
+    RET();
+}
+
+
+/* --------------------------------------------------------------------------
+ * Host: input
+ * -------------------------------------------------------------------------- */
+
+/*
+ * sni_item_at - the visible item whose icon contains (x, y) of evbox's
+ * window, or NULL.
+ */
+static sni_item *
+sni_item_at(SniHost *host, GdkWindow *window, int x, int y)
+{
+    GHashTableIter iter;
+    GtkAllocation *a;
+    sni_item *item;
+
+    if (window != host->evbox->window)
+        return NULL;
+    g_hash_table_iter_init(&iter, host->items);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &item)) {
+        if (!GTK_WIDGET_VISIBLE(item->image))
+            continue;
+        a = &item->image->allocation;
+        if (x >= a->x && x < a->x + a->width
+            && y >= a->y && y < a->y + a->height)
+            return item;
+    }
+    return NULL;
+}
+
+/*
+ * sni_item_call - fire-and-forget method call on an item.
+ */
+static void
+sni_item_call(sni_item *item, const gchar *method, GVariant *params)
+{
+    DBG("%s.%s\n", item->id, method);
+    g_dbus_connection_call(item->host->conn, item->bus, item->path,
+        SNI_ITEM_IFACE, method, params, NULL, G_DBUS_CALL_FLAGS_NONE, -1,
+        item->host->cancel, NULL, NULL);
+}
+
+/*
+ * sni_button_press - evbox "button-press-event": button 1 activates the
+ * item (or opens its menu if ItemIsMenu), 2 secondary-activates it and 3
+ * asks for its context menu.  Ctrl+button 3 is left to the panel menu.
+ */
+static gboolean
+sni_button_press(GtkWidget *widget, GdkEventButton *event, SniHost *host)
+{
+    sni_item *item;
+    GVariant *pos;
+
+    ENTER;
+    if (event->type != GDK_BUTTON_PRESS
+        || !(item = sni_item_at(host, event->window, event->x, event->y)))
+        RET(FALSE);
+    pos = g_variant_new("(ii)", (gint) event->x_root, (gint) event->y_root);
+    if (event->button == 1)
+        sni_item_call(item, item->is_menu ? "ContextMenu" : "Activate", pos);
+    else if (event->button == 2)
+        sni_item_call(item, "SecondaryActivate", pos);
+    else if (event->button == 3 && !(event->state & GDK_CONTROL_MASK))
+        sni_item_call(item, "ContextMenu", pos);
+    else {
+        g_variant_unref(g_variant_ref_sink(pos));
+        RET(FALSE);
+    }
+    RET(TRUE);
+}
+
+/*
+ * sni_scroll - evbox "scroll-event": forwarded to the item as Scroll.
+ */
+static gboolean
+sni_scroll(GtkWidget *widget, GdkEventScroll *event, SniHost *host)
+{
+    sni_item *item;
+    int delta;
+
+    ENTER;
+    if (!(item = sni_item_at(host, event->window, event->x, event->y)))
+        RET(FALSE);
+    delta = (event->direction == GDK_SCROLL_UP
+        || event->direction == GDK_SCROLL_LEFT) ? -1 : 1;
+    sni_item_call(item, "Scroll", g_variant_new("(is)", delta,
+        (event->direction == GDK_SCROLL_UP
+            || event->direction == GDK_SCROLL_DOWN)
+        ? "vertical" : "horizontal"));
+    RET(TRUE);
+}
+
+
+/* --------------------------------------------------------------------------
+ * Watcher
+ * -------------------------------------------------------------------------- */
+
+static void
+sni_watched_free(sni_watched *w)
+{
+    g_bus_unwatch_name(w->watch);
+    g_free(w->id);
+    g_free(w);
+}
+
+/*
+ * sni_watched_vanished - an item's bus name went away: unregister it.
+ */
+static void
+sni_watched_vanished(GDBusConnection *conn, const gchar *name,
+    gpointer data)
+{
+    sni_watched *w = data;
+
+    ENTER;
+    DBG("item %s vanished\n", w->id);
+    g_dbus_connection_emit_signal(conn, NULL, SNI_WATCHER_PATH,
+        SNI_WATCHER_IFACE, "StatusNotifierItemUnregistered",
+        g_variant_new("(s)", w->id), NULL);
+    /* frees w and removes its name watch */
+    g_hash_table_remove(watcher->watched, w->id);
+    RET();
+}
+
+/*
+ * sni_watcher_register_item - RegisterStatusNotifierItem(service).
+ *
+ * 'service' is a bus name (item at SNI_ITEM_PATH) or an object path on the
+ * caller's connection; either way the item id is "<bus name><path>".
+ */
+static void
+sni_watcher_register_item(GDBusMethodInvocation *inv, const gchar *service)
+{
+    const gchar *sender = g_dbus_method_invocation_get_sender(inv);
+    sni_watched *w;
+    gchar *id, *bus;
+
+    ENTER;
+    if (service[0] == '/') {
+        bus = g_strdup(sender);
+        id = g_strconcat(sender, service, NULL);
+    } else {
+        bus = g_strdup(service);
+        id = g_strconcat(service, SNI_ITEM_PATH, NULL);
+    }
+    if (!g_dbus_is_name(bus)) {
+        g_dbus_method_invocation_return_error(inv, G_DBUS_ERROR,
+            G_DBUS_ERROR_INVALID_ARGS, "invalid service %s", service);
+        g_free(bus);
+        g_free(id);
+        RET();
+    }
+    if (!g_hash_table_lookup(watcher->watched, id)) {
+        DBG("register %s\n", id);
+        w = g_new0(sni_watched, 1);
+        w->id = id;
+        g_hash_table_insert(watcher->watched, w->id, w);
+        w->watch = g_bus_watch_name_on_connection(watcher->conn, bus,
+            G_BUS_NAME_WATCHER_FLAGS_NONE, NULL, sni_watched_vanished, w,
+            NULL);
+        g_dbus_connection_emit_signal(watcher->conn, NULL, SNI_WATCHER_PATH,
+            SNI_WATCHER_IFACE, "StatusNotifierItemRegistered",
+            g_variant_new("(s)", id), NULL);
+    } else
+        g_free(id);
+    g_free(bus);
+    g_dbus_method_invocation_return_value(inv, NULL);
+    RET();
+}
+
+static void
+sni_watcher_method(GDBusConnection *conn, const gchar *sender,
+    const gchar *path, const gchar *iface, const gchar *method,
+    GVariant *params, GDBusMethodInvocation *inv, gpointer data)
+{
+    const gchar *service;
+
+    g_variant_get(params, "(&s)", &service);
+    if (!strcmp(method, "RegisterStatusNotifierItem")) {
+        sni_watcher_register_item(inv, service);
+    } else {
+        if (!watcher->host_seen) {
+            watcher->host_seen = TRUE;
+            g_dbus_connection_emit_signal(conn, NULL, SNI_WATCHER_PATH,
+                SNI_WATCHER_IFACE, "StatusNotifierHostRegistered", NULL, NULL);
+        }
+        g_dbus_method_invocation_return_value(inv, NULL);
+    }
+}
+
+static GVariant *
+sni_watcher_get_property(GDBusConnection *conn, const gchar *sender,
+    const gchar *path, const gchar *iface, const gchar *prop,
+    GError **err, gpointer data)
+{
+    GVariantBuilder b;
+    GHashTableIter iter;
+    gpointer id;
+
+    if (!strcmp(prop, "RegisteredStatusNotifierItems")) {
+        g_variant_builder_init(&b, G_VARIANT_TYPE("as"));
+        g_hash_table_iter_init(&iter, watcher->watched);
+        while (g_hash_table_iter_next(&iter, &id, NULL))
+            g_variant_builder_add(&b, "s", id);
+        return g_variant_builder_end(&b);
+    }
+    if (!strcmp(prop, "IsStatusNotifierHostRegistered"))
+        return g_variant_new_boolean(watcher->host_seen);
+    return g_variant_new_int32(0);
+}
+
+static const GDBusInterfaceVTable sni_watcher_vtable = {
+    sni_watcher_method,
+    sni_watcher_get_property,
+    NULL,
+};
+
+/*
+ * sni_watcher_ref - take a reference on the process-wide watcher, creating
+ * it on first use: export the object and ask (politely) for the name.
+ *
+ * Every tray in the process hosts the same items, so they share one
+ * watcher and one table of watched items.  Returns FALSE if the object
+ * can't be exported; the host then works with an outside watcher only.
+ */
+static gboolean
+sni_watcher_ref(GDBusConnection *conn)
+{
+    GDBusNodeInfo *info;
+    GError *err = NULL;
+    guint reg;
+
+    ENTER;
+    if (watcher) {
+        watcher->refs++;
+        RET(TRUE);
+    }
+    info = g_dbus_node_info_new_for_xml(sni_watcher_xml, NULL);
+    reg = g_dbus_connection_register_object(conn, SNI_WATCHER_PATH,
+        info->interfaces[0], &sni_watcher_vtable, NULL, NULL, &err);
+    g_dbus_node_info_unref(info);
+    if (!reg) {
+        ERR("tray: can't export StatusNotifierWatcher: %s\n", err->message);
+        g_error_free(err);
+        RET(FALSE);
+    }
+    watcher = g_new0(sni_watcher, 1);
+    watcher->conn = g_object_ref(conn);
+    watcher->refs = 1;
+    watcher->reg = reg;
+    watcher->watched = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify) sni_watched_free);
+    watcher->own = g_bus_own_name_on_connection(conn, SNI_WATCHER_NAME,
+        G_BUS_NAME_OWNER_FLAGS_NONE, NULL, NULL, NULL, NULL);
+    RET(TRUE);
+}
+
+/*
+ * sni_watcher_unref - drop a reference; the last one releases the name and
+ * the object, and forgets every watched item.
+ */
+static void
+sni_watcher_unref(void)
+{
+    ENTER;
+    if (--watcher->refs)
+        RET();
+    g_bus_unown_name(watcher->own);
+    g_dbus_connection_unregister_object(watcher->conn, watcher->reg);
+    g_hash_table_destroy(watcher->watched);
+    g_object_unref(watcher->conn);
+    g_free(watcher);
+    watcher = NULL;
+    RET();
+}
+
+
+/* --------------------------------------------------------------------------
+ * Public API
+ * -------------------------------------------------------------------------- */
+
+SniHost *
+sni_host_new(GtkWidget *box, GtkWidget *evbox, int size)
+{
+    static int seq;
+    GDBusConnection *conn;
+    SniHost *host;
+    GError *err = NULL;
+
+    ENTER;
+    if (!(conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &err))) {
+        g_message("tray: no session bus, StatusNotifierItems disabled: %s",
+            err->message);
+        g_error_free(err);
+        RET(NULL);
+    }
+    host = g_new0(SniHost, 1);
+    host->conn = conn;
+    host->cancel = g_cancellable_new();
+    host->box = box;
+    host->evbox = evbox;
+    host->size = size;
+    host->items = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+        (GDestroyNotify) sni_item_free);
+    host->pixmaps = g_hash_table_new_full(sni_pixmap_hash, sni_pixmap_equal,
+        (GDestroyNotify) g_variant_unref, g_object_unref);
+    host->theme = gtk_icon_theme_new();
+    gtk_icon_theme_set_search_path(host->theme, NULL, 0);
+    host->theme_paths = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, NULL);
+
+    host->has_watcher = sni_watcher_ref(conn);
+
+    /* host */
+    host->host_name = g_strdup_printf("org.kde.StatusNotifierHost-%d-%d",
+        (int) getpid(), ++seq);
+    host->host_own = g_bus_own_name_on_connection(conn, host->host_name,
+        G_BUS_NAME_OWNER_FLAGS_NONE, NULL, NULL, NULL, NULL);
+    host->sig_added = g_dbus_connection_signal_subscribe(conn,
+        SNI_WATCHER_NAME, SNI_WATCHER_IFACE, "StatusNotifierItemRegistered",
+        SNI_WATCHER_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+        sni_watcher_signal, host, NULL);
+    host->sig_removed = g_dbus_connection_signal_subscribe(conn,
+        SNI_WATCHER_NAME, SNI_WATCHER_IFACE, "StatusNotifierItemUnregistered",
+        SNI_WATCHER_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+        sni_watcher_signal, host, NULL);
+    host->watcher_watch = g_bus_watch_name_on_connection(conn,
+        SNI_WATCHER_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE,
+        sni_watcher_appeared, sni_watcher_vanished, host, NULL);
+
+    gtk_widget_add_events(evbox, GDK_BUTTON_PRESS_MASK | GDK_SCROLL_MASK);
+    host->press_sid = g_signal_connect(G_OBJECT(evbox), "button-press-event",
+        G_CALLBACK(sni_button_press), host);
+    host->scroll_sid = g_signal_connect(G_OBJECT(evbox), "scroll-event",
+        G_CALLBACK(sni_scroll), host);
+    RET(host);
+}
+
+void
+sni_host_free(SniHost *host)
+{
+    ENTER;
+    if (!host)
+        RET();
+    g_signal_handler_disconnect(host->evbox, host->press_sid);
+    g_signal_handler_disconnect(host->evbox, host->scroll_sid);
+    g_cancellable_cancel(host->cancel);
+    g_bus_unwatch_name(host->watcher_watch);
+    g_dbus_connection_signal_unsubscribe(host->conn, host->sig_added);
+    g_dbus_connection_signal_unsubscribe(host->conn, host->sig_removed);
+    g_bus_unown_name(host->host_own);
+    if (host->has_watcher)
+        sni_watcher_unref();
+    g_hash_table_destroy(host->items);
+    g_hash_table_destroy(host->pixmaps);
+    g_hash_table_destroy(host->theme_paths);
+    g_object_unref(host->theme);
+    g_object_unref(host->cancel);
+    g_object_unref(host->conn);
+    g_free(host->host_name);
+    g_free(host);
+    RET();
+}
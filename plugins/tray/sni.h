@@ -0,0 +1,45 @@
+/*
+ * sni.h - StatusNotifierItem host for the tray plugin.
+ *
+ * Hosts freedesktop/KDE StatusNotifierItem icons (the D-Bus successor of
+ * the XEMBED tray) next to the XEMBED sockets.  Icons are windowless
+ * GtkImages packed into the tray's GtkBar, so they are drawn into the
+ * panel's own window: no X window, no reparenting per icon.  Clicks and
+ * scrolls are taken from the plugin's event widget and hit-tested against
+ * the icons' allocations.
+ *
+ * If no org.kde.StatusNotifierWatcher is running on the session bus, the
+ * host provides one itself.  Everything goes through the session bus
+ * named by DBUS_SESSION_BUS_ADDRESS, so a private bus started with
+ * `dbus-daemon --session --print-address` (or `dbus-run-session`) can be
+ * used for testing.
+ */
+
+#ifndef SNI_H
+#define SNI_H
+
+#include <gtk/gtk.h>
+
+typedef struct _SniHost SniHost;
+
+/*
+ * sni_host_new - connect to the session bus and start hosting items.
+ *
+ * Parameters:
+ *   box   - container the icon widgets are packed into (pack_end)
+ *   evbox - windowed ancestor of box whose button/scroll events are used
+ *           to activate icons; icon allocations must be relative to it
+ *   size  - icon size in pixels
+ *
+ * Returns: a new SniHost, or NULL if there is no session bus.
+ *          Free with sni_host_free().
+ */
+SniHost *sni_host_new(GtkWidget *box, GtkWidget *evbox, int size);
+
+/*
+ * sni_host_free - stop hosting: releases the bus names, cancels pending
+ * calls and destroys the icon widgets.
+ */
+void sni_host_free(SniHost *host);
+
+#endif /* SNI_H */
@@ -10,16 +10,43 @@
  * Data source: _NET_CLIENT_LIST (updated via fbev "client_list" signal).
  * Activation:  sends _NET_ACTIVE_WINDOW client message (same as a pager).
  *
+ * Window model:
+ *   The plugin keeps a persistent model of the client windows (title,
+ *   WM_CLASS, desktop) and a menu that is built once and patched in place:
+ *     - "client_list" adds/removes only the windows that appeared or went
+ *       away; properties are fetched once per new window.
+ *     - PropertyNotify on _NET_WM_NAME / WM_NAME / _NET_WM_DESKTOP updates
+ *       the one affected entry (relabel and, if needed, move it).
+ *   Popping the menu up is therefore a map only, independent of the number
+ *   of windows.
+ *
+ *   Entries are kept in a GSequence sorted by (group, header-first, title);
+ *   an entry's position in the sequence is its position in the menu, so
+ *   insertions and moves are O(log n) plus one gtk_menu_reorder_child().
+ *
+ * Grouping:
+ *   Windows are grouped under insensitive header items by desktop (default)
+ *   or by WM_CLASS, or listed flat.  Headers are created with the first
+ *   window of a group and removed with the last.
+ *
+ * Type-ahead:
+ *   Typing while the menu is open filters the list (case-insensitive
+ *   substring match on title or class); BackSpace edits the filter.  The
+ *   filter is cleared when the menu closes.
+ *
  * No new library dependencies -- X11 and EWMH helpers already linked.
  *
  * Configuration (xconf keys):
  *   MaxTitle -- maximum characters of window title shown per menu item
  *               (default: 50; 0 = no limit).
+ *   GroupBy  -- none | desktop | class (default: desktop).
  */
 
 #include <string.h>
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <gdk/gdkkeysyms.h>
 
 #include "panel.h"
 #include "misc.h"
@@ -29,10 +56,68 @@
 //#define DEBUGPRN
 #include "dbg.h"
 
+/* Sticky windows report this desktop; sorts after every real desktop. */
+#define ALL_DESKTOPS  0xFFFFFFFF
+
+/* Menu items that always precede the window entries: filter, empty. */
+#define WL_FIXED_ITEMS 2
+
+enum { WL_GROUP_NONE, WL_GROUP_DESKTOP, WL_GROUP_CLASS };
+
+static xconf_enum group_enum[] = {
+    { .num = WL_GROUP_NONE,    .str = "none" },
+    { .num = WL_GROUP_DESKTOP, .str = "desktop" },
+    { .num = WL_GROUP_CLASS,   .str = "class" },
+    { .num = 0, .str = NULL },
+};
+
+/*
+ * wl_entry -- one window, or one group header, of the model.
+ *
+ * win       - client window; None for group headers.
+ * title     - window title (UTF-8); group label for headers.
+ * fold      - case-folded title, used for sorting and filtering.
+ * wmclass   - res_class of WM_CLASS ("" if unset); group key for headers.
+ * cfold     - case-folded wmclass.
+ * desktop   - _NET_WM_DESKTOP (ALL_DESKTOPS for sticky windows).
+ * item      - GtkMenuItem in priv->menu.
+ * iter      - position in priv->order.
+ * group     - header this window is listed under (NULL when ungrouped).
+ * nwins     - headers: number of windows in the group.
+ * nvisible  - headers: number of those passing the current filter.
+ * gen       - windows: client-list generation in which it was last seen.
+ */
+typedef struct _wl_entry {
+    Window            win;
+    gchar            *title;
+    gchar            *fold;
+    gchar            *wmclass;
+    gchar            *cfold;
+    guint             desktop;
+    GtkWidget        *item;
+    GSequenceIter    *iter;
+    struct _wl_entry *group;
+    int               nwins;
+    int               nvisible;
+    guint             gen;
+} wl_entry;
+
 typedef struct {
     plugin_instance  plugin;
     GtkWidget       *button;
     int              max_title;
+    int              group_by;
+
+    GtkWidget       *menu;       /* persistent popup menu */
+    GtkWidget       *filter_item;/* "Filter: ..." line, shown while typing */
+    GtkWidget       *empty_item; /* "(no windows)" placeholder */
+    GHashTable      *wins;       /* Window -> wl_entry (windows only) */
+    GHashTable      *groups;     /* group key string -> wl_entry (headers) */
+    GSequence       *order;      /* all entries in menu order */
+    GString         *filter;     /* current type-ahead text (case-folded) */
+    guint            gen;        /* client-list generation counter */
+    char           **desk_names;
+    int              desk_namesno;
 } windowlist_priv;
 
 /* ---------------------------------------------------------------------------
@@ -51,93 +136,467 @@ windowlist_activate(Window win)
     XSync(GDK_DISPLAY(), False);
 }
 
+/* Called when the user picks a window from the menu. */
+static void
+wl_item_activate(GtkMenuItem *item, wl_entry *e)
+{
+    ENTER;
+    windowlist_activate(e->win);
+    RET();
+}
+
 /* ---------------------------------------------------------------------------
- * Build and show popup menu
+ * Model ordering and labels
  * ------------------------------------------------------------------------- */
 
-/* Called when the user picks a window from the menu. */
+/* GCompareDataFunc for priv->order: group, then header, then title. */
+static gint
+wl_entry_cmp(gconstpointer pa, gconstpointer pb, gpointer data)
+{
+    const wl_entry *a = pa, *b = pb;
+    windowlist_priv *priv = data;
+    gint r;
+
+    if (priv->group_by == WL_GROUP_DESKTOP && a->desktop != b->desktop)
+        return (a->desktop < b->desktop) ? -1 : 1;
+    if (priv->group_by == WL_GROUP_CLASS && (r = strcmp(a->cfold, b->cfold)))
+        return r;
+    if ((a->win == None) != (b->win == None))
+        return (a->win == None) ? -1 : 1;     /* header leads its group */
+    if ((r = strcmp(a->fold, b->fold)))
+        return r;
+    return (a->win < b->win) ? -1 : (a->win > b->win);
+}
+
+/* Set @e's menu label from its title, truncated to MaxTitle characters. */
+static void
+wl_entry_set_label(windowlist_priv *priv, wl_entry *e)
+{
+    GtkWidget *label;
+    gchar truncated[256];
+    const gchar *text = e->title;
+
+    if (e->win != None && priv->max_title > 0
+        && g_utf8_strlen(e->title, -1) > priv->max_title) {
+        const gchar *end = g_utf8_offset_to_pointer(e->title,
+                                                    priv->max_title - 1);
+        gsize nbytes = (gsize)(end - e->title);
+        if (nbytes >= sizeof(truncated) - 4)
+            nbytes = sizeof(truncated) - 4;
+        memcpy(truncated, e->title, nbytes);
+        /* UTF-8 ellipsis U+2026 */
+        memcpy(truncated + nbytes, "\xe2\x80\xa6", 3);
+        truncated[nbytes + 3] = '\0';
+        text = truncated;
+    }
+    label = gtk_bin_get_child(GTK_BIN(e->item));
+    if (e->win == None) {
+        gchar *markup = g_markup_printf_escaped("<b>%s</b>", text);
+        gtk_label_set_markup(GTK_LABEL(label), markup);
+        g_free(markup);
+    } else
+        gtk_label_set_text(GTK_LABEL(label), text);
+}
+
+/* Replace e->title (taking ownership of @title) and its folded form. */
+static void
+wl_entry_set_title(wl_entry *e, gchar *title)
+{
+    g_free(e->title);
+    g_free(e->fold);
+    e->title = title;
+    e->fold = g_utf8_casefold(title, -1);
+}
+
+/* Move @e's menu item to match its (new) position in priv->order. */
+static void
+wl_entry_reposition(windowlist_priv *priv, wl_entry *e)
+{
+    g_sequence_sort_changed(e->iter, wl_entry_cmp, priv);
+    gtk_menu_reorder_child(GTK_MENU(priv->menu), e->item,
+        g_sequence_iter_get_position(e->iter) + WL_FIXED_ITEMS);
+}
+
+/* Insert @e into priv->order and its item into the menu at that spot. */
+static void
+wl_entry_insert(windowlist_priv *priv, wl_entry *e)
+{
+    e->iter = g_sequence_insert_sorted(priv->order, e, wl_entry_cmp, priv);
+    gtk_menu_shell_insert(GTK_MENU_SHELL(priv->menu), e->item,
+        g_sequence_iter_get_position(e->iter) + WL_FIXED_ITEMS);
+}
+
+/* Remove @e from the menu and the model and free it. */
+static void
+wl_entry_free(windowlist_priv *priv, wl_entry *e)
+{
+    g_sequence_remove(e->iter);
+    gtk_widget_destroy(e->item);
+    g_free(e->title);
+    g_free(e->fold);
+    g_free(e->wmclass);
+    g_free(e->cfold);
+    g_free(e);
+}
+
+/* ---------------------------------------------------------------------------
+ * Groups
+ * ------------------------------------------------------------------------- */
+
+/* Label for a desktop header: "N  name", or "All desktops" for sticky. */
+static gchar *
+wl_desktop_label(windowlist_priv *priv, guint desktop)
+{
+    if (desktop == ALL_DESKTOPS)
+        return g_strdup(_("All desktops"));
+    return g_strdup_printf("%u  %s", desktop + 1,
+        ((int) desktop < priv->desk_namesno) ? priv->desk_names[desktop] : "");
+}
+
+/* Hash key of the group @e belongs to under the current GroupBy. */
+static gchar *
+wl_group_key(windowlist_priv *priv, wl_entry *e)
+{
+    if (priv->group_by == WL_GROUP_DESKTOP)
+        return g_strdup_printf("%u", e->desktop);
+    return g_strdup(e->cfold);
+}
+
+/* Attach window @e to its group, creating the header on first use. */
+static void
+wl_group_attach(windowlist_priv *priv, wl_entry *e)
+{
+    wl_entry *h;
+    gchar *key;
+
+    if (priv->group_by == WL_GROUP_NONE)
+        return;
+    key = wl_group_key(priv, e);
+    if (!(h = g_hash_table_lookup(priv->groups, key))) {
+        h = g_new0(wl_entry, 1);
+        h->win = None;
+        h->desktop = e->desktop;
+        h->wmclass = g_strdup(e->wmclass);
+        h->cfold = g_strdup(e->cfold);
+        wl_entry_set_title(h, (priv->group_by == WL_GROUP_DESKTOP)
+            ? wl_desktop_label(priv, e->desktop) : g_strdup(e->wmclass));
+        h->item = gtk_menu_item_new_with_label("");
+        gtk_widget_set_sensitive(h->item, FALSE);
+        wl_entry_set_label(priv, h);
+        gtk_widget_show(h->item);
+        wl_entry_insert(priv, h);
+        g_hash_table_insert(priv->groups, key, h);
+    } else
+        g_free(key);
+    h->nwins++;
+    e->group = h;
+}
+
+/* Detach window @e from its group; the last window removes the header. */
+static void
+wl_group_detach(windowlist_priv *priv, wl_entry *e)
+{
+    wl_entry *h = e->group;
+    gchar *key;
+
+    if (!h)
+        return;
+    e->group = NULL;
+    if (--h->nwins > 0)
+        return;
+    key = wl_group_key(priv, h);
+    g_hash_table_remove(priv->groups, key);
+    g_free(key);
+    wl_entry_free(priv, h);
+}
+
+/* Refresh desktop names and relabel desktop headers in place. */
+static void
+wl_desktop_names(GtkWidget *widget, windowlist_priv *priv)
+{
+    GHashTableIter it;
+    gpointer h;
+
+    ENTER;
+    if (priv->desk_names)
+        g_strfreev(priv->desk_names);
+    priv->desk_namesno = 0;
+    priv->desk_names = get_utf8_property_list(GDK_ROOT_WINDOW(),
+        a_NET_DESKTOP_NAMES, &priv->desk_namesno);
+    if (priv->group_by != WL_GROUP_DESKTOP)
+        RET();
+    g_hash_table_iter_init(&it, priv->groups);
+    while (g_hash_table_iter_next(&it, NULL, &h)) {
+        wl_entry_set_title(h, wl_desktop_label(priv, ((wl_entry *) h)->desktop));
+        wl_entry_set_label(priv, h);
+    }
+    RET();
+}
+
+/* ---------------------------------------------------------------------------
+ * Filtering
+ * ------------------------------------------------------------------------- */
+
+/*
+ * wl_apply_filter -- show the entries matching priv->filter.
+ *
+ * Windows match when the folded filter is a substring of the folded title
+ * or class; headers are shown when at least one of their windows is.
+ */
 static void
-wl_item_activate(GtkMenuItem *item, gpointer data)
+wl_apply_filter(windowlist_priv *priv)
 {
-    Window win = (Window)(gulong) data;
+    GSequenceIter *it;
+    wl_entry *e;
+    const gchar *f = priv->filter->str;
+    int nvisible = 0;
+
+    for (it = g_sequence_get_begin_iter(priv->order);
+         !g_sequence_iter_is_end(it); it = g_sequence_iter_next(it)) {
+        e = g_sequence_get(it);
+        if (e->win == None)
+            e->nvisible = 0;
+    }
+    for (it = g_sequence_get_begin_iter(priv->order);
+         !g_sequence_iter_is_end(it); it = g_sequence_iter_next(it)) {
+        e = g_sequence_get(it);
+        if (e->win == None)
+            continue;
+        if (!*f || strstr(e->fold, f) || strstr(e->cfold, f)) {
+            gtk_widget_show(e->item);
+            if (e->group)
+                e->group->nvisible++;
+            nvisible++;
+        } else
+            gtk_widget_hide(e->item);
+    }
+    for (it = g_sequence_get_begin_iter(priv->order);
+         !g_sequence_iter_is_end(it); it = g_sequence_iter_next(it)) {
+        e = g_sequence_get(it);
+        if (e->win == None) {
+            if (e->nvisible)
+                gtk_widget_show(e->item);
+            else
+                gtk_widget_hide(e->item);
+        }
+    }
+
+    if (*f) {
+        gchar *markup = g_markup_printf_escaped("<i>%s %s</i>",
+            _("Filter:"), f);
+        gtk_label_set_markup(GTK_LABEL(
+            gtk_bin_get_child(GTK_BIN(priv->filter_item))), markup);
+        g_free(markup);
+        gtk_widget_show(priv->filter_item);
+    } else
+        gtk_widget_hide(priv->filter_item);
+    if (nvisible)
+        gtk_widget_hide(priv->empty_item);
+    else
+        gtk_widget_show(priv->empty_item);
+}
+
+/* Key handler on the popup: printable keys extend the filter. */
+static gboolean
+wl_menu_key_press(GtkWidget *menu, GdkEventKey *event, windowlist_priv *priv)
+{
+    gunichar c;
+    gchar buf[8], *fold;
+    gint len;
+
     ENTER;
-    windowlist_activate(win);
+    if (event->keyval == GDK_BackSpace) {
+        if (!priv->filter->len)
+            RET(TRUE);
+        /* drop the last UTF-8 character */
+        len = g_utf8_prev_char(priv->filter->str + priv->filter->len)
+            - priv->filter->str;
+        g_string_truncate(priv->filter, len);
+        wl_apply_filter(priv);
+        RET(TRUE);
+    }
+    if (event->state & (GDK_CONTROL_MASK | GDK_MOD1_MASK))
+        RET(FALSE);
+    c = gdk_keyval_to_unicode(event->keyval);
+    if (!c || !g_unichar_isprint(c))
+        RET(FALSE);   /* navigation, Return, Escape: let GtkMenu have it */
+    len = g_unichar_to_utf8(c, buf);
+    fold = g_utf8_casefold(buf, len);
+    g_string_append(priv->filter, fold);
+    g_free(fold);
+    wl_apply_filter(priv);
+    RET(TRUE);
+}
+
+/* Menu closed: drop the filter so the next popup shows everything. */
+static void
+wl_menu_unmap(GtkWidget *menu, windowlist_priv *priv)
+{
+    ENTER;
+    if (priv->filter->len) {
+        g_string_truncate(priv->filter, 0);
+        wl_apply_filter(priv);
+    }
     RET();
 }
 
+/* ---------------------------------------------------------------------------
+ * Window tracking
+ * ------------------------------------------------------------------------- */
+
+/* Fetch the window title: _NET_WM_NAME, WM_NAME, or "(untitled)". */
+static gchar *
+wl_get_title(Window win)
+{
+    gchar *title;
+
+    title = get_utf8_property(win, a_NET_WM_NAME);
+    if (!title)
+        title = get_textproperty(win, XA_WM_NAME);
+    if (!title)
+        title = g_strdup("(untitled)");
+    return title;
+}
+
+/* Create the model entry and menu item for a newly listed window. */
+static wl_entry *
+wl_window_add(windowlist_priv *priv, Window win)
+{
+    wl_entry *e;
+    XClassHint ch;
+
+    e = g_new0(wl_entry, 1);
+    e->win = win;
+    wl_entry_set_title(e, wl_get_title(win));
+    e->wmclass = NULL;
+    if (XGetClassHint(GDK_DISPLAY(), win, &ch)) {
+        e->wmclass = g_strdup(ch.res_class ? ch.res_class : "");
+        XFree(ch.res_name);
+        XFree(ch.res_class);
+    }
+    if (!e->wmclass)
+        e->wmclass = g_strdup("");
+    e->cfold = g_utf8_casefold(e->wmclass, -1);
+    e->desktop = get_net_wm_desktop(win);
+
+    /* same mask as the taskbar so neither clobbers the other's selection */
+    XSelectInput(GDK_DISPLAY(), win, PropertyChangeMask | StructureNotifyMask);
+
+    e->item = gtk_menu_item_new_with_label("");
+    wl_entry_set_label(priv, e);
+    g_signal_connect(G_OBJECT(e->item), "activate",
+                     G_CALLBACK(wl_item_activate), e);
+    wl_group_attach(priv, e);
+    wl_entry_insert(priv, e);
+    g_hash_table_insert(priv->wins, &e->win, e);
+    return e;
+}
+
+/* Remove a window's entry (and its header if it was the last one). */
 static void
-wl_show_menu(windowlist_priv *priv)
+wl_window_del(windowlist_priv *priv, wl_entry *e)
+{
+    wl_group_detach(priv, e);
+    wl_entry_free(priv, e);
+}
+
+/* GHRFunc: drop windows not seen in the latest _NET_CLIENT_LIST. */
+static gboolean
+wl_window_stale(gpointer key, wl_entry *e, windowlist_priv *priv)
 {
-    GtkWidget   *menu;
-    Window      *wins;
-    int          nwins = 0;
-    int          i;
-    gchar        truncated[256];
+    if (e->gen == priv->gen)
+        return FALSE;
+    wl_window_del(priv, e);
+    return TRUE;
+}
 
+/*
+ * wl_net_client_list -- "client_list" FbEv handler.
+ *
+ * Adds entries only for windows that are new and drops the ones that are
+ * gone; existing entries are kept untouched.
+ */
+static void
+wl_net_client_list(GtkWidget *widget, windowlist_priv *priv)
+{
+    Window *wins;
+    int nwins = 0, i;
+    wl_entry *e;
+
+    ENTER;
+    priv->gen++;
     wins = (Window *) get_xaproperty(GDK_ROOT_WINDOW(),
                                      a_NET_CLIENT_LIST,
                                      XA_WINDOW, &nwins);
-
-    menu = gtk_menu_new();
-
-    if (!wins || nwins == 0) {
-        GtkWidget *empty = gtk_menu_item_new_with_label("(no windows)");
-        gtk_widget_set_sensitive(empty, FALSE);
-        gtk_menu_shell_append(GTK_MENU_SHELL(menu), empty);
-    } else {
-        for (i = 0; i < nwins; i++) {
-            gchar     *title;
-            GtkWidget *item;
-            glong      len;
-
-            /* Skip the panel itself. */
-            if (FBPANEL_WIN(wins[i]))
-                continue;
-
-            title = get_utf8_property(wins[i], a_NET_WM_NAME);
-            if (!title)
-                title = get_textproperty(wins[i], XA_WM_NAME);
-            if (!title)
-                title = g_strdup("(untitled)");
-
-            len = g_utf8_strlen(title, -1);
-            if (priv->max_title > 0 && len > priv->max_title) {
-                const gchar *end = g_utf8_offset_to_pointer(title,
-                                                    priv->max_title - 1);
-                gsize nbytes = (gsize)(end - title);
-                if (nbytes >= sizeof(truncated) - 4)
-                    nbytes = sizeof(truncated) - 4;
-                memcpy(truncated, title, nbytes);
-                /* UTF-8 ellipsis U+2026 */
-                memcpy(truncated + nbytes, "\xe2\x80\xa6", 3);
-                truncated[nbytes + 3] = '\0';
-                item = gtk_menu_item_new_with_label(truncated);
-            } else {
-                item = gtk_menu_item_new_with_label(title);
-            }
-            g_free(title);
-
-            /* Store window ID as gpointer (safe: Window is gulong). */
-            g_signal_connect(G_OBJECT(item), "activate",
-                             G_CALLBACK(wl_item_activate),
-                             (gpointer)(gulong) wins[i]);
-            gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
-        }
-        XFree(wins);
+    for (i = 0; wins && i < nwins; i++) {
+        /* Skip the panel itself. */
+        if (FBPANEL_WIN(wins[i]))
+            continue;
+        if (!(e = g_hash_table_lookup(priv->wins, &wins[i])))
+            e = wl_window_add(priv, wins[i]);
+        e->gen = priv->gen;
     }
+    if (wins)
+        XFree(wins);
+    g_hash_table_foreach_remove(priv->wins, (GHRFunc) wl_window_stale, priv);
+    wl_apply_filter(priv);
+    RET();
+}
+
+/* Handle a property change on one tracked window. */
+static void
+wl_propertynotify(windowlist_priv *priv, XPropertyEvent *ev)
+{
+    wl_entry *e;
+    Window win = ev->window;
+
+    if (!(e = g_hash_table_lookup(priv->wins, &win)))
+        return;
+    if (ev->atom == a_NET_WM_NAME || ev->atom == XA_WM_NAME) {
+        wl_entry_set_title(e, wl_get_title(win));
+        wl_entry_set_label(priv, e);
+        wl_entry_reposition(priv, e);
+    } else if (ev->atom == a_NET_WM_DESKTOP) {
+        guint desktop = get_net_wm_desktop(win);
+
+        if (desktop == e->desktop)
+            return;
+        /* the entry must be in its new place before a new header is
+         * inserted sorted next to it */
+        if (priv->group_by == WL_GROUP_DESKTOP)
+            wl_group_detach(priv, e);
+        e->desktop = desktop;
+        wl_entry_reposition(priv, e);
+        if (priv->group_by == WL_GROUP_DESKTOP)
+            wl_group_attach(priv, e);
+    } else
+        return;
+    if (priv->filter->len)
+        wl_apply_filter(priv);
+}
 
-    gtk_widget_show_all(menu);
-    gtk_menu_popup(GTK_MENU(menu), NULL, NULL, NULL, NULL, 1,
-                   gtk_get_current_event_time());
+/* GDK filter: route PropertyNotify of client windows to the model. */
+static GdkFilterReturn
+wl_event_filter(XEvent *xev, GdkEvent *event, windowlist_priv *priv)
+{
+    if (xev->type == PropertyNotify
+        && xev->xproperty.window != GDK_ROOT_WINDOW())
+        wl_propertynotify(priv, &xev->xproperty);
+    return GDK_FILTER_CONTINUE;
 }
 
+/* ---------------------------------------------------------------------------
+ * Show popup menu
+ * ------------------------------------------------------------------------- */
+
 static gboolean
 wl_button_clicked(GtkWidget *widget, GdkEventButton *event,
                   windowlist_priv *priv)
 {
     ENTER;
     if (event->type == GDK_BUTTON_PRESS && event->button == 1)
-        wl_show_menu(priv);
+        gtk_menu_popup(GTK_MENU(priv->menu), NULL, NULL, NULL, NULL, 1,
+                       gtk_get_current_event_time());
     RET(FALSE);
 }
 
@@ -153,9 +612,29 @@ windowlist_constructor(plugin_instance *p)
     ENTER;
     priv = (windowlist_priv *) p;
     priv->max_title = 50;
+    priv->group_by = WL_GROUP_DESKTOP;
 
     XCG(p->xc, "MaxTitle", &priv->max_title, int);
     if (priv->max_title < 0) priv->max_title = 0;
+    XCG(p->xc, "GroupBy", &priv->group_by, enum, group_enum);
+
+    priv->wins   = g_hash_table_new(g_int_hash, g_int_equal);
+    priv->groups = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                         g_free, NULL);
+    priv->order  = g_sequence_new(NULL);
+    priv->filter = g_string_new(NULL);
+
+    priv->menu = gtk_menu_new();
+    priv->filter_item = gtk_menu_item_new_with_label("");
+    gtk_widget_set_sensitive(priv->filter_item, FALSE);
+    gtk_menu_shell_append(GTK_MENU_SHELL(priv->menu), priv->filter_item);
+    priv->empty_item = gtk_menu_item_new_with_label("(no windows)");
+    gtk_widget_set_sensitive(priv->empty_item, FALSE);
+    gtk_menu_shell_append(GTK_MENU_SHELL(priv->menu), priv->empty_item);
+    g_signal_connect(G_OBJECT(priv->menu), "key-press-event",
+                     G_CALLBACK(wl_menu_key_press), priv);
+    g_signal_connect(G_OBJECT(priv->menu), "unmap",
+                     G_CALLBACK(wl_menu_unmap), priv);
 
     priv->button = gtk_button_new_with_label("Win");
     gtk_button_set_relief(GTK_BUTTON(priv->button), GTK_RELIEF_NONE);
@@ -170,14 +649,41 @@ windowlist_constructor(plugin_instance *p)
     gtk_container_add(GTK_CONTAINER(p->pwid), priv->button);
     gtk_widget_show(priv->button);
 
+    gdk_window_add_filter(NULL, (GdkFilterFunc) wl_event_filter, priv);
+    g_signal_connect(G_OBJECT(fbev), "client_list",
+                     G_CALLBACK(wl_net_client_list), priv);
+    g_signal_connect(G_OBJECT(fbev), "desktop_names",
+                     G_CALLBACK(wl_desktop_names), priv);
+    g_signal_connect(G_OBJECT(fbev), "number_of_desktops",
+                     G_CALLBACK(wl_desktop_names), priv);
+
+    wl_desktop_names(NULL, priv);
+    wl_net_client_list(NULL, priv);
+
     RET(1);
 }
 
 static void
 windowlist_destructor(plugin_instance *p)
 {
+    windowlist_priv *priv = (windowlist_priv *) p;
+
     ENTER;
-    (void) p;
+    gdk_window_remove_filter(NULL, (GdkFilterFunc) wl_event_filter, priv);
+    g_signal_handlers_disconnect_by_func(G_OBJECT(fbev),
+                                         wl_net_client_list, priv);
+    g_signal_handlers_disconnect_by_func(G_OBJECT(fbev),
+                                         wl_desktop_names, priv);
+    /* a generation no window carries: every entry is stale */
+    priv->gen++;
+    g_hash_table_foreach_remove(priv->wins, (GHRFunc) wl_window_stale, priv);
+    g_hash_table_destroy(priv->wins);
+    g_hash_table_destroy(priv->groups);
+    g_sequence_free(priv->order);
+    g_string_free(priv->filter, TRUE);
+    gtk_widget_destroy(priv->menu);
+    if (priv->desk_names)
+        g_strfreev(priv->desk_names);
     RET();
 }
 